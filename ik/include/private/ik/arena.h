@@ -0,0 +1,62 @@
+/*!
+ * @file arena.h
+ * @brief Bump allocator for scratch memory that is needed during solve().
+ *
+ * Solving must not allocate from the heap (see IKAPI.heap). Anything a solver
+ * needs for the duration of a single solve is instead carved out of its arena,
+ * which is reset at the start of every solve. The arena only grows in
+ * arena_reserve(), which must be called outside of solve(), typically in
+ * rebuild().
+ *
+ * If a solve asks for more than the arena holds, arena_alloc() returns NULL
+ * and remembers how much would have been needed, so the next call to
+ * arena_reserve() can make enough room.
+ *
+ * The arena is not thread safe. Allocate everything on the thread that
+ * entered solve() before handing work to the thread pool.
+ */
+#ifndef IK_ARENA_H
+#define IK_ARENA_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+struct arena_t
+{
+    char* block;
+    uintptr_t capacity;
+    uintptr_t used;
+    /* Largest amount of memory any solve tried to use */
+    uintptr_t required;
+};
+
+IK_PRIVATE_API void
+arena_construct(struct arena_t* arena);
+
+IK_PRIVATE_API void
+arena_destruct(struct arena_t* arena);
+
+/*!
+ * @brief Makes sure the arena holds at least size bytes, as well as the
+ * amount of memory previous solves needed. Resets the arena.
+ * @note Allocates from the heap. Never call this from within solve().
+ */
+IK_PRIVATE_API ikret_t
+arena_reserve(struct arena_t* arena, uintptr_t size);
+
+/*!
+ * @brief Releases everything that was allocated from the arena.
+ */
+IK_PRIVATE_API void
+arena_reset(struct arena_t* arena);
+
+/*!
+ * @return Returns memory aligned to 16 bytes, or NULL if the arena is full.
+ */
+IK_PRIVATE_API void*
+arena_alloc(struct arena_t* arena, uintptr_t size);
+
+C_END
+
+#endif /* IK_ARENA_H */
@@ -16,6 +16,23 @@ C_BEGIN
 IK_PRIVATE_API char**
 get_backtrace(int* size);
 
+/*!
+ * @brief Stores the return addresses of up to max_frames frames of the
+ * current stack. Like with get_backtrace(), the first frame is this function
+ * itself. Much cheaper than get_backtrace(), since no symbols are looked up.
+ * @return Returns the number of frames stored.
+ */
+IK_PRIVATE_API int
+get_backtrace_frames(void** frames, int max_frames);
+
+/*!
+ * @brief Looks up the symbols of frames returned by get_backtrace_frames().
+ * @return Returns an array of size strings, which must be freed with free().
+ * Returns NULL on failure.
+ */
+IK_PRIVATE_API char**
+get_backtrace_symbols(void* const* frames, int size);
+
 C_END
 
 #endif /* LIGHTSHIP_UTIL_BACKTRACE_H */
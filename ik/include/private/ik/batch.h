@@ -0,0 +1,119 @@
+/*!
+ * @file batch.h
+ * @brief Applies the same vec3/quat operation to N elements at once.
+ *
+ * The vec3_static and quat_static functions operate on a single element and
+ * take ikreal_t[3]/[4] pointers. The batch kernels instead operate on
+ * structure-of-arrays data (one array per component), which is the layout the
+ * solve program (see program.h) uses. This allows the kernels to process
+ * several elements per instruction.
+ *
+ * Depending on the build settings and on the CPU the library is running on,
+ * an SSE2, AVX2 or NEON implementation is selected when the library is
+ * initialized. The scalar fallback is used until then, or if none of the
+ * instruction sets are available (or IK_PRECISION is "long double").
+ *
+ * All kernels produce the same results as their single element counterparts,
+ * up to rounding.
+ */
+#ifndef IK_BATCH_H
+#define IK_BATCH_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+/*
+ * Callers that have to gather their data into temporary arrays first should
+ * do so in blocks of this many elements.
+ */
+#define BATCH_BLOCK 32
+
+struct batch_kernels_t
+{
+    const char* name;
+
+    /* out[i] = |(x[i], y[i], z[i])| */
+    void (*length)(ikreal_t* out,
+                   const ikreal_t* x, const ikreal_t* y, const ikreal_t* z,
+                   uint32_t n);
+
+    /* Same semantics as ik_vec3_static_normalize() */
+    void (*normalize)(ikreal_t* x, ikreal_t* y, ikreal_t* z, uint32_t n);
+
+    /* Rotates vector i by quaternion i. Same as ik_vec3_static_rotate() */
+    void (*rotate)(ikreal_t* x, ikreal_t* y, ikreal_t* z,
+                   const ikreal_t* qx, const ikreal_t* qy, const ikreal_t* qz, const ikreal_t* qw,
+                   uint32_t n);
+
+    /* a[i] = a[i] * b[i]. Same as ik_quat_static_mul_quat() */
+    void (*quat_mul)(ikreal_t* ax, ikreal_t* ay, ikreal_t* az, ikreal_t* aw,
+                     const ikreal_t* bx, const ikreal_t* by, const ikreal_t* bz, const ikreal_t* bw,
+                     uint32_t n);
+
+    /*
+     * Converts the unit quaternion and translation i into the 3x4 row major
+     * matrix i. m[r*4+c] is the array of the element in row r and column c,
+     * the translation is in column 3.
+     */
+    void (*to_matrix)(ikreal_t* const m[12],
+                      const ikreal_t* qx, const ikreal_t* qy, const ikreal_t* qz, const ikreal_t* qw,
+                      const ikreal_t* px, const ikreal_t* py, const ikreal_t* pz,
+                      uint32_t n);
+
+    /*
+     * a[i] = a[i] * b[i], where both are 3x4 matrices laid out like in
+     * to_matrix() and the missing row is (0, 0, 0, 1).
+     */
+    void (*matrix_mul)(ikreal_t* const a[12], const ikreal_t* const b[12], uint32_t n);
+
+    /*
+     * Solves two bone problem i in closed form. upper is the length of the
+     * bone from the base to the middle joint, lower the length of the bone
+     * from the middle joint to the tip. The tip is placed on the target, or
+     * as close to it as the bones reach, and the middle joint bends toward
+     * the pole. Writes the positions of the middle joint and the tip, which
+     * are in the same space as base, target and pole.
+     */
+    void (*two_bone)(ikreal_t* const mid[3], ikreal_t* const tip[3],
+                     const ikreal_t* const base[3], const ikreal_t* const target[3],
+                     const ikreal_t* const pole[3],
+                     const ikreal_t* upper, const ikreal_t* lower, uint32_t n);
+
+    /*
+     * Aims bone i of the given length from its base at its target and
+     * writes the position of its tip, (length, 0, 0) away from the base if
+     * the target is on the base. If rotation[0] isn't NULL, also writes the
+     * shortest rotation from forward to the new direction of the bone.
+     */
+    void (*one_bone)(ikreal_t* const tip[3], ikreal_t* const rotation[4],
+                     const ikreal_t* const base[3], const ikreal_t* const target[3],
+                     const ikreal_t* const forward[3], const ikreal_t* length, uint32_t n);
+};
+
+/*!
+ * @brief Selects the fastest kernels supported by the CPU. Called when the
+ * library is initialized.
+ */
+IK_PRIVATE_API void
+batch_init(void);
+
+/*!
+ * @brief The kernels selected by batch_init().
+ */
+IK_PRIVATE_API const struct batch_kernels_t*
+batch_kernels(void);
+
+/* Implementations. The ones not compiled in return NULL */
+IK_PRIVATE_API const struct batch_kernels_t*
+batch_kernels_scalar(void);
+IK_PRIVATE_API const struct batch_kernels_t*
+batch_kernels_sse2(void);
+IK_PRIVATE_API const struct batch_kernels_t*
+batch_kernels_avx2(void);
+IK_PRIVATE_API const struct batch_kernels_t*
+batch_kernels_neon(void);
+
+C_END
+
+#endif /* IK_BATCH_H */
@@ -0,0 +1,379 @@
+/*
+ * Generates the batch kernels (see batch.h) for one instruction set. There is
+ * intentionally no include guard. Before including this file, define:
+ *
+ *   BATCH_PREFIX(name)    Prefix for the generated functions
+ *   BATCH_NAME            Name of the instruction set, as a string
+ *   BATCH_WIDTH           Number of ikreal_t's per vector register
+ *   bvec_t                The vector register type
+ *   BLOAD(p), BSTORE(p,v) Unaligned load and store
+ *   BSET1(s)              Broadcast a scalar to all lanes
+ *   BADD, BSUB, BMUL, BDIV, BSQRT, BMIN, BMAX
+ *   BCMPEQ(a,b)           All bits set in lanes where a == b
+ *   BSELECT(mask,a,b)     Lanes of a where mask is set, lanes of b otherwise
+ *
+ * The remaining elements that don't fill a whole register are processed by
+ * the scalar kernels.
+ */
+
+#include "ik/batch.h"
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(length)(ikreal_t* out,
+                     const ikreal_t* x, const ikreal_t* y, const ikreal_t* z,
+                     uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t vx = BLOAD(x + i), vy = BLOAD(y + i), vz = BLOAD(z + i);
+        BSTORE(out + i, BSQRT(BADD(BADD(BMUL(vx, vx), BMUL(vy, vy)), BMUL(vz, vz))));
+    }
+    if (i != n)
+        batch_kernels_scalar()->length(out + i, x + i, y + i, z + i, n - i);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(normalize)(ikreal_t* x, ikreal_t* y, ikreal_t* z, uint32_t n)
+{
+    const bvec_t zero = BSET1(0.0);
+    const bvec_t one = BSET1(1.0);
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t vx = BLOAD(x + i), vy = BLOAD(y + i), vz = BLOAD(z + i);
+        bvec_t length = BSQRT(BADD(BADD(BMUL(vx, vx), BMUL(vy, vy)), BMUL(vz, vz)));
+        bvec_t is_zero = BCMPEQ(length, zero);
+        bvec_t inv = BDIV(one, BSELECT(is_zero, one, length));
+
+        /* Zero length vectors become (1, 0, 0), y and z are already 0 */
+        BSTORE(x + i, BSELECT(is_zero, one, BMUL(vx, inv)));
+        BSTORE(y + i, BMUL(vy, inv));
+        BSTORE(z + i, BMUL(vz, inv));
+    }
+    if (i != n)
+        batch_kernels_scalar()->normalize(x + i, y + i, z + i, n - i);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(rotate)(ikreal_t* x, ikreal_t* y, ikreal_t* z,
+                     const ikreal_t* qx, const ikreal_t* qy, const ikreal_t* qz, const ikreal_t* qw,
+                     uint32_t n)
+{
+    const bvec_t two = BSET1(2.0);
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t vx = BLOAD(x + i), vy = BLOAD(y + i), vz = BLOAD(z + i);
+        bvec_t ux = BLOAD(qx + i), uy = BLOAD(qy + i), uz = BLOAD(qz + i), w = BLOAD(qw + i);
+
+        /* v' = (w^2 - u.u)v + 2(u.v)u + 2w(u x v) */
+        bvec_t uu = BADD(BADD(BMUL(ux, ux), BMUL(uy, uy)), BMUL(uz, uz));
+        bvec_t uv2 = BMUL(two, BADD(BADD(BMUL(ux, vx), BMUL(uy, vy)), BMUL(uz, vz)));
+        bvec_t s = BSUB(BMUL(w, w), uu);
+        bvec_t w2 = BMUL(two, w);
+        bvec_t cx = BSUB(BMUL(uy, vz), BMUL(uz, vy));
+        bvec_t cy = BSUB(BMUL(uz, vx), BMUL(ux, vz));
+        bvec_t cz = BSUB(BMUL(ux, vy), BMUL(uy, vx));
+
+        BSTORE(x + i, BADD(BADD(BMUL(s, vx), BMUL(uv2, ux)), BMUL(w2, cx)));
+        BSTORE(y + i, BADD(BADD(BMUL(s, vy), BMUL(uv2, uy)), BMUL(w2, cy)));
+        BSTORE(z + i, BADD(BADD(BMUL(s, vz), BMUL(uv2, uz)), BMUL(w2, cz)));
+    }
+    if (i != n)
+        batch_kernels_scalar()->rotate(x + i, y + i, z + i, qx + i, qy + i, qz + i, qw + i, n - i);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(quat_mul)(ikreal_t* ax, ikreal_t* ay, ikreal_t* az, ikreal_t* aw,
+                       const ikreal_t* bx, const ikreal_t* by, const ikreal_t* bz, const ikreal_t* bw,
+                       uint32_t n)
+{
+    const bvec_t zero = BSET1(0.0);
+    const bvec_t one = BSET1(1.0);
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t x1 = BLOAD(ax + i), y1 = BLOAD(ay + i), z1 = BLOAD(az + i), w1 = BLOAD(aw + i);
+        bvec_t x2 = BLOAD(bx + i), y2 = BLOAD(by + i), z2 = BLOAD(bz + i), w2 = BLOAD(bw + i);
+        bvec_t x, y, z, w, mag, is_zero, inv;
+
+        x = BADD(BADD(BMUL(x1, w2), BMUL(x2, w1)), BSUB(BMUL(y1, z2), BMUL(y2, z1)));
+        y = BADD(BADD(BMUL(y1, w2), BMUL(y2, w1)), BSUB(BMUL(z1, x2), BMUL(z2, x1)));
+        z = BADD(BADD(BMUL(z1, w2), BMUL(z2, w1)), BSUB(BMUL(x1, y2), BMUL(x2, y1)));
+        w = BSUB(BMUL(w1, w2), BADD(BADD(BMUL(x1, x2), BMUL(y1, y2)), BMUL(z1, z2)));
+
+        /* A quaternion with a magnitude of 0 stays 0 */
+        mag = BSQRT(BADD(BADD(BMUL(x, x), BMUL(y, y)), BADD(BMUL(z, z), BMUL(w, w))));
+        is_zero = BCMPEQ(mag, zero);
+        inv = BSELECT(is_zero, zero, BDIV(one, BSELECT(is_zero, one, mag)));
+
+        BSTORE(ax + i, BMUL(x, inv));
+        BSTORE(ay + i, BMUL(y, inv));
+        BSTORE(az + i, BMUL(z, inv));
+        BSTORE(aw + i, BMUL(w, inv));
+    }
+    if (i != n)
+        batch_kernels_scalar()->quat_mul(ax + i, ay + i, az + i, aw + i, bx + i, by + i, bz + i, bw + i, n - i);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(to_matrix)(ikreal_t* const m[12],
+                        const ikreal_t* qx, const ikreal_t* qy, const ikreal_t* qz, const ikreal_t* qw,
+                        const ikreal_t* px, const ikreal_t* py, const ikreal_t* pz,
+                        uint32_t n)
+{
+    const bvec_t one = BSET1(1.0);
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t x = BLOAD(qx + i), y = BLOAD(qy + i), z = BLOAD(qz + i), w = BLOAD(qw + i);
+        bvec_t x2 = BADD(x, x), y2 = BADD(y, y), z2 = BADD(z, z);
+        bvec_t xx = BMUL(x, x2), yy = BMUL(y, y2), zz = BMUL(z, z2);
+        bvec_t xy = BMUL(x, y2), xz = BMUL(x, z2), yz = BMUL(y, z2);
+        bvec_t wx = BMUL(w, x2), wy = BMUL(w, y2), wz = BMUL(w, z2);
+
+        BSTORE(m[0] + i, BSUB(one, BADD(yy, zz)));
+        BSTORE(m[1] + i, BSUB(xy, wz));
+        BSTORE(m[2] + i, BADD(xz, wy));
+        BSTORE(m[3] + i, BLOAD(px + i));
+        BSTORE(m[4] + i, BADD(xy, wz));
+        BSTORE(m[5] + i, BSUB(one, BADD(xx, zz)));
+        BSTORE(m[6] + i, BSUB(yz, wx));
+        BSTORE(m[7] + i, BLOAD(py + i));
+        BSTORE(m[8] + i, BSUB(xz, wy));
+        BSTORE(m[9] + i, BADD(yz, wx));
+        BSTORE(m[10] + i, BSUB(one, BADD(xx, yy)));
+        BSTORE(m[11] + i, BLOAD(pz + i));
+    }
+    if (i != n)
+    {
+        ikreal_t* tail[12];
+        int k;
+        for (k = 0; k != 12; ++k)
+            tail[k] = m[k] + i;
+        batch_kernels_scalar()->to_matrix(tail, qx + i, qy + i, qz + i, qw + i, px + i, py + i, pz + i, n - i);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(matrix_mul)(ikreal_t* const a[12], const ikreal_t* const b[12], uint32_t n)
+{
+    uint32_t i = 0;
+    int r;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t b0 = BLOAD(b[0] + i), b1 = BLOAD(b[1] + i), b2 = BLOAD(b[2] + i), b3 = BLOAD(b[3] + i);
+        bvec_t b4 = BLOAD(b[4] + i), b5 = BLOAD(b[5] + i), b6 = BLOAD(b[6] + i), b7 = BLOAD(b[7] + i);
+        bvec_t b8 = BLOAD(b[8] + i), b9 = BLOAD(b[9] + i), b10 = BLOAD(b[10] + i), b11 = BLOAD(b[11] + i);
+        for (r = 0; r != 3; ++r)
+        {
+            bvec_t a0 = BLOAD(a[r*4+0] + i), a1 = BLOAD(a[r*4+1] + i);
+            bvec_t a2 = BLOAD(a[r*4+2] + i), a3 = BLOAD(a[r*4+3] + i);
+            BSTORE(a[r*4+0] + i, BADD(BADD(BMUL(a0, b0), BMUL(a1, b4)), BMUL(a2, b8)));
+            BSTORE(a[r*4+1] + i, BADD(BADD(BMUL(a0, b1), BMUL(a1, b5)), BMUL(a2, b9)));
+            BSTORE(a[r*4+2] + i, BADD(BADD(BMUL(a0, b2), BMUL(a1, b6)), BMUL(a2, b10)));
+            BSTORE(a[r*4+3] + i, BADD(BADD(BADD(BMUL(a0, b3), BMUL(a1, b7)), BMUL(a2, b11)), a3));
+        }
+    }
+    if (i != n)
+    {
+        ikreal_t* tail_a[12];
+        const ikreal_t* tail_b[12];
+        int k;
+        for (k = 0; k != 12; ++k)
+        {
+            tail_a[k] = a[k] + i;
+            tail_b[k] = b[k] + i;
+        }
+        batch_kernels_scalar()->matrix_mul(tail_a, tail_b, n - i);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(two_bone)(ikreal_t* const mid[3], ikreal_t* const tip[3],
+                       const ikreal_t* const base[3], const ikreal_t* const target[3],
+                       const ikreal_t* const pole[3],
+                       const ikreal_t* upper, const ikreal_t* lower, uint32_t n)
+{
+    const bvec_t zero = BSET1(0.0);
+    const bvec_t one = BSET1(1.0);
+    const bvec_t two = BSET1(2.0);
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t a = BLOAD(upper + i), b = BLOAD(lower + i);
+        bvec_t bx = BLOAD(base[0] + i), by = BLOAD(base[1] + i), bz = BLOAD(base[2] + i);
+        bvec_t dx = BSUB(BLOAD(target[0] + i), bx);
+        bvec_t dy = BSUB(BLOAD(target[1] + i), by);
+        bvec_t dz = BSUB(BLOAD(target[2] + i), bz);
+        bvec_t px = BSUB(BLOAD(pole[0] + i), bx);
+        bvec_t py = BSUB(BLOAD(pole[1] + i), by);
+        bvec_t pz = BSUB(BLOAD(pole[2] + i), bz);
+        bvec_t c, inv, is_zero, reach, x, h, proj, length, alt_length;
+
+        /* Direction to the target, (1, 0, 0) if the target is on the base */
+        c = BSQRT(BADD(BADD(BMUL(dx, dx), BMUL(dy, dy)), BMUL(dz, dz)));
+        is_zero = BCMPEQ(c, zero);
+        inv = BDIV(one, BSELECT(is_zero, one, c));
+        dx = BSELECT(is_zero, one, BMUL(dx, inv));
+        dy = BMUL(dy, inv);
+        dz = BMUL(dz, inv);
+
+        /* The distance to the tip is limited by what the bones can span */
+        reach = BMAX(BMIN(c, BADD(a, b)), BMAX(BSUB(a, b), BSUB(b, a)));
+
+        /* The law of cosines without the angle, see scalar_two_bone() */
+        x = BDIV(BADD(BSUB(BMUL(a, a), BMUL(b, b)), BMUL(reach, reach)),
+                 BSELECT(BCMPEQ(reach, zero), one, BMUL(two, reach)));
+        h = BSQRT(BMAX(BSUB(BMUL(a, a), BMUL(x, x)), zero));
+
+        /* Bend toward the part of the pole that is perpendicular to d */
+        proj = BADD(BADD(BMUL(px, dx), BMUL(py, dy)), BMUL(pz, dz));
+        px = BSUB(px, BMUL(proj, dx));
+        py = BSUB(py, BMUL(proj, dy));
+        pz = BSUB(pz, BMUL(proj, dz));
+        length = BSQRT(BADD(BADD(BMUL(px, px), BMUL(py, py)), BMUL(pz, pz)));
+        alt_length = BSQRT(BADD(BMUL(dx, dx), BMUL(dy, dy)));
+        is_zero = BCMPEQ(length, zero);
+        px = BSELECT(is_zero, dy, px);
+        py = BSELECT(is_zero, BSUB(zero, dx), py);
+        pz = BSELECT(is_zero, zero, pz);
+        length = BSELECT(is_zero, alt_length, length);
+        is_zero = BCMPEQ(length, zero);
+        px = BSELECT(is_zero, one, px);
+        length = BSELECT(is_zero, one, length);
+        h = BDIV(h, length);
+
+        BSTORE(mid[0] + i, BADD(bx, BADD(BMUL(dx, x), BMUL(px, h))));
+        BSTORE(mid[1] + i, BADD(by, BADD(BMUL(dy, x), BMUL(py, h))));
+        BSTORE(mid[2] + i, BADD(bz, BADD(BMUL(dz, x), BMUL(pz, h))));
+        BSTORE(tip[0] + i, BADD(bx, BMUL(dx, reach)));
+        BSTORE(tip[1] + i, BADD(by, BMUL(dy, reach)));
+        BSTORE(tip[2] + i, BADD(bz, BMUL(dz, reach)));
+    }
+    if (i != n)
+    {
+        ikreal_t* tail_mid[3];
+        ikreal_t* tail_tip[3];
+        const ikreal_t* tail_base[3];
+        const ikreal_t* tail_target[3];
+        const ikreal_t* tail_pole[3];
+        int k;
+        for (k = 0; k != 3; ++k)
+        {
+            tail_mid[k] = mid[k] + i;
+            tail_tip[k] = tip[k] + i;
+            tail_base[k] = base[k] + i;
+            tail_target[k] = target[k] + i;
+            tail_pole[k] = pole[k] + i;
+        }
+        batch_kernels_scalar()->two_bone(tail_mid, tail_tip, tail_base, tail_target, tail_pole,
+                                         upper + i, lower + i, n - i);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+BATCH_PREFIX(one_bone)(ikreal_t* const tip[3], ikreal_t* const rotation[4],
+                       const ikreal_t* const base[3], const ikreal_t* const target[3],
+                       const ikreal_t* const forward[3], const ikreal_t* length, uint32_t n)
+{
+    const bvec_t zero = BSET1(0.0);
+    const bvec_t one = BSET1(1.0);
+    uint32_t i = 0;
+    for (; i + BATCH_WIDTH <= n; i += BATCH_WIDTH)
+    {
+        bvec_t bx = BLOAD(base[0] + i), by = BLOAD(base[1] + i), bz = BLOAD(base[2] + i);
+        bvec_t dx = BSUB(BLOAD(target[0] + i), bx);
+        bvec_t dy = BSUB(BLOAD(target[1] + i), by);
+        bvec_t dz = BSUB(BLOAD(target[2] + i), bz);
+        bvec_t len = BLOAD(length + i);
+        bvec_t c, inv, is_zero;
+
+        /* Direction to the target, (1, 0, 0) if the target is on the base */
+        c = BSQRT(BADD(BADD(BMUL(dx, dx), BMUL(dy, dy)), BMUL(dz, dz)));
+        is_zero = BCMPEQ(c, zero);
+        inv = BDIV(one, BSELECT(is_zero, one, c));
+        dx = BSELECT(is_zero, one, BMUL(dx, inv));
+        dy = BMUL(dy, inv);
+        dz = BMUL(dz, inv);
+
+        BSTORE(tip[0] + i, BADD(bx, BMUL(dx, len)));
+        BSTORE(tip[1] + i, BADD(by, BMUL(dy, len)));
+        BSTORE(tip[2] + i, BADD(bz, BMUL(dz, len)));
+
+        if (rotation[0] != NULL)
+        {
+            bvec_t fx = BLOAD(forward[0] + i), fy = BLOAD(forward[1] + i), fz = BLOAD(forward[2] + i);
+            bvec_t qx, qy, qz, qw, mag;
+
+            /* Half-angle identity, see scalar_one_bone() */
+            qx = BSUB(BMUL(fy, dz), BMUL(fz, dy));
+            qy = BSUB(BMUL(fz, dx), BMUL(fx, dz));
+            qz = BSUB(BMUL(fx, dy), BMUL(fy, dx));
+            qw = BADD(BSQRT(BADD(BADD(BMUL(fx, fx), BMUL(fy, fy)), BMUL(fz, fz))),
+                      BADD(BADD(BMUL(fx, dx), BMUL(fy, dy)), BMUL(fz, dz)));
+            mag = BADD(BADD(BMUL(qx, qx), BMUL(qy, qy)), BADD(BMUL(qz, qz), BMUL(qw, qw)));
+
+            /* Opposite directions: half turn about a perpendicular axis */
+            is_zero = BCMPEQ(mag, zero);
+            qx = BSELECT(is_zero, fy, qx);
+            qy = BSELECT(is_zero, BSUB(zero, fx), qy);
+            mag = BSELECT(is_zero, BADD(BMUL(fy, fy), BMUL(fx, fx)), mag);
+            is_zero = BCMPEQ(mag, zero);
+            qx = BSELECT(is_zero, one, qx);
+            mag = BSELECT(is_zero, one, mag);
+
+            inv = BDIV(one, BSQRT(mag));
+            BSTORE(rotation[0] + i, BMUL(qx, inv));
+            BSTORE(rotation[1] + i, BMUL(qy, inv));
+            BSTORE(rotation[2] + i, BMUL(qz, inv));
+            BSTORE(rotation[3] + i, BMUL(qw, inv));
+        }
+    }
+    if (i != n)
+    {
+        ikreal_t* tail_tip[3];
+        ikreal_t* tail_rotation[4] = {NULL, NULL, NULL, NULL};
+        const ikreal_t* tail_base[3];
+        const ikreal_t* tail_target[3];
+        const ikreal_t* tail_forward[3] = {NULL, NULL, NULL};
+        int k;
+        for (k = 0; k != 3; ++k)
+        {
+            tail_tip[k] = tip[k] + i;
+            tail_base[k] = base[k] + i;
+            tail_target[k] = target[k] + i;
+        }
+        if (rotation[0] != NULL)
+        {
+            for (k = 0; k != 4; ++k)
+                tail_rotation[k] = rotation[k] + i;
+            for (k = 0; k != 3; ++k)
+                tail_forward[k] = forward[k] + i;
+        }
+        batch_kernels_scalar()->one_bone(tail_tip, tail_rotation, tail_base, tail_target,
+                                         tail_forward, length + i, n - i);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static const struct batch_kernels_t BATCH_PREFIX(kernels) = {
+    BATCH_NAME,
+    BATCH_PREFIX(length),
+    BATCH_PREFIX(normalize),
+    BATCH_PREFIX(rotate),
+    BATCH_PREFIX(quat_mul),
+    BATCH_PREFIX(to_matrix),
+    BATCH_PREFIX(matrix_mul),
+    BATCH_PREFIX(two_bone),
+    BATCH_PREFIX(one_bone)
+};
@@ -0,0 +1,33 @@
+/*!
+ * @file carve.h
+ * @brief Lays out several arrays in a single block of memory.
+ *
+ * Structures that keep their data in one block (the solve program, the pose
+ * table, ...) carve every array out of it in turn. Each array starts on a
+ * 16 byte boundary. The same layout function is typically called twice:
+ * Once with a NULL block, which only computes the required size, and once
+ * more after the block was allocated, which assigns the pointers.
+ */
+#ifndef IK_CARVE_H
+#define IK_CARVE_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+/*!
+ * @brief Returns a pointer to size bytes at offset into block and advances
+ * offset past them. Returns NULL if block is NULL.
+ */
+IK_PRIVATE_API void*
+carve(uint8_t* block, uintptr_t* offset, uintptr_t size);
+
+/*!
+ * @brief Carves an array of count elements for the pointer ptr.
+ */
+#define CARVE(block, offset, ptr, count) \
+    ((ptr) = carve(block, offset, sizeof(*(ptr)) * (count)))
+
+C_END
+
+#endif /* IK_CARVE_H */
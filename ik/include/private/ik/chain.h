@@ -9,6 +9,7 @@
 #define IK_CHAIN_H
 
 #include "ik/config.h"
+#include "ik/bstv.h"
 #include "ik/vector.h"
 
 C_BEGIN
@@ -22,41 +23,48 @@ struct chain_t
      * NOTE: The nodes are in "reverse", i.e. the first node in this list is
      * the effector node.
      */
-    struct vector_t nodes;
-    /* list of chain_t objects */
-    struct vector_t children;
+    struct ik_node_t** nodes;
+    /* Child chains, stored next to each other */
+    struct chain_t* children;
+    uint32_t node_count;
+    uint32_t child_count;
 };
 
-IK_PRIVATE_API struct chain_t*
-chain_create(void);
-
-IK_PRIVATE_API void
-chain_destroy(struct chain_t* chain);
-
 /*!
- * @brief Initializes an allocated chain object.
+ * @brief Owns the memory of the chain trees in a solver's chain_list.
+ *
+ * The base chains (islands) themselves are stored in chain_list. Their child
+ * chains and the node lists of all chains are laid out in a single block,
+ * which is sized up front by counting what the new chain trees will need.
+ * Chains are written into the spare block, after which the two blocks swap
+ * roles. This way, islands that survive a rebuild can be copied over from
+ * the old block.
+ *
+ * Neither the blocks nor the scratch space used while building the chain
+ * trees shrink, so rebuilding a tree of the same size doesn't allocate.
  */
-IK_PRIVATE_API void
-chain_construct(struct chain_t* chain);
+struct chain_storage_t
+{
+    void* block;
+    uintptr_t block_size;
+    void* spare;
+    uintptr_t spare_size;
+
+    /* Scratch space for chain_tree_update(), kept around for the capacity */
+    struct bstv_t involved_nodes;
+    struct vector_t records;         /* struct chain_record_t */
+    struct vector_t record_nodes;    /* struct ik_node_t* */
+    struct vector_t live_effectors;  /* struct ik_node_t*, sorted */
+    struct vector_t dirty_effectors; /* struct ik_node_t* */
+    struct vector_t claimed;         /* uint8_t, one per live effector */
+    struct vector_t island_keys;     /* struct island_key_t, see chain.c */
+};
 
-/*!
- * @brief Destroys and frees all members, but does not deallocate the chain
- * object itself.
- */
 IK_PRIVATE_API void
-chain_destruct(struct chain_t* chain);
+chain_storage_construct(struct chain_storage_t* storage);
 
-/*!
- * @brief Deletes all children and nodes.
- */
 IK_PRIVATE_API void
-chain_clear_free(struct chain_t* chain);
-
-IK_PRIVATE_API struct chain_t*
-chain_create_child(struct chain_t* chain);
-
-IK_PRIVATE_API ikret_t
-chain_add_node(struct chain_t* chain, const struct ik_node_t* node);
+chain_storage_destruct(struct chain_storage_t* storage);
 
 /*!
  * @brief Breaks down the relevant nodes of the scene graph into a tree of
@@ -74,10 +82,41 @@ chain_add_node(struct chain_t* chain, const struct ik_node_t* node);
  * the chain tree.
  */
 IK_PRIVATE_API ikret_t
-chain_tree_rebuild(struct vector_t* chain_list,
+chain_tree_rebuild(struct chain_storage_t* storage,
+                   struct vector_t* chain_list,
                    const struct ik_node_t* base_node,
                    const struct vector_t* effector_nodes_list);
 
+/*!
+ * @brief Same as chain_tree_rebuild(), but only re-derives the islands
+ * (base chains in chain_list) that are affected by whatever changed since
+ * the last call.
+ *
+ * An island is kept if all of its nodes are still in the tree and none of
+ * them are dirty (see ik_node_interface_t::mark_dirty()). Effectors whose
+ * chain_length changed have their nodes marked dirty first. The chains of
+ * all other effectors are built from scratch. The islands end up in the same
+ * order chain_tree_rebuild() puts them in, so the result doesn't depend on
+ * the order the tree was edited in. Afterwards, the dirty flags of the tree
+ * are cleared.
+ *
+ * Kept islands move to the storage's other block, so pointers to child
+ * chains or node lists don't survive this call.
+ */
+IK_PRIVATE_API ikret_t
+chain_tree_update(struct chain_storage_t* storage,
+                  struct vector_t* chain_list,
+                  struct ik_node_t* base_node,
+                  const struct vector_t* effector_nodes_list);
+
+/*!
+ * @brief Hashes the structure of all chain trees (which nodes belong to which
+ * chains and in what order). Two chain lists with the same hash reference
+ * the same nodes in the same layout.
+ */
+IK_PRIVATE_API uint64_t
+chain_tree_hash(const struct vector_t* chain_list);
+
 /*!
  * Computes the distances between the nodes and stores them in
  * node->segment_length. The positions used for this computation are those of
@@ -103,21 +142,26 @@ count_chains(const struct vector_t* chains);
  * @note Does no error checking at all (e.g. if the index is out of bounds).
  */
 #define chain_get_node(chain_var, idx) \
-    (*(struct ik_node_t**)vector_get_element(&(chain_var)->nodes, idx))
+    ((chain_var)->nodes[idx])
 
 /*!
  * @brief Helper macro for retrieving the number of nodes in a chain.
  */
 #define chain_length(chain_var) \
-    vector_count(&(chain_var)->nodes)
+    ((chain_var)->node_count)
+
+/*!
+ * @brief Helper macro for retrieving the number of child chains.
+ */
+#define chain_child_count(chain_var) \
+    ((chain_var)->child_count)
 
 /*!
  * @brief Helper macro for retrieving the base node in the chain.
  * @note Does no error checking at all.
  */
 #define chain_get_base_node(chain_var) \
-    (*(struct ik_node_t**)vector_get_element(&(chain_var)->nodes, \
-                                chain_length(chain_var) - 1))
+    chain_get_node(chain_var, chain_length(chain_var) - 1)
 
 /*!
  * @brief Helper macro for retrieving the last node in the chain.
@@ -126,14 +170,24 @@ count_chains(const struct vector_t* chains);
 #define chain_get_tip_node(chain_var) \
     chain_get_node(chain_var, 0)
 
-#define CHAIN_FOR_EACH_CHILD(chain_var, var_name) \
-    VECTOR_FOR_EACH(&(chain_var)->children, struct chain_t, var_name) {
-
-#define CHAIN_FOR_EACH_NODE(chain_var, var_name) \
-    VECTOR_FOR_EACH(&(chain_var)->nodes, struct ik_node_t*, chain_##var_name) \
+#define CHAIN_FOR_EACH_CHILD(chain_var, var_name) {                         \
+    struct chain_t* var_name;                                               \
+    struct chain_t* internal_##var_name##_end =                             \
+        (chain_var)->children + (chain_var)->child_count;                   \
+    for (var_name = (chain_var)->children;                                  \
+         var_name != internal_##var_name##_end;                             \
+         ++var_name) {{
+
+#define CHAIN_FOR_EACH_NODE(chain_var, var_name) {                          \
+    struct ik_node_t** chain_##var_name;                                    \
+    struct ik_node_t** internal_##var_name##_end =                          \
+        (chain_var)->nodes + (chain_var)->node_count;                       \
+    for (chain_##var_name = (chain_var)->nodes;                             \
+         chain_##var_name != internal_##var_name##_end;                     \
+         ++chain_##var_name) {                                              \
     struct ik_node_t* var_name = *(chain_##var_name); {
 
-#define CHAIN_END_EACH VECTOR_END_EACH }
+#define CHAIN_END_EACH }}}
 
 #ifdef IK_DOT_OUTPUT
 /*!
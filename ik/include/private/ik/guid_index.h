@@ -0,0 +1,62 @@
+/*!
+ * @file guid_index.h
+ * @brief Open addressing hash table mapping node guids to nodes.
+ *
+ * Looking up a node with find_child() normally searches the tree. Once a tree
+ * has an index (see ik_node_interface_t::build_guid_index()), every node in
+ * the tree points to it through node->guid_index and the node functions that
+ * change the tree's structure keep it up to date. The index is owned by the
+ * root node of the tree.
+ *
+ * The table uses linear probing. Erased entries leave a tombstone behind so
+ * probe sequences stay intact. Tombstones are dropped when the table grows.
+ */
+#ifndef IK_GUID_INDEX_H
+#define IK_GUID_INDEX_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+struct ik_node_t;
+
+struct ik_guid_index_t
+{
+    /* The node that owns the index, i.e. the root node of the tree */
+    struct ik_node_t* root;
+    /* NULL for empty slots, GUID_INDEX_TOMBSTONE for erased slots */
+    struct ik_node_t** slots;
+    /* Always a power of two */
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t tombstones;
+};
+
+IK_PRIVATE_API struct ik_guid_index_t*
+guid_index_create(struct ik_node_t* root);
+
+IK_PRIVATE_API void
+guid_index_destroy(struct ik_guid_index_t* index);
+
+/*!
+ * @brief Adds a node. If a different node with the same guid is already in
+ * the index, the index isn't changed.
+ */
+IK_PRIVATE_API ikret_t
+guid_index_insert(struct ik_guid_index_t* index, struct ik_node_t* node);
+
+/*!
+ * @brief Removes the node if it's the one stored for its guid.
+ */
+IK_PRIVATE_API void
+guid_index_erase(struct ik_guid_index_t* index, const struct ik_node_t* node);
+
+/*!
+ * @return Returns NULL if no node with this guid is in the index.
+ */
+IK_PRIVATE_API struct ik_node_t*
+guid_index_find(const struct ik_guid_index_t* index, uint32_t guid);
+
+C_END
+
+#endif /* IK_GUID_INDEX_H */
@@ -0,0 +1,81 @@
+/*!
+ * @file heap_profile.h
+ * @brief Sampling heap profiler of the memory debugger. Only built with
+ * IK_MEMORY_BACKTRACE.
+ *
+ * Looking up symbols for the backtrace of every allocation is what made debug
+ * builds slow, so only some allocations are sampled (see
+ * ik_heap_interface_t::set_sampling()), and only their return addresses are
+ * captured. Samples with the same stack share a callsite, which keeps a
+ * running estimate of the bytes and objects that are live because of it.
+ * Callsites are interned in an open addressing hash table keyed on a hash of
+ * the stack and are never removed until heap_profile_deinit(). Symbols are
+ * only looked up when a profile is written.
+ *
+ * The profiler has its own lock and its memory comes straight from the
+ * allocator without being counted or tracked.
+ */
+#ifndef IK_HEAP_PROFILE_H
+#define IK_HEAP_PROFILE_H
+
+#include "ik/config.h"
+#include "ik/heap.h"
+
+C_BEGIN
+
+struct heap_callsite_t;
+
+IK_PRIVATE_API void
+heap_profile_init(void);
+
+/*!
+ * @brief Frees all callsites. The sampling settings are kept.
+ */
+IK_PRIVATE_API void
+heap_profile_deinit(void);
+
+IK_PRIVATE_API void
+heap_profile_set_sampling(enum ik_heap_sampling_e sampling, uintptr_t interval);
+
+IK_PRIVATE_API void
+heap_profile_get_sampling(enum ik_heap_sampling_e* sampling, uintptr_t* interval);
+
+/*!
+ * @brief Decides whether an allocation is sampled. If it is, the stack is
+ * captured and the allocation is added to its callsite.
+ * @param[out] weight Set to the number of bytes the sample stands for. Pass
+ * it to heap_profile_resize() and heap_profile_release().
+ * @return Returns the callsite, or NULL if the allocation isn't sampled.
+ * @note Must be called directly from malloc_wrapper(), the frames of both
+ * functions are left out of the stack.
+ */
+IK_PRIVATE_API struct heap_callsite_t*
+heap_profile_sample(uintptr_t size, uintptr_t* weight);
+
+/*!
+ * @brief Updates the callsite of a sampled allocation that was reallocated.
+ * The number of objects the sample stands for stays the same.
+ * @return Returns the new weight.
+ */
+IK_PRIVATE_API uintptr_t
+heap_profile_resize(struct heap_callsite_t* callsite,
+                    uintptr_t old_size,
+                    uintptr_t new_size,
+                    uintptr_t weight);
+
+/*!
+ * @brief Removes a sampled allocation that was freed from its callsite.
+ */
+IK_PRIVATE_API void
+heap_profile_release(struct heap_callsite_t* callsite, uintptr_t size, uintptr_t weight);
+
+/*!
+ * @brief Writes every callsite with live memory to the file, or to stdout if
+ * file_name is NULL.
+ */
+IK_PRIVATE_API ikret_t
+heap_profile_write(const char* file_name, enum ik_heap_profile_format_e format);
+
+C_END
+
+#endif /* IK_HEAP_PROFILE_H */
@@ -4,16 +4,19 @@
 #include "ik/config.h"
 
 #ifdef IK_MEMORY_DEBUGGING
-#   define MALLOC malloc_wrapper
-#   define FREE   free_wrapper
+#   define MALLOC  malloc_wrapper
+#   define REALLOC realloc_wrapper
+#   define FREE    free_wrapper
 #else
-#   include <stdlib.h>
-#   define MALLOC malloc
-#   define FREE   free
+#   define MALLOC  ik_malloc
+#   define REALLOC ik_realloc
+#   define FREE    ik_free
 #endif
 
 C_BEGIN
 
+struct ik_allocator_t;
+
 /*!
  * @brief Initializes the memory system.
  *
@@ -23,6 +26,27 @@ C_BEGIN
 IK_PRIVATE_API void
 ik_memory_init(void);
 
+/*!
+ * @brief Routes all allocations made through MALLOC(), REALLOC() and FREE() to
+ * the specified functions. NULL restores the default (malloc(), realloc() and
+ * free()).
+ * @return Returns IK_LIBRARY_IS_INITIALIZED if called between
+ * ik_memory_init() and ik_memory_deinit(). Memory can't change hands between
+ * allocators.
+ */
+IK_PRIVATE_API ikret_t
+ik_memory_set_allocator(const struct ik_allocator_t* allocator);
+
+/*!
+ * @brief Allocates from the current allocator without counting or tracking
+ * the allocation. Only meant for the memory debugger's own bookkeeping.
+ */
+IK_PRIVATE_API void*
+ik_memory_untracked_malloc(uintptr_t size);
+
+IK_PRIVATE_API void
+ik_memory_untracked_free(void* ptr);
+
 /*!
  * @brief De-initializes the memory system.
  *
@@ -41,14 +65,72 @@ ik_memory_deinit(void);
 IK_PRIVATE_API void*
 malloc_wrapper(intptr_t size);
 
+/*!
+ * @brief Does the same thing as a normal call to realloc(), but does some
+ * additional work to monitor and track down memory leaks.
+ */
+IK_PRIVATE_API void*
+realloc_wrapper(void* ptr, intptr_t size);
+
 /*!
  * @brief Does the same thing as a normal call to fee(), but does some
  * additional work to monitor and track down memory leaks.
  */
 IK_PRIVATE_API void
 free_wrapper(void* ptr);
+#else
+/*!
+ * @brief Allocates through the current allocator (see
+ * ik_memory_set_allocator()) and counts the allocation (see IKAPI.heap).
+ */
+IK_PRIVATE_API void*
+ik_malloc(intptr_t size);
+
+/*!
+ * @brief Reallocates through the current allocator. Counts as an allocation.
+ */
+IK_PRIVATE_API void*
+ik_realloc(void* ptr, intptr_t size);
+
+IK_PRIVATE_API void
+ik_free(void* ptr);
 #endif /* IK_MEMORY_DEBUGGING */
 
+/*!
+ * @brief Marks the beginning and end of a call to solve(). Allocations in
+ * between are counted separately, and with IK_MEMORY_DEBUGGING each one is
+ * reported on stderr. Calls may be nested.
+ *
+ * Only allocations made by the calling thread are affected. The thread pool
+ * enters the solve on its workers when the thread handing out the jobs is
+ * inside one.
+ */
+IK_PRIVATE_API void
+ik_memory_enter_solve(void);
+
+IK_PRIVATE_API void
+ik_memory_leave_solve(void);
+
+/*!
+ * @brief Returns non-zero if the calling thread is between
+ * ik_memory_enter_solve() and ik_memory_leave_solve().
+ */
+IK_PRIVATE_API int
+ik_memory_is_solving(void);
+
+/*!
+ * @brief Number of calls to MALLOC() and REALLOC() so far.
+ */
+IK_PRIVATE_API uintptr_t
+ik_memory_allocation_count(void);
+
+/*!
+ * @brief Number of calls to MALLOC() and REALLOC() made between ik_memory_enter_solve()
+ * and ik_memory_leave_solve().
+ */
+IK_PRIVATE_API uintptr_t
+ik_memory_solve_allocation_count(void);
+
 IK_PRIVATE_API void
 mutated_string_and_hex_dump(void* data, intptr_t size_in_bytes);
 
@@ -0,0 +1,94 @@
+/*!
+ * @file pool.h
+ * @brief Slab allocator for the nodes, effectors and constraints of a solver.
+ *
+ * Objects created through ik_solver_interface_t::create_node() (and friends)
+ * are allocated from the solver's pool instead of with MALLOC. Each object
+ * type has its own slab: a list of blocks holding objects of a fixed size
+ * back to back, so nodes sit contiguously in the order they were created.
+ * Freed objects go onto a free list and are reused before the next block is
+ * allocated.
+ *
+ * Every object starts with its vtable pointer (node->v, effector->v,
+ * constraint->v). Free slots store NULL there, followed by the next free
+ * slot, which lets pool_clear() find all live objects without having to walk
+ * the tree.
+ */
+#ifndef IK_POOL_H
+#define IK_POOL_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+struct ik_node_t;
+struct ik_node_interface_t;
+struct ik_slab_block_t;
+
+struct ik_slab_t
+{
+    struct ik_slab_block_t* first;
+    struct ik_slab_block_t* last;
+    void* free_list;
+    uintptr_t object_size;
+    uint32_t count;
+};
+
+struct ik_pool_t
+{
+    struct ik_slab_t nodes;
+    struct ik_slab_t effectors;
+    struct ik_slab_t constraints;
+    /*
+     * Set when an object that doesn't belong to this pool was added to or
+     * attached to one that does. Trees containing such objects can't be
+     * released in bulk.
+     */
+    uint8_t has_foreign_objects;
+};
+
+/*!
+ * @brief Creates an empty pool. No blocks are allocated until the first
+ * object is.
+ * @param[in] node_size Size of the node type, see
+ * ik_node_interface_t::type_size().
+ */
+IK_PRIVATE_API struct ik_pool_t*
+pool_create(uintptr_t node_size);
+
+/*!
+ * @brief Releases all objects in the pool (see pool_clear()) and frees the
+ * pool itself.
+ */
+IK_PRIVATE_API void
+pool_destroy(struct ik_pool_t* pool);
+
+/*!
+ * @brief Releases every object in the pool at once, whether it's part of a
+ * tree or not. Memory owned by live nodes (children vectors, guid indices) is
+ * freed in a single pass over the node blocks, then all blocks are freed.
+ * Nothing is destructed individually, so no callbacks are invoked.
+ */
+IK_PRIVATE_API void
+pool_clear(struct ik_pool_t* pool);
+
+/*!
+ * @brief Allocates and constructs a node of the type implemented by the
+ * interface. node->pool is set to the pool.
+ */
+IK_PRIVATE_API struct ik_node_t*
+pool_create_node(struct ik_pool_t* pool, const struct ik_node_interface_t* v, uint32_t guid);
+
+/*!
+ * @brief Returns uninitialized memory for one object. Whatever is constructed
+ * in it must set its vtable pointer.
+ */
+IK_PRIVATE_API void*
+slab_alloc(struct ik_slab_t* slab);
+
+IK_PRIVATE_API void
+slab_free(struct ik_slab_t* slab, void* object);
+
+C_END
+
+#endif /* IK_POOL_H */
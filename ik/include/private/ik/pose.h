@@ -0,0 +1,107 @@
+/*!
+ * @file pose.h
+ * @brief Fixes the order of the bones (nodes with a bone index, see
+ * ik_node_t::bone_index) when the solver is rebuilt, so that poses can be
+ * copied between the tree and the caller's arrays without walking the tree.
+ *
+ * Every node in the tree gets a slot. Slots are in pre-order, so every node
+ * comes after its parent, which is the order global transforms are
+ * accumulated in. bone_slot maps each bone index to the slot of its node.
+ *
+ * The table only stores anything if the tree has bones. Like the program
+ * (see program.h), all arrays are carved out of one block that never
+ * shrinks, so rebuilding a tree of the same size doesn't allocate.
+ */
+#ifndef IK_POSE_H
+#define IK_POSE_H
+
+#include "ik/config.h"
+#include "ik/solver.h"
+
+C_BEGIN
+
+struct ik_node_t;
+
+#define POSE_NO_PARENT ((uint32_t)-1)
+#define POSE_NO_SLOT   ((uint32_t)-1)
+
+struct pose_table_t
+{
+    uint8_t* block;
+    uintptr_t block_size;
+
+    uint32_t slot_count;
+    int32_t bone_count;
+
+    struct ik_node_t** nodes;
+    uint32_t* parent;       /* POSE_NO_PARENT for the tree's base node */
+    uint32_t* bone_slot;    /* bone_count entries, POSE_NO_SLOT if unused */
+
+    /* Scratch space for the global transforms, 7 ikreal_t's per slot */
+    ikreal_t* global;
+    ikreal_t* target;
+    uint8_t* given;
+
+    /* Caller's arrays, see ik_solver_interface_t::bind_pose() */
+    struct ik_pose_binding_t binding;
+    int bound;
+};
+
+IK_PRIVATE_API void
+pose_table_construct(struct pose_table_t* table);
+
+IK_PRIVATE_API void
+pose_table_destruct(struct pose_table_t* table);
+
+/*!
+ * @brief Forgets the nodes of the table, but keeps the memory and the
+ * binding.
+ */
+IK_PRIVATE_API void
+pose_table_clear(struct pose_table_t* table);
+
+/*!
+ * @brief Assigns slots to the nodes of the tree and looks up the slot of
+ * every bone. If several nodes have the same bone index, the last one in
+ * pre-order wins.
+ */
+IK_PRIVATE_API ikret_t
+pose_table_build(struct pose_table_t* table, struct ik_node_t* root);
+
+/*!
+ * @brief Copies the transforms of the bones into the caller's arrays. See
+ * ik_solver_interface_t::get_pose().
+ */
+IK_PRIVATE_API ikret_t
+pose_table_get(struct pose_table_t* table, int global,
+               ikreal_t* positions, uintptr_t position_stride,
+               ikreal_t* rotations, uintptr_t rotation_stride,
+               const int32_t* remap, int32_t count);
+
+/*!
+ * @brief Copies the caller's arrays into the transforms of the bones. See
+ * ik_solver_interface_t::set_pose().
+ */
+IK_PRIVATE_API ikret_t
+pose_table_set(struct pose_table_t* table, int global,
+               const ikreal_t* positions, uintptr_t position_stride,
+               const ikreal_t* rotations, uintptr_t rotation_stride,
+               const int32_t* remap, int32_t count);
+
+/*!
+ * @brief Copies the bound arrays into the local transforms of the bones.
+ * Does nothing if no arrays are bound.
+ */
+IK_PRIVATE_API void
+pose_table_pull(struct pose_table_t* table);
+
+/*!
+ * @brief Copies the local transforms of the bones into the bound arrays.
+ * Does nothing if no arrays are bound.
+ */
+IK_PRIVATE_API void
+pose_table_push(const struct pose_table_t* table);
+
+C_END
+
+#endif /* IK_POSE_H */
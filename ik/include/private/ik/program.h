@@ -0,0 +1,256 @@
+/*!
+ * @file program.h
+ * @brief Compiles the chain tree (see chain.h) into a flat "solve program".
+ *
+ * Walking the chain tree during every iteration means chasing a pointer to
+ * every node, and every node sits somewhere else on the heap. The program is
+ * a structure-of-arrays copy of everything the iterative solvers touch, laid
+ * out so that each pass of the algorithm becomes a linear loop over indices.
+ *
+ * Every node that is part of a chain is assigned a "slot". The slots of a
+ * chain are contiguous and ordered tip first, the same way chain_t stores its
+ * nodes. Chains are emitted in post-order (children before their parents) and
+ * every island ends with a slot for its base node. As a consequence:
+ *
+ *   + Iterating slots (or chains) front to back visits every node before its
+ *     parent (this is the order the forward pass of FABRIK needs).
+ *   + Iterating slots (or chains) back to front visits every node after its
+ *     parent (this is the order the backward pass of FABRIK needs).
+ *
+ * The parent of each slot is stored in program->parent (island base slots
+ * have no parent and store PROGRAM_NO_PARENT). The base node of a
+ * chain is the tip of its parent chain, so sub-base nodes only occupy a
+ * single slot. The island base slots are never written back to the tree.
+ *
+ * Islands only share data through their base node, and only if several of
+ * them hang off of the same one. Such islands are put into the same "group".
+ * Different groups touch disjoint sets of nodes and can be solved
+ * concurrently.
+ */
+#ifndef IK_PROGRAM_H
+#define IK_PROGRAM_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+struct ik_node_t;
+struct vector_t;
+
+#define PROGRAM_NO_PARENT ((uint32_t)-1)
+
+struct program_chain_t
+{
+    /* Slot of the tip node. The chain occupies [first, first + count) */
+    uint32_t first;
+    /* Number of nodes in the chain, excluding the base node */
+    uint32_t count;
+    /* Slot of the base node (tip of the parent chain, or the island base) */
+    uint32_t base;
+    /* Range into program->child_chains listing the chains to average */
+    uint32_t child_begin;
+    uint32_t child_count;
+};
+
+struct program_island_t
+{
+    /* Range into program->chains. The last chain is the island's root chain */
+    uint32_t chain_begin;
+    uint32_t chain_count;
+    /* Range of slots. The last slot is the island's base node */
+    uint32_t slot_begin;
+    uint32_t slot_count;
+    /* Range into program->effector_chains */
+    uint32_t effector_begin;
+    uint32_t effector_count;
+};
+
+struct program_t
+{
+    uint32_t slot_count;
+    uint32_t chain_count;
+    uint32_t island_count;
+    uint32_t effector_count;
+
+    /* Per slot data */
+    struct ik_node_t** nodes;
+    uint32_t* parent;
+    ikreal_t* pos_x;
+    ikreal_t* pos_y;
+    ikreal_t* pos_z;
+    ikreal_t* dist;
+    ikreal_t* rotation_weight;
+    /*
+     * 7 values per slot laid out like node->transform: The rotation and
+     * position accumulated from the island's base node up to and including
+     * the slot, see ik_transform_island().
+     */
+    ikreal_t* transform;
+    /*
+     * Global space cache, see ik_transform_island_to_cache(). local holds
+     * node->transform of every slot (7 values) as the solver last read or
+     * wrote it. As long as a node's transform and its parent's global
+     * transform haven't changed since, program->transform is still valid for
+     * that slot. slot_changed is scratch space for both passes.
+     * island_cached is non-zero for islands whose cache is valid.
+     */
+    ikreal_t* local;
+    uint8_t* slot_changed;
+
+    /*
+     * Per chain data. The target and direction arrays are scratch space for
+     * the forward pass, where each chain stores the position (and direction)
+     * its base node should move to so the parent chain can average them. The
+     * effector arrays hold the goal of each chain whose tip node has an
+     * effector attached.
+     */
+    struct program_chain_t* chains;
+    uint32_t* child_chains;
+    ikreal_t* target_x;
+    ikreal_t* target_y;
+    ikreal_t* target_z;
+    ikreal_t* direction_x;
+    ikreal_t* direction_y;
+    ikreal_t* direction_z;
+    ikreal_t* effector_x;
+    ikreal_t* effector_y;
+    ikreal_t* effector_z;
+    ikreal_t* effector_dir_x;
+    ikreal_t* effector_dir_y;
+    ikreal_t* effector_dir_z;
+
+    /*
+     * Indices of the chains whose tip node has an effector (the chains
+     * without children), grouped by island. These are the chains the
+     * convergence check has to look at.
+     */
+    uint32_t* effector_chains;
+
+    /*
+     * Per island results of the last solve: The number of iterations used
+     * and the largest distance of any effector to its target afterwards.
+     */
+    struct program_island_t* islands;
+    int32_t* island_iterations;
+    ikreal_t* island_residual;
+
+    /*
+     * Warm start buffer (see IK_ENABLE_WARM_START). The solved positions of
+     * every slot and the targets of every chain from the last solve, stored
+     * relative to the island's base node so they survive the base moving.
+     * island_warm is non-zero for islands that have been stored.
+     */
+    ikreal_t* warm_x;
+    ikreal_t* warm_y;
+    ikreal_t* warm_z;
+    ikreal_t* warm_target_x;
+    ikreal_t* warm_target_y;
+    ikreal_t* warm_target_z;
+    uint8_t* island_warm;
+    uint8_t* island_cached;
+
+    /*
+     * Islands of group g are group_islands[group_begin[g]] up to (excluding)
+     * group_islands[group_begin[g + 1]], in the same order as the chain list.
+     */
+    uint32_t group_count;
+    uint32_t* group_begin;
+    uint32_t* group_islands;
+
+    /*
+     * Hash of the program's structure (the slot, chain and island layout, but
+     * none of the positions or segment lengths). Two programs with the same
+     * topology visit their slots in the same order and can be solved in
+     * lockstep.
+     */
+    uint64_t topology;
+
+    /*
+     * All of the above arrays are carved out of this single allocation. It's
+     * reused by the next compile if it's large enough.
+     */
+    void* block;
+    uintptr_t block_size;
+};
+
+IK_PRIVATE_API void
+program_construct(struct program_t* program);
+
+IK_PRIVATE_API void
+program_destruct(struct program_t* program);
+
+/*!
+ * @brief Flattens a list of chain trees into the program. Any previously
+ * compiled data is discarded.
+ * @param[in] chain_list A list of base chains, as built by
+ * chain_tree_rebuild().
+ */
+IK_PRIVATE_API ikret_t
+program_compile(struct program_t* program, const struct vector_t* chain_list);
+
+/*!
+ * @brief Copies node->dist_to_parent and node->rotation_weight of every node
+ * into the program.
+ */
+IK_PRIVATE_API void
+program_update_segments(struct program_t* program);
+
+/*!
+ * @brief Copies node->position of every node into the program.
+ */
+IK_PRIVATE_API void
+program_gather_positions(struct program_t* program);
+
+IK_PRIVATE_API void
+program_gather_island_positions(struct program_t* program, uint32_t island_idx);
+
+/*!
+ * @brief Copies the actual target position of every effector into the
+ * program. If with_directions is non-zero, the target direction of each
+ * effector (derived from its target rotation) is copied as well.
+ */
+IK_PRIVATE_API void
+program_gather_targets(struct program_t* program, int with_directions);
+
+IK_PRIVATE_API void
+program_gather_island_targets(struct program_t* program, uint32_t island_idx, int with_directions);
+
+/*!
+ * @brief Writes the positions stored in the program back to the nodes. Island
+ * base nodes are left untouched.
+ */
+IK_PRIVATE_API void
+program_scatter_positions(const struct program_t* program);
+
+IK_PRIVATE_API void
+program_scatter_island_positions(const struct program_t* program, uint32_t island_idx);
+
+/*!
+ * @brief Seeds the island's positions from the warm start buffer. Must be
+ * called after gathering the positions and targets. Each position becomes
+ * warm + (gathered - warm) * blend. Nothing is changed if the island was
+ * never stored, or if any of its targets moved further than threshold since
+ * it was.
+ * @return Returns non-zero if the island was seeded.
+ */
+IK_PRIVATE_API int
+program_warm_start_island(struct program_t* program, uint32_t island_idx,
+                          ikreal_t blend, ikreal_t threshold);
+
+/*!
+ * @brief Stores the island's current positions and targets in the warm start
+ * buffer.
+ */
+IK_PRIVATE_API void
+program_store_warm_start_island(struct program_t* program, uint32_t island_idx);
+
+/*!
+ * @brief Returns the largest distance between any effector's tip node
+ * (program->pos_*) and its target (program->effector_*) in the island.
+ */
+IK_PRIVATE_API ikreal_t
+program_island_residual(const struct program_t* program, uint32_t island_idx);
+
+C_END
+
+#endif /* IK_PROGRAM_H */
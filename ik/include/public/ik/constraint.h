@@ -7,6 +7,7 @@ C_BEGIN
 
 struct ik_node_t;
 struct ik_constraint_interface_t;
+struct ik_pool_t;
 
 typedef int (*ik_constraint_apply_func)(struct ik_node_t*);
 
@@ -30,6 +31,13 @@ struct ik_constraint_t
     struct ik_node_t* node;
     ik_constraint_apply_func apply;
     enum ik_constraint_type_e type;
+
+    /*!
+     * @brief The solver pool the constraint was allocated from (see
+     * ik_solver_interface_t::create_constraint()), NULL if it was allocated
+     * on its own with create().
+     */
+    struct ik_pool_t* pool;
 };
 
 IK_INTERFACE(constraint_interface)
@@ -41,6 +49,12 @@ IK_INTERFACE(constraint_interface)
     struct ik_constraint_t*
     (*create)(enum ik_constraint_type_e constraint_type);
 
+    /*!
+     * @brief Constructs an already allocated constraint.
+     */
+    ikret_t
+    (*construct)(struct ik_constraint_t* constraint, enum ik_constraint_type_e constraint_type);
+
     /*!
      * @brief Sets the type of constraint to enforce.
      * @note The tree must be rebuilt only if you change to or from the "stiff"
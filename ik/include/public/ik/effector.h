@@ -9,6 +9,7 @@ C_BEGIN
 
 struct ik_node_t;
 struct ik_effector_interface_t;
+struct ik_pool_t;
 
 enum effector_flags_e
 {
@@ -20,7 +21,14 @@ enum effector_flags_e
      */
     IK_WEIGHT_NLERP      = 0x01,
 
-    IK_INHERIT_ROTATION  = 0x02
+    IK_INHERIT_ROTATION  = 0x02,
+
+    /*!
+     * @brief The solver bends the chain toward pole_position. Only used by
+     * the TWO_BONE solver. Without it, the chain keeps bending the way it
+     * currently does.
+     */
+    IK_USE_POLE          = 0x04
 };
 
 /*!
@@ -51,6 +59,13 @@ struct ik_effector_t
      */
     ik_quat_t target_rotation;
 
+    /*!
+     * @brief The global (world) position the middle joint of a two bone
+     * chain bends toward, if IK_USE_POLE is set.
+     * @note Default value is (0, 0, 0).
+     */
+    ik_vec3_t pole_position;
+
     /*!
      * Used internally to hold the actual target position/rotation, which will
      * be different from target_position/target_rotation if the weight is not
@@ -84,11 +99,24 @@ struct ik_effector_t
      */
     uint16_t chain_length;
 
+    /*!
+     * Used internally to hold the chain length the solver's chains were last
+     * built with, so rebuild() can tell which effectors changed.
+     */
+    uint16_t _built_chain_length;
+
     /*!
      * @brief Various behavioural settings. Check the enum effector_flags_e for
      * more information.
      */
     uint8_t flags;
+
+    /*!
+     * @brief The solver pool the effector was allocated from (see
+     * ik_solver_interface_t::create_effector()), NULL if it was allocated on
+     * its own with create().
+     */
+    struct ik_pool_t* pool;
 };
 
 IK_INTERFACE(effector_interface)
@@ -100,6 +128,12 @@ IK_INTERFACE(effector_interface)
     struct ik_effector_t*
     (*create)(void);
 
+    /*!
+     * @brief Constructs an already allocated effector.
+     */
+    ikret_t
+    (*construct)(struct ik_effector_t* effector);
+
     /*!
      * @brief Destroys and frees an effector object. This should **NOT** be called
      * on effectors that are attached to nodes. Use ik_node_destroy_effector()
@@ -0,0 +1,146 @@
+#ifndef IK_HEAP_H
+#define IK_HEAP_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+/*!
+ * @brief Functions through which the library allocates all of its memory,
+ * see ik.heap.set_allocator(). Each one receives user_data as its first
+ * argument. They have the same semantics as malloc(), realloc() and free(),
+ * except that free() is never called with NULL.
+ */
+struct ik_allocator_t
+{
+    void*
+    (*malloc)(void* user_data, uintptr_t size);
+
+    void*
+    (*realloc)(void* user_data, void* ptr, uintptr_t size);
+
+    void
+    (*free)(void* user_data, void* ptr);
+
+    void* user_data;
+};
+
+/*!
+ * @brief Which allocations the heap profiler captures a backtrace for, see
+ * ik.heap.set_sampling().
+ */
+enum ik_heap_sampling_e
+{
+    /* No backtraces are captured */
+    IK_HEAP_SAMPLE_NOTHING,
+    /* Every Nth allocation */
+    IK_HEAP_SAMPLE_ALLOCATIONS,
+    /* One allocation every N bytes allocated */
+    IK_HEAP_SAMPLE_BYTES
+};
+
+enum ik_heap_profile_format_e
+{
+    /* Callsites sorted by live bytes, with symbols */
+    IK_HEAP_PROFILE_REPORT,
+    /* The heap profile text format of gperftools, which pprof reads */
+    IK_HEAP_PROFILE_PPROF
+};
+
+/*!
+ * @brief Controls and reports on the library's heap usage.
+ *
+ * Solving is not supposed to allocate any memory. Everything a solver needs
+ * is allocated when it's rebuilt, and per-solve scratch memory comes from an
+ * arena that is reserved along with it. Every allocation made from inside
+ * ik.solver.solve(), solve_batch() or solve_lanes() is counted separately,
+ * which is what the unit tests check. This includes the worker threads
+ * solving on the caller's behalf, but not other threads of the application
+ * that happen to allocate at the same time. The only exception is the first
+ * time a solver leads a group in solve_lanes(), where it reserves its
+ * scratch space for the lanes. After that, rebuild() keeps it reserved.
+ *
+ * If the library was built with IK_MEMORY_DEBUGGING, each one is also
+ * reported on stderr (with a backtrace if IK_MEMORY_BACKTRACE is enabled).
+ *
+ * @note The counters are only atomic if the library was built with
+ * IK_THREADS. Otherwise they may be slightly off if several threads allocate
+ * at the same time.
+ */
+IK_INTERFACE(heap_interface)
+{
+    /*!
+     * @brief Routes every allocation the library makes, including the
+     * storage of vectors and bstvs, through the specified functions. The
+     * structure is copied. Pass NULL to go back to malloc(), realloc() and
+     * free().
+     *
+     * Memory must be freed by the allocator it came from, which is why this
+     * has to be called before ik.init() (and before ik.log.init(), which
+     * initializes the library as well) or after the last call to ik.deinit().
+     * @return Returns IK_LIBRARY_IS_INITIALIZED if the library is currently
+     * initialized, in which case nothing is changed.
+     */
+    ikret_t
+    (*set_allocator)(const struct ik_allocator_t* allocator);
+
+    /*!
+     * @brief Returns the number of allocations the library has made so far.
+     */
+    uintptr_t
+    (*allocation_count)(void);
+
+    /*!
+     * @brief Returns the number of allocations the library has made while
+     * solving.
+     */
+    uintptr_t
+    (*solve_allocation_count)(void);
+
+    /*!
+     * @brief Chooses which allocations the heap profiler samples. Only
+     * available if the library was built with IK_MEMORY_BACKTRACE.
+     *
+     * A sampled allocation has the backtrace to where it was made captured.
+     * Allocations with the same backtrace share a callsite, which keeps track
+     * of how many bytes and objects it currently has live. Since only
+     * samples are seen, these are estimates: with IK_HEAP_SAMPLE_ALLOCATIONS
+     * each sample stands for interval allocations of its size, with
+     * IK_HEAP_SAMPLE_BYTES it stands for interval bytes (or its own size if
+     * larger). Leaked memory is reported by callsite when the library is
+     * de-initialized.
+     *
+     * The default is to sample every allocation, which is also the slowest.
+     * Changing this at any time is fine, allocations that were sampled stay
+     * sampled.
+     * @param[in] interval 0 is the same as 1.
+     * @return Returns IK_BUILT_WITHOUT_MEMORY_BACKTRACE if the library was
+     * built without IK_MEMORY_BACKTRACE.
+     */
+    ikret_t
+    (*set_sampling)(enum ik_heap_sampling_e sampling, uintptr_t interval);
+
+    /*!
+     * @brief Retrieves what set_sampling() was last called with, so it can be
+     * restored later.
+     * @return Returns IK_BUILT_WITHOUT_MEMORY_BACKTRACE if the library was
+     * built without IK_MEMORY_BACKTRACE.
+     */
+    ikret_t
+    (*get_sampling)(enum ik_heap_sampling_e* sampling, uintptr_t* interval);
+
+    /*!
+     * @brief Writes the live heap of every callsite, see set_sampling().
+     * @param[in] file_name The file to write to. It is overwritten. If NULL,
+     * the profile is written to stdout.
+     * @return Returns IK_BUILT_WITHOUT_MEMORY_BACKTRACE if the library was
+     * built without IK_MEMORY_BACKTRACE, or IK_FAILED_TO_OPEN_FILE if the
+     * file couldn't be opened.
+     */
+    ikret_t
+    (*dump_profile)(const char* file_name, enum ik_heap_profile_format_e format);
+};
+
+C_END
+
+#endif /* IK_HEAP_H */
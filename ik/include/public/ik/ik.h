@@ -5,10 +5,12 @@
 #include "ik/build_info.h"
 #include "ik/constraint.h"
 #include "ik/effector.h"
+#include "ik/heap.h"
 #include "ik/log.h"
 #include "ik/node.h"
 #include "ik/solver.h"
 #include "ik/tests.h"
+#include "ik/thread_pool.h"
 
 C_BEGIN
 
@@ -58,10 +60,12 @@ struct ik_interface_t
     (*implement_callbacks)(const struct ik_callback_interface_t* callbacks);
 
     const struct ik_build_info_interface_t info;
+    const struct ik_heap_interface_t       heap;
     const struct ik_log_interface_t        log;
     const struct ik_quat_interface_t       quat;
     const struct ik_solver_interface_t     solver;
     const struct ik_tests_interface_t      tests;
+    const struct ik_thread_pool_interface_t thread_pool;
     const struct ik_vec3_interface_t       vec3;
 
     /* "Private" interface, should not be used by clients of the library. */
@@ -10,14 +10,52 @@ C_BEGIN
 
 struct ik_effector_t;
 struct ik_constraint_t;
+struct ik_guid_index_t;
 struct ik_node_interface_t;
+struct ik_pool_t;
+
+/*
+ * How a node stores its children is selected at build time with
+ * IK_NODE_CHILDREN (see CMakeLists.txt). Use NODE_FOR_EACH() and
+ * NODE_CHILD_COUNT() instead of accessing these members directly.
+ *
+ * BSTV:   A vector of {guid, child} pairs, sorted by guid. Children are
+ *         iterated in order of their guid.
+ * LINKED: Intrusive first-child/next-sibling links. Adding and unlinking
+ *         children is O(1) and iterating them doesn't need any memory besides
+ *         the nodes themselves. Children are iterated in the order they were
+ *         added. Sibling guids are not checked for uniqueness.
+ */
+#if defined(IK_NODE_CHILDREN_LINKED)
+#   define IK_NODE_CHILDREN_HEAD                                              \
+    struct ik_node_t* first_child; /* first_child->prev_sibling is the last child */ \
+    struct ik_node_t* next_sibling;                                           \
+    struct ik_node_t* prev_sibling;                                           \
+    uint32_t child_count;
+#else
+#   define IK_NODE_CHILDREN_HEAD                                              \
+    struct bstv_t children;
+#endif
 
 #define IK_NODE_HEAD                                                          \
     const struct ik_node_interface_t* v;                                      \
     struct ik_node_t* parent;                                                 \
-    struct bstv_t children;                                                   \
+    IK_NODE_CHILDREN_HEAD                                                     \
     uint32_t guid;                                                            \
                                                                               \
+    /*!                                                                       \
+     * @brief Shared by all nodes of a tree once build_guid_index() was       \
+     * called on it, NULL otherwise.                                          \
+     */                                                                       \
+    struct ik_guid_index_t* guid_index;                                       \
+                                                                              \
+    /*!                                                                       \
+     * @brief The solver pool the node was allocated from (see                \
+     * ik_solver_interface_t::create_node()), NULL if it was allocated on its \
+     * own with create().                                                     \
+     */                                                                       \
+    struct ik_pool_t* pool;                                                   \
+                                                                              \
     union                                                                     \
     {                                                                         \
         struct                                                                \
@@ -71,7 +109,22 @@ struct ik_node_interface_t;
     struct ik_constraint_t* constraint;                                       \
                                                                               \
     ikreal_t rotation_weight;                                                 \
-    ikreal_t dist_to_parent;
+    ikreal_t dist_to_parent;                                                  \
+                                                                              \
+    /*!                                                                       \
+     * @brief Where the solver writes this node's matrix to (see              \
+     * ik_solver_interface_t::write_matrices()), and this node's element in   \
+     * get_pose() and set_pose(). -1 by default, which means the node has no  \
+     * matrix. Call mark_dirty() after changing it.                           \
+     */                                                                       \
+    int32_t bone_index;                                                       \
+                                                                              \
+    /*!                                                                       \
+     * @brief Set if this node or any of its descendants changed in a way     \
+     * that affects the chains built by the solver (see mark_dirty()).        \
+     * Cleared by the solver's rebuild().                                     \
+     */                                                                       \
+    uint8_t dirty;
 
 /*!
  * @brief Base structure used to build the tree structure to be solved.
@@ -83,6 +136,12 @@ struct ik_node_t
 
 IK_INTERFACE(node_interface)
 {
+    /*!
+     * @brief Size of the node structure allocated by create().
+     */
+    uintptr_t
+    (*type_size)(void);
+
     /*!
      * @brief Creates a new node and returns it. Each node requires a tree-unique
      * ID, which can be used later to search for nodes in the tree.
@@ -114,7 +173,8 @@ IK_INTERFACE(node_interface)
     /*!
      * @brief Creates a new node, attaches it as a child to the specified node,
      * and returns it. Each node requires a tree-unique ID, which can be used
-     * later to search for nodes in the tree.
+     * later to search for nodes in the tree. If the node was allocated from a
+     * solver's pool, so is the child.
      */
     struct ik_node_t*
     (*create_child)(struct ik_node_t* node, uint32_t child_guid);
@@ -136,15 +196,40 @@ IK_INTERFACE(node_interface)
     void
     (*unlink)(struct ik_node_t* node);
 
+    /*!
+     * @brief Flags the node and all of its parents as dirty. The next call to
+     * ik_solver_rebuild() will then re-derive the chains going through these
+     * nodes and keep all others.
+     *
+     * This is called for you by add_child(), unlink() and by attaching or
+     * detaching effectors and constraints. Changes to an effector's
+     * chain_length are detected automatically as well.
+     */
+    void
+    (*mark_dirty)(struct ik_node_t* node);
+
     /*!
      * @brief Searches recursively for a node in a tree with the specified global
-     * identifier.
+     * identifier. If the tree has a guid index (see build_guid_index()), the
+     * lookup is O(1) for the root node, and O(depth) for any other node.
      * @return Returns NULL if the node was not found, otherwise the node is
      * returned.
      */
     struct ik_node_t*
     (*find_child)(const struct ik_node_t* node, uint32_t guid);
 
+    /*!
+     * @brief Builds a hash table from guid to node for the whole tree the
+     * node is part of. It's owned by the root node and kept up to date by
+     * add_child(), unlink() and destroy(). Adding a tree that has an index
+     * as a child of another tree discards the index.
+     * @note Requires guids to be unique within the tree. If the index can't
+     * grow because there is no memory left, it's discarded and find_child()
+     * searches the tree again.
+     */
+    ikret_t
+    (*build_guid_index)(struct ik_node_t* node);
+
     struct ik_node_t*
     (*duplicate)(const struct ik_node_t* node, int copy_attachments);
 
@@ -156,11 +241,30 @@ IK_INTERFACE(node_interface)
     (*dump_to_dot)(struct ik_node_t* node, const char* file_name);
 };
 
+#if defined(IK_NODE_CHILDREN_LINKED)
+/* The next sibling is read up front so the current child may be destroyed */
+#define NODE_FOR_EACH(node, key, value) {                                     \
+    uint32_t key;                                                             \
+    struct ik_node_t* value;                                                  \
+    struct ik_node_t* next_##value;                                           \
+    for(value = (node)->first_child;                                          \
+        value != NULL &&                                                      \
+            ((next_##value = value->next_sibling) || 1) &&                    \
+            ((key = value->guid) || 1);                                       \
+        value = next_##value) {
+
+#define NODE_END_EACH }}
+
+#define NODE_CHILD_COUNT(node) ((node)->child_count)
+#else
 #define NODE_FOR_EACH(node, key, value) \
     BSTV_FOR_EACH(&(node)->children, struct ik_node_t, key, value)
 
 #define NODE_END_EACH BSTV_END_EACH
 
+#define NODE_CHILD_COUNT(node) bstv_count(&(node)->children)
+#endif
+
 C_END
 
 #endif /* IK_NODE_H */
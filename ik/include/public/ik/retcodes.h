@@ -16,7 +16,12 @@ typedef enum ikret_t
     IK_SOLVER_HAS_NO_TREE = -5,
     IK_UNIT_TESTS_FAILED = -6,
     IK_BUILT_WITHOUT_TESTS = -7,
-    IK_WRONG_FUNCTION_FOR_CUSTOM_CONSTRAINT = -8
+    IK_WRONG_FUNCTION_FOR_CUSTOM_CONSTRAINT = -8,
+    IK_INDEX_OUT_OF_RANGE = -9,
+    IK_LIBRARY_IS_INITIALIZED = -10,
+    IK_BUILT_WITHOUT_MEMORY_BACKTRACE = -11,
+    IK_FAILED_TO_OPEN_FILE = -12,
+    IK_TREE_NOT_SUPPORTED = -13
 } ikret_t;
 
 #ifdef __cplusplus
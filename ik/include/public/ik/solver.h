@@ -37,12 +37,18 @@ typedef void(*ik_solver_iterate_node_cb_func)(struct ik_node_t*);
 struct ik_solver_interface_t;
 struct ik_solver_t;
 struct ik_node_t;
+struct ik_effector_t;
+struct ik_pool_t;
+struct chain_storage_t;
+struct pose_table_t;
 
 #define IK_SOLVER_HEAD                                                        \
     const struct ik_solver_interface_t*      v;                               \
                                                                               \
     int32_t                                  max_iterations;                  \
     ikreal_t                                 tolerance;                       \
+    ikreal_t                                 warm_start_blend;                \
+    ikreal_t                                 warm_start_threshold;            \
     uint8_t                                  flags;                           \
                                                                               \
     /* API functions */                                                       \
@@ -55,7 +61,15 @@ struct ik_node_t;
     /* list of effector_t* references (not owned by us) */                    \
     struct vector_t                          effector_nodes_list;             \
     /* list of chain_t objects (allocated in-place, i.e. ik_solver_t owns them) */ \
-    struct vector_t                          chain_list;
+    struct vector_t                          chain_list;                      \
+    /* memory of the child chains and node lists in chain_list */             \
+    struct chain_storage_t*                  chain_storage;                   \
+    /* bone order of get_pose() and set_pose(), fixed by rebuild() */         \
+    struct pose_table_t*                     pose_table;                      \
+    /* hash of chain_list, doesn't change if rebuild() had nothing to do */   \
+    uint64_t                                 topology;                        \
+    /* objects allocated with create_node() etc., created on first use */     \
+    struct ik_pool_t*                        pool;
 
 /*!
  * @brief This is a base for all solvers.
@@ -65,6 +79,89 @@ struct ik_solver_t
     IK_SOLVER_HEAD
 };
 
+/*!
+ * @brief The space of the transforms copied by get_pose() and set_pose().
+ */
+enum ik_pose_space_e
+{
+    /*! Relative to the parent node, same as node->position and node->rotation */
+    IK_POSE_LOCAL,
+    /*! Relative to the tree's base node's parent, same as write_matrices() */
+    IK_POSE_GLOBAL
+};
+
+/*!
+ * @brief Structure-of-arrays input and output of
+ * ik_solver_interface_t::solve_two_bone(). Every array holds one component
+ * of each problem. All positions are in the same space.
+ */
+struct ik_two_bone_batch_t
+{
+    const ikreal_t* base[3];
+    const ikreal_t* target[3];
+    /*! The middle joint bends toward this position */
+    const ikreal_t* pole[3];
+    /*! Length of the bone from the base to the middle joint */
+    const ikreal_t* upper_length;
+    /*! Length of the bone from the middle joint to the tip */
+    const ikreal_t* lower_length;
+    /*! Receives the positions of the middle joints */
+    ikreal_t* mid[3];
+    /*! Receives the positions of the tips */
+    ikreal_t* tip[3];
+};
+
+/*!
+ * @brief Structure-of-arrays input and output of
+ * ik_solver_interface_t::solve_one_bone(). Every array holds one component
+ * of each problem. All positions are in the same space.
+ */
+struct ik_one_bone_batch_t
+{
+    const ikreal_t* base[3];
+    const ikreal_t* target[3];
+    /*! Length of the bone */
+    const ikreal_t* length;
+    /*! Receives the positions of the tips */
+    ikreal_t* tip[3];
+    /*!
+     * Direction the bone currently points in. Only read if rotation is
+     * set. Must not be zero.
+     */
+    const ikreal_t* forward[3];
+    /*!
+     * Receives the shortest rotation from forward to the new direction of
+     * the bone, as x, y, z and w. Set rotation[0] to NULL if the rotations
+     * aren't needed.
+     */
+    ikreal_t* rotation[4];
+};
+
+/*!
+ * @brief Type of the elements of the arrays in ik_pose_binding_t.
+ */
+enum ik_binding_type_e
+{
+    IK_BINDING_FLOAT,
+    IK_BINDING_DOUBLE
+};
+
+/*!
+ * @brief Structure-of-arrays storage of local transforms owned by the caller
+ * (see ik_solver_interface_t::bind_pose()). Element i of each array belongs
+ * to the node with a bone index of i (see ik_node_t::bone_index).
+ */
+struct ik_pose_binding_t
+{
+    enum ik_binding_type_e type;
+    /*! The x, y and z coordinates of the positions, or NULL */
+    void* position[3];
+    /*! The x, y, z and w components of the rotations, or NULL */
+    void* rotation[4];
+    /*! The number of elements in each array */
+    int32_t count;
+};
+
 enum ik_flags_e
 {
     /*!
@@ -76,7 +173,28 @@ enum ik_flags_e
 
     IK_ENABLE_TARGET_ROTATIONS = 0x02,
 
-    IK_ENABLE_JOINT_ROTATIONS = 0x04
+    IK_ENABLE_JOINT_ROTATIONS = 0x04,
+
+    /*!
+     * @brief Islands (independent groups of chains, see solver->chain_list)
+     * are solved concurrently on the library's worker threads (see
+     * ik.thread_pool). The result is identical to solving them serially.
+     * Only worth enabling for trees with several islands of reasonable size.
+     * Has no effect when called from within solve_batch().
+     */
+    IK_ENABLE_PARALLEL_ISLANDS = 0x08,
+
+    /*!
+     * @brief Each solve starts from the previous solve's solution instead of
+     * the pose currently in the tree, which cuts the number of iterations
+     * down to a few when targets move slowly. The starting position of each
+     * node is blended toward its current pose by solver->warm_start_blend.
+     * Islands fall back to starting from the current pose if any of their
+     * targets moved further than solver->warm_start_threshold. The previous
+     * solution is stored relative to the island's base node, so moving the
+     * base node is fine. Rebuilding discards it.
+     */
+    IK_ENABLE_WARM_START = 0x10
 };
 
 IK_INTERFACE(solver_interface)
@@ -101,6 +219,14 @@ IK_INTERFACE(solver_interface)
      *       will stop iterating if the effectors are within this distance. The
      *       default value is 1e-3. Recommended values are 100th of your world
      *       unit.
+     *  + solver->warm_start_blend
+     *       How far the starting pose is moved from the previous solution toward
+     *       the current pose, if IK_ENABLE_WARM_START is set. 0 starts from the
+     *       previous solution, 1 from the current pose. The default is 0.
+     *  + solver->warm_start_threshold
+     *       If IK_ENABLE_WARM_START is set and an effector's target moved
+     *       further than this distance since the previous solve, the island
+     *       starts from the current pose instead. The default is 1.
      *  + solver->flags
      *       Changes the behaviour of the solver. See the enum solver_flags_e for
      *       more information.
@@ -126,7 +252,9 @@ IK_INTERFACE(solver_interface)
 
     /*!
      * @brief Destroys the solver and all nodes/effectors that are part of the
-     * solver. Any pointers to tree nodes are invalid after this function returns.
+     * solver, as well as everything allocated from its pool (see
+     * create_node()). Any pointers to tree nodes are invalid after this
+     * function returns.
      */
     void
     (*destroy)(struct ik_solver_t* solver);
@@ -143,6 +271,10 @@ IK_INTERFACE(solver_interface)
      * @note Needs to be called whenever the tree changes in any way. I.e. if you
      * remove nodes or add nodes, or if you remove effectors or add effectors,
      * you must call this again before invoking the solver.
+     *
+     * Only the islands that contain nodes marked as dirty (see
+     * ik_node_interface_t::mark_dirty()) are re-derived. If nothing in the
+     * tree changed since the last call, only the segment lengths are updated.
      * @return Returns non-zero if any of the chain trees are invalid for any
      * reason. If this happens, check the log for error messages.
      * @warning If this functions fails, the internal structures are in an
@@ -177,6 +309,164 @@ IK_INTERFACE(solver_interface)
     ikret_t
     (*solve)(struct ik_solver_t* solver);
 
+    /*!
+     * @brief Solves multiple solvers at once by distributing them over the
+     * library's worker threads (see ik.thread_pool). Blocks until every solver
+     * has been solved.
+     *
+     * Solving only ever touches the solver itself and the nodes/effectors of
+     * its own tree, so solvers that share no tree can safely be solved at the
+     * same time. The same solver must not appear in the list more than once.
+     * Each solver must have been rebuilt beforehand.
+     * @note Rebuilding is *not* safe to do concurrently, because it may log
+     * messages and allocate memory.
+     * @return Returns the smallest value returned by any of the solvers. That
+     * is, 1 if every solver converged, 0 if any of them didn't, or a negative
+     * error code if any of them failed.
+     */
+    ikret_t
+    (*solve_batch)(struct ik_solver_t** solvers, int count);
+
+    /*!
+     * @brief Like solve_batch(), but solvers with identical chain trees
+     * ("rigs" instantiated from the same template) are solved in lockstep.
+     *
+     * Consecutive solvers in the list are grouped into "lanes" if they were
+     * rebuilt from the same topology (same tree layout and the same effector
+     * chain lengths) and use the same IK_ENABLE_TARGET_ROTATIONS setting.
+     * Their data is interleaved so every step of the algorithm is computed
+     * for all lanes at once. Targets, poses, segment lengths, tolerances and
+     * iteration counts may differ between lanes. A lane stops as soon as its
+     * own effectors have converged.
+     *
+     * The number of lanes is 8 for IK_PRECISION=float and 4 for double. Sort
+     * the list by rig template to get full lanes. Solvers that can't be
+     * grouped (different topology, or an algorithm other than FABRIK) are
+     * solved individually. The groups are distributed over the library's
+     * worker threads the same way solve_batch() distributes solvers.
+     * @return Returns the smallest value returned by any of the solvers. A
+     * lane returns 1 if all of its effectors converged, 0 if otherwise.
+     */
+    ikret_t
+    (*solve_lanes)(struct ik_solver_t** solvers, int count);
+
+    /*!
+     * @brief Solves count independent two bone problems (e.g. the legs and
+     * arms of a crowd) without any solver or tree. Each tip is placed on its
+     * target, or as close to it as the bones reach, and the middle joint
+     * bends toward the pole. This is the same closed form solution the
+     * TWO_BONE solver uses. It needs no trigonometry and several problems
+     * are solved per instruction.
+     */
+    void
+    (*solve_two_bone)(const struct ik_two_bone_batch_t* batch, int32_t count);
+
+    /*!
+     * @brief Aims count independent bones (e.g. the heads and eyes of a
+     * crowd) at their targets without any solver or tree. Each tip is
+     * placed on the line from the base to the target, one bone length away
+     * from the base. This is what the ONE_BONE solver uses. Optionally
+     * also writes the rotation that turns each bone onto its target.
+     */
+    void
+    (*solve_one_bone)(const struct ik_one_bone_batch_t* batch, int32_t count);
+
+    /*!
+     * @brief Reports how the last call to solve() went for one of the
+     * islands (see solver->chain_list). Islands stop iterating as soon as all
+     * of their effectors are within solver->tolerance of their targets, so
+     * poses that are already solved only cost a single iteration.
+     * @param[in] island_idx Index into solver->chain_list.
+     * @param[out] iterations Number of iterations used. May be NULL.
+     * @param[out] residual Largest distance between any of the island's
+     * effector nodes and its target after the last iteration. May be NULL.
+     * @return IK_RESULT_CONVERGED if the island converged, IK_OK if it ran
+     * out of iterations, IK_INDEX_OUT_OF_RANGE if the island doesn't exist.
+     * Solvers that don't iterate report 0 iterations and a residual of 0.
+     */
+    ikret_t
+    (*get_island_stats)(const struct ik_solver_t* solver, int island_idx,
+                        int32_t* iterations, ikreal_t* residual);
+
+    /*!
+     * @brief Writes the global transform of every node in the tree with a
+     * bone index (see ik_node_t::bone_index) to matrices[bone_index]. Call
+     * this after solve() instead of converting the nodes yourself in a
+     * callback.
+     *
+     * Each matrix is 3x4 and row major, i.e. 12 ikreal_t's: The rotation is
+     * in the first three columns and the translation in the last one. The
+     * matrix transforms from the node's space into the space of the tree's
+     * base node's parent. With IK_PRECISION=float, each matrix takes 48
+     * bytes, so the matrices of a 16 byte aligned array are aligned too.
+     * @param[in] inverse_bind If not NULL, holds bone_count matrices in the
+     * same layout. The global transform of each node is then multiplied by
+     * the inverse bind matrix of its bone (global * inverse bind), which
+     * gives the skinning matrices.
+     * @return IK_INDEX_OUT_OF_RANGE if any node has a bone index of
+     * bone_count or higher. These nodes are skipped, all others are still
+     * written. IK_SOLVER_HAS_NO_TREE if no tree was set.
+     */
+    ikret_t
+    (*write_matrices)(const struct ik_solver_t* solver, ikreal_t* matrices,
+                      const ikreal_t* inverse_bind, int32_t bone_count);
+
+    /*!
+     * @brief Copies the positions and rotations of the bones (see
+     * ik_node_t::bone_index) into the caller's arrays. This is the bulk
+     * alternative to reading each node in iterate_all_nodes().
+     *
+     * The order of the bones is fixed by rebuild(). If you change the bone
+     * index of a node, call mark_dirty() on it and rebuild() the solver.
+     * @param[out] positions Receives 3 ikreal_t's per element. May be NULL.
+     * @param[in] position_stride Distance between two elements in bytes, so
+     * the positions may be part of the caller's own structure. 0 means the
+     * elements are tightly packed.
+     * @param[out] rotations Receives a quaternion (x, y, z, w) per element.
+     * May be NULL.
+     * @param[in] rotation_stride Like position_stride, 0 means tightly packed.
+     * @param[in] remap If not NULL, element i holds bone remap[i]. Otherwise,
+     * element i holds bone i.
+     * @param[in] count The number of elements.
+     * @return IK_INDEX_OUT_OF_RANGE if any element refers to a bone no node
+     * has. These elements are left untouched, all others are still written.
+     * IK_SOLVER_HAS_NO_TREE if no tree was set.
+     */
+    ikret_t
+    (*get_pose)(struct ik_solver_t* solver, enum ik_pose_space_e space,
+                ikreal_t* positions, uintptr_t position_stride,
+                ikreal_t* rotations, uintptr_t rotation_stride,
+                const int32_t* remap, int32_t count);
+
+    /*!
+     * @brief Copies the caller's arrays into the positions and rotations of
+     * the bones. Takes the same arguments as get_pose().
+     *
+     * With IK_POSE_GLOBAL, only what was given is changed, e.g. if positions
+     * is NULL, the bones keep their local positions. Nodes that aren't set
+     * keep their local transforms and follow their parents.
+     */
+    ikret_t
+    (*set_pose)(struct ik_solver_t* solver, enum ik_pose_space_e space,
+                const ikreal_t* positions, uintptr_t position_stride,
+                const ikreal_t* rotations, uintptr_t rotation_stride,
+                const int32_t* remap, int32_t count);
+
+    /*!
+     * @brief Makes the caller's arrays the source and destination of the
+     * local transforms of the bones. Every call to solve(), solve_batch() or
+     * solve_lanes() then reads the bones from the arrays before solving and
+     * writes them back afterwards, so there is nothing left to copy for the
+     * caller. The arrays must stay valid until they are unbound.
+     *
+     * The bone order is fixed by rebuild(), see get_pose(). Bones with an
+     * index of binding->count or higher are left alone.
+     * @param[in] binding Describes the arrays and is copied. Pass NULL to
+     * unbind the arrays.
+     */
+    void
+    (*bind_pose)(struct ik_solver_t* solver, const struct ik_pose_binding_t* binding);
+
     /*!
      * @brief Sets the tree to solve. The solver takes ownership of the tree, so
      * destroying the solver will destroy all nodes in the tree. Note that you will
@@ -198,10 +488,42 @@ IK_INTERFACE(solver_interface)
     /*!
      * @brief The solver releases any references to a previously set tree and
      * destroys it.
+     *
+     * If the tree was built from objects allocated with create_node(),
+     * create_effector() and create_constraint() only, the solver's pool is
+     * released in bulk instead of destroying the nodes one by one. This
+     * releases *every* object allocated from the pool, including ones that
+     * aren't part of the tree (anymore).
      */
     void
     (*destroy_tree)(struct ik_solver_t* solver);
 
+    /*!
+     * @brief Creates a node of the solver's node type in the solver's pool.
+     *
+     * Nodes created this way are stored contiguously in the order they are
+     * created, and so are their children if they're created with
+     * create_child(). Objects from the pool must not outlive the solver:
+     * destroying the solver, or destroying its tree (see destroy_tree()),
+     * releases all of them at once. They can still be destroyed individually,
+     * which returns their memory to the pool.
+     */
+    struct ik_node_t*
+    (*create_node)(struct ik_solver_t* solver, uint32_t guid);
+
+    /*!
+     * @brief Creates an effector in the solver's pool. See create_node().
+     */
+    struct ik_effector_t*
+    (*create_effector)(struct ik_solver_t* solver);
+
+    /*!
+     * @brief Creates a constraint in the solver's pool. See create_node().
+     */
+    struct ik_constraint_t*
+    (*create_constraint)(struct ik_solver_t* solver,
+                         enum ik_constraint_type_e constraint_type);
+
     /*!
      * @brief Iterates all nodes in the internal tree, breadth first, and passes
      * each node to the specified callback function.
@@ -231,7 +553,9 @@ IK_INTERFACE(solver_interface)
      * replicated for solving. Because of this, the base nodes of all of the chains
      * in the tree won't be affected by a potential parent node if it is moved or
      * rotated, since the ik library doesn't know about any parent nodes -- It
-     * believes the base nodes ARE the parent-most nodes in the tree.
+     * believes the base nodes ARE the parent-most nodes in the tree. Every
+     * solver takes the transform of a base node as global and leaves its
+     * position alone.
      *
      * To overcome this, you can iterate all of these base nodes and copy the
      * *global* (world) position/rotation into each base node position/rotation.
@@ -0,0 +1,39 @@
+#ifndef IK_THREAD_POOL_H
+#define IK_THREAD_POOL_H
+
+#include "ik/config.h"
+
+C_BEGIN
+
+/*!
+ * @brief Configures the worker threads used by ik.solver.solve_batch().
+ *
+ * The pool is started lazily the first time it is needed. By default it spawns
+ * one worker thread less than there are online processors, because the thread
+ * calling solve_batch() participates in solving as well.
+ *
+ * If the library was built with IK_THREADS=OFF, everything is solved on the
+ * calling thread and set_worker_count() has no effect.
+ */
+IK_INTERFACE(thread_pool_interface)
+{
+    /*!
+     * @brief Stops all running worker threads and starts the specified number
+     * of new ones. A count of 0 causes all work to be done on the calling
+     * thread. A negative count restores the default.
+     * @warning Must not be called while a batch is being solved.
+     */
+    ikret_t
+    (*set_worker_count)(int count);
+
+    /*!
+     * @brief Returns the number of worker threads (not including the calling
+     * thread) that will be used to solve the next batch.
+     */
+    int
+    (*worker_count)(void);
+};
+
+C_END
+
+#endif /* IK_THREAD_POOL_H */
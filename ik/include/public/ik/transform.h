@@ -8,6 +8,7 @@ C_BEGIN
 struct vector_t;
 struct ik_node_t;
 struct chain_t;
+struct program_t;
 
 enum ik_transform_flags_e
 {
@@ -28,6 +29,44 @@ ik_transform_chain_list(const struct vector_t* chain_list, uint8_t flags);
 IK_PRIVATE_API void
 ik_transform_chain(struct chain_t* chain, uint8_t flags);
 
+/*!
+ * @brief Transforms the nodes of one island of a compiled program (see
+ * program.h), producing the same results as ik_transform_chain() on the
+ * island's base chain.
+ *
+ * Instead of recursing into every child chain, the island's slots are swept
+ * once from the base to the tips. Each slot's accumulated transform is
+ * computed from its parent's (see program->parent) and kept in
+ * program->transform, so the depth of the tree doesn't matter.
+ */
+IK_PRIVATE_API void
+ik_transform_island(struct program_t* program, uint32_t island_idx, uint8_t flags);
+
+/*!
+ * @brief Computes the global transform of every slot of the island into
+ * program->transform, same as ik_transform_island() with TR_L2G, but leaves
+ * the nodes in local space. The global positions are also written to
+ * program->pos_*, which is where the solver expects them.
+ *
+ * The result is kept in the program between solves. Only slots whose
+ * node->transform changed since the cache was last updated (compared to
+ * program->local), and the slots below them, are recomputed. The cache of an
+ * island is invalid after the program was compiled, or if island_cached was
+ * cleared.
+ */
+IK_PRIVATE_API void
+ik_transform_island_to_cache(struct program_t* program, uint32_t island_idx);
+
+/*!
+ * @brief Writes the solved global positions (program->pos_*) of the island
+ * back to the nodes in local space, same as ik_transform_island() with
+ * TR_G2L | TR_TRANSLATIONS. Only nodes that moved, or whose parent moved, are
+ * written. Afterwards the cache holds the solved pose. Must follow
+ * ik_transform_island_to_cache().
+ */
+IK_PRIVATE_API void
+ik_transform_island_from_cache(struct program_t* program, uint32_t island_idx);
+
 C_END
 
 #endif /* IK_TRANSFORM_H */
@@ -0,0 +1,3 @@
+#include "ik/heap.h"
+
+IK_IMPLEMENT(heap_static, heap_interface)
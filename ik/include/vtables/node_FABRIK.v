@@ -19,6 +19,7 @@ struct ik_node_FABRIK_t
 
 IK_IMPLEMENT(node_FABRIK, node_base)
 {
+    IK_OVERRIDE(type_size)
     IK_OVERRIDE(create)
     IK_CONSTRUCTOR(construct)
 }
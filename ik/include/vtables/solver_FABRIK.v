@@ -1,11 +1,36 @@
 #include "ik/solver_base.h"
+#include "ik/arena.h"
+#include "ik/program.h"
+
+struct ik_solver_FABRIK_t
+{
+    IK_SOLVER_HEAD
+
+    /* Flattened copy of the chain tree, compiled during rebuild() */
+    struct program_t program;
+    /* solver->topology at the time the program was compiled */
+    uint64_t compiled_topology;
+
+    /* Scratch memory for a single solve, see arena.h */
+    struct arena_t arena;
+
+    /*
+     * Scratch space for solve_lanes() if this solver leads a group of lanes.
+     * Points into the arena.
+     */
+    void* lanes_block;
+};
 
 IK_IMPLEMENT(solver_FABRIK, solver_base)
 {
     IK_OVERRIDE(type_size)
     IK_CONSTRUCTOR(construct)
     IK_BEFORE(destruct)
+    IK_AFTER(rebuild)
+    IK_AFTER(update_distances)
     IK_AFTER(solve)
+    IK_OVERRIDE(solve_lanes)
+    IK_OVERRIDE(get_island_stats)
 }
 
 /*
@@ -20,6 +45,10 @@ IK_IMPLEMENT(constraint_FABRIK, constraint_base)
  * Need to combine multiple ikret_t return values from the various before/after
  * functions.
  */
+static inline ikret_t ik_solver_FABRIK_harness_rebuild_return_value(ikret_t a, ikret_t b) {
+    if (a != IK_OK) return a;
+    return b;
+}
 static inline ikret_t ik_solver_FABRIK_harness_solve_return_value(ikret_t a, ikret_t b) {
     if (a != IK_OK) return a;
     return b;
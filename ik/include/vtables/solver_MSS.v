@@ -1,5 +1,50 @@
 #include "ik/solver_base.h"
 
+/*
+ * Every node of the chain trees is a particle, every bone a spring. See
+ * solver_MSS.c.
+ */
+struct ik_solver_MSS_t
+{
+    IK_SOLVER_HEAD
+
+    /* All of the arrays below are carved out of this block by rebuild() */
+    uint8_t* block;
+    uintptr_t block_size;
+
+    uint32_t particle_count;
+    uint32_t spring_count;
+
+    /* Particles, in pre-order starting at the base node of each island */
+    struct ik_node_t** nodes;
+    ikreal_t* inv_mass;    /* 0 for the base nodes, which don't move */
+    ikreal_t* pull;        /* Stiffness of the spring to the target */
+    ikreal_t* target[3];   /* Only set for particles with an effector */
+
+    /* Springs, a parent particle always comes before its child */
+    uint32_t* spring_parent;
+    uint32_t* spring_child;
+    ikreal_t* rest_length;
+
+    /*
+     * Integrator state. Each array holds 6 rows of particle_count elements:
+     * x, y, z of the positions followed by x, y, z of the velocities.
+     */
+    ikreal_t* y;
+    ikreal_t* dydx;
+    ikreal_t* ak2;
+    ikreal_t* ak3;
+    ikreal_t* ak4;
+    ikreal_t* ak5;
+    ikreal_t* ak6;
+    ikreal_t* ytemp;
+    ikreal_t* ytry;
+    ikreal_t* yerr;
+
+    /* Step size suggested by the last solve, tried first by the next one */
+    ikreal_t step;
+};
+
 IK_IMPLEMENT(node_MSS, node_base)
 {
 }
@@ -9,7 +54,7 @@ IK_IMPLEMENT(solver_MSS, solver_base)
     IK_OVERRIDE(type_size)
     IK_CONSTRUCTOR(construct)
     IK_DESTRUCTOR(destruct)
-    IK_AFTER(rebuild_data)
+    IK_AFTER(rebuild)
     IK_AFTER(solve)
 }
 
@@ -0,0 +1,37 @@
+#include "ik/thread_pool.h"
+
+IK_IMPLEMENT(thread_pool_static, thread_pool_interface)
+
+/*!
+ * @brief A job is called once for every index in [0, count). The return values
+ * of all jobs are reduced to the smallest value, so errors take precedence.
+ */
+typedef ikret_t (*ik_thread_pool_job_func)(void* user_data, uint32_t job_idx);
+
+/*!
+ * @brief Runs count jobs on the worker threads and blocks until they have all
+ * completed. The calling thread participates. Idle threads steal work from
+ * busy ones, so jobs of unequal cost are balanced out.
+ *
+ * If the pool is already busy (i.e. a job calls this function again, or two
+ * threads call it at the same time) the jobs are run serially on the calling
+ * thread instead.
+ * @return Returns the smallest value returned by any of the jobs, or IK_OK if
+ * count is 0.
+ */
+IK_PRIVATE_API ikret_t
+ik_thread_pool_static_run(ik_thread_pool_job_func job, void* user_data, uint32_t count);
+
+/*!
+ * @brief Spawns the worker threads if they aren't running yet. This happens
+ * automatically the first time jobs are run, but the solver entry points call
+ * it beforehand so solving itself never allocates (see IKAPI.heap).
+ */
+IK_PRIVATE_API ikret_t
+ik_thread_pool_static_start(void);
+
+/*!
+ * @brief Joins all worker threads. Called when the library is de-initialized.
+ */
+IK_PRIVATE_API void
+ik_thread_pool_static_deinit(void);
@@ -0,0 +1,80 @@
+#include "ik/arena.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1))
+
+/* ------------------------------------------------------------------------- */
+void
+arena_construct(struct arena_t* arena)
+{
+    arena->block = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+    arena->required = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+arena_destruct(struct arena_t* arena)
+{
+    if (arena->block != NULL)
+        FREE(arena->block);
+    arena_construct(arena);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+arena_reserve(struct arena_t* arena, uintptr_t size)
+{
+    char* block;
+
+    arena->used = 0;
+    size = ARENA_ALIGN(size);
+    if (size < arena->required)
+        size = arena->required;
+    if (size <= arena->capacity)
+        return IK_OK;
+
+    if ((block = MALLOC(size)) == NULL)
+    {
+        IKAPI.log.message("Failed to allocate solver arena: Ran out of memory");
+        return IK_RAN_OUT_OF_MEMORY;
+    }
+
+    if (arena->block != NULL)
+        FREE(arena->block);
+    arena->block = block;
+    arena->capacity = size;
+    arena->required = size;
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+arena_reset(struct arena_t* arena)
+{
+    arena->used = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+arena_alloc(struct arena_t* arena, uintptr_t size)
+{
+    void* p;
+
+    size = ARENA_ALIGN(size);
+    if (arena->used + size > arena->capacity)
+    {
+        if (arena->used + size > arena->required)
+            arena->required = arena->used + size;
+        return NULL;
+    }
+
+    p = arena->block + arena->used;
+    arena->used += size;
+    return p;
+}
@@ -0,0 +1,300 @@
+#include "ik/batch.h"
+#include <math.h>
+#include <stddef.h>
+
+static const struct batch_kernels_t* g_kernels = NULL;
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_length(ikreal_t* out,
+              const ikreal_t* x, const ikreal_t* y, const ikreal_t* z,
+              uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i != n; ++i)
+        out[i] = sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_normalize(ikreal_t* x, ikreal_t* y, ikreal_t* z, uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i != n; ++i)
+    {
+        ikreal_t length = sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
+        if (length != 0.0)
+        {
+            length = 1.0 / length;
+            x[i] *= length;
+            y[i] *= length;
+            z[i] *= length;
+        }
+        else
+        {
+            x[i] = 1;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_rotate(ikreal_t* x, ikreal_t* y, ikreal_t* z,
+              const ikreal_t* qx, const ikreal_t* qy, const ikreal_t* qz, const ikreal_t* qw,
+              uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i != n; ++i)
+    {
+        /* v' = (w^2 - u.u)v + 2(u.v)u + 2w(u x v) */
+        ikreal_t uu = qx[i]*qx[i] + qy[i]*qy[i] + qz[i]*qz[i];
+        ikreal_t uv2 = 2.0 * (qx[i]*x[i] + qy[i]*y[i] + qz[i]*z[i]);
+        ikreal_t s = qw[i]*qw[i] - uu;
+        ikreal_t w2 = 2.0 * qw[i];
+        ikreal_t cx = qy[i]*z[i] - qz[i]*y[i];
+        ikreal_t cy = qz[i]*x[i] - qx[i]*z[i];
+        ikreal_t cz = qx[i]*y[i] - qy[i]*x[i];
+        ikreal_t vx = x[i], vy = y[i], vz = z[i];
+        x[i] = s*vx + uv2*qx[i] + w2*cx;
+        y[i] = s*vy + uv2*qy[i] + w2*cy;
+        z[i] = s*vz + uv2*qz[i] + w2*cz;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_quat_mul(ikreal_t* ax, ikreal_t* ay, ikreal_t* az, ikreal_t* aw,
+                const ikreal_t* bx, const ikreal_t* by, const ikreal_t* bz, const ikreal_t* bw,
+                uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i != n; ++i)
+    {
+        ikreal_t x = ax[i]*bw[i] + bx[i]*aw[i] + (ay[i]*bz[i] - by[i]*az[i]);
+        ikreal_t y = ay[i]*bw[i] + by[i]*aw[i] + (az[i]*bx[i] - bz[i]*ax[i]);
+        ikreal_t z = az[i]*bw[i] + bz[i]*aw[i] + (ax[i]*by[i] - bx[i]*ay[i]);
+        ikreal_t w = aw[i]*bw[i] - (ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i]);
+        ikreal_t mag = sqrt((x*x + y*y) + (z*z + w*w));
+        if (mag != 0.0)
+            mag = 1.0 / mag;
+        ax[i] = x * mag;
+        ay[i] = y * mag;
+        az[i] = z * mag;
+        aw[i] = w * mag;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_to_matrix(ikreal_t* const m[12],
+                 const ikreal_t* qx, const ikreal_t* qy, const ikreal_t* qz, const ikreal_t* qw,
+                 const ikreal_t* px, const ikreal_t* py, const ikreal_t* pz,
+                 uint32_t n)
+{
+    uint32_t i;
+    for (i = 0; i != n; ++i)
+    {
+        ikreal_t x2 = 2.0 * qx[i], y2 = 2.0 * qy[i], z2 = 2.0 * qz[i];
+        ikreal_t xx = qx[i]*x2, yy = qy[i]*y2, zz = qz[i]*z2;
+        ikreal_t xy = qx[i]*y2, xz = qx[i]*z2, yz = qy[i]*z2;
+        ikreal_t wx = qw[i]*x2, wy = qw[i]*y2, wz = qw[i]*z2;
+        m[0][i] = 1.0 - (yy + zz); m[1][i] = xy - wz;         m[2][i] = xz + wy;          m[3][i] = px[i];
+        m[4][i] = xy + wz;         m[5][i] = 1.0 - (xx + zz); m[6][i] = yz - wx;          m[7][i] = py[i];
+        m[8][i] = xz - wy;         m[9][i] = yz + wx;         m[10][i] = 1.0 - (xx + yy); m[11][i] = pz[i];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_matrix_mul(ikreal_t* const a[12], const ikreal_t* const b[12], uint32_t n)
+{
+    uint32_t i;
+    int r;
+    for (i = 0; i != n; ++i)
+        for (r = 0; r != 3; ++r)
+        {
+            ikreal_t a0 = a[r*4+0][i], a1 = a[r*4+1][i], a2 = a[r*4+2][i], a3 = a[r*4+3][i];
+            a[r*4+0][i] = a0*b[0][i] + a1*b[4][i] + a2*b[8][i];
+            a[r*4+1][i] = a0*b[1][i] + a1*b[5][i] + a2*b[9][i];
+            a[r*4+2][i] = a0*b[2][i] + a1*b[6][i] + a2*b[10][i];
+            a[r*4+3][i] = a0*b[3][i] + a1*b[7][i] + a2*b[11][i] + a3;
+        }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_two_bone(ikreal_t* const mid[3], ikreal_t* const tip[3],
+                const ikreal_t* const base[3], const ikreal_t* const target[3],
+                const ikreal_t* const pole[3],
+                const ikreal_t* upper, const ikreal_t* lower, uint32_t n)
+{
+    uint32_t i;
+    int k;
+    for (i = 0; i != n; ++i)
+    {
+        ikreal_t a = upper[i], b = lower[i];
+        ikreal_t d[3], p[3], c, reach, x, h, proj, length;
+        for (k = 0; k != 3; ++k)
+        {
+            d[k] = target[k][i] - base[k][i];
+            p[k] = pole[k][i] - base[k][i];
+        }
+
+        /* Direction to the target, (1, 0, 0) if the target is on the base */
+        c = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        if (c != 0.0)
+        {
+            d[0] /= c;
+            d[1] /= c;
+            d[2] /= c;
+        }
+        else
+            d[0] = 1;
+
+        /* The distance to the tip is limited by what the bones can span */
+        reach = c < a + b ? c : a + b;
+        if (reach < fabs(a - b))
+            reach = fabs(a - b);
+
+        /*
+         * The law of cosines without the angle: x is how far the middle
+         * joint is along d, h how far it is away from d
+         */
+        x = reach != 0.0 ? (a*a - b*b + reach*reach) / (2.0 * reach) : 0.0;
+        h = a*a - x*x;
+        h = h > 0.0 ? sqrt(h) : 0.0;
+
+        /*
+         * Bend toward the part of the pole that is perpendicular to d. If
+         * there is none, any perpendicular direction will do.
+         */
+        proj = p[0]*d[0] + p[1]*d[1] + p[2]*d[2];
+        for (k = 0; k != 3; ++k)
+            p[k] -= proj * d[k];
+        length = sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+        if (length == 0.0)
+        {
+            p[0] = d[1];
+            p[1] = -d[0];
+            p[2] = 0;
+            length = sqrt(p[0]*p[0] + p[1]*p[1]);
+        }
+        if (length == 0.0)
+        {
+            p[0] = 1;
+            length = 1;
+        }
+
+        for (k = 0; k != 3; ++k)
+        {
+            mid[k][i] = base[k][i] + d[k]*x + p[k]*(h / length);
+            tip[k][i] = base[k][i] + d[k]*reach;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+scalar_one_bone(ikreal_t* const tip[3], ikreal_t* const rotation[4],
+                const ikreal_t* const base[3], const ikreal_t* const target[3],
+                const ikreal_t* const forward[3], const ikreal_t* length, uint32_t n)
+{
+    uint32_t i;
+    int k;
+    for (i = 0; i != n; ++i)
+    {
+        ikreal_t d[3], f[3], q[4], c, mag;
+        for (k = 0; k != 3; ++k)
+            d[k] = target[k][i] - base[k][i];
+
+        /* Direction to the target, (1, 0, 0) if the target is on the base */
+        c = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        if (c != 0.0)
+        {
+            d[0] /= c;
+            d[1] /= c;
+            d[2] /= c;
+        }
+        else
+            d[0] = 1;
+
+        for (k = 0; k != 3; ++k)
+            tip[k][i] = base[k][i] + d[k] * length[i];
+
+        if (rotation[0] == NULL)
+            continue;
+
+        /*
+         * Half-angle identity: (f x d, |f| + f.d) is the rotation from f to
+         * the unit vector d scaled by 2|f|cos(angle/2). If f and d are
+         * opposite it is zero, and any half turn about an axis
+         * perpendicular to f will do.
+         */
+        for (k = 0; k != 3; ++k)
+            f[k] = forward[k][i];
+        q[0] = f[1]*d[2] - f[2]*d[1];
+        q[1] = f[2]*d[0] - f[0]*d[2];
+        q[2] = f[0]*d[1] - f[1]*d[0];
+        q[3] = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]) + f[0]*d[0] + f[1]*d[1] + f[2]*d[2];
+        mag = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+        if (mag == 0.0)
+        {
+            q[0] = f[1];
+            q[1] = -f[0];
+            q[2] = 0;
+            q[3] = 0;
+            mag = q[0]*q[0] + q[1]*q[1];
+        }
+        if (mag == 0.0)
+        {
+            q[0] = 1;
+            mag = 1;
+        }
+
+        mag = 1.0 / sqrt(mag);
+        for (k = 0; k != 4; ++k)
+            rotation[k][i] = q[k] * mag;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static const struct batch_kernels_t g_scalar_kernels = {
+    "scalar",
+    scalar_length,
+    scalar_normalize,
+    scalar_rotate,
+    scalar_quat_mul,
+    scalar_to_matrix,
+    scalar_matrix_mul,
+    scalar_two_bone,
+    scalar_one_bone
+};
+const struct batch_kernels_t*
+batch_kernels_scalar(void)
+{
+    return &g_scalar_kernels;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+batch_init(void)
+{
+    const struct batch_kernels_t* kernels;
+
+    /* Ordered from most to least preferred */
+    if ((kernels = batch_kernels_avx2()) != NULL)
+        g_kernels = kernels;
+    else if ((kernels = batch_kernels_neon()) != NULL)
+        g_kernels = kernels;
+    else if ((kernels = batch_kernels_sse2()) != NULL)
+        g_kernels = kernels;
+    else
+        g_kernels = &g_scalar_kernels;
+}
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels(void)
+{
+    return g_kernels != NULL ? g_kernels : &g_scalar_kernels;
+}
@@ -1,5 +1,7 @@
 #include "benchmark/benchmark.h"
 #include "ik/ik.h"
+#include "ik/transform.h"
+#include <vector>
 
 using namespace benchmark;
 
@@ -117,14 +119,36 @@ static ik_solver_t* create_solver(Type type)
     return solver;
 }
 
+/*
+ * Reports the number of allocations made per iteration since "allocations"
+ * was sampled. Solving isn't supposed to allocate anything, and neither is
+ * rebuilding a tree that was rebuilt before.
+ */
+static void set_allocations_per_iteration(State& state, const char* name, uintptr_t allocations)
+{
+    state.counters[name] =
+        (double)(IKAPI.heap.allocation_count() - allocations) / state.iterations();
+}
+
+/*
+ * BINARY_TREE has ~12k nodes, which is where the child layout selected with
+ * IK_NODE_CHILDREN makes a difference in these two benchmarks.
+ */
 static void BM_rebuild_tree(State& state)
 {
     ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
     ik_node_t* root = create_tree(solver, (Type)state.range(0));
     IKAPI.solver.set_tree(solver, root);
+    IKAPI.solver.rebuild(solver);
 
+    uintptr_t allocations = IKAPI.heap.allocation_count();
     while (state.KeepRunning())
+    {
+        /* Setting the tree again forces rebuild() to start from scratch */
+        IKAPI.solver.set_tree(solver, IKAPI.solver.unlink_tree(solver));
         IKAPI.solver.rebuild(solver);
+    }
+    set_allocations_per_iteration(state, "allocs_per_rebuild", allocations);
 
     IKAPI.solver.destroy(solver);
 }
@@ -134,15 +158,113 @@ BENCHMARK(BM_rebuild_tree)
     ->Arg(BINARY_TREE)
     ;
 
+static void BM_rebuild_tree_unchanged(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+
+    while (state.KeepRunning())
+        IKAPI.solver.rebuild(solver);
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_rebuild_tree_unchanged)
+    ->Arg(CHAIN_10)
+    ->Arg(TWO_ARMS)
+    ->Arg(BINARY_TREE)
+    ;
+
+static void BM_transform_tree(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+
+    while (state.KeepRunning())
+    {
+        ik_transform_tree(solver->tree, TR_L2G);
+        ik_transform_tree(solver->tree, TR_G2L);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_transform_tree)
+    ->Arg(CHAIN_10)
+    ->Arg(TWO_ARMS)
+    ->Arg(BINARY_TREE)
+    ;
+
+static int32_t g_bone_count;
+static void assign_bone_index(ik_node_t* node)
+{
+    node->bone_index = g_bone_count++;
+}
+
+/*
+ * Writes a matrix for every node of the tree. The second arg is 1 if the
+ * global transforms are multiplied by inverse bind matrices.
+ */
+static void BM_write_matrices(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+    g_bone_count = 0;
+    IKAPI.solver.iterate_all_nodes(solver, assign_bone_index);
+
+    std::vector<ikreal_t> matrices(g_bone_count * 12);
+    std::vector<ikreal_t> inverse_bind(g_bone_count * 12);
+    for (int32_t i = 0; i != g_bone_count; ++i)
+        inverse_bind[i * 12 + 0] = inverse_bind[i * 12 + 5] = inverse_bind[i * 12 + 10] = 1;
+
+    while (state.KeepRunning())
+        IKAPI.solver.write_matrices(solver, matrices.data(),
+                                    state.range(1) ? inverse_bind.data() : NULL, g_bone_count);
+
+    state.SetItemsProcessed(state.iterations() * g_bone_count);
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_write_matrices)
+    ->Args({CHAIN_10, 0})
+    ->Args({BINARY_TREE, 0})
+    ->Args({BINARY_TREE, 1})
+    ;
+
+/*
+ * Reads the pose of every node of the tree into interleaved position and
+ * rotation arrays. The second arg is the space (IK_POSE_LOCAL or
+ * IK_POSE_GLOBAL).
+ */
+static void BM_get_pose(State& state)
+{
+    ik_solver_t* solver = create_solver((Type)state.range(0));
+    g_bone_count = 0;
+    IKAPI.solver.iterate_all_nodes(solver, assign_bone_index);
+    solver->node->mark_dirty(solver->tree);
+    IKAPI.solver.rebuild(solver);
+
+    std::vector<ikreal_t> pose(g_bone_count * 8);
+    while (state.KeepRunning())
+        IKAPI.solver.get_pose(solver, (ik_pose_space_e)state.range(1),
+                              &pose[0], sizeof(ikreal_t) * 8,
+                              &pose[4], sizeof(ikreal_t) * 8,
+                              NULL, g_bone_count);
+
+    state.SetItemsProcessed(state.iterations() * g_bone_count);
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_get_pose)
+    ->Args({BINARY_TREE, IK_POSE_LOCAL})
+    ->Args({BINARY_TREE, IK_POSE_GLOBAL})
+    ;
+
 static void BM_FABRIK_solve(State& state)
 {
     ik_solver_t* solver = create_solver((Type)state.range(0));
+    solver->flags &= ~IK_ENABLE_JOINT_ROTATIONS;
 
+    uintptr_t allocations = IKAPI.heap.allocation_count();
     while (state.KeepRunning())
     {
         /*ik_solver_reset_to_original_pose(solver);*/
         IKAPI.solver.solve(solver);
     }
+    set_allocations_per_iteration(state, "allocs_per_solve", allocations);
 
     IKAPI.solver.destroy(solver);
 }
@@ -156,11 +278,13 @@ static void BM_FABRIK_solve_final_rotations(State& state)
 {
     ik_solver_t* solver = create_solver((Type)state.range(0));
 
+    uintptr_t allocations = IKAPI.heap.allocation_count();
     while (state.KeepRunning())
     {
         /*ik_solver_reset_to_original_pose(solver);*/
         IKAPI.solver.solve(solver);
     }
+    set_allocations_per_iteration(state, "allocs_per_solve", allocations);
 
     IKAPI.solver.destroy(solver);
 }
@@ -170,3 +294,55 @@ BENCHMARK(BM_FABRIK_solve_final_rotations)
     ->Arg(BINARY_TREE)
     ;
 
+
+static void BM_FABRIK_solve_batch(State& state)
+{
+    const int crowd_size = 256;
+    ik_solver_t* solvers[crowd_size];
+    for (int i = 0; i != crowd_size; ++i)
+        solvers[i] = create_solver(TWO_ARMS);
+
+    IKAPI.thread_pool.set_worker_count((int)state.range(0));
+    IKAPI.solver.solve_batch(solvers, crowd_size); /* Warm up: starts the workers, reserves scratch */
+    uintptr_t allocations = IKAPI.heap.allocation_count();
+    while (state.KeepRunning())
+        IKAPI.solver.solve_batch(solvers, crowd_size);
+    state.SetItemsProcessed(state.iterations() * crowd_size);
+    set_allocations_per_iteration(state, "allocs_per_solve", allocations);
+    IKAPI.thread_pool.set_worker_count(-1);
+
+    for (int i = 0; i != crowd_size; ++i)
+        IKAPI.solver.destroy(solvers[i]);
+}
+BENCHMARK(BM_FABRIK_solve_batch)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(3)
+    ->Arg(7)
+    ->UseRealTime()
+    ;
+
+static void BM_FABRIK_solve_lanes(State& state)
+{
+    const int crowd_size = 256;
+    ik_solver_t* solvers[crowd_size];
+    for (int i = 0; i != crowd_size; ++i)
+        solvers[i] = create_solver(TWO_ARMS);
+
+    IKAPI.thread_pool.set_worker_count((int)state.range(0));
+    IKAPI.solver.solve_lanes(solvers, crowd_size); /* Warm up: starts the workers, reserves scratch */
+    uintptr_t allocations = IKAPI.heap.allocation_count();
+    while (state.KeepRunning())
+        IKAPI.solver.solve_lanes(solvers, crowd_size);
+    state.SetItemsProcessed(state.iterations() * crowd_size);
+    set_allocations_per_iteration(state, "allocs_per_solve", allocations);
+    IKAPI.thread_pool.set_worker_count(-1);
+
+    for (int i = 0; i != crowd_size; ++i)
+        IKAPI.solver.destroy(solvers[i]);
+}
+BENCHMARK(BM_FABRIK_solve_lanes)
+    ->Arg(0)
+    ->Arg(3)
+    ->UseRealTime()
+    ;
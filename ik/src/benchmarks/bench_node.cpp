@@ -0,0 +1,74 @@
+#include "benchmark/benchmark.h"
+#include "ik/ik.h"
+
+using namespace benchmark;
+
+static ik_node_t* create_wide_tree(const ik_node_interface_t* node, uint32_t* guid, int depth)
+{
+    ik_node_t* parent = node->create((*guid)++);
+    if (depth > 0)
+        for (int i = 0; i != 5; ++i)
+            node->add_child(parent, create_wide_tree(node, guid, depth - 1));
+    return parent;
+}
+
+/*
+ * Looks up nodes spread across a tree with 5^0 + 5^1 + ... + 5^7 = 97656
+ * nodes. Arg is 1 if the tree has a guid index.
+ */
+static void BM_find_child(State& state)
+{
+    const ik_node_interface_t* node = &IKAPI.internal.node_base;
+    uint32_t guid = 0;
+    uint32_t lookup = 0;
+    ik_node_t* root = create_wide_tree(node, &guid, 7);
+    if (state.range(0))
+        node->build_guid_index(root);
+
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(node->find_child(root, lookup));
+        lookup = (lookup + 7919) % guid;
+    }
+
+    node->destroy(root);
+}
+BENCHMARK(BM_find_child)
+    ->Arg(0)
+    ->Arg(1)
+    ;
+
+/*
+ * Creates and destroys a skeleton of 80 nodes with 5 effectors, like
+ * spawning a character. Arg is 1 if the objects are allocated from the
+ * solver's pool.
+ */
+static void BM_create_destroy_tree(State& state)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    const ik_node_interface_t* node = solver->node;
+    const ik_effector_interface_t* effector = solver->effector;
+
+    while (state.KeepRunning())
+    {
+        ik_node_t* root = state.range(0) ?
+            solver->v->create_node(solver, 0) : node->create(0);
+        uint32_t guid = 1;
+        for (int limb = 0; limb != 5; ++limb)
+        {
+            ik_node_t* parent = root;
+            for (int i = 0; i != 16 && guid != 80; ++i)
+                parent = node->create_child(parent, guid++);
+            effector->attach(state.range(0) ?
+                solver->v->create_effector(solver) : effector->create(), parent);
+        }
+        solver->v->set_tree(solver, root);
+        solver->v->destroy_tree(solver);
+    }
+
+    IKAPI.solver.destroy(solver);
+}
+BENCHMARK(BM_create_destroy_tree)
+    ->Arg(0)
+    ->Arg(1)
+    ;
@@ -1,3 +1,90 @@
 #include "benchmark/benchmark.h"
+#include "ik/ik.h"
+#include <vector>
 
+using namespace benchmark;
 
+/*
+ * Solves state.range(0) two bone problems in one call to solve_two_bone().
+ * Every problem is reachable, so none of them take the straight chain path.
+ */
+static void BM_solve_two_bone(State& state)
+{
+    const int count = (int)state.range(0);
+    std::vector<ikreal_t> in(count * 11), out(count * 6);
+    ik_two_bone_batch_t batch;
+    for (int k = 0; k != 3; ++k)
+    {
+        batch.base[k] = &in[(0 + k) * count];
+        batch.target[k] = &in[(3 + k) * count];
+        batch.pole[k] = &in[(6 + k) * count];
+        batch.mid[k] = &out[k * count];
+        batch.tip[k] = &out[(3 + k) * count];
+    }
+    batch.upper_length = &in[9 * count];
+    batch.lower_length = &in[10 * count];
+
+    for (int i = 0; i != count; ++i)
+    {
+        in[3 * count + i] = 0.5 + (i % 11) * 0.1;
+        in[4 * count + i] = 0.25 * (i % 3);
+        in[7 * count + i] = 1;
+        in[8 * count + i] = 1;
+        in[9 * count + i] = 1;
+        in[10 * count + i] = 1;
+    }
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.solve_two_bone(&batch, count);
+        ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_solve_two_bone)
+    ->Arg(31)
+    ->Arg(8000)
+    ;
+
+/*
+ * Aims state.range(0) bones in one call to solve_one_bone(). The second arg
+ * is 1 to also compute the rotations.
+ */
+static void BM_solve_one_bone(State& state)
+{
+    const int count = (int)state.range(0);
+    std::vector<ikreal_t> in(count * 10), out(count * 7);
+    ik_one_bone_batch_t batch;
+    for (int k = 0; k != 3; ++k)
+    {
+        batch.base[k] = &in[(0 + k) * count];
+        batch.target[k] = &in[(3 + k) * count];
+        batch.forward[k] = &in[(6 + k) * count];
+        batch.tip[k] = &out[k * count];
+    }
+    for (int k = 0; k != 4; ++k)
+        batch.rotation[k] = state.range(1) ? &out[(3 + k) * count] : NULL;
+    batch.length = &in[9 * count];
+
+    for (int i = 0; i != count; ++i)
+    {
+        in[3 * count + i] = 0.5 + (i % 11) * 0.1;
+        in[4 * count + i] = 0.25 * (i % 3);
+        in[5 * count + i] = 1;
+        in[7 * count + i] = 1;
+        in[9 * count + i] = 1;
+    }
+
+    while (state.KeepRunning())
+    {
+        IKAPI.solver.solve_one_bone(&batch, count);
+        ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_solve_one_bone)
+    ->Args({8000, 0})
+    ->Args({8000, 1})
+    ;
@@ -0,0 +1,14 @@
+#include "ik/carve.h"
+#include <stddef.h>
+
+#define CARVE_ALIGNMENT 16
+#define CARVE_ALIGN(size) (((size) + CARVE_ALIGNMENT - 1) & ~(uintptr_t)(CARVE_ALIGNMENT - 1))
+
+/* ------------------------------------------------------------------------- */
+void*
+carve(uint8_t* block, uintptr_t* offset, uintptr_t size)
+{
+    void* p = block ? block + *offset : NULL;
+    *offset = CARVE_ALIGN(*offset + size);
+    return p;
+}
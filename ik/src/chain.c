@@ -5,6 +5,8 @@
 #include "ik/vec3_static.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 enum node_marking_e
 {
@@ -13,66 +15,69 @@ enum node_marking_e
     MARK_SECTION
 };
 
-/* ------------------------------------------------------------------------- */
-struct chain_t*
-chain_create(void)
-{
-    struct chain_t* chain = MALLOC(sizeof *chain);
-    if (chain == NULL)
-    {
-        IKAPI.log.message("Failed to allocate chain: out of memory");
-        return NULL;
-    }
-    chain_construct(chain);
-    return chain;
-}
+/* Parent of a chain record that starts a new island */
+#define CHAIN_NO_PARENT ((uint32_t)-1)
 
-/* ------------------------------------------------------------------------- */
-void
-chain_destroy(struct chain_t* chain)
+/*
+ * A chain found while walking the tree. Records are stored in the order the
+ * chains are found, so a parent always comes before its children.
+ */
+struct chain_record_t
 {
-    chain_destruct(chain);
-    FREE(chain);
-}
+    uint32_t parent;
+    /* Range in storage->record_nodes */
+    uint32_t first_node;
+    uint32_t node_count;
+    uint32_t child_count;
+    /* Where the children are laid out, and how many were placed so far */
+    struct chain_t* children;
+    uint32_t placed_children;
+};
 
-/* ------------------------------------------------------------------------- */
-void
-chain_construct(struct chain_t* chain)
+/*
+ * Used to put the islands of chain_tree_update() in the same order
+ * chain_tree_rebuild() would have found them in.
+ */
+struct island_key_t
 {
-    vector_construct(&chain->nodes, sizeof(struct ik_node_t*));
-    vector_construct(&chain->children, sizeof(struct chain_t));
-}
+    const struct ik_node_t* tip;
+    uint32_t order;
+    struct chain_t island;
+};
 
 /* ------------------------------------------------------------------------- */
 void
-chain_destruct(struct chain_t* chain)
+chain_storage_construct(struct chain_storage_t* storage)
 {
-    CHAIN_FOR_EACH_CHILD(chain, child_chain)
-        chain_destruct(child_chain);
-    CHAIN_END_EACH
-    vector_clear_free(&chain->children);
-    vector_clear_free(&chain->nodes);
+    storage->block = NULL;
+    storage->block_size = 0;
+    storage->spare = NULL;
+    storage->spare_size = 0;
+    bstv_construct(&storage->involved_nodes);
+    vector_construct(&storage->records, sizeof(struct chain_record_t));
+    vector_construct(&storage->record_nodes, sizeof(struct ik_node_t*));
+    vector_construct(&storage->live_effectors, sizeof(struct ik_node_t*));
+    vector_construct(&storage->dirty_effectors, sizeof(struct ik_node_t*));
+    vector_construct(&storage->claimed, sizeof(uint8_t));
+    vector_construct(&storage->island_keys, sizeof(struct island_key_t));
 }
 
 /* ------------------------------------------------------------------------- */
 void
-chain_clear_free(struct chain_t* chain)
+chain_storage_destruct(struct chain_storage_t* storage)
 {
-    chain_destruct(chain); /* does the same thing */
-}
-
-/* ------------------------------------------------------------------------- */
-struct chain_t*
-chain_create_child(struct chain_t* chain)
-{
-    return vector_push_emplace(&chain->children);
-}
-
-/* ------------------------------------------------------------------------- */
-ikret_t
-chain_add_node(struct chain_t* chain, const struct ik_node_t* node)
-{
-    return vector_push(&chain->nodes, &node);
+    if (storage->block != NULL)
+        FREE(storage->block);
+    if (storage->spare != NULL)
+        FREE(storage->spare);
+    bstv_clear_free(&storage->involved_nodes);
+    vector_clear_free(&storage->records);
+    vector_clear_free(&storage->record_nodes);
+    vector_clear_free(&storage->live_effectors);
+    vector_clear_free(&storage->dirty_effectors);
+    vector_clear_free(&storage->claimed);
+    vector_clear_free(&storage->island_keys);
+    chain_storage_construct(storage);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -164,15 +169,19 @@ mark_involved_nodes(struct bstv_t* involved_nodes,
 
 /* ------------------------------------------------------------------------- */
 static ikret_t
-recursively_build_chain_tree(struct vector_t* chain_list,
-                             struct chain_t* chain_current,
+recursively_build_chain_tree(struct chain_storage_t* storage,
+                             uint32_t chain_current,
                              const struct ik_node_t* node_base,
-                             const struct ik_node_t* node_current,
-                             struct bstv_t* involved_nodes)
+                             const struct ik_node_t* node_current)
 {
     int marked_children_count;
     const struct ik_node_t* child_node_base = node_base;
-    struct chain_t* child_chain = chain_current;
+    uint32_t child_chain = chain_current;
+    struct bstv_t* involved_nodes = &storage->involved_nodes;
+
+    /* Every marked node has been visited, nothing left to build */
+    if (bstv_count(involved_nodes) == 0)
+        return IK_OK;
 
     /* can remove the mark from the set to speed up future checks */
     enum node_marking_e marking =
@@ -189,7 +198,7 @@ recursively_build_chain_tree(struct vector_t* chain_list,
          */
         case MARK_BASE:
             child_node_base = node_current;
-            chain_current = NULL;
+            chain_current = CHAIN_NO_PARENT;
             break;
         /*
          * If this node is not marked at all, cut off any previous chain but
@@ -217,49 +226,48 @@ recursively_build_chain_tree(struct vector_t* chain_list,
             if ((marked_children_count == 2 || node_current->effector != NULL) && node_current != node_base)
             {
                 const struct ik_node_t* node;
+                struct chain_record_t* record;
+                uint32_t first_node = vector_count(&storage->record_nodes);
 
-                if (chain_current == NULL) /* First chain in the tree? */
-                {
-                    /* Insert and initialize a base chain in the list. */
-                    child_chain = vector_push_emplace(chain_list);
-                    if (child_chain == NULL)
-                    {
-                        IKAPI.log.message("Failed to create base chain: Ran out of memory");
-                        return IK_RAN_OUT_OF_MEMORY;
-                    }
-                    chain_construct(child_chain);
-                }
-                else /* This is not the first chain in the tree */
+                /*
+                 * Record a new chain. If there is no current chain, this is
+                 * the first chain in the tree and it becomes an island.
+                 * Otherwise it's a child of the current chain.
+                 */
+                if ((record = vector_push_emplace(&storage->records)) == NULL)
                 {
-                    /*
-                     * Create a new child chain in the current chain and
-                     * initialize it.
-                     */
-                    child_chain = chain_create_child(chain_current);
-                    if (child_chain == NULL)
-                    {
-                        IKAPI.log.message("Failed to create child chain: Ran out of memory");
-                        return IK_RAN_OUT_OF_MEMORY;
-                    }
-                    chain_construct(child_chain);
+                    IKAPI.log.message("Failed to create chain: Ran out of memory");
+                    return IK_RAN_OUT_OF_MEMORY;
                 }
+                record->parent = chain_current;
+                record->first_node = first_node;
+                record->child_count = 0;
+                record->children = NULL;
+                record->placed_children = 0;
+                child_chain = vector_count(&storage->records) - 1;
 
                 /*
                  * Add pointers to all nodes that are part of this chain into
                  * the chain's list, starting with the end node.
                  */
                 for (node = node_current; node != node_base; node = node->parent)
-                    if (chain_add_node(child_chain, node) != 0)
+                    if (vector_push(&storage->record_nodes, &node) != IK_OK)
                     {
                         IKAPI.log.message("Failed to insert node into chain: Ran out of memory");
                         return IK_RAN_OUT_OF_MEMORY;
                     }
-                if (chain_add_node(child_chain, node_base) != 0)
+                if (vector_push(&storage->record_nodes, &node_base) != IK_OK)
                 {
                     IKAPI.log.message("Failed to insert node into chain: Ran out of memory");
                     return IK_RAN_OUT_OF_MEMORY;
                 }
 
+                record = vector_get_element(&storage->records, child_chain);
+                record->node_count = vector_count(&storage->record_nodes) - first_node;
+                if (chain_current != CHAIN_NO_PARENT)
+                    ((struct chain_record_t*)vector_get_element(
+                        &storage->records, chain_current))->child_count++;
+
                 /*
                  * Update the base node to be this node so deeper chains are
                  * built back to this node
@@ -273,11 +281,10 @@ recursively_build_chain_tree(struct vector_t* chain_list,
     NODE_FOR_EACH(node_current, child_guid, child_node)
         ikret_t result;
         if ((result = recursively_build_chain_tree(
-                chain_list,
+                storage,
                 child_chain,
                 child_node_base,
-                child_node,
-                involved_nodes)) != IK_OK)
+                child_node)) != IK_OK)
             return result;
     NODE_END_EACH
 
@@ -285,55 +292,483 @@ recursively_build_chain_tree(struct vector_t* chain_list,
 }
 
 /* ------------------------------------------------------------------------- */
-ikret_t
-chain_tree_rebuild(struct vector_t* chain_list,
-                   const struct ik_node_t* base_node,
-                   const struct vector_t* effector_nodes_list)
+static void
+count_child_chains(const struct chain_t* chain, uint32_t* chains, uint32_t* nodes)
+{
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        *chains += 1;
+        *nodes += chain_length(child);
+        count_child_chains(child, chains, nodes);
+    CHAIN_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+move_chain(struct chain_t* chain, struct chain_t** chain_cursor, struct ik_node_t*** node_cursor)
+{
+    memcpy(*node_cursor, chain->nodes, sizeof(*chain->nodes) * chain_length(chain));
+    chain->nodes = *node_cursor;
+    *node_cursor += chain_length(chain);
+
+    memcpy(*chain_cursor, chain->children, sizeof(*chain->children) * chain_child_count(chain));
+    chain->children = *chain_cursor;
+    *chain_cursor += chain_child_count(chain);
+
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        move_chain(child, chain_cursor, node_cursor);
+    CHAIN_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+lay_out_chain_trees(struct chain_storage_t* storage, struct vector_t* chain_list)
+{
+    ikret_t result = IK_OK;
+    uint32_t chains = 0, nodes = 0;
+    uintptr_t size;
+    struct chain_t* chain_cursor;
+    struct ik_node_t** node_cursor;
+    void* block;
+
+    /*
+     * Count how much space the islands that are already in the list and the
+     * newly recorded chains need. Islands themselves live in chain_list.
+     */
+    VECTOR_FOR_EACH(chain_list, struct chain_t, island)
+        nodes += chain_length(island);
+        count_child_chains(island, &chains, &nodes);
+    VECTOR_END_EACH
+    VECTOR_FOR_EACH(&storage->records, struct chain_record_t, record)
+        nodes += record->node_count;
+        if (record->parent != CHAIN_NO_PARENT)
+            chains += 1;
+    VECTOR_END_EACH
+
+    size = sizeof(struct chain_t) * chains + sizeof(struct ik_node_t*) * nodes;
+    if (size > storage->spare_size)
+    {
+        if ((block = MALLOC(size)) == NULL)
+        {
+            IKAPI.log.message("Failed to allocate chain storage: Ran out of memory");
+            return IK_RAN_OUT_OF_MEMORY;
+        }
+        if (storage->spare != NULL)
+            FREE(storage->spare);
+        storage->spare = block;
+        storage->spare_size = size;
+    }
+
+    /* Child chains go first, then all node lists */
+    chain_cursor = storage->spare;
+    node_cursor = (struct ik_node_t**)(chain_cursor + chains);
+
+    VECTOR_FOR_EACH(chain_list, struct chain_t, island)
+        move_chain(island, &chain_cursor, &node_cursor);
+    VECTOR_END_EACH
+
+    /*
+     * Parents are recorded before their children, so by the time a chain is
+     * placed, its parent has reserved room for it.
+     */
+    VECTOR_FOR_EACH(&storage->records, struct chain_record_t, record)
+        struct chain_t* chain;
+        if (record->parent == CHAIN_NO_PARENT)
+        {
+            if ((chain = vector_push_emplace(chain_list)) == NULL)
+            {
+                IKAPI.log.message("Failed to create base chain: Ran out of memory");
+                result = IK_RAN_OUT_OF_MEMORY;
+                break;
+            }
+        }
+        else
+        {
+            struct chain_record_t* parent = vector_get_element(&storage->records, record->parent);
+            chain = parent->children + parent->placed_children++;
+        }
+
+        memcpy(node_cursor,
+               vector_get_element(&storage->record_nodes, record->first_node),
+               sizeof(*node_cursor) * record->node_count);
+        chain->nodes = node_cursor;
+        chain->node_count = record->node_count;
+        node_cursor += record->node_count;
+
+        chain->children = chain_cursor;
+        chain->child_count = record->child_count;
+        record->children = chain_cursor;
+        chain_cursor += record->child_count;
+    VECTOR_END_EACH
+
+    /* Whatever is in chain_list now refers to the spare block */
+    block = storage->block;
+    size = storage->block_size;
+    storage->block = storage->spare;
+    storage->block_size = storage->spare_size;
+    storage->spare = block;
+    storage->spare_size = size;
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+build_chain_trees(struct chain_storage_t* storage,
+                  struct vector_t* chain_list,
+                  const struct ik_node_t* base_node,
+                  const struct vector_t* effector_nodes_list)
 {
     ikret_t result;
-    struct bstv_t involved_nodes;
     int involved_nodes_count;
 #ifdef IK_DOT_OUTPUT
     char buffer[20];
     static int file_name_counter = 0;
 #endif
 
-    /* Clear all existing chain trees */
-    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        chain_destruct(chain);
-    VECTOR_END_EACH
-    vector_clear_free(chain_list);
-
     /*
      * Build a set of all nodes that are in a direct path with all of the
      * effectors.
      */
-    bstv_construct(&involved_nodes);
-    if ((result = mark_involved_nodes(&involved_nodes, effector_nodes_list)) != IK_OK)
-        goto mark_involved_nodes_failed;
-    involved_nodes_count = bstv_count(&involved_nodes);
-
-    recursively_build_chain_tree(chain_list, NULL, base_node, base_node, &involved_nodes);
+    bstv_clear(&storage->involved_nodes);
+    vector_clear(&storage->records);
+    vector_clear(&storage->record_nodes);
+    if ((result = mark_involved_nodes(&storage->involved_nodes, effector_nodes_list)) != IK_OK)
+        return result;
+    involved_nodes_count = bstv_count(&storage->involved_nodes);
+
+    if ((result = recursively_build_chain_tree(
+            storage, CHAIN_NO_PARENT, base_node, base_node)) != IK_OK)
+        return result;
+    if ((result = lay_out_chain_trees(storage, chain_list)) != IK_OK)
+        return result;
 
     /* DEBUG: Save chain tree to DOT */
 #ifdef IK_DOT_OUTPUT
     sprintf(buffer, "tree%d.dot", file_name_counter++);
-    dump_to_dot(base_node, chains, buffer);
+    dump_to_dot(base_node, chain_list, buffer);
 #endif
 
     IKAPI.log.message("There are %d effector(s) involving %d node(s). %d chain(s) were created",
                    vector_count(effector_nodes_list),
                    involved_nodes_count,
-                   count_chains(chain_list));
+                   vector_count(&storage->records));
 
-    bstv_clear_free(&involved_nodes);
+    return IK_OK;
+}
 
-    return result;
+/* ------------------------------------------------------------------------- */
+ikret_t
+chain_tree_rebuild(struct chain_storage_t* storage,
+                   struct vector_t* chain_list,
+                   const struct ik_node_t* base_node,
+                   const struct vector_t* effector_nodes_list)
+{
+    /* Clear all existing chain trees */
+    vector_clear(chain_list);
+
+    return build_chain_trees(storage, chain_list, base_node, effector_nodes_list);
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+compare_node_ptrs(const void* a, const void* b)
+{
+    uintptr_t pa = (uintptr_t)*(struct ik_node_t* const*)a;
+    uintptr_t pb = (uintptr_t)*(struct ik_node_t* const*)b;
+    return (pa > pb) - (pa < pb);
+}
+static int
+find_node_ptr(const struct vector_t* sorted_nodes, const struct ik_node_t* node)
+{
+    struct ik_node_t** found;
+    if (vector_count(sorted_nodes) == 0)
+        return -1;
+    found = bsearch(&node, sorted_nodes->data,
+                                       vector_count(sorted_nodes),
+                                       sorted_nodes->element_size,
+                                       compare_node_ptrs);
+    if (found == NULL)
+        return -1;
+    return (int)(found - (struct ik_node_t**)sorted_nodes->data);
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+chain_is_clean(const struct chain_t* chain, const struct vector_t* live_effectors)
+{
+    int idx;
+
+    /*
+     * The nodes of a chain that was not kept up to date may have been
+     * destroyed by now, so they can't be dereferenced until we know they
+     * are still part of the tree. Leaf chains have to end at an effector
+     * that is still in the tree. The tip of every other chain is the base
+     * node of its children, which those vouch for.
+     */
+    if (chain_child_count(chain) == 0)
+    {
+        if (find_node_ptr(live_effectors, chain_get_tip_node(chain)) < 0)
+            return 0;
+    }
+    else
+    {
+        CHAIN_FOR_EACH_CHILD(chain, child)
+            if (chain_is_clean(child, live_effectors) == 0)
+                return 0;
+        CHAIN_END_EACH
+    }
+
+    /*
+     * Walk from the tip to the base. Checking the parent pointer before
+     * moving on makes sure the next node is still in the tree as well.
+     */
+    for (idx = 0; idx != (int)chain_length(chain) - 1; ++idx)
+    {
+        const struct ik_node_t* node = chain_get_node(chain, idx);
+        if (node->dirty || node->parent != chain_get_node(chain, idx + 1))
+            return 0;
+    }
+
+    return chain_get_base_node(chain)->dirty == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+claim_effectors_of_chain(const struct chain_t* chain,
+                         const struct vector_t* live_effectors,
+                         uint8_t* claimed)
+{
+    CHAIN_FOR_EACH_NODE(chain, node)
+        if (node->effector != NULL)
+        {
+            int idx = find_node_ptr(live_effectors, node);
+            if (idx >= 0)
+                claimed[idx] = 1;
+        }
+    CHAIN_END_EACH
+
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        claim_effectors_of_chain(child, live_effectors, claimed);
+    CHAIN_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+clear_dirty_flags(struct ik_node_t* node)
+{
+    /* Clean nodes only ever have clean children */
+    if (node->dirty == 0)
+        return;
+    node->dirty = 0;
+
+    NODE_FOR_EACH(node, guid, child)
+        clear_dirty_flags(child);
+    NODE_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+compare_island_tips(const void* a, const void* b)
+{
+    uintptr_t pa = (uintptr_t)((const struct island_key_t*)a)->tip;
+    uintptr_t pb = (uintptr_t)((const struct island_key_t*)b)->tip;
+    return (pa > pb) - (pa < pb);
+}
+static int
+compare_island_order(const void* a, const void* b)
+{
+    uint32_t oa = ((const struct island_key_t*)a)->order;
+    uint32_t ob = ((const struct island_key_t*)b)->order;
+    return (oa > ob) - (oa < ob);
+}
+static void
+number_island_tips(struct vector_t* keys, const struct ik_node_t* node,
+                   uint32_t* visited, uint32_t* remaining)
+{
+    struct island_key_t key;
+    struct island_key_t* found;
+
+    key.tip = node;
+    found = bsearch(&key, keys->data, vector_count(keys), keys->element_size, compare_island_tips);
+    if (found != NULL)
+    {
+        found->order = *visited;
+        --*remaining;
+    }
+    ++*visited;
+
+    NODE_FOR_EACH(node, guid, child)
+        if (*remaining == 0)
+            break;
+        number_island_tips(keys, child, visited, remaining);
+    NODE_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * recursively_build_chain_tree() records an island when it reaches the tip
+ * of its base chain, and it walks the tree in pre-order. Sorting the islands
+ * by the pre-order position of that tip gives the order of a full rebuild,
+ * no matter which islands were kept and which were appended.
+ */
+static ikret_t
+sort_islands(struct chain_storage_t* storage,
+             struct vector_t* chain_list,
+             const struct ik_node_t* base_node)
+{
+    struct vector_t* keys = &storage->island_keys;
+    uint32_t visited = 0;
+    uint32_t remaining;
+    uint32_t i;
+    ikret_t result;
+
+    if ((result = vector_resize(keys, vector_count(chain_list))) != IK_OK)
+        return result;
+    for (i = 0; i != vector_count(chain_list); ++i)
+    {
+        struct island_key_t* key = vector_get_element(keys, i);
+        key->island = *(struct chain_t*)vector_get_element(chain_list, i);
+        key->tip = chain_get_tip_node(&key->island);
+        key->order = 0;
+    }
+
+    qsort(keys->data, vector_count(keys), keys->element_size, compare_island_tips);
+    remaining = vector_count(keys);
+    number_island_tips(keys, base_node, &visited, &remaining);
+    assert(remaining == 0);
+    qsort(keys->data, vector_count(keys), keys->element_size, compare_island_order);
+
+    for (i = 0; i != vector_count(chain_list); ++i)
+        *(struct chain_t*)vector_get_element(chain_list, i) =
+            ((struct island_key_t*)vector_get_element(keys, i))->island;
 
-    mark_involved_nodes_failed : bstv_clear_free(&involved_nodes);
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+ikret_t
+chain_tree_update(struct chain_storage_t* storage,
+                  struct vector_t* chain_list,
+                  struct ik_node_t* base_node,
+                  const struct vector_t* effector_nodes_list)
+{
+    ikret_t result;
+    struct vector_t* live_effectors = &storage->live_effectors;
+    struct vector_t* dirty_effectors = &storage->dirty_effectors;
+    uint8_t* claimed;
+    uint32_t i;
+    int kept_islands = 0;
+
+    vector_clear(live_effectors);
+    vector_clear(dirty_effectors);
+    vector_clear(&storage->claimed);
+
+    /*
+     * Changing the chain length doesn't go through any function we could
+     * hook into, so compare it against the length the chains were built with
+     * and treat the effector as if it was attached again.
+     */
+    VECTOR_FOR_EACH(effector_nodes_list, struct ik_node_t*, p_effector_node)
+        struct ik_node_t* node = *p_effector_node;
+        if (node->effector->chain_length != node->effector->_built_chain_length)
+            node->v->mark_dirty(node);
+    VECTOR_END_EACH
+
+    if ((result = vector_push_vector(live_effectors, (struct vector_t*)effector_nodes_list)) != IK_OK)
+        return result;
+    if ((result = vector_resize(&storage->claimed, vector_count(live_effectors))) != IK_OK)
+        return result;
+    claimed = (uint8_t*)storage->claimed.data;
+    if (vector_count(live_effectors) > 0)
+    {
+        qsort(live_effectors->data, vector_count(live_effectors),
+              live_effectors->element_size, compare_node_ptrs);
+        memset(claimed, 0, vector_count(live_effectors));
+    }
+
+    /*
+     * Islands that only consist of clean nodes are unaffected by whatever
+     * changed. Keep them, and discard the rest. Effectors that belong to a
+     * kept island don't have to be looked at again.
+     */
+    for (i = 0; i != vector_count(chain_list); )
+    {
+        struct chain_t* island = vector_get_element(chain_list, i);
+        if (chain_is_clean(island, live_effectors))
+        {
+            claim_effectors_of_chain(island, live_effectors, claimed);
+            ++kept_islands;
+            ++i;
+        }
+        else
+            vector_erase_index(chain_list, i);
+    }
+
+    /* Derive new islands for the remaining effectors */
+    for (i = 0; i != vector_count(live_effectors); ++i)
+        if (claimed[i] == 0)
+            if ((result = vector_push(dirty_effectors, vector_get_element(live_effectors, i))) != IK_OK)
+                return result;
+    IKAPI.log.message("Keeping %d island(s), rebuilding chains for %d effector(s)",
+                      kept_islands, vector_count(dirty_effectors));
+    if (vector_count(dirty_effectors) > 0)
+    {
+        if ((result = build_chain_trees(storage, chain_list, base_node, dirty_effectors)) != IK_OK)
+            return result;
+        /* The new islands were appended after the kept ones */
+        if (kept_islands > 0)
+            if ((result = sort_islands(storage, chain_list, base_node)) != IK_OK)
+                return result;
+    }
+
+    VECTOR_FOR_EACH(effector_nodes_list, struct ik_node_t*, p_effector_node)
+        struct ik_effector_t* effector = (*p_effector_node)->effector;
+        effector->_built_chain_length = effector->chain_length;
+    VECTOR_END_EACH
+    clear_dirty_flags(base_node);
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint64_t
+hash_uintptr(uint64_t hash, uintptr_t value)
+{
+    /* FNV-1a, one byte at a time */
+    unsigned i;
+    for (i = 0; i != sizeof(value); ++i)
+    {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+static uint64_t
+hash_chain(uint64_t hash, const struct chain_t* chain)
+{
+    hash = hash_uintptr(hash, chain_length(chain));
+    CHAIN_FOR_EACH_NODE(chain, node)
+        hash = hash_uintptr(hash, (uintptr_t)node);
+    CHAIN_END_EACH
+
+    hash = hash_uintptr(hash, chain_child_count(chain));
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        hash = hash_chain(hash, child);
+    CHAIN_END_EACH
+
+    return hash;
+}
+uint64_t
+chain_tree_hash(const struct vector_t* chain_list)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    hash = hash_uintptr(hash, vector_count(chain_list));
+    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
+        hash = hash_chain(hash, chain);
+    VECTOR_END_EACH
+    return hash;
+}
+
 /* ------------------------------------------------------------------------- */
 static void
 calculate_segment_lengths_in_island(struct chain_t* chain)
@@ -386,9 +821,9 @@ dump_chain(const chain_t* chain, FILE* fp)
             chain_get_node(chain, last_idx + 1)->guid);
     }
 
-    VECTOR_FOR_EACH(&chain->children, chain_t, child)
+    CHAIN_FOR_EACH_CHILD(chain, child)
         dump_chain(child, fp);
-    VECTOR_END_EACH
+    CHAIN_END_EACH
 }
 static void
 dump_node(const ik_node_t* node, FILE* fp)
@@ -0,0 +1,163 @@
+#include "ik/guid_index.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/node.h"
+#include <string.h>
+
+#define GUID_INDEX_TOMBSTONE ((struct ik_node_t*)(uintptr_t)1)
+#define GUID_INDEX_MIN_CAPACITY 16
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+first_slot(uint32_t guid, uint32_t capacity)
+{
+    /* guids are often sequential, so spread them out */
+    uint32_t hash = guid * 0x9E3779B1u;
+    hash ^= hash >> 16;
+    return hash & (capacity - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+resize(struct ik_guid_index_t* index, uint32_t capacity)
+{
+    uint32_t i;
+    struct ik_node_t** old_slots = index->slots;
+    uint32_t old_capacity = index->capacity;
+    struct ik_node_t** slots = MALLOC(sizeof(*slots) * capacity);
+    if (slots == NULL)
+    {
+        IKAPI.log.message("Failed to resize guid index: Ran out of memory");
+        return IK_RAN_OUT_OF_MEMORY;
+    }
+    memset(slots, 0, sizeof(*slots) * capacity);
+
+    /* Tombstones are left behind */
+    for (i = 0; i != old_capacity; ++i)
+    {
+        struct ik_node_t* node = old_slots[i];
+        uint32_t slot;
+        if (node == NULL || node == GUID_INDEX_TOMBSTONE)
+            continue;
+        for (slot = first_slot(node->guid, capacity);
+             slots[slot] != NULL;
+             slot = (slot + 1) & (capacity - 1)) {}
+        slots[slot] = node;
+    }
+
+    if (old_slots != NULL)
+        FREE(old_slots);
+    index->slots = slots;
+    index->capacity = capacity;
+    index->tombstones = 0;
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_guid_index_t*
+guid_index_create(struct ik_node_t* root)
+{
+    struct ik_guid_index_t* index = MALLOC(sizeof *index);
+    if (index == NULL)
+    {
+        IKAPI.log.message("Failed to allocate guid index: Ran out of memory");
+        return NULL;
+    }
+
+    memset(index, 0, sizeof *index);
+    index->root = root;
+    if (resize(index, GUID_INDEX_MIN_CAPACITY) != IK_OK)
+    {
+        FREE(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+guid_index_destroy(struct ik_guid_index_t* index)
+{
+    FREE(index->slots);
+    FREE(index);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+guid_index_insert(struct ik_guid_index_t* index, struct ik_node_t* node)
+{
+    ikret_t result;
+    uint32_t slot;
+    uint32_t insert_at;
+
+    /* Keep the load factor (including tombstones) below 3/4 */
+    if ((index->count + index->tombstones + 1) * 4 > index->capacity * 3)
+    {
+        uint32_t capacity = index->capacity;
+        if ((index->count + 1) * 2 > capacity)
+            capacity *= 2;
+        if ((result = resize(index, capacity)) != IK_OK)
+            return result;
+    }
+
+    insert_at = index->capacity;
+    for (slot = first_slot(node->guid, index->capacity);
+         index->slots[slot] != NULL;
+         slot = (slot + 1) & (index->capacity - 1))
+    {
+        if (index->slots[slot] == GUID_INDEX_TOMBSTONE)
+        {
+            if (insert_at == index->capacity)
+                insert_at = slot;
+        }
+        else if (index->slots[slot]->guid == node->guid)
+            return IK_OK;
+    }
+
+    if (insert_at == index->capacity)
+        insert_at = slot;
+    else
+        index->tombstones--;
+    index->slots[insert_at] = node;
+    index->count++;
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+guid_index_erase(struct ik_guid_index_t* index, const struct ik_node_t* node)
+{
+    uint32_t slot;
+    for (slot = first_slot(node->guid, index->capacity);
+         index->slots[slot] != NULL;
+         slot = (slot + 1) & (index->capacity - 1))
+    {
+        if (index->slots[slot] == node)
+        {
+            index->slots[slot] = GUID_INDEX_TOMBSTONE;
+            index->count--;
+            index->tombstones++;
+            return;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+guid_index_find(const struct ik_guid_index_t* index, uint32_t guid)
+{
+    uint32_t slot;
+    for (slot = first_slot(guid, index->capacity);
+         index->slots[slot] != NULL;
+         slot = (slot + 1) & (index->capacity - 1))
+    {
+        struct ik_node_t* node = index->slots[slot];
+        if (node != GUID_INDEX_TOMBSTONE && node->guid == guid)
+            return node;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,421 @@
+#include "ik/heap_profile.h"
+#include "ik/backtrace.h"
+#include "ik/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef IK_THREADS
+#   include <pthread.h>
+static pthread_mutex_t g_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define PROFILE_LOCK()   pthread_mutex_lock(&g_profile_lock)
+#   define PROFILE_UNLOCK() pthread_mutex_unlock(&g_profile_lock)
+#else
+#   define PROFILE_LOCK()
+#   define PROFILE_UNLOCK()
+#endif
+
+/* get_backtrace_frames(), heap_profile_sample() and malloc_wrapper() */
+#define CALLSITE_OMIT_COUNT 3
+#define CALLSITES_MIN_CAPACITY 256
+
+struct heap_callsite_t
+{
+    uint64_t hash;
+    /* Estimates, see heap_profile_sample() */
+    uintptr_t live_bytes;
+    uintptr_t live_objects;
+    uintptr_t total_bytes;
+    uintptr_t total_objects;
+    int frame_count;
+    void* frames[];
+};
+
+struct callsite_table_t
+{
+    /* NULL for empty slots */
+    struct heap_callsite_t** slots;
+    /* Always a power of two */
+    uintptr_t capacity;
+    uintptr_t count;
+};
+
+static struct callsite_table_t g_callsites;
+static enum ik_heap_sampling_e g_sampling = IK_HEAP_SAMPLE_ALLOCATIONS;
+static uintptr_t g_interval = 1;
+/* Allocations or bytes until the next sample */
+static uintptr_t g_until_sample = 1;
+
+/* ------------------------------------------------------------------------- */
+static uint64_t
+hash_frames(void* const* frames, int frame_count)
+{
+    /* FNV-1a over the return addresses */
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    int i;
+    for (i = 0; i != frame_count; ++i)
+        hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+callsites_resize(uintptr_t capacity)
+{
+    uintptr_t i;
+    struct heap_callsite_t** slots = ik_memory_untracked_malloc(sizeof(*slots) * capacity);
+    if (slots == NULL)
+        return -1;
+    memset(slots, 0, sizeof(*slots) * capacity);
+
+    for (i = 0; i != g_callsites.capacity; ++i)
+    {
+        struct heap_callsite_t* callsite = g_callsites.slots[i];
+        uintptr_t slot;
+        if (callsite == NULL)
+            continue;
+        for (slot = (uintptr_t)callsite->hash & (capacity - 1);
+             slots[slot] != NULL;
+             slot = (slot + 1) & (capacity - 1)) {}
+        slots[slot] = callsite;
+    }
+
+    if (g_callsites.slots != NULL)
+        ik_memory_untracked_free(g_callsites.slots);
+    g_callsites.slots = slots;
+    g_callsites.capacity = capacity;
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct heap_callsite_t*
+callsites_intern(void* const* frames, int frame_count)
+{
+    uintptr_t slot;
+    struct heap_callsite_t* callsite;
+    uint64_t hash = hash_frames(frames, frame_count);
+
+    /* Keep the load factor below 3/4 */
+    if ((g_callsites.count + 1) * 4 > g_callsites.capacity * 3)
+    {
+        uintptr_t capacity = g_callsites.capacity < CALLSITES_MIN_CAPACITY ?
+            CALLSITES_MIN_CAPACITY : g_callsites.capacity * 2;
+        if (callsites_resize(capacity) != 0)
+            return NULL;
+    }
+
+    for (slot = (uintptr_t)hash & (g_callsites.capacity - 1);
+         (callsite = g_callsites.slots[slot]) != NULL;
+         slot = (slot + 1) & (g_callsites.capacity - 1))
+    {
+        if (callsite->hash == hash &&
+            callsite->frame_count == frame_count &&
+            memcmp(callsite->frames, frames, sizeof(*frames) * frame_count) == 0)
+        {
+            return callsite;
+        }
+    }
+
+    callsite = ik_memory_untracked_malloc(
+        sizeof(*callsite) + sizeof(*frames) * frame_count);
+    if (callsite == NULL)
+        return NULL;
+    memset(callsite, 0, sizeof *callsite);
+    callsite->hash = hash;
+    callsite->frame_count = frame_count;
+    memcpy(callsite->frames, frames, sizeof(*frames) * frame_count);
+
+    g_callsites.slots[slot] = callsite;
+    g_callsites.count++;
+    return callsite;
+}
+
+/* ------------------------------------------------------------------------- */
+static uintptr_t
+objects_of(uintptr_t size, uintptr_t weight)
+{
+    return weight / (size != 0 ? size : 1);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+heap_profile_init(void)
+{
+    memset(&g_callsites, 0, sizeof g_callsites);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+heap_profile_deinit(void)
+{
+    uintptr_t i;
+
+    PROFILE_LOCK();
+    for (i = 0; i != g_callsites.capacity; ++i)
+        if (g_callsites.slots[i] != NULL)
+            ik_memory_untracked_free(g_callsites.slots[i]);
+    if (g_callsites.slots != NULL)
+        ik_memory_untracked_free(g_callsites.slots);
+    memset(&g_callsites, 0, sizeof g_callsites);
+    PROFILE_UNLOCK();
+}
+
+/* ------------------------------------------------------------------------- */
+void
+heap_profile_set_sampling(enum ik_heap_sampling_e sampling, uintptr_t interval)
+{
+    PROFILE_LOCK();
+    g_sampling = sampling;
+    g_interval = interval != 0 ? interval : 1;
+    g_until_sample = g_interval;
+    PROFILE_UNLOCK();
+}
+
+/* ------------------------------------------------------------------------- */
+void
+heap_profile_get_sampling(enum ik_heap_sampling_e* sampling, uintptr_t* interval)
+{
+    PROFILE_LOCK();
+    *sampling = g_sampling;
+    *interval = g_interval;
+    PROFILE_UNLOCK();
+}
+
+/* ------------------------------------------------------------------------- */
+struct heap_callsite_t*
+heap_profile_sample(uintptr_t size, uintptr_t* weight)
+{
+    void* frames[BACKTRACE_SIZE];
+    int frame_count;
+    struct heap_callsite_t* callsite;
+    uintptr_t bytes = size != 0 ? size : 1;
+
+    PROFILE_LOCK();
+    switch (g_sampling)
+    {
+        case IK_HEAP_SAMPLE_NOTHING:
+            PROFILE_UNLOCK();
+            return NULL;
+
+        case IK_HEAP_SAMPLE_ALLOCATIONS:
+            if (--g_until_sample != 0)
+            {
+                PROFILE_UNLOCK();
+                return NULL;
+            }
+            *weight = bytes * g_interval;
+            break;
+
+        case IK_HEAP_SAMPLE_BYTES:
+            if (bytes < g_until_sample)
+            {
+                g_until_sample -= bytes;
+                PROFILE_UNLOCK();
+                return NULL;
+            }
+            *weight = bytes > g_interval ? bytes : g_interval;
+            break;
+    }
+    g_until_sample = g_interval;
+    PROFILE_UNLOCK();
+
+    /* Walking the stack is the expensive part, so don't hold the lock */
+    frame_count = get_backtrace_frames(frames, BACKTRACE_SIZE);
+    if (frame_count <= CALLSITE_OMIT_COUNT)
+        return NULL;
+
+    PROFILE_LOCK();
+    callsite = callsites_intern(frames + CALLSITE_OMIT_COUNT,
+                                frame_count - CALLSITE_OMIT_COUNT);
+    if (callsite != NULL)
+    {
+        callsite->live_bytes += *weight;
+        callsite->live_objects += objects_of(size, *weight);
+        callsite->total_bytes += *weight;
+        callsite->total_objects += objects_of(size, *weight);
+    }
+    PROFILE_UNLOCK();
+
+    if (callsite == NULL)
+        fprintf(stderr, "[memory] WARNING: Failed to record heap profile sample"
+            " -- not enough memory.\n");
+
+    return callsite;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+heap_profile_resize(struct heap_callsite_t* callsite,
+                    uintptr_t old_size,
+                    uintptr_t new_size,
+                    uintptr_t weight)
+{
+    uintptr_t new_weight = objects_of(old_size, weight) * (new_size != 0 ? new_size : 1);
+
+    PROFILE_LOCK();
+    callsite->live_bytes = callsite->live_bytes - weight + new_weight;
+    if (new_weight > weight)
+        callsite->total_bytes += new_weight - weight;
+    PROFILE_UNLOCK();
+
+    return new_weight;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+heap_profile_release(struct heap_callsite_t* callsite, uintptr_t size, uintptr_t weight)
+{
+    PROFILE_LOCK();
+    callsite->live_bytes -= weight;
+    callsite->live_objects -= objects_of(size, weight);
+    PROFILE_UNLOCK();
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+compare_live_bytes(const void* a, const void* b)
+{
+    const struct heap_callsite_t* x = *(struct heap_callsite_t* const*)a;
+    const struct heap_callsite_t* y = *(struct heap_callsite_t* const*)b;
+    if (x->live_bytes != y->live_bytes)
+        return x->live_bytes < y->live_bytes ? 1 : -1;
+    if (x->total_bytes != y->total_bytes)
+        return x->total_bytes < y->total_bytes ? 1 : -1;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+write_report(FILE* fp, struct heap_callsite_t** callsites, uintptr_t count)
+{
+    uintptr_t i, live_bytes = 0, live_objects = 0;
+    int j;
+
+    for (i = 0; i != count; ++i)
+    {
+        live_bytes += callsites[i]->live_bytes;
+        live_objects += callsites[i]->live_objects;
+    }
+
+    fprintf(fp, "  %lu bytes in %lu objects live", (unsigned long)live_bytes, (unsigned long)live_objects);
+    if (g_sampling == IK_HEAP_SAMPLE_NOTHING)
+        fprintf(fp, ", sampling is off\n");
+    else
+        fprintf(fp, ", sampling one allocation every %lu %s\n", (unsigned long)g_interval,
+            g_sampling == IK_HEAP_SAMPLE_BYTES ? "bytes" : "allocations");
+
+    for (i = 0; i != count; ++i)
+    {
+        struct heap_callsite_t* callsite = callsites[i];
+        char** symbols;
+        if (callsite->live_bytes == 0)
+            break;
+
+        fprintf(fp, "  -----------------------------------------\n");
+        fprintf(fp, "  %lu bytes in %lu objects (%.1f%%), %lu bytes in %lu objects allocated in total\n",
+            (unsigned long)callsite->live_bytes, (unsigned long)callsite->live_objects,
+            100.0 * (double)callsite->live_bytes / (double)live_bytes,
+            (unsigned long)callsite->total_bytes, (unsigned long)callsite->total_objects);
+
+        symbols = get_backtrace_symbols(callsite->frames, callsite->frame_count);
+        for (j = 0; j != callsite->frame_count; ++j)
+        {
+            if (symbols != NULL)
+                fprintf(fp, "      %s\n", symbols[j]);
+            else
+                fprintf(fp, "      %p\n", callsite->frames[j]);
+        }
+        free(symbols);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+write_pprof(FILE* fp, struct heap_callsite_t** callsites, uintptr_t count)
+{
+    uintptr_t i, live_bytes = 0, live_objects = 0, total_bytes = 0, total_objects = 0;
+    int j;
+
+    for (i = 0; i != count; ++i)
+    {
+        live_bytes += callsites[i]->live_bytes;
+        live_objects += callsites[i]->live_objects;
+        total_bytes += callsites[i]->total_bytes;
+        total_objects += callsites[i]->total_objects;
+    }
+
+    /* The estimates are already scaled, so no sampling rate is given */
+    fprintf(fp, "heap profile: %lu: %lu [%lu: %lu] @ heapprofile\n",
+        (unsigned long)live_objects, (unsigned long)live_bytes,
+        (unsigned long)total_objects, (unsigned long)total_bytes);
+
+    for (i = 0; i != count; ++i)
+    {
+        struct heap_callsite_t* callsite = callsites[i];
+        fprintf(fp, "%lu: %lu [%lu: %lu] @",
+            (unsigned long)callsite->live_objects, (unsigned long)callsite->live_bytes,
+            (unsigned long)callsite->total_objects, (unsigned long)callsite->total_bytes);
+        for (j = 0; j != callsite->frame_count; ++j)
+            fprintf(fp, " %p", callsite->frames[j]);
+        fprintf(fp, "\n");
+    }
+
+    /* pprof needs the mappings to symbolize the addresses */
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+    {
+        char buf[4096];
+        uintptr_t read;
+        FILE* maps = fopen("/proc/self/maps", "r");
+        if (maps != NULL)
+        {
+            while ((read = fread(buf, 1, sizeof buf, maps)) != 0)
+                fwrite(buf, 1, read, fp);
+            fclose(maps);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+heap_profile_write(const char* file_name, enum ik_heap_profile_format_e format)
+{
+    uintptr_t i, count = 0;
+    struct heap_callsite_t** callsites;
+    ikret_t result = IK_OK;
+    FILE* fp = stdout;
+
+    if (file_name != NULL && (fp = fopen(file_name, "w")) == NULL)
+        return IK_FAILED_TO_OPEN_FILE;
+
+    /*
+     * Allocations on other threads wait until the profile is written. Nothing
+     * in here goes through MALLOC(), which would deadlock.
+     */
+    PROFILE_LOCK();
+    callsites = ik_memory_untracked_malloc(sizeof(*callsites) * (g_callsites.count + 1));
+    if (callsites == NULL)
+    {
+        result = IK_RAN_OUT_OF_MEMORY;
+        goto alloc_callsites_failed;
+    }
+    for (i = 0; i != g_callsites.capacity; ++i)
+        if (g_callsites.slots[i] != NULL)
+            callsites[count++] = g_callsites.slots[i];
+    qsort(callsites, count, sizeof(*callsites), compare_live_bytes);
+
+    switch (format)
+    {
+        case IK_HEAP_PROFILE_REPORT : write_report(fp, callsites, count); break;
+        case IK_HEAP_PROFILE_PPROF  : write_pprof(fp, callsites, count);  break;
+    }
+
+    ik_memory_untracked_free(callsites);
+    alloc_callsites_failed : PROFILE_UNLOCK();
+    if (fp != stdout)
+        fclose(fp);
+    else
+        fflush(fp);
+
+    return result;
+}
@@ -0,0 +1,65 @@
+#include "ik/heap_static.h"
+#include "ik/heap_profile.h"
+#include "ik/memory.h"
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_heap_static_set_allocator(const struct ik_allocator_t* allocator)
+{
+    return ik_memory_set_allocator(allocator);
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_heap_static_allocation_count(void)
+{
+    return ik_memory_allocation_count();
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_heap_static_solve_allocation_count(void)
+{
+    return ik_memory_solve_allocation_count();
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_heap_static_set_sampling(enum ik_heap_sampling_e sampling, uintptr_t interval)
+{
+#ifdef IK_MEMORY_BACKTRACE
+    heap_profile_set_sampling(sampling, interval);
+    return IK_OK;
+#else
+    (void)sampling;
+    (void)interval;
+    return IK_BUILT_WITHOUT_MEMORY_BACKTRACE;
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_heap_static_get_sampling(enum ik_heap_sampling_e* sampling, uintptr_t* interval)
+{
+#ifdef IK_MEMORY_BACKTRACE
+    heap_profile_get_sampling(sampling, interval);
+    return IK_OK;
+#else
+    (void)sampling;
+    (void)interval;
+    return IK_BUILT_WITHOUT_MEMORY_BACKTRACE;
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_heap_static_dump_profile(const char* file_name, enum ik_heap_profile_format_e format)
+{
+#ifdef IK_MEMORY_BACKTRACE
+    return heap_profile_write(file_name, format);
+#else
+    (void)file_name;
+    (void)format;
+    return IK_BUILT_WITHOUT_MEMORY_BACKTRACE;
+#endif
+}
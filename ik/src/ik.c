@@ -1,7 +1,9 @@
 #include "ik/ik.h"
+#include "ik/batch.h"
 #include "ik/build_info_static.h"
 #include "ik/constraint_base.h"
 #include "ik/effector_base.h"
+#include "ik/heap_static.h"
 #include "ik/log_static.h"
 #include "ik/memory.h"
 #include "ik/node_base.h"
@@ -14,6 +16,7 @@
 #include "ik/solver_FABRIK.h"
 #include "ik/solver_MSS.h"
 #include "ik/tests_static.h"
+#include "ik/thread_pool_static.h"
 #include "ik/vec3_static.h"
 #include <stddef.h>
 #include <stdio.h>
@@ -49,6 +52,7 @@ ik_init(void)
         return IK_OK;
 
     ik_memory_init();
+    batch_init();
     return IK_OK;
 }
 
@@ -59,6 +63,7 @@ ik_deinit(void)
     if (--g_init_counter != 0)
         return 0;
 
+    ik_thread_pool_static_deinit();
     ik_implement_callbacks(NULL);
     return ik_memory_deinit();
 }
@@ -69,10 +74,12 @@ struct ik_interface_t IKAPI = {
     ik_deinit,
     ik_implement_callbacks,
     { IK_BUILD_INFO_STATIC_IMPL },
+    { IK_HEAP_STATIC_IMPL },
     { IK_LOG_STATIC_IMPL },
     { IK_QUAT_STATIC_IMPL },
     { IK_SOLVER_STATIC_IMPL },
     { IK_TESTS_STATIC_IMPL },
+    { IK_THREAD_POOL_STATIC_IMPL },
     { IK_VEC3_STATIC_IMPL },
     {
         &dummy_callbacks,
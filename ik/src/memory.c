@@ -1,251 +1,605 @@
 #include "ik/memory.h"
-#include "ik/bstv.h"
 #include "ik/backtrace.h"
+#include "ik/heap.h"
+#include "ik/heap_profile.h"
+#include "ik/ik.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+#ifdef IK_THREADS
+#   include <stdatomic.h>
+#   include <pthread.h>
+typedef atomic_uintptr_t counter_t;
+#   define COUNTER_ADD(counter, value) \
+        atomic_fetch_add_explicit(&(counter), value, memory_order_relaxed)
+#   define COUNTER_SUB(counter, value) \
+        atomic_fetch_sub_explicit(&(counter), value, memory_order_relaxed)
+#   define COUNTER_LOAD(counter) \
+        atomic_load_explicit(&(counter), memory_order_relaxed)
+#else
+typedef uintptr_t counter_t;
+#   define COUNTER_ADD(counter, value) ((counter) += (value))
+#   define COUNTER_SUB(counter, value) ((counter) -= (value))
+#   define COUNTER_LOAD(counter) (counter)
+#endif
+
 #define BACKTRACE_OMIT_COUNT 2
 
+/*
+ * Allocations are counted in every build (see IKAPI.heap). If the library
+ * was built with IK_THREADS, the counters are atomic. Whether an allocation
+ * happens during a solve depends on the thread making it, so the solve depth
+ * is thread local instead.
+ */
+static counter_t g_allocation_count = 0;
+static counter_t g_solve_allocation_count = 0;
+#ifdef IK_THREADS
+static _Thread_local uintptr_t g_solve_depth = 0;
+#else
+static uintptr_t g_solve_depth = 0;
+#endif
+static int g_initialized = 0;
+
+/* ------------------------------------------------------------------------- */
+static void*
+default_malloc(void* user_data, uintptr_t size)
+{
+    (void)user_data;
+    return malloc(size);
+}
+
+/* ------------------------------------------------------------------------- */
+static void*
+default_realloc(void* user_data, void* ptr, uintptr_t size)
+{
+    (void)user_data;
+    return realloc(ptr, size);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+default_free(void* user_data, void* ptr)
+{
+    (void)user_data;
+    free(ptr);
+}
+
+static const struct ik_allocator_t g_default_allocator = {
+    default_malloc,
+    default_realloc,
+    default_free,
+    NULL
+};
+static struct ik_allocator_t g_allocator = {
+    default_malloc,
+    default_realloc,
+    default_free,
+    NULL
+};
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_memory_set_allocator(const struct ik_allocator_t* allocator)
+{
+    if (g_initialized)
+    {
+        IKAPI.log.message("Failed to set allocator: The library is still initialized");
+        return IK_LIBRARY_IS_INITIALIZED;
+    }
+
+    g_allocator = allocator != NULL ? *allocator : g_default_allocator;
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+ik_memory_untracked_malloc(uintptr_t size)
+{
+    return g_allocator.malloc(g_allocator.user_data, size);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_memory_untracked_free(void* ptr)
+{
+    g_allocator.free(g_allocator.user_data, ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Returns non-zero if the allocation was made during solve() */
+static int
+count_allocation(void)
+{
+    COUNTER_ADD(g_allocation_count, 1);
+    if (g_solve_depth == 0)
+        return 0;
+    COUNTER_ADD(g_solve_allocation_count, 1);
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_memory_enter_solve(void)
+{
+    g_solve_depth++;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_memory_leave_solve(void)
+{
+    assert(g_solve_depth > 0);
+    g_solve_depth--;
+}
+
+/* ------------------------------------------------------------------------- */
+int
+ik_memory_is_solving(void)
+{
+    return g_solve_depth != 0;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_memory_allocation_count(void)
+{
+    return COUNTER_LOAD(g_allocation_count);
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_memory_solve_allocation_count(void)
+{
+    return COUNTER_LOAD(g_solve_allocation_count);
+}
+
 #ifdef IK_MEMORY_DEBUGGING
-static uintptr_t g_allocations = 0;
-static uintptr_t d_deg_allocations = 0;
-static uintptr_t g_ignore_bstv_malloc = 0;
-static struct bstv_t report;
 
-typedef struct report_info_t
+/*
+ * Every live allocation has an entry in an open addressing hash table, keyed
+ * on the full pointer. The table uses linear probing and leaves tombstones
+ * behind when entries are erased, which are dropped when it grows. Its memory
+ * comes straight from the allocator without being counted or tracked.
+ */
+#define REPORT_EMPTY     ((uintptr_t)0)
+#define REPORT_TOMBSTONE ((uintptr_t)1)
+#define REPORT_MIN_CAPACITY 1024
+
+struct report_entry_t
 {
     uintptr_t location;
     uintptr_t size;
 #   ifdef IK_MEMORY_BACKTRACE
-    int backtrace_size;
-    char** backtrace;
+    /* NULL if the allocation wasn't sampled, see heap_profile.h */
+    struct heap_callsite_t* callsite;
+    uintptr_t weight;
 #   endif
-} report_info_t;
+};
+
+struct report_t
+{
+    struct report_entry_t* entries;
+    /* Always a power of two */
+    uintptr_t capacity;
+    uintptr_t count;
+    uintptr_t tombstones;
+};
+
+static counter_t g_allocations = 0;
+static counter_t g_deallocations = 0;
+static struct report_t g_report;
+#   ifdef IK_THREADS
+static pthread_mutex_t g_report_lock = PTHREAD_MUTEX_INITIALIZER;
+#       define REPORT_LOCK()   pthread_mutex_lock(&g_report_lock)
+#       define REPORT_UNLOCK() pthread_mutex_unlock(&g_report_lock)
+#   else
+#       define REPORT_LOCK()
+#       define REPORT_UNLOCK()
+#   endif
+
+/* ------------------------------------------------------------------------- */
+static uintptr_t
+report_first_slot(uintptr_t location, uintptr_t capacity)
+{
+    /* Allocations are aligned, so the low bits carry no information */
+    uint64_t hash = (uint64_t)(location >> 4) * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 32;
+    return (uintptr_t)hash & (capacity - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+report_resize(uintptr_t capacity)
+{
+    uintptr_t i;
+    struct report_entry_t* old_entries = g_report.entries;
+    uintptr_t old_capacity = g_report.capacity;
+    struct report_entry_t* entries = g_allocator.malloc(
+        g_allocator.user_data, sizeof(*entries) * capacity);
+    if (entries == NULL)
+    {
+        fprintf(stderr, "[memory] ERROR: Failed to grow the memory report"
+            " -- not enough memory.\n");
+        return -1;
+    }
+    memset(entries, 0, sizeof(*entries) * capacity);
+
+    /* Tombstones are left behind */
+    for (i = 0; i != old_capacity; ++i)
+    {
+        uintptr_t slot;
+        if (old_entries[i].location == REPORT_EMPTY || old_entries[i].location == REPORT_TOMBSTONE)
+            continue;
+        for (slot = report_first_slot(old_entries[i].location, capacity);
+             entries[slot].location != REPORT_EMPTY;
+             slot = (slot + 1) & (capacity - 1)) {}
+        entries[slot] = old_entries[i];
+    }
+
+    if (old_entries != NULL)
+        g_allocator.free(g_allocator.user_data, old_entries);
+    g_report.entries = entries;
+    g_report.capacity = capacity;
+    g_report.tombstones = 0;
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct report_entry_t*
+report_find(uintptr_t location)
+{
+    uintptr_t slot;
+    if (g_report.capacity == 0)
+        return NULL;
+    for (slot = report_first_slot(location, g_report.capacity);
+         g_report.entries[slot].location != REPORT_EMPTY;
+         slot = (slot + 1) & (g_report.capacity - 1))
+    {
+        if (g_report.entries[slot].location == location)
+            return &g_report.entries[slot];
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct report_entry_t*
+report_insert(uintptr_t location)
+{
+    uintptr_t slot;
+    struct report_entry_t* entry;
+
+    /* Keep the load factor (including tombstones) below 3/4 */
+    if ((g_report.count + g_report.tombstones + 1) * 4 > g_report.capacity * 3)
+    {
+        uintptr_t capacity = g_report.capacity < REPORT_MIN_CAPACITY ?
+            REPORT_MIN_CAPACITY : g_report.capacity;
+        if ((g_report.count + 1) * 2 > capacity)
+            capacity *= 2;
+        if (report_resize(capacity) != 0)
+            return NULL;
+    }
+
+    /* Callers only insert live pointers without an entry, so it can't be in the table */
+    for (slot = report_first_slot(location, g_report.capacity);
+         g_report.entries[slot].location != REPORT_EMPTY &&
+         g_report.entries[slot].location != REPORT_TOMBSTONE;
+         slot = (slot + 1) & (g_report.capacity - 1)) {}
+
+    entry = &g_report.entries[slot];
+    if (entry->location == REPORT_TOMBSTONE)
+        g_report.tombstones--;
+    g_report.count++;
+    entry->location = location;
+    return entry;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+report_erase(struct report_entry_t* entry)
+{
+    entry->location = REPORT_TOMBSTONE;
+    g_report.count--;
+    g_report.tombstones++;
+}
 
 /* ------------------------------------------------------------------------- */
 void
 ik_memory_init(void)
 {
     g_allocations = 0;
-    d_deg_allocations = 0;
+    g_deallocations = 0;
+    g_initialized = 1;
 
     /*
-     * Init bst vector of report objects and force it to allocate by adding
-     * and removing one item. This fixes a bug where the number of memory leaks
-     * would be wrong in the case of MALLOC() never being called.
+     * Allocate the table up front. This fixes a bug where the number of memory
+     * leaks would be wrong in the case of MALLOC() never being called.
      */
-    g_ignore_bstv_malloc = 1;
-        bstv_construct(&report);
-        bstv_insert(&report, 0, NULL); bstv_erase(&report, 0);
-    g_ignore_bstv_malloc = 0;
+    memset(&g_report, 0, sizeof g_report);
+    report_resize(REPORT_MIN_CAPACITY);
+#   ifdef IK_MEMORY_BACKTRACE
+    heap_profile_init();
+#   endif
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+print_backtrace(const char* title)
+{
+#   ifdef IK_MEMORY_BACKTRACE
+    char** bt;
+    int bt_size, i;
+    if ((bt = get_backtrace(&bt_size)))
+    {
+        if (title != NULL)
+            fprintf(stderr, "  %s\n", title);
+        for (i = BACKTRACE_OMIT_COUNT; i < bt_size; ++i)
+            fprintf(stderr, "      %s\n", bt[i]);
+        free(bt);
+    }
+    else
+        fprintf(stderr, "[memory] WARNING: Failed to generate backtrace\n");
+#   else
+    (void)title;
+#   endif
 }
 
 /* ------------------------------------------------------------------------- */
 void*
 malloc_wrapper(intptr_t size)
 {
-    void* p = NULL;
-    report_info_t* info = NULL;
+    struct report_entry_t* entry;
+#   ifdef IK_MEMORY_BACKTRACE
+    struct heap_callsite_t* callsite;
+    uintptr_t weight = 0;
+#   endif
+    void* p = g_allocator.malloc(g_allocator.user_data, size);
+    if (p == NULL)
+        return NULL;
 
-    /* breaking from this will clean up and return NULL */
-    for (;;)
+    COUNTER_ADD(g_allocations, 1);
+    if (count_allocation())
     {
-        /* allocate */
-        p = malloc(size);
-        if (p)
-            ++g_allocations;
-        else
-            break;
-
-        /*
-        * Record allocation info. Call to bstv may allocate memory,
-        * so set flag to ignore the call to malloc() when inserting.
-        */
-        if (!g_ignore_bstv_malloc)
-        {
-            g_ignore_bstv_malloc = 1;
-            info = (report_info_t*)malloc(sizeof(report_info_t));
-            if (!info)
-            {
-                fprintf(stderr, "[memory] ERROR: malloc() for report_info_t failed"
-                    " -- not enough memory.\n");
-                g_ignore_bstv_malloc = 0;
-                break;
-            }
-
-            /* record the location and size of the allocation */
-            info->location = (uintptr_t)p;
-            info->size = size;
-
-            /* if (enabled, generate a backtrace so we know where memory leaks
-            * occurred */
+        fprintf(stderr, "[memory] ERROR: malloc() was called during solve()\n");
+        print_backtrace(NULL);
+    }
+
+    /*
+     * If enabled, remember where some of the allocations were made so we
+     * know where memory leaks occurred
+     */
 #   ifdef IK_MEMORY_BACKTRACE
-            if (!(info->backtrace = get_backtrace(&info->backtrace_size)))
-                fprintf(stderr, "[memory] WARNING: Failed to generate backtrace\n");
+    callsite = heap_profile_sample(size, &weight);
 #   endif
 
-            /* insert into bstv */
-            if (bstv_insert(&report, (uintptr_t)p, info) == 1)
-            {
-                fprintf(stderr,
-                "[memory] WARNING: Hash collision occurred when inserting\n"
-                "into memory report bstv. On 64-bit systems the pointers are\n"
-                "rounded down to 32-bit unsigned integers, so even though\n"
-                "it's rare, collisions can happen.\n\n"
-                "The matching call to FREE() will generate a warning saying\n"
-                "something is being freed that was never allocated. This is to\n"
-                "be expected and can be ignored.\n");
+    /* Record the location and size of the allocation */
+    REPORT_LOCK();
+    if ((entry = report_insert((uintptr_t)p)) == NULL)
+    {
+        REPORT_UNLOCK();
+#   ifdef IK_MEMORY_BACKTRACE
+        if (callsite != NULL)
+            heap_profile_release(callsite, size, weight);
+#   endif
+        g_allocator.free(g_allocator.user_data, p);
+        COUNTER_SUB(g_allocations, 1);
+        return NULL;
+    }
+    entry->size = size;
 #   ifdef IK_MEMORY_BACKTRACE
-                {
-                    char** bt;
-                    int bt_size, i;
-                    if ((bt = get_backtrace(&bt_size)))
-                    {
-                        printf("  backtrace to where malloc() was called:\n");
-                        for (i = 0; i < bt_size; ++i)
-                            printf("      %s\n", bt[i]);
-                        printf("  -----------------------------------------\n");
-                        free(bt);
-                    }
-                    else
-                        fprintf(stderr, "[memory] WARNING: Failed to generate backtrace\n");
-                }
+    entry->callsite = callsite;
+    entry->weight = weight;
 #   endif
-            }
-            g_ignore_bstv_malloc = 0;
+    REPORT_UNLOCK();
+
+    return p;
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+realloc_wrapper(void* ptr, intptr_t size)
+{
+    void* p;
+    int found;
+    struct report_entry_t* entry;
+    struct report_entry_t info;
+
+    if (ptr == NULL)
+        return malloc_wrapper(size);
+
+    /*
+     * Take the entry out of the report before reallocating. If the block
+     * moves, ptr is freed and another thread's malloc() may be handed the
+     * same address, which must not find a stale entry in the report.
+     */
+    REPORT_LOCK();
+    entry = report_find((uintptr_t)ptr);
+    found = (entry != NULL);
+    if (found)
+    {
+        info = *entry;
+        report_erase(entry);
+    }
+    REPORT_UNLOCK();
+
+    if ((p = g_allocator.realloc(g_allocator.user_data, ptr, size)) == NULL)
+    {
+        /* ptr is still valid, so it gets its entry back */
+        if (found)
+        {
+            REPORT_LOCK();
+            if ((entry = report_insert((uintptr_t)ptr)) != NULL)
+                *entry = info;
+#   ifdef IK_MEMORY_BACKTRACE
+            else if (info.callsite != NULL)
+                heap_profile_release(info.callsite, info.size, info.weight);
+#   endif
+            REPORT_UNLOCK();
         }
+        return NULL;
+    }
 
-        /* success */
-        return p;
+    if (count_allocation())
+    {
+        fprintf(stderr, "[memory] ERROR: realloc() was called during solve()\n");
+        print_backtrace(NULL);
     }
 
-    /* failure */
-    if (p)
+    if (!found)
     {
-        free(p);
-        --g_allocations;
+        fprintf(stderr, "  WARNING: Reallocating something that was never allocated\n");
+        return p;
     }
 
-    if (info)
+    /* The allocation keeps its report entry, it only moves and changes size */
+    REPORT_LOCK();
+    if ((entry = report_insert((uintptr_t)p)) != NULL)
     {
+        *entry = info;
+        entry->location = (uintptr_t)p;
+        entry->size = size;
 #   ifdef IK_MEMORY_BACKTRACE
-        if (info->backtrace)
-            free(info->backtrace);
+        if (entry->callsite != NULL)
+            entry->weight = heap_profile_resize(entry->callsite, info.size, size, info.weight);
 #   endif
-        free(info);
     }
+#   ifdef IK_MEMORY_BACKTRACE
+    else if (info.callsite != NULL)
+        heap_profile_release(info.callsite, info.size, info.weight);
+#   endif
+    REPORT_UNLOCK();
 
-    return NULL;
+    return p;
 }
 
 /* ------------------------------------------------------------------------- */
 void
 free_wrapper(void* ptr)
 {
-    /* find matching allocation and remove from bstv */
-    if (!g_ignore_bstv_malloc)
+    struct report_entry_t* entry;
+
+    if (ptr == NULL)
     {
-        report_info_t* info = (report_info_t*)bstv_erase(&report, (uintptr_t)ptr);
-        if (info)
-        {
-#   ifdef IK_MEMORY_BACKTRACE
-            if (info->backtrace)
-                free(info->backtrace);
-            else
-                fprintf(stderr, "[memory] WARNING: free(): Allocation didn't "
-                    "have a backtrace (it was NULL)\n");
-#   endif
-            free(info);
-        }
-        else
-        {
-#   ifdef IK_MEMORY_BACKTRACE
-            char** bt;
-            int bt_size, i;
-            fprintf(stderr, "  -----------------------------------------\n");
-#   endif
-            fprintf(stderr, "  WARNING: Freeing something that was never allocated\n");
-#   ifdef IK_MEMORY_BACKTRACE
-            if ((bt = get_backtrace(&bt_size)))
-            {
-                fprintf(stderr, "  backtrace to where free() was called:\n");
-                for (i = 0; i < bt_size; ++i)
-                    fprintf(stderr, "      %s\n", bt[i]);
-                fprintf(stderr, "  -----------------------------------------\n");
-                free(bt);
-            }
-            else
-                fprintf(stderr, "[memory] WARNING: Failed to generate backtrace\n");
-#   endif
-        }
+        fprintf(stderr, "Warning: free(NULL)\n");
+        return;
     }
 
-    if (ptr)
+    /* find matching allocation and remove it from the report */
+    REPORT_LOCK();
+    if ((entry = report_find((uintptr_t)ptr)) != NULL)
     {
-        ++d_deg_allocations;
-        free(ptr);
+#   ifdef IK_MEMORY_BACKTRACE
+        if (entry->callsite != NULL)
+            heap_profile_release(entry->callsite, entry->size, entry->weight);
+#   endif
+        report_erase(entry);
+        REPORT_UNLOCK();
     }
     else
-        fprintf(stderr, "Warning: free(NULL)\n");
+    {
+        REPORT_UNLOCK();
+        fprintf(stderr, "  -----------------------------------------\n");
+        fprintf(stderr, "  WARNING: Freeing something that was never allocated\n");
+        print_backtrace("backtrace to where free() was called:");
+        fprintf(stderr, "  -----------------------------------------\n");
+    }
+
+    COUNTER_ADD(g_deallocations, 1);
+    g_allocator.free(g_allocator.user_data, ptr);
 }
 
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_memory_deinit(void)
 {
-    uintptr_t leaks;
-
-    --g_allocations; /* this is the single allocation still held by the report vector */
+    uintptr_t leaks, i;
 
     printf("=========================================\n");
     printf("Inverse Kinematics Memory Report\n");
     printf("=========================================\n");
 
     /* report details on any g_allocations that were not de-allocated */
-    if (report.vector.count != 0)
+    if (g_report.count != 0)
     {
-        BSTV_FOR_EACH(&report, report_info_t, key, info)
+        for (i = 0; i != g_report.capacity; ++i)
+        {
+            struct report_entry_t* entry = &g_report.entries[i];
+            if (entry->location == REPORT_EMPTY || entry->location == REPORT_TOMBSTONE)
+                continue;
 
-            printf("  un-freed memory at %p, size %p\n", (void*)info->location, (void*)info->size);
-            mutated_string_and_hex_dump((void*)info->location, info->size);
+            printf("  un-freed memory at %p, size %p\n", (void*)entry->location, (void*)entry->size);
+            mutated_string_and_hex_dump((void*)entry->location, entry->size);
+        }
 
+        /* Whatever is still live at this point was leaked */
 #   ifdef IK_MEMORY_BACKTRACE
-            printf("  Backtrace to where malloc() was called:\n");
-            {
-                intptr_t i;
-                for (i = BACKTRACE_OMIT_COUNT; i < info->backtrace_size; ++i)
-                    printf("      %s\n", info->backtrace[i]);
-            }
-            free(info->backtrace); /* this was allocated when malloc() was called */
-            printf("  -----------------------------------------\n");
+        printf("=========================================\n");
+        printf("Leaked memory by callsite (only sampled allocations have one)\n");
+        heap_profile_write(NULL, IK_HEAP_PROFILE_REPORT);
 #   endif
-            free(info);
-
-        BSTV_END_EACH
-
         printf("=========================================\n");
     }
 
     /* overall report */
-    leaks = (g_allocations > d_deg_allocations ? g_allocations - d_deg_allocations : d_deg_allocations - g_allocations);
-    printf("allocations: %lu\n", g_allocations);
-    printf("deallocations: %lu\n", d_deg_allocations);
-    printf("memory leaks: %lu\n", leaks);
+    leaks = g_report.count;
+    printf("allocations: %lu\n", (unsigned long)COUNTER_LOAD(g_allocations));
+    printf("deallocations: %lu\n", (unsigned long)COUNTER_LOAD(g_deallocations));
+    printf("memory leaks: %lu\n", (unsigned long)leaks);
+    printf("allocations during solve: %lu\n", (unsigned long)COUNTER_LOAD(g_solve_allocation_count));
     printf("=========================================\n");
 
-    ++g_allocations; /* this is the single allocation still held by the report vector */
-    g_ignore_bstv_malloc = 1;
-    bstv_clear_free(&report);
+    if (g_report.entries != NULL)
+        g_allocator.free(g_allocator.user_data, g_report.entries);
+    memset(&g_report, 0, sizeof g_report);
+#   ifdef IK_MEMORY_BACKTRACE
+    heap_profile_deinit();
+#   endif
+    g_initialized = 0;
 
     return leaks;
 }
 
 #else /* IK_MEMORY_DEBUGGING */
 
-void ik_memory_init(void) {}
-uintptr_t ik_memory_deinit(void) { return 0; }
+/* ------------------------------------------------------------------------- */
+void
+ik_memory_init(void)
+{
+    g_initialized = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_memory_deinit(void)
+{
+    g_initialized = 0;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+ik_malloc(intptr_t size)
+{
+    count_allocation();
+    return g_allocator.malloc(g_allocator.user_data, size);
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+ik_realloc(void* ptr, intptr_t size)
+{
+    count_allocation();
+    return g_allocator.realloc(g_allocator.user_data, ptr, size);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_free(void* ptr)
+{
+    g_allocator.free(g_allocator.user_data, ptr);
+}
 
 #endif /* IK_MEMORY_DEBUGGING */
 
@@ -0,0 +1,60 @@
+#include "ik/batch.h"
+#include <stddef.h>
+
+/* Only AArch64 has double precision vector instructions (and vsqrtq/vdivq) */
+#if defined(IK_SIMD_NEON) && defined(__aarch64__) && (defined(IK_PRECISION_DOUBLE) || defined(IK_PRECISION_FLOAT))
+#include <arm_neon.h>
+
+#define BATCH_PREFIX(name) neon_##name
+#define BATCH_NAME "neon"
+#if defined(IK_PRECISION_DOUBLE)
+#   define BATCH_WIDTH     2
+#   define bvec_t          float64x2_t
+#   define BLOAD(p)        vld1q_f64(p)
+#   define BSTORE(p, v)    vst1q_f64(p, v)
+#   define BSET1(s)        vdupq_n_f64(s)
+#   define BADD(a, b)      vaddq_f64(a, b)
+#   define BSUB(a, b)      vsubq_f64(a, b)
+#   define BMUL(a, b)      vmulq_f64(a, b)
+#   define BDIV(a, b)      vdivq_f64(a, b)
+#   define BSQRT(a)        vsqrtq_f64(a)
+#   define BMIN(a, b)      vminq_f64(a, b)
+#   define BMAX(a, b)      vmaxq_f64(a, b)
+#   define BCMPEQ(a, b)    vreinterpretq_f64_u64(vceqq_f64(a, b))
+#   define BSELECT(m, a, b) vbslq_f64(vreinterpretq_u64_f64(m), a, b)
+#else
+#   define BATCH_WIDTH     4
+#   define bvec_t          float32x4_t
+#   define BLOAD(p)        vld1q_f32(p)
+#   define BSTORE(p, v)    vst1q_f32(p, v)
+#   define BSET1(s)        vdupq_n_f32(s)
+#   define BADD(a, b)      vaddq_f32(a, b)
+#   define BSUB(a, b)      vsubq_f32(a, b)
+#   define BMUL(a, b)      vmulq_f32(a, b)
+#   define BDIV(a, b)      vdivq_f32(a, b)
+#   define BSQRT(a)        vsqrtq_f32(a)
+#   define BMIN(a, b)      vminq_f32(a, b)
+#   define BMAX(a, b)      vmaxq_f32(a, b)
+#   define BCMPEQ(a, b)    vreinterpretq_f32_u32(vceqq_f32(a, b))
+#   define BSELECT(m, a, b) vbslq_f32(vreinterpretq_u32_f32(m), a, b)
+#endif
+#include "ik/batch_template.h"
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels_neon(void)
+{
+    /* NEON is mandatory on AArch64 */
+    return &neon_kernels;
+}
+
+#else
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels_neon(void)
+{
+    return NULL;
+}
+
+#endif
@@ -13,3 +13,17 @@ get_backtrace(int* size)
 
     return strings;
 }
+
+/* ------------------------------------------------------------------------- */
+int
+get_backtrace_frames(void** frames, int max_frames)
+{
+    return backtrace(frames, max_frames);
+}
+
+/* ------------------------------------------------------------------------- */
+char**
+get_backtrace_symbols(void* const* frames, int size)
+{
+    return backtrace_symbols(frames, size);
+}
@@ -0,0 +1,62 @@
+#include "ik/batch.h"
+#include <stddef.h>
+
+/* This file is compiled with -mavx2 -mfma. Only call into it after checking the CPU */
+#if defined(IK_SIMD_AVX2) && (defined(IK_PRECISION_DOUBLE) || defined(IK_PRECISION_FLOAT))
+#include <immintrin.h>
+
+#define BATCH_PREFIX(name) avx2_##name
+#define BATCH_NAME "avx2"
+#if defined(IK_PRECISION_DOUBLE)
+#   define BATCH_WIDTH     4
+#   define bvec_t          __m256d
+#   define BLOAD(p)        _mm256_loadu_pd(p)
+#   define BSTORE(p, v)    _mm256_storeu_pd(p, v)
+#   define BSET1(s)        _mm256_set1_pd(s)
+#   define BADD(a, b)      _mm256_add_pd(a, b)
+#   define BSUB(a, b)      _mm256_sub_pd(a, b)
+#   define BMUL(a, b)      _mm256_mul_pd(a, b)
+#   define BDIV(a, b)      _mm256_div_pd(a, b)
+#   define BSQRT(a)        _mm256_sqrt_pd(a)
+#   define BMIN(a, b)      _mm256_min_pd(a, b)
+#   define BMAX(a, b)      _mm256_max_pd(a, b)
+#   define BCMPEQ(a, b)    _mm256_cmp_pd(a, b, _CMP_EQ_OQ)
+#   define BSELECT(m, a, b) _mm256_blendv_pd(b, a, m)
+#else
+#   define BATCH_WIDTH     8
+#   define bvec_t          __m256
+#   define BLOAD(p)        _mm256_loadu_ps(p)
+#   define BSTORE(p, v)    _mm256_storeu_ps(p, v)
+#   define BSET1(s)        _mm256_set1_ps(s)
+#   define BADD(a, b)      _mm256_add_ps(a, b)
+#   define BSUB(a, b)      _mm256_sub_ps(a, b)
+#   define BMUL(a, b)      _mm256_mul_ps(a, b)
+#   define BDIV(a, b)      _mm256_div_ps(a, b)
+#   define BSQRT(a)        _mm256_sqrt_ps(a)
+#   define BMIN(a, b)      _mm256_min_ps(a, b)
+#   define BMAX(a, b)      _mm256_max_ps(a, b)
+#   define BCMPEQ(a, b)    _mm256_cmp_ps(a, b, _CMP_EQ_OQ)
+#   define BSELECT(m, a, b) _mm256_blendv_ps(b, a, m)
+#endif
+#include "ik/batch_template.h"
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels_avx2(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return &avx2_kernels;
+    return NULL;
+}
+
+#else
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels_avx2(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "ik/batch.h"
+#include <stddef.h>
+
+#if defined(IK_SIMD_SSE2) && (defined(IK_PRECISION_DOUBLE) || defined(IK_PRECISION_FLOAT))
+#include <emmintrin.h>
+
+#define BATCH_PREFIX(name) sse2_##name
+#define BATCH_NAME "sse2"
+#if defined(IK_PRECISION_DOUBLE)
+#   define BATCH_WIDTH     2
+#   define bvec_t          __m128d
+#   define BLOAD(p)        _mm_loadu_pd(p)
+#   define BSTORE(p, v)    _mm_storeu_pd(p, v)
+#   define BSET1(s)        _mm_set1_pd(s)
+#   define BADD(a, b)      _mm_add_pd(a, b)
+#   define BSUB(a, b)      _mm_sub_pd(a, b)
+#   define BMUL(a, b)      _mm_mul_pd(a, b)
+#   define BDIV(a, b)      _mm_div_pd(a, b)
+#   define BSQRT(a)        _mm_sqrt_pd(a)
+#   define BMIN(a, b)      _mm_min_pd(a, b)
+#   define BMAX(a, b)      _mm_max_pd(a, b)
+#   define BCMPEQ(a, b)    _mm_cmpeq_pd(a, b)
+#   define BSELECT(m, a, b) _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b))
+#else
+#   define BATCH_WIDTH     4
+#   define bvec_t          __m128
+#   define BLOAD(p)        _mm_loadu_ps(p)
+#   define BSTORE(p, v)    _mm_storeu_ps(p, v)
+#   define BSET1(s)        _mm_set1_ps(s)
+#   define BADD(a, b)      _mm_add_ps(a, b)
+#   define BSUB(a, b)      _mm_sub_ps(a, b)
+#   define BMUL(a, b)      _mm_mul_ps(a, b)
+#   define BDIV(a, b)      _mm_div_ps(a, b)
+#   define BSQRT(a)        _mm_sqrt_ps(a)
+#   define BMIN(a, b)      _mm_min_ps(a, b)
+#   define BMAX(a, b)      _mm_max_ps(a, b)
+#   define BCMPEQ(a, b)    _mm_cmpeq_ps(a, b)
+#   define BSELECT(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+#endif
+#include "ik/batch_template.h"
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels_sse2(void)
+{
+    /* SSE2 is part of the x86-64 baseline, no need to check the CPU */
+    return &sse2_kernels;
+}
+
+#else
+
+/* ------------------------------------------------------------------------- */
+const struct batch_kernels_t*
+batch_kernels_sse2(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "ik/pool.h"
+#include "ik/guid_index.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/node.h"
+#include <string.h>
+
+#define POOL_ALIGNMENT 16
+#define POOL_ALIGN(size) (((size) + POOL_ALIGNMENT - 1) & ~(uintptr_t)(POOL_ALIGNMENT - 1))
+#define SLAB_MIN_BLOCK_CAPACITY 32
+#define SLAB_MAX_BLOCK_CAPACITY 4096
+
+struct ik_slab_block_t
+{
+    struct ik_slab_block_t* next;
+    uint32_t capacity;
+    /* Slots handed out so far. Slots past this were never used */
+    uint32_t used;
+};
+
+#define BLOCK_HEADER_SIZE POOL_ALIGN(sizeof(struct ik_slab_block_t))
+#define BLOCK_SLOT(slab, block, i) \
+    ((char*)(block) + BLOCK_HEADER_SIZE + (uintptr_t)(i) * (slab)->object_size)
+
+/* Layout of a free slot, see pool.h */
+struct free_slot_t
+{
+    const void* v;
+    struct free_slot_t* next;
+};
+
+/* ------------------------------------------------------------------------- */
+static void
+slab_construct(struct ik_slab_t* slab, uintptr_t object_size)
+{
+    memset(slab, 0, sizeof *slab);
+    if (object_size < sizeof(struct free_slot_t))
+        object_size = sizeof(struct free_slot_t);
+    slab->object_size = POOL_ALIGN(object_size);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+slab_clear(struct ik_slab_t* slab)
+{
+    struct ik_slab_block_t* block = slab->first;
+    while (block != NULL)
+    {
+        struct ik_slab_block_t* next = block->next;
+        FREE(block);
+        block = next;
+    }
+
+    slab->first = NULL;
+    slab->last = NULL;
+    slab->free_list = NULL;
+    slab->count = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+slab_alloc(struct ik_slab_t* slab)
+{
+    struct ik_slab_block_t* block = slab->last;
+
+    if (slab->free_list != NULL)
+    {
+        struct free_slot_t* slot = slab->free_list;
+        slab->free_list = slot->next;
+        slab->count++;
+        return slot;
+    }
+
+    /* Each block is twice the size of the previous one, up to a limit */
+    if (block == NULL || block->used == block->capacity)
+    {
+        uint32_t capacity = SLAB_MIN_BLOCK_CAPACITY;
+        if (block != NULL)
+            capacity = block->capacity < SLAB_MAX_BLOCK_CAPACITY / 2 ?
+                block->capacity * 2 : SLAB_MAX_BLOCK_CAPACITY;
+
+        block = MALLOC(BLOCK_HEADER_SIZE + capacity * slab->object_size);
+        if (block == NULL)
+        {
+            IKAPI.log.message("Failed to allocate pool block: Ran out of memory");
+            return NULL;
+        }
+        block->next = NULL;
+        block->capacity = capacity;
+        block->used = 0;
+
+        if (slab->last != NULL)
+            slab->last->next = block;
+        else
+            slab->first = block;
+        slab->last = block;
+    }
+
+    slab->count++;
+    return BLOCK_SLOT(slab, block, block->used++);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+slab_free(struct ik_slab_t* slab, void* object)
+{
+    struct free_slot_t* slot = object;
+    slot->v = NULL;
+    slot->next = slab->free_list;
+    slab->free_list = slot;
+    slab->count--;
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_pool_t*
+pool_create(uintptr_t node_size)
+{
+    struct ik_pool_t* pool = MALLOC(sizeof *pool);
+    if (pool == NULL)
+    {
+        IKAPI.log.message("Failed to allocate pool: Ran out of memory");
+        return NULL;
+    }
+
+    slab_construct(&pool->nodes, node_size);
+    slab_construct(&pool->effectors, sizeof(struct ik_effector_t));
+    slab_construct(&pool->constraints, sizeof(struct ik_constraint_t));
+    pool->has_foreign_objects = 0;
+
+    return pool;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pool_destroy(struct ik_pool_t* pool)
+{
+    pool_clear(pool);
+    FREE(pool);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pool_clear(struct ik_pool_t* pool)
+{
+    struct ik_slab_block_t* block;
+    struct ik_slab_t* nodes = &pool->nodes;
+
+    for (block = nodes->first; block != NULL; block = block->next)
+    {
+        uint32_t i;
+        for (i = 0; i != block->used; ++i)
+        {
+            struct ik_node_t* node = (struct ik_node_t*)BLOCK_SLOT(nodes, block, i);
+            if (node->v == NULL)
+                continue;
+#if !defined(IK_NODE_CHILDREN_LINKED)
+            bstv_clear_free(&node->children);
+#endif
+            if (node->guid_index != NULL && node->guid_index->root == node)
+                guid_index_destroy(node->guid_index);
+        }
+    }
+
+    slab_clear(&pool->nodes);
+    slab_clear(&pool->effectors);
+    slab_clear(&pool->constraints);
+    pool->has_foreign_objects = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+pool_create_node(struct ik_pool_t* pool, const struct ik_node_interface_t* v, uint32_t guid)
+{
+    struct ik_node_t* node;
+
+    if (v->type_size() > pool->nodes.object_size)
+    {
+        IKAPI.log.message("Failed to allocate node: Node type doesn't fit into the pool");
+        return NULL;
+    }
+
+    if ((node = slab_alloc(&pool->nodes)) == NULL)
+        return NULL;
+    if (v->construct(node, guid) != IK_OK)
+    {
+        slab_free(&pool->nodes, node);
+        return NULL;
+    }
+    node->pool = pool;
+
+    return node;
+}
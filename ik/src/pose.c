@@ -0,0 +1,460 @@
+#include "ik/pose.h"
+#include "ik/batch.h"
+#include "ik/carve.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/node.h"
+#include "ik/quat_static.h"
+#include "ik/vec3_static.h"
+#include <assert.h>
+#include <string.h>
+
+#define GLOBAL(table, slot) (&(table)->global[(uintptr_t)(slot) * 7])
+#define TARGET(table, slot) (&(table)->target[(uintptr_t)(slot) * 7])
+
+/* Elements of the caller's arrays, stride is in bytes */
+#define ELEMENT(base, stride, i) \
+    ((ikreal_t*)((char*)(base) + (uintptr_t)(i) * (stride)))
+#define CONST_ELEMENT(base, stride, i) \
+    ((const ikreal_t*)((const char*)(base) + (uintptr_t)(i) * (stride)))
+
+#define GIVEN_POSITION 0x01
+#define GIVEN_ROTATION 0x02
+
+struct build_state_t
+{
+    struct pose_table_t* table;
+    uint32_t slot;
+};
+
+/*
+ * Same idea as in transform_program.c: The accumulated rotations of a block
+ * of slots are computed serially, and then the positions of the whole block
+ * are rotated with the batch kernels. A parent is always earlier in the block
+ * than its children.
+ */
+struct block_t
+{
+    uint32_t slots[BATCH_BLOCK];
+    ikreal_t px[BATCH_BLOCK], py[BATCH_BLOCK], pz[BATCH_BLOCK];
+    ikreal_t qx[BATCH_BLOCK], qy[BATCH_BLOCK], qz[BATCH_BLOCK], qw[BATCH_BLOCK];
+};
+
+static const ikreal_t g_identity[7] = {0, 0, 0, 1, 0, 0, 0};
+
+/* ------------------------------------------------------------------------- */
+void
+pose_table_construct(struct pose_table_t* table)
+{
+    memset(table, 0, sizeof *table);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pose_table_destruct(struct pose_table_t* table)
+{
+    if (table->block != NULL)
+        FREE(table->block);
+    pose_table_construct(table);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pose_table_clear(struct pose_table_t* table)
+{
+    table->slot_count = 0;
+    table->bone_count = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+count_nodes_recursive(const struct ik_node_t* node, uint32_t* slots, int32_t* bones)
+{
+    *slots += 1;
+    if (node->bone_index >= *bones)
+        *bones = node->bone_index + 1;
+    NODE_FOR_EACH(node, guid, child)
+        count_nodes_recursive(child, slots, bones);
+    NODE_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+static uintptr_t
+layout(struct pose_table_t* table, uint8_t* block)
+{
+    uintptr_t offset = 0;
+    uintptr_t slots = table->slot_count;
+
+    /* When block is NULL this only computes the required size */
+    CARVE(block, &offset, table->global, slots * 7);
+    CARVE(block, &offset, table->target, slots * 7);
+    CARVE(block, &offset, table->nodes, slots);
+    CARVE(block, &offset, table->parent, slots);
+    CARVE(block, &offset, table->bone_slot, table->bone_count);
+    CARVE(block, &offset, table->given, slots);
+
+    return offset;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+build_recursive(struct build_state_t* state, struct ik_node_t* node, uint32_t parent)
+{
+    struct pose_table_t* table = state->table;
+    uint32_t slot = state->slot++;
+
+    table->nodes[slot] = node;
+    table->parent[slot] = parent;
+    if (node->bone_index >= 0)
+        table->bone_slot[node->bone_index] = slot;
+
+    NODE_FOR_EACH(node, guid, child)
+        build_recursive(state, child, slot);
+    NODE_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+pose_table_build(struct pose_table_t* table, struct ik_node_t* root)
+{
+    struct build_state_t state;
+    uintptr_t size;
+    int32_t i;
+
+    pose_table_clear(table);
+    if (root == NULL)
+        return IK_OK;
+
+    count_nodes_recursive(root, &table->slot_count, &table->bone_count);
+
+    /* Trees without bones don't need a table */
+    if (table->bone_count == 0)
+    {
+        table->slot_count = 0;
+        return IK_OK;
+    }
+
+    size = layout(table, NULL);
+    if (size > table->block_size)
+    {
+        uint8_t* block;
+        if ((block = MALLOC(size)) == NULL)
+        {
+            IKAPI.log.message("Failed to allocate pose table: Ran out of memory");
+            pose_table_destruct(table);
+            return IK_RAN_OUT_OF_MEMORY;
+        }
+        if (table->block != NULL)
+            FREE(table->block);
+        table->block = block;
+        table->block_size = size;
+    }
+    layout(table, table->block);
+
+    for (i = 0; i != table->bone_count; ++i)
+        table->bone_slot[i] = POSE_NO_SLOT;
+
+    state.table = table;
+    state.slot = 0;
+    build_recursive(&state, root, POSE_NO_PARENT);
+    assert(state.slot == table->slot_count);
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static const ikreal_t*
+parent_global(const struct pose_table_t* table, uint32_t slot)
+{
+    uint32_t parent = table->parent[slot];
+    return parent == POSE_NO_PARENT ? g_identity : GLOBAL(table, parent);
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+element_slot(const struct pose_table_t* table, const int32_t* remap, int32_t i)
+{
+    int32_t bone = remap != NULL ? remap[i] : i;
+    if (bone < 0 || bone >= table->bone_count)
+        return POSE_NO_SLOT;
+    return table->bone_slot[bone];
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+update_globals(struct pose_table_t* table)
+{
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+    uint32_t slot = 0;
+
+    while (slot != table->slot_count)
+    {
+        int i, count = table->slot_count - slot < BATCH_BLOCK ?
+            (int)(table->slot_count - slot) : BATCH_BLOCK;
+
+        /* Rotations depend on the parent's result and can't be batched */
+        for (i = 0; i != count; ++i, ++slot)
+        {
+            const struct ik_node_t* node = table->nodes[slot];
+            const ikreal_t* parent = parent_global(table, slot);
+            ikreal_t* global = GLOBAL(table, slot);
+
+            block.slots[i] = slot;
+            block.qx[i] = parent[0];
+            block.qy[i] = parent[1];
+            block.qz[i] = parent[2];
+            block.qw[i] = parent[3];
+            block.px[i] = node->position.x;
+            block.py[i] = node->position.y;
+            block.pz[i] = node->position.z;
+            ik_quat_static_set(global, parent);
+            ik_quat_static_mul_quat(global, node->rotation.f);
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            uint32_t s = block.slots[i];
+            const ikreal_t* parent = parent_global(table, s);
+            ikreal_t* global = GLOBAL(table, s);
+            global[4] = parent[4] + block.px[i];
+            global[5] = parent[5] + block.py[i];
+            global[6] = parent[6] + block.pz[i];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+pose_table_get(struct pose_table_t* table, int global,
+               ikreal_t* positions, uintptr_t position_stride,
+               ikreal_t* rotations, uintptr_t rotation_stride,
+               const int32_t* remap, int32_t count)
+{
+    ikret_t result = IK_OK;
+    int32_t i;
+
+    if (position_stride == 0)
+        position_stride = sizeof(ikreal_t) * 3;
+    if (rotation_stride == 0)
+        rotation_stride = sizeof(ikreal_t) * 4;
+
+    if (global)
+        update_globals(table);
+
+    for (i = 0; i < count; ++i)
+    {
+        const ikreal_t* rotation;
+        const ikreal_t* position;
+        uint32_t slot = element_slot(table, remap, i);
+        if (slot == POSE_NO_SLOT)
+        {
+            result = IK_INDEX_OUT_OF_RANGE;
+            continue;
+        }
+
+        if (global)
+        {
+            rotation = GLOBAL(table, slot);
+            position = GLOBAL(table, slot) + 4;
+        }
+        else
+        {
+            rotation = table->nodes[slot]->rotation.f;
+            position = table->nodes[slot]->position.f;
+        }
+
+        if (positions != NULL)
+            ik_vec3_static_set(ELEMENT(positions, position_stride, i), position);
+        if (rotations != NULL)
+            ik_quat_static_set(ELEMENT(rotations, rotation_stride, i), rotation);
+    }
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+set_globals(struct pose_table_t* table)
+{
+    uint32_t slot;
+
+    /*
+     * Each node's new local transform depends on the new global transform of
+     * its parent, so this is done serially. Nodes that weren't given a
+     * global transform keep their local transform and follow their parent.
+     */
+    for (slot = 0; slot != table->slot_count; ++slot)
+    {
+        struct ik_node_t* node = table->nodes[slot];
+        const ikreal_t* parent = parent_global(table, slot);
+        const ikreal_t* target = TARGET(table, slot);
+        ikreal_t* global = GLOBAL(table, slot);
+        ikreal_t inv_parent_rot[4];
+
+        ik_quat_static_set(inv_parent_rot, parent);
+        ik_quat_static_conj(inv_parent_rot);
+
+        if (table->given[slot] & GIVEN_ROTATION)
+        {
+            ik_quat_static_set(global, target);
+            ik_quat_static_set(node->rotation.f, inv_parent_rot);
+            ik_quat_static_mul_quat(node->rotation.f, target);
+        }
+        else
+        {
+            ik_quat_static_set(global, parent);
+            ik_quat_static_mul_quat(global, node->rotation.f);
+        }
+
+        if (table->given[slot] & GIVEN_POSITION)
+        {
+            ik_vec3_static_set(global + 4, target + 4);
+            ik_vec3_static_set(node->position.f, target + 4);
+            ik_vec3_static_sub_vec3(node->position.f, parent + 4);
+            ik_vec3_static_rotate(node->position.f, inv_parent_rot);
+        }
+        else
+        {
+            ik_vec3_static_set(global + 4, node->position.f);
+            ik_vec3_static_rotate(global + 4, parent);
+            ik_vec3_static_add_vec3(global + 4, parent + 4);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+pose_table_set(struct pose_table_t* table, int global,
+               const ikreal_t* positions, uintptr_t position_stride,
+               const ikreal_t* rotations, uintptr_t rotation_stride,
+               const int32_t* remap, int32_t count)
+{
+    ikret_t result = IK_OK;
+    int32_t i;
+
+    if (position_stride == 0)
+        position_stride = sizeof(ikreal_t) * 3;
+    if (rotation_stride == 0)
+        rotation_stride = sizeof(ikreal_t) * 4;
+
+    if (global)
+        memset(table->given, 0, table->slot_count);
+
+    for (i = 0; i < count; ++i)
+    {
+        ikreal_t* rotation;
+        ikreal_t* position;
+        uint32_t slot = element_slot(table, remap, i);
+        if (slot == POSE_NO_SLOT)
+        {
+            result = IK_INDEX_OUT_OF_RANGE;
+            continue;
+        }
+
+        if (global)
+        {
+            rotation = TARGET(table, slot);
+            position = TARGET(table, slot) + 4;
+            table->given[slot] |= (positions != NULL ? GIVEN_POSITION : 0) |
+                                  (rotations != NULL ? GIVEN_ROTATION : 0);
+        }
+        else
+        {
+            rotation = table->nodes[slot]->rotation.f;
+            position = table->nodes[slot]->position.f;
+        }
+
+        if (positions != NULL)
+            ik_vec3_static_set(position, CONST_ELEMENT(positions, position_stride, i));
+        if (rotations != NULL)
+            ik_quat_static_set(rotation, CONST_ELEMENT(rotations, rotation_stride, i));
+    }
+
+    if (global)
+        set_globals(table);
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static int32_t
+bound_count(const struct pose_table_t* table)
+{
+    return table->binding.count < table->bone_count ?
+        table->binding.count : table->bone_count;
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * One component at a time, so every loop streams through one of the
+ * caller's arrays. component is the index into ik_node_t::transform.
+ */
+static void
+pull_component(struct pose_table_t* table, const void* array, int component)
+{
+    int32_t bone, count = bound_count(table);
+    if (array == NULL)
+        return;
+
+    for (bone = 0; bone < count; ++bone)
+    {
+        uint32_t slot = table->bone_slot[bone];
+        if (slot == POSE_NO_SLOT)
+            continue;
+        if (table->binding.type == IK_BINDING_FLOAT)
+            table->nodes[slot]->transform[component] = (ikreal_t)((const float*)array)[bone];
+        else
+            table->nodes[slot]->transform[component] = (ikreal_t)((const double*)array)[bone];
+    }
+}
+static void
+push_component(const struct pose_table_t* table, void* array, int component)
+{
+    int32_t bone, count = bound_count(table);
+    if (array == NULL)
+        return;
+
+    for (bone = 0; bone < count; ++bone)
+    {
+        uint32_t slot = table->bone_slot[bone];
+        if (slot == POSE_NO_SLOT)
+            continue;
+        if (table->binding.type == IK_BINDING_FLOAT)
+            ((float*)array)[bone] = (float)table->nodes[slot]->transform[component];
+        else
+            ((double*)array)[bone] = (double)table->nodes[slot]->transform[component];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pose_table_pull(struct pose_table_t* table)
+{
+    int i;
+    if (table->bound == 0)
+        return;
+
+    /* The rotation comes first in ik_node_t::transform */
+    for (i = 0; i != 4; ++i)
+        pull_component(table, table->binding.rotation[i], i);
+    for (i = 0; i != 3; ++i)
+        pull_component(table, table->binding.position[i], 4 + i);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pose_table_push(const struct pose_table_t* table)
+{
+    int i;
+    if (table->bound == 0)
+        return;
+
+    for (i = 0; i != 4; ++i)
+        push_component(table, table->binding.rotation[i], i);
+    for (i = 0; i != 3; ++i)
+        push_component(table, table->binding.position[i], 4 + i);
+}
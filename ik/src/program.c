@@ -0,0 +1,557 @@
+#include "ik/program.h"
+#include "ik/batch.h"
+#include "ik/carve.h"
+#include "ik/chain.h"
+#include "ik/effector.h"
+#include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/node.h"
+#include "ik/quat_static.h"
+#include "ik/vec3_static.h"
+#include <assert.h>
+#include <string.h>
+
+struct compile_state_t
+{
+    struct program_t* program;
+    uint32_t slot;
+    uint32_t chain;
+    uint32_t child;
+};
+
+/* ------------------------------------------------------------------------- */
+void
+program_construct(struct program_t* program)
+{
+    memset(program, 0, sizeof *program);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+program_destruct(struct program_t* program)
+{
+    if (program->block != NULL)
+        FREE(program->block);
+    program_construct(program);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+count_chain_recursive(const struct chain_t* chain, uint32_t* slots, uint32_t* chains, uint32_t* effectors)
+{
+    assert(chain_length(chain) >= 2);
+    *slots += chain_length(chain) - 1;
+    *chains += 1;
+    if (chain_child_count(chain) == 0)
+        *effectors += 1;
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        count_chain_recursive(child, slots, chains, effectors);
+    CHAIN_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+static uintptr_t
+layout(struct program_t* program, uint8_t* block)
+{
+    uintptr_t offset = 0;
+    uintptr_t slots = program->slot_count;
+    uintptr_t chains = program->chain_count;
+
+    /*
+     * Largest alignment requirements first. When block is NULL this only
+     * computes the required size.
+     */
+    CARVE(block, &offset, program->pos_x, slots);
+    CARVE(block, &offset, program->pos_y, slots);
+    CARVE(block, &offset, program->pos_z, slots);
+    CARVE(block, &offset, program->dist, slots);
+    CARVE(block, &offset, program->rotation_weight, slots);
+    CARVE(block, &offset, program->transform, slots * 7);
+    CARVE(block, &offset, program->local, slots * 7);
+    CARVE(block, &offset, program->island_residual, program->island_count);
+    CARVE(block, &offset, program->warm_x, slots);
+    CARVE(block, &offset, program->warm_y, slots);
+    CARVE(block, &offset, program->warm_z, slots);
+    CARVE(block, &offset, program->warm_target_x, chains);
+    CARVE(block, &offset, program->warm_target_y, chains);
+    CARVE(block, &offset, program->warm_target_z, chains);
+    CARVE(block, &offset, program->target_x, chains);
+    CARVE(block, &offset, program->target_y, chains);
+    CARVE(block, &offset, program->target_z, chains);
+    CARVE(block, &offset, program->direction_x, chains);
+    CARVE(block, &offset, program->direction_y, chains);
+    CARVE(block, &offset, program->direction_z, chains);
+    CARVE(block, &offset, program->effector_x, chains);
+    CARVE(block, &offset, program->effector_y, chains);
+    CARVE(block, &offset, program->effector_z, chains);
+    CARVE(block, &offset, program->effector_dir_x, chains);
+    CARVE(block, &offset, program->effector_dir_y, chains);
+    CARVE(block, &offset, program->effector_dir_z, chains);
+    CARVE(block, &offset, program->nodes, slots);
+    CARVE(block, &offset, program->chains, chains);
+    CARVE(block, &offset, program->islands, program->island_count);
+    CARVE(block, &offset, program->island_iterations, program->island_count);
+    CARVE(block, &offset, program->parent, slots);
+    CARVE(block, &offset, program->child_chains, chains);
+    CARVE(block, &offset, program->effector_chains, program->effector_count);
+    CARVE(block, &offset, program->group_begin, program->island_count + 1);
+    CARVE(block, &offset, program->group_islands, program->island_count);
+    CARVE(block, &offset, program->island_warm, program->island_count);
+    CARVE(block, &offset, program->island_cached, program->island_count);
+    CARVE(block, &offset, program->slot_changed, slots);
+
+    return offset;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+compile_chain_recursive(struct compile_state_t* state, const struct chain_t* chain)
+{
+    struct program_t* program = state->program;
+    struct program_chain_t* pchain;
+    uint32_t child_begin, child_count, chain_idx, first, count, i;
+
+    /*
+     * Reserve space for the indices of our child chains before recursing, so
+     * they end up next to each other in child_chains.
+     */
+    child_begin = state->child;
+    child_count = chain_child_count(chain);
+    state->child += child_count;
+
+    /* Post-order: Child chains are emitted before their parent */
+    i = 0;
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        program->child_chains[child_begin + i++] = compile_chain_recursive(state, child);
+    CHAIN_END_EACH
+
+    /* Assign slots to all nodes except for the base node, tip first */
+    first = state->slot;
+    count = chain_length(chain) - 1;
+    for (i = 0; i != count; ++i)
+    {
+        program->nodes[first + i] = chain_get_node(chain, i);
+        program->parent[first + i] = first + i + 1;
+    }
+    state->slot += count;
+
+    chain_idx = state->chain++;
+    pchain = &program->chains[chain_idx];
+    pchain->first = first;
+    pchain->count = count;
+    pchain->base = PROGRAM_NO_PARENT; /* patched by whoever owns the base node */
+    pchain->child_begin = child_begin;
+    pchain->child_count = child_count;
+
+    /* Our tip node is the base node of all of our children */
+    for (i = 0; i != child_count; ++i)
+    {
+        struct program_chain_t* child = &program->chains[program->child_chains[child_begin + i]];
+        assert(program->nodes[child->first + child->count - 1]->parent == program->nodes[first]);
+        child->base = first;
+        program->parent[child->first + child->count - 1] = first;
+    }
+
+    return chain_idx;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+group_islands_by_base(struct program_t* program)
+{
+    uint32_t island_idx, other_idx, out = 0;
+
+    /*
+     * The number of islands sharing a base node is usually 1, and islands are
+     * few, so a quadratic search is fine. An island belongs to the group of
+     * the first island with the same base node.
+     */
+    program->group_count = 0;
+    for (island_idx = 0; island_idx != program->island_count; ++island_idx)
+    {
+        const struct program_island_t* island = &program->islands[island_idx];
+        const struct ik_node_t* base = program->nodes[island->slot_begin + island->slot_count - 1];
+
+        for (other_idx = 0; other_idx != island_idx; ++other_idx)
+        {
+            const struct program_island_t* other = &program->islands[other_idx];
+            if (program->nodes[other->slot_begin + other->slot_count - 1] == base)
+                break;
+        }
+        if (other_idx != island_idx)
+            continue; /* already emitted as part of an earlier group */
+
+        program->group_begin[program->group_count++] = out;
+        program->group_islands[out++] = island_idx;
+        for (other_idx = island_idx + 1; other_idx != program->island_count; ++other_idx)
+        {
+            const struct program_island_t* other = &program->islands[other_idx];
+            if (program->nodes[other->slot_begin + other->slot_count - 1] == base)
+                program->group_islands[out++] = other_idx;
+        }
+    }
+    program->group_begin[program->group_count] = out;
+
+    assert(out == program->island_count);
+}
+
+/* ------------------------------------------------------------------------- */
+static uint64_t
+hash_u32(uint64_t hash, uint32_t value)
+{
+    /* FNV-1a, one byte at a time */
+    int i;
+    for (i = 0; i != 4; ++i)
+    {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+static uint64_t
+hash_topology(const struct program_t* program)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint32_t i;
+
+    hash = hash_u32(hash, program->slot_count);
+    hash = hash_u32(hash, program->chain_count);
+    hash = hash_u32(hash, program->island_count);
+    for (i = 0; i != program->slot_count; ++i)
+        hash = hash_u32(hash, program->parent[i]);
+    for (i = 0; i != program->chain_count; ++i)
+    {
+        const struct program_chain_t* chain = &program->chains[i];
+        uint32_t child;
+        hash = hash_u32(hash, chain->first);
+        hash = hash_u32(hash, chain->count);
+        hash = hash_u32(hash, chain->base);
+        hash = hash_u32(hash, chain->child_begin);
+        hash = hash_u32(hash, chain->child_count);
+        for (child = 0; child != chain->child_count; ++child)
+            hash = hash_u32(hash, program->child_chains[chain->child_begin + child]);
+    }
+    for (i = 0; i != program->island_count; ++i)
+    {
+        const struct program_island_t* island = &program->islands[i];
+        hash = hash_u32(hash, island->chain_begin);
+        hash = hash_u32(hash, island->chain_count);
+        hash = hash_u32(hash, island->slot_begin);
+        hash = hash_u32(hash, island->slot_count);
+    }
+
+    return hash;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+program_compile(struct program_t* program, const struct vector_t* chain_list)
+{
+    struct compile_state_t state;
+    uint32_t slots = 0, chains = 0, effectors = 0, island_idx = 0;
+    uint32_t chain_idx;
+    uintptr_t size;
+    void* block;
+
+    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
+        count_chain_recursive(chain, &slots, &chains, &effectors);
+        slots += 1; /* island base node */
+    VECTOR_END_EACH
+
+    program->slot_count = slots;
+    program->chain_count = chains;
+    program->island_count = vector_count(chain_list);
+    program->effector_count = effectors;
+
+    size = layout(program, NULL);
+    if (size == 0)
+        size = 1;
+    if (size > program->block_size)
+    {
+        if ((block = MALLOC(size)) == NULL)
+        {
+            IKAPI.log.message("Failed to allocate solve program: Ran out of memory");
+            program_destruct(program);
+            return IK_RAN_OUT_OF_MEMORY;
+        }
+        if (program->block != NULL)
+            FREE(program->block);
+        program->block = block;
+        program->block_size = size;
+    }
+    layout(program, program->block);
+
+    state.program = program;
+    state.slot = 0;
+    state.chain = 0;
+    state.child = 0;
+    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
+        struct program_island_t* island = &program->islands[island_idx++];
+        uint32_t root_idx, base_slot;
+
+        island->chain_begin = state.chain;
+        island->slot_begin = state.slot;
+
+        root_idx = compile_chain_recursive(&state, chain);
+
+        base_slot = state.slot++;
+        program->nodes[base_slot] = chain_get_base_node(chain);
+        program->parent[base_slot] = PROGRAM_NO_PARENT;
+        program->chains[root_idx].base = base_slot;
+        program->parent[base_slot - 1] = base_slot;
+
+        island->chain_count = state.chain - island->chain_begin;
+        island->slot_count = state.slot - island->slot_begin;
+    VECTOR_END_EACH
+
+    assert(state.slot == program->slot_count);
+    assert(state.chain == program->chain_count);
+
+    /* Chains are emitted island by island, so the effectors are as well */
+    effectors = 0;
+    for (island_idx = 0; island_idx != program->island_count; ++island_idx)
+    {
+        struct program_island_t* island = &program->islands[island_idx];
+        island->effector_begin = effectors;
+        for (chain_idx = island->chain_begin; chain_idx != island->chain_begin + island->chain_count; ++chain_idx)
+            if (program->chains[chain_idx].child_count == 0)
+                program->effector_chains[effectors++] = chain_idx;
+        island->effector_count = effectors - island->effector_begin;
+        program->island_iterations[island_idx] = 0;
+        program->island_residual[island_idx] = 0.0;
+        program->island_warm[island_idx] = 0;
+        program->island_cached[island_idx] = 0;
+    }
+    assert(effectors == program->effector_count);
+
+    group_islands_by_base(program);
+    program->topology = hash_topology(program);
+    program_update_segments(program);
+
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+program_update_segments(struct program_t* program)
+{
+    uint32_t slot;
+    for (slot = 0; slot != program->slot_count; ++slot)
+    {
+        const struct ik_node_t* node = program->nodes[slot];
+        program->dist[slot] = node->dist_to_parent;
+        program->rotation_weight[slot] = node->rotation_weight;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+program_gather_island_positions(struct program_t* program, uint32_t island_idx)
+{
+    const struct program_island_t* island = &program->islands[island_idx];
+    uint32_t slot, end = island->slot_begin + island->slot_count;
+    for (slot = island->slot_begin; slot != end; ++slot)
+    {
+        const struct ik_node_t* node = program->nodes[slot];
+        program->pos_x[slot] = node->position.x;
+        program->pos_y[slot] = node->position.y;
+        program->pos_z[slot] = node->position.z;
+    }
+}
+void
+program_gather_positions(struct program_t* program)
+{
+    uint32_t island_idx;
+    for (island_idx = 0; island_idx != program->island_count; ++island_idx)
+        program_gather_island_positions(program, island_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+program_gather_island_targets(struct program_t* program, uint32_t island_idx, int with_directions)
+{
+    const struct program_island_t* island = &program->islands[island_idx];
+    uint32_t chain_idx, end = island->chain_begin + island->chain_count;
+    for (chain_idx = island->chain_begin; chain_idx != end; ++chain_idx)
+    {
+        const struct ik_node_t* tip = program->nodes[program->chains[chain_idx].first];
+        const struct ik_effector_t* effector = tip->effector;
+        if (effector == NULL)
+            continue;
+
+        program->effector_x[chain_idx] = effector->_actual_target.x;
+        program->effector_y[chain_idx] = effector->_actual_target.y;
+        program->effector_z[chain_idx] = effector->_actual_target.z;
+
+        if (with_directions)
+        {
+            /* TODO This "global direction" could be made configurable if needed */
+            ik_vec3_t direction = ik_vec3_static_vec3(0, 0, 1);
+            ik_vec3_static_rotate(direction.f, effector->target_rotation.f);
+            program->effector_dir_x[chain_idx] = direction.x;
+            program->effector_dir_y[chain_idx] = direction.y;
+            program->effector_dir_z[chain_idx] = direction.z;
+        }
+    }
+}
+void
+program_gather_targets(struct program_t* program, int with_directions)
+{
+    uint32_t island_idx;
+    for (island_idx = 0; island_idx != program->island_count; ++island_idx)
+        program_gather_island_targets(program, island_idx, with_directions);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+program_scatter_island_positions(const struct program_t* program, uint32_t island_idx)
+{
+    const struct program_island_t* island = &program->islands[island_idx];
+    uint32_t slot, end = island->slot_begin + island->slot_count - 1; /* skip base */
+    for (slot = island->slot_begin; slot != end; ++slot)
+    {
+        struct ik_node_t* node = program->nodes[slot];
+        node->position.x = program->pos_x[slot];
+        node->position.y = program->pos_y[slot];
+        node->position.z = program->pos_z[slot];
+    }
+}
+void
+program_scatter_positions(const struct program_t* program)
+{
+    uint32_t island_idx;
+    for (island_idx = 0; island_idx != program->island_count; ++island_idx)
+        program_scatter_island_positions(program, island_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+to_base_space(ikreal_t v[3], const ikreal_t base_pos[3], const ikreal_t inv_base_rot[4])
+{
+    ik_vec3_static_sub_vec3(v, base_pos);
+    ik_vec3_static_rotate(v, inv_base_rot);
+}
+
+/* ------------------------------------------------------------------------- */
+int
+program_warm_start_island(struct program_t* program, uint32_t island_idx,
+                          ikreal_t blend, ikreal_t threshold)
+{
+    const struct program_island_t* island = &program->islands[island_idx];
+    uint32_t base = island->slot_begin + island->slot_count - 1;
+    uint32_t effector, effector_end = island->effector_begin + island->effector_count;
+    const ikreal_t* base_rot = program->nodes[base]->rotation.f;
+    ikreal_t base_pos[3], inv_base_rot[4];
+    uint32_t slot;
+
+    if (program->island_warm[island_idx] == 0)
+        return 0;
+
+    base_pos[0] = program->pos_x[base];
+    base_pos[1] = program->pos_y[base];
+    base_pos[2] = program->pos_z[base];
+    ik_quat_static_set(inv_base_rot, base_rot);
+    ik_quat_static_conj(inv_base_rot);
+
+    /* The previous solution is of no use if a target jumped */
+    for (effector = island->effector_begin; effector != effector_end; ++effector)
+    {
+        uint32_t chain_idx = program->effector_chains[effector];
+        ik_vec3_t target = ik_vec3_static_vec3(
+            program->effector_x[chain_idx],
+            program->effector_y[chain_idx],
+            program->effector_z[chain_idx]);
+        to_base_space(target.f, base_pos, inv_base_rot);
+        target.x -= program->warm_target_x[chain_idx];
+        target.y -= program->warm_target_y[chain_idx];
+        target.z -= program->warm_target_z[chain_idx];
+        if (ik_vec3_static_length_squared(target.f) > threshold * threshold)
+            return 0;
+    }
+
+    for (slot = island->slot_begin; slot != base; ++slot)
+    {
+        ik_vec3_t seed = ik_vec3_static_vec3(program->warm_x[slot], program->warm_y[slot], program->warm_z[slot]);
+        ik_vec3_static_rotate(seed.f, base_rot);
+        ik_vec3_static_add_vec3(seed.f, base_pos);
+        program->pos_x[slot] = seed.x + (program->pos_x[slot] - seed.x) * blend;
+        program->pos_y[slot] = seed.y + (program->pos_y[slot] - seed.y) * blend;
+        program->pos_z[slot] = seed.z + (program->pos_z[slot] - seed.z) * blend;
+    }
+
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+program_store_warm_start_island(struct program_t* program, uint32_t island_idx)
+{
+    const struct program_island_t* island = &program->islands[island_idx];
+    uint32_t base = island->slot_begin + island->slot_count - 1;
+    uint32_t effector, effector_end = island->effector_begin + island->effector_count;
+    ikreal_t base_pos[3], inv_base_rot[4];
+    uint32_t slot;
+
+    base_pos[0] = program->pos_x[base];
+    base_pos[1] = program->pos_y[base];
+    base_pos[2] = program->pos_z[base];
+    ik_quat_static_set(inv_base_rot, program->nodes[base]->rotation.f);
+    ik_quat_static_conj(inv_base_rot);
+
+    for (slot = island->slot_begin; slot != base; ++slot)
+    {
+        ik_vec3_t pos = ik_vec3_static_vec3(program->pos_x[slot], program->pos_y[slot], program->pos_z[slot]);
+        to_base_space(pos.f, base_pos, inv_base_rot);
+        program->warm_x[slot] = pos.x;
+        program->warm_y[slot] = pos.y;
+        program->warm_z[slot] = pos.z;
+    }
+    for (effector = island->effector_begin; effector != effector_end; ++effector)
+    {
+        uint32_t chain_idx = program->effector_chains[effector];
+        ik_vec3_t target = ik_vec3_static_vec3(
+            program->effector_x[chain_idx],
+            program->effector_y[chain_idx],
+            program->effector_z[chain_idx]);
+        to_base_space(target.f, base_pos, inv_base_rot);
+        program->warm_target_x[chain_idx] = target.x;
+        program->warm_target_y[chain_idx] = target.y;
+        program->warm_target_z[chain_idx] = target.z;
+    }
+
+    program->island_warm[island_idx] = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+ikreal_t
+program_island_residual(const struct program_t* program, uint32_t island_idx)
+{
+    ikreal_t dx[BATCH_BLOCK], dy[BATCH_BLOCK], dz[BATCH_BLOCK], dist[BATCH_BLOCK];
+    const struct batch_kernels_t* batch = batch_kernels();
+    const struct program_island_t* island = &program->islands[island_idx];
+    uint32_t effector = island->effector_begin;
+    uint32_t end = island->effector_begin + island->effector_count;
+    ikreal_t residual = 0.0;
+
+    while (effector != end)
+    {
+        uint32_t i, count = end - effector < BATCH_BLOCK ? end - effector : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            uint32_t chain_idx = program->effector_chains[effector + i];
+            uint32_t tip = program->chains[chain_idx].first;
+            dx[i] = program->pos_x[tip] - program->effector_x[chain_idx];
+            dy[i] = program->pos_y[tip] - program->effector_y[chain_idx];
+            dz[i] = program->pos_z[tip] - program->effector_z[chain_idx];
+        }
+
+        batch->length(dist, dx, dy, dz, count);
+        for (i = 0; i != count; ++i)
+            if (dist[i] > residual)
+                residual = dist[i];
+
+        effector += count;
+    }
+
+    return residual;
+}
@@ -3,6 +3,13 @@
 #include "ik/ik.h"
 #include <stddef.h>
 
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_node_FABRIK_type_size(void)
+{
+    return sizeof(struct ik_node_FABRIK_t);
+}
+
 /* ------------------------------------------------------------------------- */
 struct ik_node_t*
 ik_node_FABRIK_create(uint32_t guid)
@@ -1,10 +1,13 @@
 #include "ik/solver_FABRIK.h"
+#include "ik/batch.h"
 #include "ik/bstv.h"
 #include "ik/chain.h"
 #include "ik/ik.h"
 #include "ik/memory.h"
 #include "ik/node_FABRIK.h"
+#include "ik/program.h"
 #include "ik/quat_static.h"
+#include "ik/thread_pool_static.h"
 #include "ik/transform.h"
 #include "ik/vec3_static.h"
 #include <assert.h>
@@ -12,416 +15,366 @@
 #include <stdio.h>
 #include <math.h>
 
-struct position_direction_t
-{
-    union {
-        struct {
-            ik_vec3_t position;
-            ik_vec3_t direction;
-        };
-        ikreal_t f[6];
-    };
-};
-
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_solver_FABRIK_type_size(void)
 {
-    return sizeof(struct ik_solver_t);
+    return sizeof(struct ik_solver_FABRIK_t);
 }
 
 /* ------------------------------------------------------------------------- */
-static struct position_direction_t
-solve_chain_forwards_with_target_rotation(struct chain_t* chain)
+static void
+normalize_and_scale(ikreal_t* x, ikreal_t* y, ikreal_t* z, ikreal_t scale)
 {
-    int node_count, node_idx;
-    int average_count;
-    struct position_direction_t target;
-
-    /*
-     * Target position (and direction) is the average of all solved child chain base positions.
-     */
-    ik_vec3_static_set_zero(target.position.f);
-    ik_vec3_static_set_zero(target.direction.f);
-    average_count = 0;
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        struct position_direction_t child_posdir = solve_chain_forwards_with_target_rotation(child);
-        ik_vec3_static_add_vec3(target.position.f, child_posdir.position.f);
-        ik_vec3_static_add_vec3(target.direction.f, child_posdir.direction.f);
-        ++average_count;
-    CHAIN_END_EACH
-
-    /*
-     * If there are no child chains, then the first node in the chain must
-     * contain an effector. The target position is the effector's target
-     * position.
-     *
-     * If we are an intermediate chain, then our target position is not the
-     * effector's target position (there is no effector), instead, it is the
-     * average position of all of child chains.
-     */
-    if (average_count == 0)
+    /* Same semantics as ik_vec3_static_normalize() followed by a mul_scalar() */
+    ikreal_t length = sqrt(*x * *x + *y * *y + *z * *z);
+    if (length != 0.0)
     {
-        struct ik_node_t* effector_node = chain_get_node(chain, 0);
-        struct ik_effector_t* effector = effector_node->effector;
-        target.position = effector->_actual_target;
-
-        /* TODO This "global direction" could be made configurable if needed */
-        target.direction.x = 0.0;
-        target.direction.y = 0.0;
-        target.direction.z = 1.0;
-        ik_vec3_static_rotate(target.direction.f, effector->target_rotation.f);
+        length = 1.0 / length;
+        *x *= length;
+        *y *= length;
+        *z *= length;
     }
     else
     {
-        ik_vec3_static_div_scalar(target.position.f, average_count);
-        ik_vec3_static_normalize(target.direction.f);
+        *x = 1;
     }
-
-    /*
-     * Iterate through each segment and apply the FABRIK algorithm.
-     */
-    node_count = chain_length(chain);
-    for (node_idx = 0; node_idx < node_count - 1; ++node_idx)
-    {
-        struct ik_node_t* child_node  = chain_get_node(chain, node_idx + 0);
-        struct ik_node_t* parent_node = chain_get_node(chain, node_idx + 1);
-
-        /* move node to target */
-        child_node->position = target.position;
-
-        /* lerp between direction vector and segment vector */
-        ik_vec3_static_sub_vec3(target.position.f, parent_node->position.f);        /* segment vector */
-        ik_vec3_static_normalize(target.position.f);                                /* normalizeso we have segment direction vector */
-        ik_vec3_static_sub_vec3(target.position.f, target.direction.f);             /* for lerp, subtract target direction... */
-        ik_vec3_static_mul_scalar(target.position.f, parent_node->rotation_weight); /* ...mul with weight... */
-        ik_vec3_static_add_vec3(target.position.f, parent_node->position.f);        /* ...and attach this lerp'd direction to the parent node */
-
-        /* point segment to previous node */
-        ik_vec3_static_sub_vec3(target.position.f, child_node->position.f);         /* this computes the correct direction the segment should have */
-        ik_vec3_static_normalize(target.position.f);
-        ik_vec3_static_mul_scalar(target.position.f, child_node->dist_to_parent);
-        ik_vec3_static_add_vec3(target.position.f, child_node->position.f);         /* attach to child -- this is the new target for the next segment */
-    }
-
-    return target;
+    *x *= scale;
+    *y *= scale;
+    *z *= scale;
 }
 
 /* ------------------------------------------------------------------------- */
-ik_vec3_t
-solve_chain_forwards_with_constraints(struct chain_t* chain)
+static void
+solve_island_forwards_with_target_rotation(struct program_t* p,
+                                           const struct program_island_t* island)
 {
-    int node_count, node_idx;
-    int average_count;
-    ik_vec3_t target_position;
+    uint32_t chain_idx;
+    uint32_t chain_end = island->chain_begin + island->chain_count;
 
     /*
-     * Target position is the average of all solved child chain base positions.
+     * Chains are stored in post-order, so all child chains have already
+     * written their results into the target arrays by the time we get to
+     * their parent chain.
      */
-    ik_vec3_static_set_zero(target_position.f);
-    average_count = 0;
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        ik_vec3_t child_base_position = solve_chain_forwards_with_constraints(child);
-        ik_vec3_static_add_vec3(target_position.f, child_base_position.f);
-        ++average_count;
-    CHAIN_END_EACH
-
-    /*
-     * If there are no child chains, then the first node in the chain must
-     * contain an effector. The target position is the effector's target
-     * position.
-     *
-     * If we are an intermediate chain, then our target position is not the
-     * effector's target position (there is no effector), instead, it is the
-     * average position of all of child chains.
-     */
-    if (average_count == 0)
+    for (chain_idx = island->chain_begin; chain_idx != chain_end; ++chain_idx)
     {
-        struct ik_node_FABRIK_t* effector_node = (struct ik_node_FABRIK_t*)chain_get_node(chain, 0);
-        struct ik_effector_t* effector = effector_node->effector;
-        target_position = effector->_actual_target;
-    }
-    else
-    {
-        ik_vec3_static_div_scalar(target_position.f, average_count);
-    }
-
-    /*
-     * Iterate through each segment and apply the FABRIK algorithm.
-     */
-    node_count = chain_length(chain);
-    for (node_idx = 0; node_idx < node_count - 1; ++node_idx)
-    {
-        ik_vec3_t initial_segment;
-        struct ik_node_FABRIK_t* child_node  = (struct ik_node_FABRIK_t*)chain_get_node(chain, node_idx + 0);
-        struct ik_node_FABRIK_t* parent_node = (struct ik_node_FABRIK_t*)chain_get_node(chain, node_idx + 1);
+        const struct program_chain_t* chain = &p->chains[chain_idx];
+        uint32_t slot, slot_end;
+        ikreal_t tx, ty, tz;
+        ikreal_t dx, dy, dz;
 
         /*
-         * Need the initial (unsolved) segment so we can calculate joint
-         * rotation for constraints.
+         * If there are no child chains, then the first node in the chain must
+         * contain an effector. The target position is the effector's target
+         * position.
+         *
+         * If we are an intermediate chain, then our target position is not the
+         * effector's target position (there is no effector), instead, it is the
+         * average position of all of child chains.
          */
-        ik_vec3_static_set(initial_segment.f, child_node->initial_position.f);
-        ik_vec3_static_sub_vec3(initial_segment.f, parent_node->initial_position.f);
-        ik_vec3_static_normalize(initial_segment.f);
-
-        /* move node to target */
-        child_node->position = target_position;
+        if (chain->child_count == 0)
+        {
+            tx = p->effector_x[chain_idx];
+            ty = p->effector_y[chain_idx];
+            tz = p->effector_z[chain_idx];
+            dx = p->effector_dir_x[chain_idx];
+            dy = p->effector_dir_y[chain_idx];
+            dz = p->effector_dir_z[chain_idx];
+        }
+        else
+        {
+            uint32_t i;
+            ikreal_t det = 1.0 / chain->child_count;
+            tx = ty = tz = 0.0;
+            dx = dy = dz = 0.0;
+            for (i = 0; i != chain->child_count; ++i)
+            {
+                uint32_t child_idx = p->child_chains[chain->child_begin + i];
+                tx += p->target_x[child_idx];
+                ty += p->target_y[child_idx];
+                tz += p->target_z[child_idx];
+                dx += p->direction_x[child_idx];
+                dy += p->direction_y[child_idx];
+                dz += p->direction_z[child_idx];
+            }
+            tx *= det; ty *= det; tz *= det;
+            normalize_and_scale(&dx, &dy, &dz, 1.0);
+        }
 
         /*
-         * target_position will be a directional vector pointing from the new
-         * target position to the previous node,
+         * Iterate through each segment and apply the FABRIK algorithm.
          */
-        ik_vec3_static_sub_vec3(target_position.f, parent_node->position.f);        /* parent points to child */
-        ik_vec3_static_normalize(target_position.f);                                /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* child points to parent */
-        ik_vec3_static_add_vec3(target_position.f, child_node->position.f);         /* attach to child -- this is the new target for the next segment */
-
-        /* Calculate global rotation of parent node *
-        segment_original = child_node->initial_position;
-        segment_current  = child_node->position;
-        ik_vec3_static_sub_vec3(segment_original.f, parent_node->initial_position.f);
-        ik_vec3_static_sub_vec3(segment_current.f, target_position.f);
-        ik_vec3_static_angle(parent_node->rotation.f, segment_original.f, segment_current.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, parent_node->initial_rotation.f);
-
-        * Convert global transform to local *
-        inv_rotation = accumulated.rotation;
-        ik_quat_static_conj(inv_rotation.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, inv_rotation.f);
-        ik_vec3_static_sub_vec3(parent_node->position.f, accumulated.position.f);
-        ik_quat_static_rotate_vec(parent_node->position.f, inv_rotation.f);
-
-        if (child_node->constraint != NULL)
-            child_node->constraint->apply(parent_node);
-
-        * Accumulate local rotation and translation for deeper nodes *after*
-         * constraint was applied *
-        accumulated_previous = accumulated;
-        ik_quat_static_mul_quat(accumulated.rotation.f, parent_node->rotation.f);
-        ik_vec3_static_add_vec3(accumulated.position.f, parent_node->position.f);
-
-        * Convert local transform back to global *
-        ik_quat_static_rotate_vec(parent_node->position.f, accumulated_previous.rotation.f);
-        ik_vec3_static_add_vec3(parent_node->position.f, accumulated_previous.position.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, accumulated_previous.rotation.f);
-
-        if (child_node->constraint != NULL)
+        slot_end = chain->first + chain->count;
+        for (slot = chain->first; slot != slot_end; ++slot)
         {
-            * XXX combine this? *
-            inv_rotation = parent_node->initial_rotation;
-            ik_quat_static_conj(inv_rotation.f);
-            ik_quat_static_mul_quat(parent_node->rotation.f, inv_rotation.f);
-
-            target_position = parent_node->position;
-            ik_quat_static_rotate_vec(segment_original.f, parent_node->rotation.f);
-            ik_vec3_static_add_vec3(target_position.f, segment_original.f);
-        }*/
+            uint32_t parent = p->parent[slot];
+
+            /* move node to target */
+            p->pos_x[slot] = tx;
+            p->pos_y[slot] = ty;
+            p->pos_z[slot] = tz;
+
+            /* lerp between direction vector and segment vector */
+            tx -= p->pos_x[parent];
+            ty -= p->pos_y[parent];
+            tz -= p->pos_z[parent];
+            normalize_and_scale(&tx, &ty, &tz, 1.0);
+            tx = (tx - dx) * p->rotation_weight[parent] + p->pos_x[parent];
+            ty = (ty - dy) * p->rotation_weight[parent] + p->pos_y[parent];
+            tz = (tz - dz) * p->rotation_weight[parent] + p->pos_z[parent];
+
+            /* point segment to previous node */
+            tx -= p->pos_x[slot];
+            ty -= p->pos_y[slot];
+            tz -= p->pos_z[slot];
+            normalize_and_scale(&tx, &ty, &tz, p->dist[slot]);
+            tx += p->pos_x[slot];
+            ty += p->pos_y[slot];
+            tz += p->pos_z[slot];
+        }
+
+        p->target_x[chain_idx] = tx;
+        p->target_y[chain_idx] = ty;
+        p->target_z[chain_idx] = tz;
+        p->direction_x[chain_idx] = dx;
+        p->direction_y[chain_idx] = dy;
+        p->direction_z[chain_idx] = dz;
     }
-
-    return target_position;
 }
 
 /* ------------------------------------------------------------------------- */
-static ik_vec3_t
-solve_chain_forwards(struct chain_t* chain)
+static void
+solve_island_forwards(struct program_t* p, const struct program_island_t* island)
 {
-    int node_count, node_idx;
-    int average_count;
-    ik_vec3_t target_position;
-
-    /*
-     * Target position is the average of all solved child chain base positions.
-     */
-    ik_vec3_static_set_zero(target_position.f);
-    average_count = 0;
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        ik_vec3_t child_base_position = solve_chain_forwards(child);
-        ik_vec3_static_add_vec3(target_position.f, child_base_position.f);
-        ++average_count;
-    CHAIN_END_EACH
+    uint32_t chain_idx;
+    uint32_t chain_end = island->chain_begin + island->chain_count;
 
-    /*
-     * If there are no child chains, then the first node in the chain must
-     * contain an effector. The target position is the effector's target
-     * position. Otherwise, average the data we've been accumulating from the
-     * child chains.
-     */
-    if (average_count == 0)
-    {
-        struct ik_node_t* effector_node = chain_get_node(chain, 0);
-        struct ik_effector_t* effector = effector_node->effector;
-        target_position = effector->_actual_target;
-    }
-    else
+    for (chain_idx = island->chain_begin; chain_idx != chain_end; ++chain_idx)
     {
-        ik_vec3_static_div_scalar(target_position.f, average_count);
-    }
+        const struct program_chain_t* chain = &p->chains[chain_idx];
+        uint32_t slot, slot_end;
+        ikreal_t tx, ty, tz;
 
-    /*
-     * Iterate through each segment and apply the FABRIK algorithm.
-     */
-    node_count = chain_length(chain);
-    for (node_idx = 0; node_idx < node_count - 1; ++node_idx)
-    {
-        struct ik_node_t* child_node  = chain_get_node(chain, node_idx + 0);
-        struct ik_node_t* parent_node = chain_get_node(chain, node_idx + 1);
-
-        /* move node to target */
-        child_node->position = target_position;
+        /*
+         * If there are no child chains, then the first node in the chain must
+         * contain an effector. The target position is the effector's target
+         * position. Otherwise, average the data the child chains left behind.
+         */
+        if (chain->child_count == 0)
+        {
+            tx = p->effector_x[chain_idx];
+            ty = p->effector_y[chain_idx];
+            tz = p->effector_z[chain_idx];
+        }
+        else
+        {
+            uint32_t i;
+            ikreal_t det = 1.0 / chain->child_count;
+            tx = ty = tz = 0.0;
+            for (i = 0; i != chain->child_count; ++i)
+            {
+                uint32_t child_idx = p->child_chains[chain->child_begin + i];
+                tx += p->target_x[child_idx];
+                ty += p->target_y[child_idx];
+                tz += p->target_z[child_idx];
+            }
+            tx *= det; ty *= det; tz *= det;
+        }
 
-        /* point segment to previous node and set target position to its end */
-        ik_vec3_static_sub_vec3(target_position.f, parent_node->position.f);        /* parent points to child */
-        ik_vec3_static_normalize(target_position.f);                                /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* child points to parent */
-        ik_vec3_static_add_vec3(target_position.f, child_node->position.f);         /* attach to child -- this is the new target for next iteration */
+        /*
+         * Iterate through each segment and apply the FABRIK algorithm.
+         */
+        slot_end = chain->first + chain->count;
+        for (slot = chain->first; slot != slot_end; ++slot)
+        {
+            uint32_t parent = p->parent[slot];
+
+            /* move node to target */
+            p->pos_x[slot] = tx;
+            p->pos_y[slot] = ty;
+            p->pos_z[slot] = tz;
+
+            /* point segment to previous node and set target position to its end */
+            tx -= p->pos_x[parent];                                 /* parent points to child */
+            ty -= p->pos_y[parent];
+            tz -= p->pos_z[parent];
+            normalize_and_scale(&tx, &ty, &tz, -p->dist[slot]);     /* child points to parent */
+            tx += p->pos_x[slot];                                   /* attach to child -- this is the new target */
+            ty += p->pos_y[slot];
+            tz += p->pos_z[slot];
+        }
+
+        p->target_x[chain_idx] = tx;
+        p->target_y[chain_idx] = ty;
+        p->target_z[chain_idx] = tz;
     }
-
-    return target_position;
 }
 
 /* ------------------------------------------------------------------------- */
 static void
-solve_chain_backwards_with_constraints(struct chain_t* chain,
-                                       ik_vec3_t target_position,
-                                       ik_quat_t acc_rot, ik_vec3_t acc_pos)
+solve_island_backwards(struct program_t* p, const struct program_island_t* island)
 {
-    int node_idx = chain_length(chain) - 1;
-
     /*
-     * The base node must be set to the target position before iterating.
-     * XXX: Why is this conditional?
+     * Iterate the chains (and the nodes in each chain) the other way around,
+     * starting at the base and moving down to the tips. Every node's parent
+     * has been placed by the time we get to it. The island base itself is
+     * never moved.
      */
-    if (node_idx > 1)
+    uint32_t chain_idx = island->chain_begin + island->chain_count;
+    while (chain_idx-- > island->chain_begin)
     {
-        struct ik_node_t* base_node = chain_get_node(chain, node_idx);
-        base_node->position = target_position;
+        const struct program_chain_t* chain = &p->chains[chain_idx];
+        uint32_t slot = chain->first + chain->count;
+        while (slot-- > chain->first)
+        {
+            uint32_t parent = p->parent[slot];
+            ikreal_t tx = p->pos_x[parent] - p->pos_x[slot];        /* child points to parent */
+            ikreal_t ty = p->pos_y[parent] - p->pos_y[slot];
+            ikreal_t tz = p->pos_z[parent] - p->pos_z[slot];
+            normalize_and_scale(&tx, &ty, &tz, -p->dist[slot]);     /* parent points to child */
+            p->pos_x[slot] = tx + p->pos_x[parent];                 /* attach to parent */
+            p->pos_y[slot] = ty + p->pos_y[parent];
+            p->pos_z[slot] = tz + p->pos_z[parent];
+        }
     }
+}
 
-    /*
-     * Iterate through each segment the other way around and apply the FABRIK
-     * algorithm (starting at the base and moving down to the tip).
-     */
-    while (node_idx-- > 0)
+/* ------------------------------------------------------------------------- */
+/*
+ * Same as solve_island_backwards(), but also does the work of
+ * ik_transform_island_from_cache() in the same sweep. The segment computed
+ * for each node already is its position relative to its parent, it only has
+ * to be rotated into the parent's space. Accumulated rotations don't change
+ * when solving, so the rotations can be batched.
+ */
+static void
+solve_island_backwards_to_local(struct program_t* p, const struct program_island_t* island)
+{
+    const struct batch_kernels_t* batch = batch_kernels();
+    uint32_t slots[BATCH_BLOCK];
+    ikreal_t tx[BATCH_BLOCK], ty[BATCH_BLOCK], tz[BATCH_BLOCK];
+    ikreal_t qx[BATCH_BLOCK], qy[BATCH_BLOCK], qz[BATCH_BLOCK], qw[BATCH_BLOCK];
+    uint32_t slot = island->slot_begin + island->slot_count - 1;
+
+    /* Slots in descending order visit the chains in the same order as above */
+    while (slot != island->slot_begin)
     {
-        struct ik_node_t* child_node  = chain_get_node(chain, node_idx + 0);
-        struct ik_node_t* parent_node = chain_get_node(chain, node_idx + 1);
-
-        /* point segment to child node and set target position to its beginning */
-        ik_vec3_static_sub_vec3(target_position.f, child_node->position.f);         /* child points to parent */
-        ik_vec3_static_normalize(target_position.f);                                /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);  /* parent points to child */
-        ik_vec3_static_add_vec3(target_position.f, parent_node->position.f);        /* attach to parent -- this is the new target */
-
-        /* target_position is now where the position of child_node should be. */
-
-        /* Calculate delta rotation of parent node *
-        segment_original = child_node->initial_position;
-        segment_current  = target_position;
-        ik_vec3_static_sub_vec3(segment_original.f, parent_node->initial_position.f);
-        ik_vec3_static_sub_vec3(segment_current.f, parent_node->position.f);
-        ik_vec3_static_angle(parent_node->rotation.f, segment_original.f, segment_current.f);
-
-        *
-         * Since the initial rotation is in local space temporarily (see
-         * solve() entry point on why), we now have the rotation in local space
-         *
-        ik_quat_static_mul_quat(parent_node->rotation.f, parent_node->initial_rotation.f);
-
-        * Convert global translation to local *
-        inv_rotation = accumulated_positions.rotation;
-        ik_quat_static_conj(inv_rotation.f);
-        ik_vec3_static_sub_vec3(parent_node->position.f, accumulated_positions.position.f);
-        ik_quat_static_rotate_vec(parent_node->position.f, inv_rotation.f);
+        int i, count = slot - island->slot_begin < BATCH_BLOCK ?
+            (int)(slot - island->slot_begin) : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            uint32_t parent = p->parent[--slot];
+            const ikreal_t* parent_acc = &p->transform[(uintptr_t)parent * 7];
+            ikreal_t* acc = &p->transform[(uintptr_t)slot * 7];
+            tx[i] = p->pos_x[parent] - p->pos_x[slot];
+            ty[i] = p->pos_y[parent] - p->pos_y[slot];
+            tz[i] = p->pos_z[parent] - p->pos_z[slot];
+            normalize_and_scale(&tx[i], &ty[i], &tz[i], -p->dist[slot]);
+            acc[4] = p->pos_x[slot] = tx[i] + p->pos_x[parent];
+            acc[5] = p->pos_y[slot] = ty[i] + p->pos_y[parent];
+            acc[6] = p->pos_z[slot] = tz[i] + p->pos_z[parent];
+
+            /* Rotate by the inverse of the parent's accumulated rotation */
+            slots[i] = slot;
+            qx[i] = -parent_acc[0];
+            qy[i] = -parent_acc[1];
+            qz[i] = -parent_acc[2];
+            qw[i] = parent_acc[3];
+        }
+
+        batch->rotate(tx, ty, tz, qx, qy, qz, qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = p->nodes[slots[i]];
+            ikreal_t* local = &p->local[(uintptr_t)slots[i] * 7];
+            node->position.x = local[4] = tx[i];
+            node->position.y = local[5] = ty[i];
+            node->position.z = local[6] = tz[i];
+        }
+    }
+}
 
-        if (child_node->constraint != NULL)
-            child_node->constraint->apply(parent_node);
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_construct(struct ik_solver_t* solver)
+{
+    struct ik_solver_FABRIK_t* fabrik = (struct ik_solver_FABRIK_t*)solver;
 
-        * Accumulate local rotation and translation for deeper nodes *after*
-         * constraint was applied *
-        accumulated_previous = accumulated_positions;
-        ik_vec3_static_add_vec3(accumulated_positions.position.f, parent_node->position.f);
+    /* typical default values */
+    solver->max_iterations = 20;
+    solver->tolerance = 1e-3;
 
-        * Convert local transform back to global *
-        ik_quat_static_rotate_vec(parent_node->position.f, accumulated_previous.rotation.f);
-        ik_vec3_static_add_vec3(parent_node->position.f, accumulated_previous.position.f);
-        ik_quat_static_mul_quat(parent_node->rotation.f, accumulated_previous.rotation.f);
+    program_construct(&fabrik->program);
+    arena_construct(&fabrik->arena);
+    fabrik->compiled_topology = 0;
+    fabrik->lanes_block = NULL;
 
-        if (child_node->constraint != NULL)
-        {
-            * XXX combine this? *
-            inv_rotation = parent_node->initial_rotation;
-            ik_quat_static_conj(inv_rotation.f);
-            ik_quat_static_mul_quat(parent_node->rotation.f, inv_rotation.f);
-
-            target_position = parent_node->position;
-            ik_quat_static_rotate_vec(segment_original.f, parent_node->rotation.f);
-            ik_vec3_static_add_vec3(target_position.f, segment_original.f);
-        }*/
-
-        /* move node to target */
-        child_node->position = target_position;
-    }
+    return IK_OK;
+}
 
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        solve_chain_backwards_with_constraints(child, target_position, acc_rot, acc_pos);
-    CHAIN_END_EACH
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_FABRIK_destruct(struct ik_solver_t* solver)
+{
+    struct ik_solver_FABRIK_t* fabrik = (struct ik_solver_FABRIK_t*)solver;
+    program_destruct(&fabrik->program);
+    arena_destruct(&fabrik->arena);
+    fabrik->lanes_block = NULL;
 }
 
 /* ------------------------------------------------------------------------- */
-static void
-solve_chain_backwards(struct chain_t* chain, ik_vec3_t target_position)
+static uintptr_t
+lanes_size(const struct program_t* program);
+ikret_t
+ik_solver_FABRIK_rebuild(struct ik_solver_t* solver)
 {
-    int node_idx = chain_length(chain) - 1;
+    struct ik_solver_FABRIK_t* fabrik = (struct ik_solver_FABRIK_t*)solver;
+    ikret_t result;
 
     /*
-     * The base node must be set to the target position before iterating.
-     * XXX: Why is this conditional?
+     * The base implementation didn't change any chains, so the program (and
+     * any warm start data it holds) is still valid.
      */
-    if (node_idx > 1)
+    if (solver->tree != NULL &&
+        fabrik->program.block != NULL &&
+        fabrik->compiled_topology == solver->topology)
     {
-        struct ik_node_t* base_node = chain_get_node(chain, node_idx);
-        base_node->position = target_position;
+        program_update_segments(&fabrik->program);
+        return arena_reserve(&fabrik->arena, 0);
     }
 
+    fabrik->lanes_block = NULL;
+
     /*
-     * Iterate through each segment the other way around and apply the FABRIK
-     * algorithm.
+     * The chain list is stale if the base implementation bailed out early, so
+     * don't hold on to any node references.
      */
-    while (node_idx-- > 0)
+    if (solver->tree == NULL)
     {
-        struct ik_node_t* child_node  = chain_get_node(chain, node_idx + 0);
-        struct ik_node_t* parent_node = chain_get_node(chain, node_idx + 1);
-
-        /* point segment to child node and set target position to its beginning */
-        ik_vec3_static_sub_vec3(target_position.f, child_node->position.f); /* child points to parent */
-        ik_vec3_static_normalize(target_position.f);                                  /* normalise */
-        ik_vec3_static_mul_scalar(target_position.f, -child_node->dist_to_parent);    /* parent points to child */
-        ik_vec3_static_add_vec3(target_position.f, parent_node->position.f);/* attach to parent -- this is the new target */
-
-        /* move node to target */
-        child_node->position = target_position;
+        program_destruct(&fabrik->program);
+        return IK_SOLVER_HAS_NO_TREE;
     }
 
-    CHAIN_FOR_EACH_CHILD(chain, child)
-        solve_chain_backwards(child, target_position);
-    CHAIN_END_EACH
-}
+    if ((result = program_compile(&fabrik->program, &solver->chain_list)) != IK_OK)
+        return result;
+    fabrik->compiled_topology = solver->topology;
 
-/* ------------------------------------------------------------------------- */
-ikret_t
-ik_solver_FABRIK_construct(struct ik_solver_t* solver)
-{
-    /* typical default values */
-    solver->max_iterations = 20;
-    solver->tolerance = 1e-3;
-
-    return IK_OK;
+    /*
+     * Solvers that led a group of lanes before will most likely do so again,
+     * so make room for the new program's lanes now instead of in solve_lanes().
+     */
+    return arena_reserve(&fabrik->arena,
+                         fabrik->arena.capacity != 0 ? lanes_size(&fabrik->program) : 0);
 }
 
 /* ------------------------------------------------------------------------- */
 void
-ik_solver_FABRIK_destruct(struct ik_solver_t* solver)
+ik_solver_FABRIK_update_distances(struct ik_solver_t* solver)
 {
+    struct ik_solver_FABRIK_t* fabrik = (struct ik_solver_FABRIK_t*)solver;
+    program_update_segments(&fabrik->program);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -438,13 +391,6 @@ store_initial_transform_for_chain(struct chain_t* chain)
         store_initial_transform_for_chain(child);
     CHAIN_END_EACH
 }
-static void
-store_initial_transform(const struct vector_t* chain_list)
-{
-    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        store_initial_transform_for_chain(chain);
-    VECTOR_END_EACH
-}
 
 /* ------------------------------------------------------------------------- */
 static void
@@ -491,20 +437,103 @@ calculate_delta_rotation_of_each_segment(struct chain_t* chain)
 {
     /*
      * Calculate all of the delta rotations of the joints and store them into
-     * node->rotation.
+     * node->rotation. Same as calling ik_quat_static_angle() for each segment,
+     * except the lengths and axes are computed for a block of segments at a
+     * time.
      */
+    ikreal_t ox[BATCH_BLOCK], oy[BATCH_BLOCK], oz[BATCH_BLOCK], olen[BATCH_BLOCK];
+    ikreal_t sx[BATCH_BLOCK], sy[BATCH_BLOCK], sz[BATCH_BLOCK], slen[BATCH_BLOCK];
+    ikreal_t ax[BATCH_BLOCK], ay[BATCH_BLOCK], az[BATCH_BLOCK];
+    const struct batch_kernels_t* batch = batch_kernels();
     int node_idx = chain_length(chain) - 1;
-    while (node_idx-- > 0)
+
+    while (node_idx > 0)
     {
-        struct ik_node_FABRIK_t* child_node  = (struct ik_node_FABRIK_t*)chain_get_node(chain, node_idx + 0);
-        struct ik_node_FABRIK_t* parent_node = (struct ik_node_FABRIK_t*)chain_get_node(chain, node_idx + 1);
-
-        /* calculate vectors for original and solved segments */
-        ik_vec3_t segment_original = child_node->initial_position;
-        ik_vec3_t segment_solved   = child_node->position;
-        ik_vec3_static_sub_vec3(segment_original.f, parent_node->initial_position.f);
-        ik_vec3_static_sub_vec3(segment_solved.f, parent_node->position.f);
-        ik_quat_static_angle(parent_node->rotation.f, segment_original.f, segment_solved.f);
+        int i, count = node_idx < BATCH_BLOCK ? node_idx : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            const struct ik_node_FABRIK_t* child_node  = (struct ik_node_FABRIK_t*)chain_get_node(chain, node_idx - i - 1);
+            const struct ik_node_FABRIK_t* parent_node = (struct ik_node_FABRIK_t*)chain_get_node(chain, node_idx - i);
+
+            /* calculate vectors for original and solved segments */
+            ox[i] = child_node->initial_position.x - parent_node->initial_position.x;
+            oy[i] = child_node->initial_position.y - parent_node->initial_position.y;
+            oz[i] = child_node->initial_position.z - parent_node->initial_position.z;
+            sx[i] = child_node->position.x - parent_node->position.x;
+            sy[i] = child_node->position.y - parent_node->position.y;
+            sz[i] = child_node->position.z - parent_node->position.z;
+
+            /* axis of rotation */
+            ax[i] = oy[i] * sz[i] - oz[i] * sy[i];
+            ay[i] = oz[i] * sx[i] - ox[i] * sz[i];
+            az[i] = ox[i] * sy[i] - oy[i] * sx[i];
+        }
+
+        batch->length(olen, ox, oy, oz, count);
+        batch->length(slen, sx, sy, sz, count);
+        batch->normalize(ax, ay, az, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* parent_node = chain_get_node(chain, node_idx - i);
+            ikreal_t cos_a = (ox[i]*sx[i] + oy[i]*sy[i] + oz[i]*sz[i]) * (1.0 / olen[i] / slen[i]);
+            if (cos_a >= -1.0 && cos_a <= 1.0)
+            {
+                /* quaternion's vector needs to be weighted with sin_a */
+                ikreal_t angle = acos(cos_a);
+                ikreal_t sin_a = sin(angle * 0.5);
+                parent_node->rotation.x = ax[i] * sin_a;
+                parent_node->rotation.y = ay[i] * sin_a;
+                parent_node->rotation.z = az[i] * sin_a;
+                parent_node->rotation.w = cos(angle * 0.5);
+            }
+            else
+            {
+                /* Important! otherwise garbage happens when applying initial rotations */
+                ik_quat_static_set_identity(parent_node->rotation.f);
+            }
+        }
+
+        node_idx -= count;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+apply_initial_rotations(struct chain_t* chain)
+{
+    ikreal_t rx[BATCH_BLOCK], ry[BATCH_BLOCK], rz[BATCH_BLOCK], rw[BATCH_BLOCK];
+    ikreal_t ix[BATCH_BLOCK], iy[BATCH_BLOCK], iz[BATCH_BLOCK], iw[BATCH_BLOCK];
+    const struct batch_kernels_t* batch = batch_kernels();
+    int node_count = chain_length(chain);
+    int first;
+
+    for (first = 0; first < node_count; first += BATCH_BLOCK)
+    {
+        int i, count = node_count - first < BATCH_BLOCK ? node_count - first : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            const struct ik_node_FABRIK_t* node = (struct ik_node_FABRIK_t*)chain_get_node(chain, first + i);
+            rx[i] = node->rotation.x;
+            ry[i] = node->rotation.y;
+            rz[i] = node->rotation.z;
+            rw[i] = node->rotation.w;
+            ix[i] = node->initial_rotation.x;
+            iy[i] = node->initial_rotation.y;
+            iz[i] = node->initial_rotation.z;
+            iw[i] = node->initial_rotation.w;
+        }
+
+        batch->quat_mul(rx, ry, rz, rw, ix, iy, iz, iw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = chain_get_node(chain, first + i);
+            node->rotation.x = rx[i];
+            node->rotation.y = ry[i];
+            node->rotation.z = rz[i];
+            node->rotation.w = rw[i];
+        }
     }
 }
 
@@ -552,29 +581,112 @@ calculate_joint_rotations_for_chain(struct chain_t* chain)
      * Finally, apply initial global rotations to calculated delta rotations to
      * obtain the solved global rotations.
      */
-    CHAIN_FOR_EACH_NODE(chain, node_base)
-        struct ik_node_FABRIK_t* node = (struct ik_node_FABRIK_t*)node_base;
-        ik_quat_static_mul_quat(node->rotation.f, node->initial_rotation.f);
-    CHAIN_END_EACH
+    apply_initial_rotations(chain);
 }
-static void
-calculate_joint_rotations(struct vector_t* chain_list)
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Without joint rotations, the global positions never have to be written to
+ * the nodes. They stay in the program's cache instead, which only has to be
+ * updated for the nodes the user or the solver actually moved.
+ */
+static int
+uses_global_cache(const struct ik_solver_t* solver)
 {
-    VECTOR_FOR_EACH(chain_list, struct chain_t, chain)
-        calculate_joint_rotations_for_chain(chain);
-    VECTOR_END_EACH
+    return (solver->flags & IK_ENABLE_JOINT_ROTATIONS) == 0;
 }
 
 /* ------------------------------------------------------------------------- */
-ikret_t
-ik_solver_FABRIK_solve(struct ik_solver_t* solver)
+static ikret_t
+solve_island(struct ik_solver_t* solver, uint32_t island_idx)
+{
+    struct program_t* program = &((struct ik_solver_FABRIK_t*)solver)->program;
+    const struct program_island_t* island = &program->islands[island_idx];
+    ikreal_t residual = 0.0;
+    int32_t iteration = 0;
+    int written_back = 0;
+
+    /*
+     * The iterations only ever touch the program's arrays. With the cache,
+     * ik_transform_island_to_cache() already put the positions there.
+     */
+    if (uses_global_cache(solver) == 0)
+        program_gather_island_positions(program, island_idx);
+    program_gather_island_targets(program, island_idx, solver->flags & IK_ENABLE_TARGET_ROTATIONS);
+    if (solver->flags & IK_ENABLE_WARM_START)
+        program_warm_start_island(program, island_idx, solver->warm_start_blend, solver->warm_start_threshold);
+
+    /*
+     * Islands don't affect each other, so each island stops as soon as all
+     * of its own effectors are in range. Always do at least one iteration,
+     * so a pose that already satisfies its targets still has its segment
+     * lengths restored.
+     */
+    while (iteration < solver->max_iterations)
+    {
+        /* Actual algorithm here */
+        if (solver->flags & IK_ENABLE_TARGET_ROTATIONS)
+            solve_island_forwards_with_target_rotation(program, island);
+        else
+            solve_island_forwards(program, island);
+
+        /*
+         * TODO Constraints are not applied yet, see IK_ENABLE_CONSTRAINTS.
+         * If this is the last iteration for sure, write the nodes back to
+         * local space in the same sweep.
+         */
+        if (uses_global_cache(solver) && iteration + 1 == solver->max_iterations)
+        {
+            solve_island_backwards_to_local(program, island);
+            written_back = 1;
+        }
+        else
+            solve_island_backwards(program, island);
+        iteration++;
+
+        /* Check if all effectors are within range */
+        residual = program_island_residual(program, island_idx);
+        if (residual <= solver->tolerance)
+            break;
+    }
+    if (iteration == 0)
+        residual = program_island_residual(program, island_idx);
+
+    if (solver->flags & IK_ENABLE_WARM_START)
+        program_store_warm_start_island(program, island_idx);
+
+    /*
+     * Islands of a group only share their base node, which is never written,
+     * so with the cache the nodes can be written back right away.
+     */
+    if (uses_global_cache(solver) == 0)
+        program_scatter_island_positions(program, island_idx);
+    else if (written_back == 0)
+        ik_transform_island_from_cache(program, island_idx);
+
+    program->island_iterations[island_idx] = iteration;
+    program->island_residual[island_idx] = residual;
+    return residual <= solver->tolerance ? IK_RESULT_CONVERGED : IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+prepare_islands(struct ik_solver_t* solver, const uint32_t* island_idx, const uint32_t* island_end)
 {
-    ikret_t result = IK_OK;
-    int iteration = solver->max_iterations;
-    ikreal_t tolerance_squared = solver->tolerance * solver->tolerance;
+    struct program_t* program = &((struct ik_solver_FABRIK_t*)solver)->program;
+    const uint32_t* it;
 
     /* Tree is in local space -- FABRIK needs only global node positions */
-    ik_transform_chain_list(&solver->chain_list, TR_L2G | TR_TRANSLATIONS);
+    for (it = island_idx; it != island_end; ++it)
+    {
+        if (uses_global_cache(solver))
+            ik_transform_island_to_cache(program, *it);
+        else
+        {
+            ik_transform_island(program, *it, TR_L2G | TR_TRANSLATIONS);
+            program->island_cached[*it] = 0;
+        }
+    }
 
     /*
      * Joint rotations are calculated by comparing positional differences
@@ -583,53 +695,736 @@ ik_solver_FABRIK_solve(struct ik_solver_t* solver)
      * positions and locations before solving for later.
      */
     if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
-        store_initial_transform(&solver->chain_list);
+        for (it = island_idx; it != island_end; ++it)
+            store_initial_transform_for_chain(vector_get_element(&solver->chain_list, *it));
+}
+static void
+finish_islands(struct ik_solver_t* solver, const uint32_t* island_idx, const uint32_t* island_end)
+{
+    struct program_t* program = &((struct ik_solver_FABRIK_t*)solver)->program;
+    const uint32_t* it;
+
+    if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
+        for (it = island_idx; it != island_end; ++it)
+            calculate_joint_rotations_for_chain(vector_get_element(&solver->chain_list, *it));
+
+    /*
+     * Transform back to local space now that solving is complete. With the
+     * cache, this was already done when the positions were scattered.
+     */
+    if (uses_global_cache(solver) == 0)
+        for (it = island_idx; it != island_end; ++it)
+            ik_transform_island(program, *it, TR_G2L | TR_TRANSLATIONS);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_group(void* user_data, uint32_t group_idx)
+{
+    struct ik_solver_t* solver = (struct ik_solver_t*)user_data;
+    struct program_t* program = &((struct ik_solver_FABRIK_t*)solver)->program;
+    const uint32_t* island_idx = &program->group_islands[program->group_begin[group_idx]];
+    const uint32_t* island_end = &program->group_islands[program->group_begin[group_idx + 1]];
+    const uint32_t* it;
+    ikret_t result = IK_RESULT_CONVERGED;
+
+    /*
+     * Islands in the same group share a base node. Joint rotations write to
+     * the base node and the G2L transform reads from it, so each step must be
+     * done for all islands of the group before moving on to the next step.
+     * This is the same order the steps would happen in if the whole tree was
+     * solved at once.
+     */
+    prepare_islands(solver, island_idx, island_end);
+
+    for (it = island_idx; it != island_end; ++it)
+        if (solve_island(solver, *it) == IK_OK)
+            result = IK_OK;
+
+    finish_islands(solver, island_idx, island_end);
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_solve(struct ik_solver_t* solver)
+{
+    struct ik_solver_FABRIK_t* fabrik = (struct ik_solver_FABRIK_t*)solver;
+    struct program_t* program = &fabrik->program;
+    ikret_t result = IK_RESULT_CONVERGED;
+    uint32_t group_idx;
 
-    while (iteration-- > 0)
+    arena_reset(&fabrik->arena);
+
+    /*
+     * Groups of islands don't share any nodes, so they can be handed to the
+     * worker threads. The result is identical to solving them one after the
+     * other. The pool reduces the results to the smallest one, which is
+     * IK_OK if any of the groups didn't converge.
+     */
+    if ((solver->flags & IK_ENABLE_PARALLEL_ISLANDS) && program->group_count > 1)
+        return ik_thread_pool_static_run(solve_group, solver, program->group_count);
+
+    for (group_idx = 0; group_idx != program->group_count; ++group_idx)
     {
-        /* Actual algorithm here */
-        SOLVER_FOR_EACH_CHAIN(solver, chain)
-            struct  ik_node_t* base_node;
-            int idx;
+        ikret_t group_result = solve_group(solver, group_idx);
+        if (group_result < result)
+            result = group_result;
+    }
 
-            /*
-             * The algorithm assumes chains have at least one bone. This should
-             * be asserted while building the chain trees, but it can't hurt
-             * to double check
-             */
-            idx = chain_length(chain) - 1;
-            assert(idx > 0);
+    return result;
+}
 
-            base_node = chain_get_node(chain, idx);
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_get_island_stats(const struct ik_solver_t* solver, int island_idx,
+                                  int32_t* iterations, ikreal_t* residual)
+{
+    const struct program_t* program = &((const struct ik_solver_FABRIK_t*)solver)->program;
 
-            if (solver->flags & IK_ENABLE_TARGET_ROTATIONS)
-                solve_chain_forwards_with_target_rotation(chain);
-            else
-                solve_chain_forwards(chain);
+    if (island_idx < 0 || (uint32_t)island_idx >= program->island_count)
+        return IK_INDEX_OUT_OF_RANGE;
 
-            if (solver->flags & IK_ENABLE_CONSTRAINTS)
-                solve_chain_backwards_with_constraints(chain, base_node->position, base_node->rotation, base_node->position);
-            else
-                solve_chain_backwards(chain, base_node->position);
-        SOLVER_END_EACH
+    if (iterations != NULL)
+        *iterations = program->island_iterations[island_idx];
+    if (residual != NULL)
+        *residual = program->island_residual[island_idx];
+    return program->island_residual[island_idx] <= solver->tolerance ?
+            IK_RESULT_CONVERGED : IK_OK;
+}
 
-        /* Check if all effectors are within range */
-        SOLVER_FOR_EACH_EFFECTOR_NODE(solver, node)
-            ik_vec3_t diff = node->position;
-            ik_vec3_static_sub_vec3(diff.f, node->effector->target_position.f);
-            if (ik_vec3_static_length_squared(diff.f) > tolerance_squared)
+/*
+ * "Rig lanes": Several solvers compiled from the same topology are solved in
+ * lockstep. All of the per slot and per chain data is interleaved, i.e.
+ * element [slot * LANE_COUNT + lane], and every step of the algorithm loops
+ * over the lanes in its innermost loop so the compiler can vectorise it. The
+ * slot, chain and parent indices are taken from the first lane's program.
+ */
+#define LANE_COUNT (32 / sizeof(ikreal_t))
+#define LANE_FOR_EACH(lane) for (lane = 0; lane != LANE_COUNT; ++lane)
+
+struct lanes_t
+{
+    struct ik_solver_t* solvers[LANE_COUNT];
+    uint32_t count;
+    const struct program_t* schedule;
+
+    /* Per slot */
+    ikreal_t* pos_x;
+    ikreal_t* pos_y;
+    ikreal_t* pos_z;
+    ikreal_t* dist;
+    ikreal_t* rotation_weight;
+
+    /* Per chain */
+    ikreal_t* target_x;
+    ikreal_t* target_y;
+    ikreal_t* target_z;
+    ikreal_t* direction_x;
+    ikreal_t* direction_y;
+    ikreal_t* direction_z;
+    ikreal_t* effector_x;
+    ikreal_t* effector_y;
+    ikreal_t* effector_z;
+    ikreal_t* effector_dir_x;
+    ikreal_t* effector_dir_y;
+    ikreal_t* effector_dir_z;
+};
+
+/* ------------------------------------------------------------------------- */
+static uintptr_t
+lanes_layout(struct lanes_t* lanes, const struct program_t* program, ikreal_t* block)
+{
+    uintptr_t offset = 0;
+    uintptr_t slots = program->slot_count * LANE_COUNT;
+    uintptr_t chains = program->chain_count * LANE_COUNT;
+
+    /* When block is NULL this only computes the required number of elements */
+#define CARVE(member, count) \
+    lanes->member = block ? block + offset : NULL; \
+    offset += (count)
+    CARVE(pos_x, slots);
+    CARVE(pos_y, slots);
+    CARVE(pos_z, slots);
+    CARVE(dist, slots);
+    CARVE(rotation_weight, slots);
+    CARVE(target_x, chains);
+    CARVE(target_y, chains);
+    CARVE(target_z, chains);
+    CARVE(direction_x, chains);
+    CARVE(direction_y, chains);
+    CARVE(direction_z, chains);
+    CARVE(effector_x, chains);
+    CARVE(effector_y, chains);
+    CARVE(effector_z, chains);
+    CARVE(effector_dir_x, chains);
+    CARVE(effector_dir_y, chains);
+    CARVE(effector_dir_z, chains);
+#undef CARVE
+
+    return offset;
+}
+static uintptr_t
+lanes_size(const struct program_t* program)
+{
+    struct lanes_t lanes;
+    return lanes_layout(&lanes, program, NULL) * sizeof(ikreal_t);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+lanes_normalize_and_scale(ikreal_t* x, ikreal_t* y, ikreal_t* z, const ikreal_t* scale, ikreal_t sign)
+{
+    /* Same as normalize_and_scale() for every lane, but without branches */
+    uint32_t lane;
+    LANE_FOR_EACH(lane)
+    {
+        ikreal_t length = sqrt(x[lane] * x[lane] + y[lane] * y[lane] + z[lane] * z[lane]);
+        ikreal_t inv = 1.0 / (length != 0.0 ? length : 1.0);
+        ikreal_t s = scale[lane] * sign;
+        x[lane] = (length != 0.0 ? x[lane] * inv : 1.0) * s;
+        y[lane] = y[lane] * inv * s;
+        z[lane] = z[lane] * inv * s;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+lanes_average_children(const struct lanes_t* lanes, const struct program_chain_t* chain,
+                       const ikreal_t* src_x, const ikreal_t* src_y, const ikreal_t* src_z,
+                       ikreal_t* x, ikreal_t* y, ikreal_t* z)
+{
+    const struct program_t* p = lanes->schedule;
+    ikreal_t det = 1.0 / chain->child_count;
+    uint32_t i, lane;
+
+    LANE_FOR_EACH(lane)
+        x[lane] = y[lane] = z[lane] = 0.0;
+    for (i = 0; i != chain->child_count; ++i)
+    {
+        uint32_t child = p->child_chains[chain->child_begin + i] * LANE_COUNT;
+        LANE_FOR_EACH(lane)
+        {
+            x[lane] += src_x[child + lane];
+            y[lane] += src_y[child + lane];
+            z[lane] += src_z[child + lane];
+        }
+    }
+    LANE_FOR_EACH(lane)
+    {
+        x[lane] *= det;
+        y[lane] *= det;
+        z[lane] *= det;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+lanes_solve_forwards(struct lanes_t* lanes)
+{
+    const struct program_t* p = lanes->schedule;
+    uint32_t chain_idx, lane;
+
+    for (chain_idx = 0; chain_idx != p->chain_count; ++chain_idx)
+    {
+        const struct program_chain_t* chain = &p->chains[chain_idx];
+        uint32_t c = chain_idx * LANE_COUNT;
+        uint32_t slot, slot_end;
+        ikreal_t tx[LANE_COUNT], ty[LANE_COUNT], tz[LANE_COUNT];
+
+        if (chain->child_count == 0)
+        {
+            LANE_FOR_EACH(lane)
             {
-                result = IK_RESULT_CONVERGED;
-                break;
+                tx[lane] = lanes->effector_x[c + lane];
+                ty[lane] = lanes->effector_y[c + lane];
+                tz[lane] = lanes->effector_z[c + lane];
             }
-        SOLVER_END_EACH
+        }
+        else
+        {
+            lanes_average_children(lanes, chain, lanes->target_x, lanes->target_y, lanes->target_z, tx, ty, tz);
+        }
+
+        slot_end = chain->first + chain->count;
+        for (slot = chain->first; slot != slot_end; ++slot)
+        {
+            uint32_t s = slot * LANE_COUNT;
+            uint32_t q = p->parent[slot] * LANE_COUNT;
+
+            LANE_FOR_EACH(lane)
+            {
+                lanes->pos_x[s + lane] = tx[lane];
+                lanes->pos_y[s + lane] = ty[lane];
+                lanes->pos_z[s + lane] = tz[lane];
+                tx[lane] -= lanes->pos_x[q + lane];
+                ty[lane] -= lanes->pos_y[q + lane];
+                tz[lane] -= lanes->pos_z[q + lane];
+            }
+            lanes_normalize_and_scale(tx, ty, tz, &lanes->dist[s], -1.0);
+            LANE_FOR_EACH(lane)
+            {
+                tx[lane] += lanes->pos_x[s + lane];
+                ty[lane] += lanes->pos_y[s + lane];
+                tz[lane] += lanes->pos_z[s + lane];
+            }
+        }
+
+        LANE_FOR_EACH(lane)
+        {
+            lanes->target_x[c + lane] = tx[lane];
+            lanes->target_y[c + lane] = ty[lane];
+            lanes->target_z[c + lane] = tz[lane];
+        }
     }
+}
 
-    if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
-        calculate_joint_rotations(&solver->chain_list);
+/* ------------------------------------------------------------------------- */
+static void
+lanes_solve_forwards_with_target_rotation(struct lanes_t* lanes)
+{
+    const struct program_t* p = lanes->schedule;
+    uint32_t chain_idx, lane;
+    ikreal_t one[LANE_COUNT];
+
+    LANE_FOR_EACH(lane)
+        one[lane] = 1.0;
+
+    for (chain_idx = 0; chain_idx != p->chain_count; ++chain_idx)
+    {
+        const struct program_chain_t* chain = &p->chains[chain_idx];
+        uint32_t c = chain_idx * LANE_COUNT;
+        uint32_t slot, slot_end;
+        ikreal_t tx[LANE_COUNT], ty[LANE_COUNT], tz[LANE_COUNT];
+        ikreal_t dx[LANE_COUNT], dy[LANE_COUNT], dz[LANE_COUNT];
+
+        if (chain->child_count == 0)
+        {
+            LANE_FOR_EACH(lane)
+            {
+                tx[lane] = lanes->effector_x[c + lane];
+                ty[lane] = lanes->effector_y[c + lane];
+                tz[lane] = lanes->effector_z[c + lane];
+                dx[lane] = lanes->effector_dir_x[c + lane];
+                dy[lane] = lanes->effector_dir_y[c + lane];
+                dz[lane] = lanes->effector_dir_z[c + lane];
+            }
+        }
+        else
+        {
+            lanes_average_children(lanes, chain, lanes->target_x, lanes->target_y, lanes->target_z, tx, ty, tz);
+            lanes_average_children(lanes, chain, lanes->direction_x, lanes->direction_y, lanes->direction_z, dx, dy, dz);
+            lanes_normalize_and_scale(dx, dy, dz, one, 1.0);
+        }
+
+        slot_end = chain->first + chain->count;
+        for (slot = chain->first; slot != slot_end; ++slot)
+        {
+            uint32_t s = slot * LANE_COUNT;
+            uint32_t q = p->parent[slot] * LANE_COUNT;
+
+            /* move node to target */
+            LANE_FOR_EACH(lane)
+            {
+                lanes->pos_x[s + lane] = tx[lane];
+                lanes->pos_y[s + lane] = ty[lane];
+                lanes->pos_z[s + lane] = tz[lane];
+                tx[lane] -= lanes->pos_x[q + lane];
+                ty[lane] -= lanes->pos_y[q + lane];
+                tz[lane] -= lanes->pos_z[q + lane];
+            }
+
+            /* lerp between direction vector and segment vector */
+            lanes_normalize_and_scale(tx, ty, tz, one, 1.0);
+            LANE_FOR_EACH(lane)
+            {
+                ikreal_t weight = lanes->rotation_weight[q + lane];
+                tx[lane] = (tx[lane] - dx[lane]) * weight + lanes->pos_x[q + lane];
+                ty[lane] = (ty[lane] - dy[lane]) * weight + lanes->pos_y[q + lane];
+                tz[lane] = (tz[lane] - dz[lane]) * weight + lanes->pos_z[q + lane];
+                tx[lane] -= lanes->pos_x[s + lane];
+                ty[lane] -= lanes->pos_y[s + lane];
+                tz[lane] -= lanes->pos_z[s + lane];
+            }
+
+            /* point segment to previous node */
+            lanes_normalize_and_scale(tx, ty, tz, &lanes->dist[s], 1.0);
+            LANE_FOR_EACH(lane)
+            {
+                tx[lane] += lanes->pos_x[s + lane];
+                ty[lane] += lanes->pos_y[s + lane];
+                tz[lane] += lanes->pos_z[s + lane];
+            }
+        }
 
-    /* Transform back to local space now that solving is complete */
-    ik_transform_chain_list(&solver->chain_list, TR_G2L | TR_TRANSLATIONS);
+        LANE_FOR_EACH(lane)
+        {
+            lanes->target_x[c + lane] = tx[lane];
+            lanes->target_y[c + lane] = ty[lane];
+            lanes->target_z[c + lane] = tz[lane];
+            lanes->direction_x[c + lane] = dx[lane];
+            lanes->direction_y[c + lane] = dy[lane];
+            lanes->direction_z[c + lane] = dz[lane];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+lanes_solve_backwards(struct lanes_t* lanes)
+{
+    /*
+     * Islands are disjoint apart from their base nodes, which never move, so
+     * the chains of all islands can be walked back to front in one go.
+     */
+    const struct program_t* p = lanes->schedule;
+    uint32_t chain_idx = p->chain_count;
+    uint32_t lane;
+
+    while (chain_idx-- > 0)
+    {
+        const struct program_chain_t* chain = &p->chains[chain_idx];
+        uint32_t slot = chain->first + chain->count;
+        while (slot-- > chain->first)
+        {
+            uint32_t s = slot * LANE_COUNT;
+            uint32_t q = p->parent[slot] * LANE_COUNT;
+            ikreal_t tx[LANE_COUNT], ty[LANE_COUNT], tz[LANE_COUNT];
+
+            LANE_FOR_EACH(lane)
+            {
+                tx[lane] = lanes->pos_x[q + lane] - lanes->pos_x[s + lane];
+                ty[lane] = lanes->pos_y[q + lane] - lanes->pos_y[s + lane];
+                tz[lane] = lanes->pos_z[q + lane] - lanes->pos_z[s + lane];
+            }
+            lanes_normalize_and_scale(tx, ty, tz, &lanes->dist[s], -1.0);
+            LANE_FOR_EACH(lane)
+            {
+                lanes->pos_x[s + lane] = tx[lane] + lanes->pos_x[q + lane];
+                lanes->pos_y[s + lane] = ty[lane] + lanes->pos_y[q + lane];
+                lanes->pos_z[s + lane] = tz[lane] + lanes->pos_z[q + lane];
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+lanes_gather(struct lanes_t* lanes, uint32_t lane)
+{
+    struct ik_solver_t* solver = lanes->solvers[lane];
+    struct program_t* p = &((struct ik_solver_FABRIK_t*)solver)->program;
+    uint32_t i;
+
+    if (uses_global_cache(solver) == 0)
+        program_gather_positions(p);
+    program_gather_targets(p, solver->flags & IK_ENABLE_TARGET_ROTATIONS);
+    if (solver->flags & IK_ENABLE_WARM_START)
+        for (i = 0; i != p->island_count; ++i)
+            program_warm_start_island(p, i, solver->warm_start_blend, solver->warm_start_threshold);
+
+    for (i = 0; i != p->slot_count; ++i)
+    {
+        uint32_t dst = i * LANE_COUNT + lane;
+        lanes->pos_x[dst] = p->pos_x[i];
+        lanes->pos_y[dst] = p->pos_y[i];
+        lanes->pos_z[dst] = p->pos_z[i];
+        lanes->dist[dst] = p->dist[i];
+        lanes->rotation_weight[dst] = p->rotation_weight[i];
+    }
+    for (i = 0; i != p->chain_count; ++i)
+    {
+        uint32_t dst = i * LANE_COUNT + lane;
+        if (p->chains[i].child_count != 0)
+            continue;
+        lanes->effector_x[dst] = p->effector_x[i];
+        lanes->effector_y[dst] = p->effector_y[i];
+        lanes->effector_z[dst] = p->effector_z[i];
+        lanes->effector_dir_x[dst] = p->effector_dir_x[i];
+        lanes->effector_dir_y[dst] = p->effector_dir_y[i];
+        lanes->effector_dir_z[dst] = p->effector_dir_z[i];
+    }
+}
+static void
+lanes_scatter(const struct lanes_t* lanes, uint32_t lane)
+{
+    struct ik_solver_t* solver = lanes->solvers[lane];
+    struct program_t* p = &((struct ik_solver_FABRIK_t*)solver)->program;
+    uint32_t i;
+
+    for (i = 0; i != p->slot_count; ++i)
+    {
+        uint32_t src = i * LANE_COUNT + lane;
+        p->pos_x[i] = lanes->pos_x[src];
+        p->pos_y[i] = lanes->pos_y[src];
+        p->pos_z[i] = lanes->pos_z[src];
+    }
+    if (solver->flags & IK_ENABLE_WARM_START)
+        for (i = 0; i != p->island_count; ++i)
+            program_store_warm_start_island(p, i);
+    if (uses_global_cache(solver) == 0)
+        program_scatter_positions(p);
+    else
+        for (i = 0; i != p->island_count; ++i)
+            ik_transform_island_from_cache(p, i);
+}
+
+/* ------------------------------------------------------------------------- */
+static ikreal_t
+lanes_island_residual(const struct lanes_t* lanes, uint32_t lane, uint32_t island_idx)
+{
+    /* Same as program_island_residual(), for a single lane */
+    const struct program_t* p = lanes->schedule;
+    const struct program_island_t* island = &p->islands[island_idx];
+    uint32_t effector = island->effector_begin;
+    uint32_t end = island->effector_begin + island->effector_count;
+    ikreal_t residual = 0.0;
+
+    for (; effector != end; ++effector)
+    {
+        uint32_t chain_idx = p->effector_chains[effector];
+        uint32_t s = p->chains[chain_idx].first * LANE_COUNT + lane;
+        uint32_t c = chain_idx * LANE_COUNT + lane;
+        ikreal_t dx = lanes->pos_x[s] - lanes->effector_x[c];
+        ikreal_t dy = lanes->pos_y[s] - lanes->effector_y[c];
+        ikreal_t dz = lanes->pos_z[s] - lanes->effector_z[c];
+        ikreal_t dist = sqrt(dx*dx + dy*dy + dz*dz);
+        if (dist > residual)
+            residual = dist;
+    }
+
+    return residual;
+}
+static int
+lanes_effectors_converged(const struct lanes_t* lanes, uint32_t lane, ikreal_t tolerance)
+{
+    uint32_t island_idx;
+    for (island_idx = 0; island_idx != lanes->schedule->island_count; ++island_idx)
+        if (lanes_island_residual(lanes, lane, island_idx) > tolerance)
+            return 0;
+    return 1;
+}
+static void
+lanes_store_stats(const struct lanes_t* lanes, uint32_t lane, int32_t iterations)
+{
+    struct program_t* p = &((struct ik_solver_FABRIK_t*)lanes->solvers[lane])->program;
+    uint32_t island_idx;
+    for (island_idx = 0; island_idx != p->island_count; ++island_idx)
+    {
+        p->island_iterations[island_idx] = iterations;
+        p->island_residual[island_idx] = lanes_island_residual(lanes, lane, island_idx);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+lanes_solve(struct lanes_t* lanes)
+{
+    struct ik_solver_FABRIK_t* leader = (struct ik_solver_FABRIK_t*)lanes->solvers[0];
+    const struct program_t* p = &leader->program;
+    uint32_t lane, remaining = lanes->count;
+    uint8_t finished[LANE_COUNT] = { 0 };
+    int32_t iteration;
+    ikret_t result = IK_RESULT_CONVERGED;
+
+    /*
+     * Unused lanes are still computed, so make sure they hold harmless data.
+     * Their results are never written anywhere.
+     */
+    lanes->schedule = p;
+    if (lanes->count != LANE_COUNT)
+        memset(leader->lanes_block, 0, lanes_layout(lanes, p, NULL) * sizeof(ikreal_t));
+    lanes_layout(lanes, p, (ikreal_t*)leader->lanes_block);
+
+    /* Steps that don't depend on the topology are done per solver */
+    for (lane = 0; lane != lanes->count; ++lane)
+    {
+        struct ik_solver_t* solver = lanes->solvers[lane];
+        const struct program_t* own = &((struct ik_solver_FABRIK_t*)solver)->program;
+        ik_solver_base_solve(solver);
+        prepare_islands(solver, own->group_islands, own->group_islands + own->island_count);
+        lanes_gather(lanes, lane);
+    }
+
+    for (iteration = 0; remaining > 0; ++iteration)
+    {
+        for (lane = 0; lane != lanes->count; ++lane)
+        {
+            struct ik_solver_t* solver = lanes->solvers[lane];
+            int converged;
+
+            if (finished[lane])
+                continue;
+
+            /*
+             * A lane is masked out as soon as its effectors are in range or
+             * it ran out of iterations. Masked lanes keep being computed
+             * along with the others, but are no longer read. Unlike solve(),
+             * all islands of a lane stop at the same time. Like solve(), at
+             * least one iteration is done.
+             */
+            if (iteration == 0 && solver->max_iterations > 0)
+                continue;
+            converged = lanes_effectors_converged(lanes, lane, solver->tolerance);
+            if (converged == 0 && iteration < solver->max_iterations)
+                continue;
+
+            if (converged == 0)
+                result = IK_OK;
+            lanes_scatter(lanes, lane);
+            lanes_store_stats(lanes, lane, iteration);
+            finished[lane] = 1;
+            remaining--;
+        }
+
+        if (remaining == 0)
+            break;
+
+        if (leader->flags & IK_ENABLE_TARGET_ROTATIONS)
+            lanes_solve_forwards_with_target_rotation(lanes);
+        else
+            lanes_solve_forwards(lanes);
+        lanes_solve_backwards(lanes);
+    }
+
+    for (lane = 0; lane != lanes->count; ++lane)
+    {
+        struct ik_solver_t* solver = lanes->solvers[lane];
+        const struct program_t* own = &((struct ik_solver_FABRIK_t*)solver)->program;
+        finish_islands(solver, own->group_islands, own->group_islands + own->island_count);
+    }
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+can_share_lanes(const struct ik_solver_t* a, const struct ik_solver_t* b)
+{
+    const struct program_t* pa = &((const struct ik_solver_FABRIK_t*)a)->program;
+    const struct program_t* pb = &((const struct ik_solver_FABRIK_t*)b)->program;
+    return b->v == a->v &&
+           pa->topology == pb->topology &&
+           pa->slot_count == pb->slot_count &&
+           pa->chain_count == pb->chain_count &&
+           (a->flags & IK_ENABLE_TARGET_ROTATIONS) == (b->flags & IK_ENABLE_TARGET_ROTATIONS);
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+next_lane_group(struct ik_solver_t** solvers, int begin, int end)
+{
+    /*
+     * Returns the end of the group of solvers starting at begin. Solvers that
+     * don't have a solve program (other algorithms, not rebuilt) form a
+     * group of their own.
+     */
+    const struct ik_solver_t* leader = solvers[begin];
+    int group_end = begin + 1;
+
+    if (leader->v != &IKAPI.internal.solver_FABRIK ||
+        ((const struct ik_solver_FABRIK_t*)leader)->program.island_count == 0)
+        return group_end;
+
+    while (group_end != end && group_end - begin != (int)LANE_COUNT &&
+           can_share_lanes(leader, solvers[group_end]))
+        group_end++;
+
+    return group_end;
+}
+
+/* ------------------------------------------------------------------------- */
+struct lanes_job_t
+{
+    struct ik_solver_t** solvers;
+    int count;
+};
+static ikret_t
+solve_lanes_job(void* user_data, uint32_t job_idx)
+{
+    const struct lanes_job_t* job = (const struct lanes_job_t*)user_data;
+    int begin = (int)(job_idx * LANE_COUNT);
+    int end = begin + (int)LANE_COUNT < job->count ? begin + (int)LANE_COUNT : job->count;
+    ikret_t result = IK_RESULT_CONVERGED;
+
+    while (begin != end)
+    {
+        int group_end = next_lane_group(job->solvers, begin, end);
+        struct ik_solver_t* leader = job->solvers[begin];
+        ikret_t group_result;
+
+        if (group_end - begin > 1)
+        {
+            struct lanes_t lanes;
+            int i;
+            lanes.count = (uint32_t)(group_end - begin);
+            for (i = begin; i != group_end; ++i)
+                lanes.solvers[i - begin] = job->solvers[i];
+            group_result = lanes_solve(&lanes);
+        }
+        else
+        {
+            group_result = leader->v->solve(leader);
+        }
+
+        if (group_result < result)
+            result = group_result;
+        begin = group_end;
+    }
 
     return result;
 }
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_FABRIK_solve_lanes(struct ik_solver_t** solvers, int count)
+{
+    struct lanes_job_t job;
+    int begin, end;
+
+    if (count <= 0)
+        return IK_OK;
+
+    /*
+     * Groups never straddle a multiple of LANE_COUNT, so each job can find
+     * its groups without looking at the rest of the list. The scratch space
+     * of each group's leader is taken from its arena up front, because the
+     * jobs may run on worker threads. The arena only has to grow the first
+     * time a solver leads a group, after that rebuild() takes care of it.
+     */
+    for (end = 0; end < count; )
+    {
+        begin = end;
+        end = begin + (int)LANE_COUNT < count ? begin + (int)LANE_COUNT : count;
+        while (begin != end)
+        {
+            int group_end = next_lane_group(solvers, begin, end);
+            struct ik_solver_FABRIK_t* leader = (struct ik_solver_FABRIK_t*)solvers[begin];
+            if (group_end - begin > 1)
+            {
+                uintptr_t size = lanes_size(&leader->program);
+                arena_reset(&leader->arena);
+                if ((leader->lanes_block = arena_alloc(&leader->arena, size)) == NULL)
+                {
+                    /*
+                     * Nothing told us this solver would lead a group before,
+                     * so this is the one allocation that is allowed here.
+                     */
+                    ikret_t result;
+                    ik_memory_leave_solve();
+                    result = arena_reserve(&leader->arena, size);
+                    ik_memory_enter_solve();
+                    if (result != IK_OK)
+                        return result;
+                    leader->lanes_block = arena_alloc(&leader->arena, size);
+                }
+            }
+            begin = group_end;
+        }
+    }
+
+    job.solvers = solvers;
+    job.count = count;
+    return ik_thread_pool_static_run(solve_lanes_job, &job, (uint32_t)((count + LANE_COUNT - 1) / LANE_COUNT));
+}
@@ -1,23 +1,104 @@
 #include "ik/solver_MSS.h"
+#include "ik/carve.h"
+#include "ik/chain.h"
 #include "ik/ik.h"
+#include "ik/memory.h"
+#include "ik/transform.h"
+#include <assert.h>
 #include <math.h>
+#include <stddef.h>
 
-struct mss_solver_t
-{
-    IK_SOLVER_HEAD
-};
+/*
+ * Mass/spring/damper solver. Every node of the chain trees becomes a particle
+ * with unit mass, every bone a stiff damped spring with the bone's length as
+ * its rest length, and every effector pulls its node toward the target with
+ * a softer spring. The base node of each island is fixed. The system is
+ * integrated with the Cash-Karp embedded Runge-Kutta method (4th and 5th
+ * order), with the step size adapted to the error estimate, until all
+ * effectors are within tolerance of their targets or the budget runs out.
+ * The budget is max_iterations steps (rejected ones included) or
+ * MSS_TIME_LIMIT of simulated time, whichever comes first.
+ *
+ * Springs stretch a little under load, so the bones are set back to their
+ * lengths afterwards. Like FABRIK without IK_ENABLE_JOINT_ROTATIONS, only the
+ * positions of the nodes change.
+ *
+ * All work buffers are carved out of one block in rebuild(), which never
+ * shrinks, so solve() doesn't allocate.
+ */
+
+/*
+ * Bones are a lot stiffer than the pull of the targets. Less damping lets
+ * chains settle faster, at the cost of some overshoot.
+ */
+#define MSS_BONE_STIFFNESS   400.0
+#define MSS_BONE_DAMPING     10.0
+#define MSS_TARGET_STIFFNESS 100.0
+#define MSS_DRAG             6.0
+#define MSS_TIME_LIMIT       20.0
+#define MSS_FIRST_STEP       0.01
+/* Error allowed per step, relative to solver->tolerance */
+#define MSS_ERROR_FRACTION   0.1
+
+/* Step size control, from Numerical Recipes' rkqs() */
+#define SAFETY 0.9
+#define PGROW  -0.2
+#define PSHRNK -0.25
+/* (5 / SAFETY) raised to the power (1 / PGROW), limits growth to 5x */
+#define ERRCON 1.89e-4
+
+/* Cash-Karp Butcher tableau */
+#define CK_B21  (0.2)
+#define CK_B31  (3.0 / 40.0)
+#define CK_B32  (9.0 / 40.0)
+#define CK_B41  (0.3)
+#define CK_B42  (-0.9)
+#define CK_B43  (1.2)
+#define CK_B51  (-11.0 / 54.0)
+#define CK_B52  (2.5)
+#define CK_B53  (-70.0 / 27.0)
+#define CK_B54  (35.0 / 27.0)
+#define CK_B61  (1631.0 / 55296.0)
+#define CK_B62  (175.0 / 512.0)
+#define CK_B63  (575.0 / 13824.0)
+#define CK_B64  (44275.0 / 110592.0)
+#define CK_B65  (253.0 / 4096.0)
+#define CK_C1   (37.0 / 378.0)
+#define CK_C3   (250.0 / 621.0)
+#define CK_C4   (125.0 / 594.0)
+#define CK_C6   (512.0 / 1771.0)
+#define CK_DC1  (CK_C1 - 2825.0 / 27648.0)
+#define CK_DC3  (CK_C3 - 18575.0 / 48384.0)
+#define CK_DC4  (CK_C4 - 13525.0 / 55296.0)
+#define CK_DC5  (-277.00 / 14336.0)
+#define CK_DC6  (CK_C6 - 0.25)
+
+/* Row r of an integrator array, see ik_solver_MSS_t */
+#define ROW(mss, array, r) (&(array)[(uintptr_t)(r) * (mss)->particle_count])
 
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_solver_MSS_type_size(void)
 {
-    return sizeof(struct mss_solver_t);
+    return sizeof(struct ik_solver_MSS_t);
 }
 
 /* ------------------------------------------------------------------------- */
 ikret_t
 ik_solver_MSS_construct(struct ik_solver_t* solver)
 {
+    struct ik_solver_MSS_t* mss = (struct ik_solver_MSS_t*)solver;
+
+    /* Steps, not iterations. A chain typically settles in less than 100 */
+    solver->max_iterations = 200;
+    solver->tolerance = 1e-3;
+
+    mss->block = NULL;
+    mss->block_size = 0;
+    mss->particle_count = 0;
+    mss->spring_count = 0;
+    mss->step = 0;
+
     return IK_OK;
 }
 
@@ -25,249 +106,375 @@ ik_solver_MSS_construct(struct ik_solver_t* solver)
 void
 ik_solver_MSS_destruct(struct ik_solver_t* solver)
 {
+    struct ik_solver_MSS_t* mss = (struct ik_solver_MSS_t*)solver;
+    if (mss->block != NULL)
+        FREE(mss->block);
+    mss->block = NULL;
+    mss->block_size = 0;
 }
 
 /* ------------------------------------------------------------------------- */
-ikret_t
-ik_solver_MSS_rebuild(struct ik_solver_t* solver)
+static uintptr_t
+layout(struct ik_solver_MSS_t* mss, uint8_t* block)
 {
-    return IK_OK;
+    uintptr_t offset = 0;
+    uintptr_t n = mss->particle_count;
+    int k;
+
+    /* When block is NULL this only computes the required size */
+    CARVE(block, &offset, mss->y, n * 6);
+    CARVE(block, &offset, mss->dydx, n * 6);
+    CARVE(block, &offset, mss->ak2, n * 6);
+    CARVE(block, &offset, mss->ak3, n * 6);
+    CARVE(block, &offset, mss->ak4, n * 6);
+    CARVE(block, &offset, mss->ak5, n * 6);
+    CARVE(block, &offset, mss->ak6, n * 6);
+    CARVE(block, &offset, mss->ytemp, n * 6);
+    CARVE(block, &offset, mss->ytry, n * 6);
+    CARVE(block, &offset, mss->yerr, n * 6);
+    CARVE(block, &offset, mss->inv_mass, n);
+    CARVE(block, &offset, mss->pull, n);
+    for (k = 0; k != 3; ++k)
+        CARVE(block, &offset, mss->target[k], n);
+    CARVE(block, &offset, mss->rest_length, mss->spring_count);
+    CARVE(block, &offset, mss->nodes, n);
+    CARVE(block, &offset, mss->spring_parent, mss->spring_count);
+    CARVE(block, &offset, mss->spring_child, mss->spring_count);
+
+    return offset;
 }
 
+/* ------------------------------------------------------------------------- */
+static uint32_t
+count_chain_nodes(const struct chain_t* chain)
+{
+    /* The base node belongs to the parent chain */
+    uint32_t count = chain_length(chain) - 1;
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        count += count_chain_nodes(child);
+    CHAIN_END_EACH
+    return count;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+add_chain(struct ik_solver_MSS_t* mss, const struct chain_t* chain, uint32_t base)
+{
+    uint32_t parent = base;
+    int idx;
+
+    /* Nodes are stored from the tip to the base */
+    for (idx = (int)chain_length(chain) - 2; idx >= 0; --idx)
+    {
+        struct ik_node_t* node = chain_get_node(chain, idx);
+        uint32_t p = mss->particle_count++;
+        uint32_t s = mss->spring_count++;
+
+        mss->nodes[p] = node;
+        mss->inv_mass[p] = 1;
+        mss->spring_parent[s] = parent;
+        mss->spring_child[s] = p;
+        mss->rest_length[s] = node->dist_to_parent;
+        parent = p;
+    }
+
+    CHAIN_FOR_EACH_CHILD(chain, child)
+        add_chain(mss, child, parent);
+    CHAIN_END_EACH
+}
 
 /* ------------------------------------------------------------------------- */
 ikret_t
-ik_solver_MSS_solve(struct ik_solver_t* solver)
+ik_solver_MSS_rebuild(struct ik_solver_t* solver)
 {
+    struct ik_solver_MSS_t* mss = (struct ik_solver_MSS_t*)solver;
+    uint32_t particle_count = 0;
+    uint32_t island_count = 0;
+    uintptr_t size;
+
+    VECTOR_FOR_EACH(&solver->chain_list, struct chain_t, chain)
+        particle_count += 1 + count_chain_nodes(chain);
+        ++island_count;
+    VECTOR_END_EACH
+
+    mss->particle_count = particle_count;
+    mss->spring_count = particle_count - island_count;
+    size = layout(mss, NULL);
+    if (size > mss->block_size)
+    {
+        uint8_t* block;
+        if ((block = MALLOC(size)) == NULL)
+        {
+            IKAPI.log.message("Failed to allocate MSS solver buffers: Ran out of memory");
+            mss->particle_count = 0;
+            mss->spring_count = 0;
+            return IK_RAN_OUT_OF_MEMORY;
+        }
+        if (mss->block != NULL)
+            FREE(mss->block);
+        mss->block = block;
+        mss->block_size = size;
+    }
+    layout(mss, mss->block);
+
+    /* Fill in the particles and springs, counting them again as we go */
+    mss->particle_count = 0;
+    mss->spring_count = 0;
+    VECTOR_FOR_EACH(&solver->chain_list, struct chain_t, chain)
+        uint32_t base = mss->particle_count++;
+        mss->nodes[base] = chain_get_base_node(chain);
+        mss->inv_mass[base] = 0;
+        add_chain(mss, chain, base);
+    VECTOR_END_EACH
+    assert(mss->particle_count == particle_count);
+
+    mss->step = 0;
+
     return IK_OK;
 }
 
-#if 0
+/* ------------------------------------------------------------------------- */
+static void
+derivs(const struct ik_solver_MSS_t* mss, const ikreal_t* y, ikreal_t* dydx)
+{
+    uint32_t n = mss->particle_count;
+    const ikreal_t* px = ROW(mss, y, 0);
+    const ikreal_t* py = ROW(mss, y, 1);
+    const ikreal_t* pz = ROW(mss, y, 2);
+    const ikreal_t* vx = ROW(mss, y, 3);
+    const ikreal_t* vy = ROW(mss, y, 4);
+    const ikreal_t* vz = ROW(mss, y, 5);
+    ikreal_t* ax = ROW(mss, dydx, 3);
+    ikreal_t* ay = ROW(mss, dydx, 4);
+    ikreal_t* az = ROW(mss, dydx, 5);
+    uint32_t i, s;
 
-#define SAFETY 0.9
-#define PGROW -0.2
-#define PSHRNK -0.25
-#define ERRCON 1.89e-4
+    /* Positions change with the velocities */
+    for (i = 0; i != n * 3; ++i)
+        dydx[i] = y[n * 3 + i];
+
+    /* Pull of the targets and drag */
+    for (i = 0; i != n; ++i)
+    {
+        ax[i] = mss->pull[i] * (mss->target[0][i] - px[i]) - MSS_DRAG * vx[i];
+        ay[i] = mss->pull[i] * (mss->target[1][i] - py[i]) - MSS_DRAG * vy[i];
+        az[i] = mss->pull[i] * (mss->target[2][i] - pz[i]) - MSS_DRAG * vz[i];
+    }
 
-#define a2  (0.2)
-#define a3  (0.3)
-#define a4  (0.6)
-#define a5  (1.0)
-#define a6  (0.875)
-#define b21 (0.2)
-#define b31 (3.0 / 40.0)
-#define b32 (9.0 / 40.0)
-#define b41 (0.3)
-#define b42 (-0.9)
-#define b43 (1.2)
-#define b51 (-11.0 / 54.0)
-#define b52 (2.5)
-#define b53 (-70.0 / 27.0)
-#define b54 (35.0 / 27.0)
-#define b61 (1631.0 / 55296.0)
-#define b62 (175.0 / 512.0)
-#define b63 (575.0 / 13824.0)
-#define b64 (44275.0 / 110592.0)
-#define b65 (253.0 / 4096.0)
-#define c1  (37.0 / 378.0)
-#define c3  (250.0 / 621.0)
-#define c4  (125.0 / 594.0)
-#define c6  (512.0 / 1771.0)
-#define dc1 (c1 - 2825.0 / 27648.0)
-#define dc3 (c3 - 18575.0 / 48384.0)
-#define dc4 (c4 - 13525.0 / 55296.0)
-#define dc5 (-277.00 / 14336.0)
-#define dc6 (c6 - 0.25)
-
-/* The value ERRCON equals (5/SAFETY) raised to the power (1/PGROW), see use below. */
-
-/* Given values for n variables y[1..n] and their derivatives dydx[1..n] known at x, use
-the fifth-order Cash-Karp Runge-Kutta method to advance the solution over an interval h
-and return the incremented variables as yout[1..n]. Also return an estimate of the local
-truncation error in yout using the embedded fourth-order method. The user supplies the routine
-derivs(x,y,dydx), which returns derivatives dydx at x. */
-
-void rkck(float y[], float dydx[], int n, float x, float h, float yout[],
-          float yerr[], void (*derivs)(float, float [], float []))
+    /* Bones push and pull along their direction */
+    for (s = 0; s != mss->spring_count; ++s)
+    {
+        uint32_t a = mss->spring_parent[s];
+        uint32_t b = mss->spring_child[s];
+        ikreal_t dx = px[b] - px[a];
+        ikreal_t dy = py[b] - py[a];
+        ikreal_t dz = pz[b] - pz[a];
+        ikreal_t length = sqrt(dx*dx + dy*dy + dz*dz);
+        ikreal_t f;
+        if (length == 0.0)
+            continue;
+        dx /= length;
+        dy /= length;
+        dz /= length;
 
-{
-    int i;
-
-    float *ak2,*ak3,*ak4,*ak5,*ak6,*ytemp; /*
-    ak2=vector(1,n);
-    ak3=vector(1,n);
-    ak4=vector(1,n);
-    ak5=vector(1,n);
-    ak6=vector(1,n);
-    ytemp=vector(1,n);*/
-
-    for (i=1;i<=n;i++) /*First step.*/
-        ytemp[i]=y[i]+b21*h*dydx[i];
-    (*derivs)(x+a2*h,ytemp,ak2); /*Second step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b31*dydx[i]+b32*ak2[i]);
-    (*derivs)(x+a3*h,ytemp,ak3); /*Third step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b41*dydx[i]+b42*ak2[i]+b43*ak3[i]);
-    (*derivs)(x+a4*h,ytemp,ak4); /*Fourth step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b51*dydx[i]+b52*ak2[i]+b53*ak3[i]+b54*ak4[i]);
-    (*derivs)(x+a5*h,ytemp,ak5); /*Fifth step.*/
-    for (i=1;i<=n;i++)
-        ytemp[i]=y[i]+h*(b61*dydx[i]+b62*ak2[i]+b63*ak3[i]+b64*ak4[i]+b65*ak5[i]);
-    (*derivs)(x+a6*h,ytemp,ak6); /*Sixth step.*/
-    for (i=1;i<=n;i++) /*Accumulate increments with proper weights.*/
-        yout[i]=y[i]+h*(c1*dydx[i]+c3*ak3[i]+c4*ak4[i]+c6*ak6[i]);
-    /* Estimate error as difference between fourth and fifth order methods. */
-    for (i=1;i<=n;i++)
-        yerr[i]=h*(dc1*dydx[i]+dc3*ak3[i]+dc4*ak4[i]+dc5*ak5[i]+dc6*ak6[i]);
-    /*
-    free_vector(ytemp,1,n);
-    free_vector(ak6,1,n);
-    free_vector(ak5,1,n);
-    free_vector(ak4,1,n);
-    free_vector(ak3,1,n);
-    free_vector(ak2,1,n);*/
+        f = MSS_BONE_STIFFNESS * (length - mss->rest_length[s]) +
+            MSS_BONE_DAMPING * ((vx[b] - vx[a])*dx + (vy[b] - vy[a])*dy + (vz[b] - vz[a])*dz);
+        ax[a] += f * dx;
+        ay[a] += f * dy;
+        az[a] += f * dz;
+        ax[b] -= f * dx;
+        ay[b] -= f * dy;
+        az[b] -= f * dz;
+    }
+
+    /* Unit masses. The base nodes start at rest and never accelerate */
+    for (i = 0; i != n; ++i)
+    {
+        ax[i] *= mss->inv_mass[i];
+        ay[i] *= mss->inv_mass[i];
+        az[i] *= mss->inv_mass[i];
+    }
 }
 
+/* ------------------------------------------------------------------------- */
 /*
- Fifth-order Runge-Kutta step with monitoring of local truncation error to ensure accuracy and
- adjust stepsize. Input are the dependent variable vector y[1..n] and its derivative dydx[1..n]
- at the starting value of the independent variable x. Also input are the stepsize to be attempted
- htry, the required accuracy eps, and the vector yscal[1..n] against which the error is
- scaled. On output, y and x are replaced by their new values, hdid is the stepsize that was
- actually accomplished, and hnext is the estimated next stepsize. derivs is the user-supplied
- routine that computes the right-hand side derivatives.*/
-
-void rkqs(float y[], float dydx[], int n, float *x, float htry, float eps,
-          float yscal[], float *hdid, float *hnext,
-          void (*derivs)(float, float [], float []))
+ * Given y and its derivatives dydx, uses the fifth-order Cash-Karp
+ * Runge-Kutta method to advance the solution over an interval h into ytry.
+ * The difference to the embedded fourth-order method is written to yerr as
+ * an estimate of the local truncation error.
+ */
+static void
+rkck(struct ik_solver_MSS_t* mss, ikreal_t h)
 {
-    int i;
-    float errmax,h,htemp,xnew,*yerr,*ytemp;
-    /*
-    yerr=vector(1,n);
-    ytemp=vector(1,n);*/
-
-    h = htry; /* Set stepsize to the initial trial value. */
-    for (;;)
+    const ikreal_t* y = mss->y;
+    const ikreal_t* dydx = mss->dydx;
+    ikreal_t* ytemp = mss->ytemp;
+    uint32_t i, n = mss->particle_count * 6;
+
+    for (i = 0; i != n; ++i)
+        ytemp[i] = y[i] + CK_B21*h*dydx[i];
+    derivs(mss, ytemp, mss->ak2);
+    for (i = 0; i != n; ++i)
+        ytemp[i] = y[i] + h*(CK_B31*dydx[i] + CK_B32*mss->ak2[i]);
+    derivs(mss, ytemp, mss->ak3);
+    for (i = 0; i != n; ++i)
+        ytemp[i] = y[i] + h*(CK_B41*dydx[i] + CK_B42*mss->ak2[i] + CK_B43*mss->ak3[i]);
+    derivs(mss, ytemp, mss->ak4);
+    for (i = 0; i != n; ++i)
+        ytemp[i] = y[i] + h*(CK_B51*dydx[i] + CK_B52*mss->ak2[i] + CK_B53*mss->ak3[i] + CK_B54*mss->ak4[i]);
+    derivs(mss, ytemp, mss->ak5);
+    for (i = 0; i != n; ++i)
+        ytemp[i] = y[i] + h*(CK_B61*dydx[i] + CK_B62*mss->ak2[i] + CK_B63*mss->ak3[i] + CK_B64*mss->ak4[i] + CK_B65*mss->ak5[i]);
+    derivs(mss, ytemp, mss->ak6);
+
+    for (i = 0; i != n; ++i)
     {
-        rkck(y,dydx,n,*x,h,ytemp,yerr,derivs); /* Take a step. */
-        errmax = 0.0; /* Evaluate accuracy. */
-        for (i = 1; i <= n; i++)
-            errmax = fmax(errmax, fabs(yerr[i]/yscal[i]));
-        errmax /= eps; /* Scale relative to required tolerance. */
-        if (errmax <= 1.0)
-            break; /* Step succeeded. Compute size of next step. */
-        htemp=SAFETY*h*pow(errmax, PSHRNK);
-        /* Truncation error too large, reduce stepsize. */
-        h = (h >= 0.0 ? fmax(htemp, 0.1*h) : fmin(htemp, 0.1*h));
-        /* No more than a factor of 10. */
-        xnew = (*x)+h;
-        if (xnew == *x)
-        {
-            ik.log.message("stepsize underflow in rkqs");
-            return;
-        }
+        mss->ytry[i] = y[i] + h*(CK_C1*dydx[i] + CK_C3*mss->ak3[i] + CK_C4*mss->ak4[i] + CK_C6*mss->ak6[i]);
+        mss->yerr[i] = h*(CK_DC1*dydx[i] + CK_DC3*mss->ak3[i] + CK_DC4*mss->ak4[i] + CK_DC5*mss->ak5[i] + CK_DC6*mss->ak6[i]);
     }
+}
 
-    if (errmax > ERRCON)
-        *hnext=SAFETY*h*pow(errmax,PGROW);
-    else
-        *hnext=5.0*h; /* No more than a factor of 5 increase. */
-    *x += (*hdid=h);
-    for (i=1;i<=n;i++)
-        y[i]=ytemp[i];
-    /*
-    free_vector(ytemp,1,n);
-    free_vector(yerr,1,n);*/
+/* ------------------------------------------------------------------------- */
+static ikreal_t
+max_residual(const struct ik_solver_MSS_t* mss)
+{
+    ikreal_t residual = 0;
+    uint32_t i;
+    for (i = 0; i != mss->particle_count; ++i)
+    {
+        ikreal_t dx, dy, dz, d;
+        if (mss->pull[i] == 0.0)
+            continue;
+        dx = mss->target[0][i] - ROW(mss, mss->y, 0)[i];
+        dy = mss->target[1][i] - ROW(mss, mss->y, 1)[i];
+        dz = mss->target[2][i] - ROW(mss, mss->y, 2)[i];
+        d = dx*dx + dy*dy + dz*dz;
+        if (d > residual)
+            residual = d;
+    }
+    return sqrt(residual);
 }
 
-#define MAXSTP 10000
-#define TINY 1.0e-30
-#define SIGN(x) (((x) > 0) - ((x) < 0))
+/* ------------------------------------------------------------------------- */
+static ikret_t
+integrate(struct ik_solver_MSS_t* mss)
+{
+    ikreal_t eps = mss->tolerance * MSS_ERROR_FRACTION;
+    ikreal_t t = 0;
+    ikreal_t h = mss->step > 0.0 ? mss->step : MSS_FIRST_STEP;
+    uint32_t i, n = mss->particle_count * 6;
+    int32_t iteration = 0;
+
+    if (eps <= 0.0)
+        eps = 1e-9;
 
+    derivs(mss, mss->y, mss->dydx);
+    while (max_residual(mss) > mss->tolerance)
+    {
+        ikreal_t errmax = 0;
 
-/* User storage for intermediate results. Preset kmax and dxsav in the calling program. If kmax 6=
-0 results are stored at approximate intervals dxsav in the arrays xp[1..kount], yp[1..nvar]
-[1..kount], where kount is output by odeint. Defining declarations for these variables, with
-memory allocations xp[1..kmax] and yp[1..nvar][1..kmax] for the arrays, should be in
-the calling program. */
+        if (iteration++ >= mss->max_iterations || t >= MSS_TIME_LIMIT)
+            return IK_OK;
+        if (t + h > MSS_TIME_LIMIT)
+            h = MSS_TIME_LIMIT - t;
 
-extern int kmax,kount;
-extern float *xp,**yp,dxsav;
+        rkck(mss, h);
+        for (i = 0; i != n; ++i)
+        {
+            ikreal_t err = fabs(mss->yerr[i]);
+            if (err > errmax)
+                errmax = err;
+        }
+        errmax /= eps;
 
-/* Runge-Kutta driver with adaptive stepsize control. Integrate starting values ystart[1..nvar]
-from x1 to x2 with accuracy eps, storing intermediate results in global variables. h1 should
-be set as a guessed first stepsize, hmin as the minimum allowed stepsize (can be zero). On
-output nok and nbad are the number of good and bad (but retried and fixed) steps taken, and
-ystart is replaced by values at the end of the integration interval. derivs is the user-supplied
-routine for calculating the right-hand side derivative, while rkqs is the name of the stepper
-routine to be used. */
+        if (errmax > 1.0)
+        {
+            /* Truncation error too large, shrink by no more than 10x */
+            ikreal_t shrunk = SAFETY * h * pow(errmax, PSHRNK);
+            h = shrunk > 0.1 * h ? shrunk : 0.1 * h;
+            continue;
+        }
 
-void odeint(float ystart[], int nvar, float x1, float x2, float eps, float h1,
-            float hmin, int *nok, int *nbad,
-            void (*derivs)(float, float [], float []))
+        /* Accept the step, and grow the next one by no more than 5x */
+        t += h;
+        for (i = 0; i != n; ++i)
+            mss->y[i] = mss->ytry[i];
+        mss->step = h = errmax > ERRCON ? SAFETY * h * pow(errmax, PGROW) : 5.0 * h;
+        derivs(mss, mss->y, mss->dydx);
+    }
+
+    return IK_RESULT_CONVERGED;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_MSS_solve(struct ik_solver_t* solver)
 {
-    int nstp,i;
-    float xsav,x,hnext,hdid,h;
-    float *yscal,*y,*dydx;
-    /*
-    yscal=vector(1,nvar);
-    y=vector(1,nvar);
-    dydx=vector(1,nvar);*/
-    x=x1;
-    /*h=SIGN(h1,x2-x1);*/
-    h=h1;
-    *nok = (*nbad) = kount = 0;
-    for (i=1;i<=nvar;i++)
-        y[i]=ystart[i];
-    if (kmax > 0) xsav=x-dxsav*2.0;   /*Assures storage of first step.*/
-    for (nstp=1;nstp<=MAXSTP;nstp++)  /*Take at most MAXSTP steps.*/
+    struct ik_solver_MSS_t* mss = (struct ik_solver_MSS_t*)solver;
+    ikreal_t* px = ROW(mss, mss->y, 0);
+    ikreal_t* py = ROW(mss, mss->y, 1);
+    ikreal_t* pz = ROW(mss, mss->y, 2);
+    ikret_t result;
+    uint32_t i, s;
+
+    if (mss->particle_count == 0)
+        return IK_RESULT_CONVERGED;
+
+    ik_transform_chain_list(&solver->chain_list, TR_L2G | TR_TRANSLATIONS);
+
+    /* Start at rest in the current pose */
+    for (i = 0; i != mss->particle_count; ++i)
     {
-        (*derivs)(x,y,dydx);
-        /*Scaling used to monitor accuracy. This general-purpose choice can be modified
-        if need be.*/
-        for (i=1;i<=nvar;i++)
-            yscal[i]=fabs(y[i])+fabs(dydx[i]*h)+TINY;
-        if (kmax > 0 && kount < kmax-1 && fabs(x-xsav) > fabs(dxsav))
+        const struct ik_node_t* node = mss->nodes[i];
+        px[i] = node->position.x;
+        py[i] = node->position.y;
+        pz[i] = node->position.z;
+        mss->pull[i] = 0;
+        if (node->effector != NULL && mss->inv_mass[i] != 0.0)
         {
-            xp[++kount]=x; /*Store intermediate results.*/
-            for (i=1;i<=nvar;i++)
-                yp[i][kount]=y[i];
-            xsav=x;
+            mss->pull[i] = MSS_TARGET_STIFFNESS;
+            mss->target[0][i] = node->effector->_actual_target.x;
+            mss->target[1][i] = node->effector->_actual_target.y;
+            mss->target[2][i] = node->effector->_actual_target.z;
         }
-        if ((x+h-x2)*(x+h-x1) > 0.0)
-            h=x2-x; /*If stepsize can overshoot, decrease*/
-        rkqs(y,dydx,nvar,&x,h,eps,yscal,&hdid,&hnext,derivs);
-        if (hdid == h)
-            ++(*nok);
         else
-            ++(*nbad);
-        if ((x-x2)*(x2-x1) >= 0.0) /*Are we done?*/
         {
-            for (i=1;i<=nvar;i++)
-                ystart[i]=y[i];
-            if (kmax)
-            {
-                xp[++kount]=x; /*Save final step.*/
-                for (i=1;i<=nvar;i++)
-                    yp[i][kount]=y[i];
-            }
-            /*
-            free_vector(dydx,1,nvar);
-            free_vector(y,1,nvar);
-            free_vector(yscal,1,nvar);*/
-            return; /*Normal exit.*/
+            mss->target[0][i] = 0;
+            mss->target[1][i] = 0;
+            mss->target[2][i] = 0;
         }
-        if (fabs(hnext) <= hmin)
+    }
+    for (i = mss->particle_count * 3; i != mss->particle_count * 6; ++i)
+        mss->y[i] = 0;
+
+    result = integrate(mss);
+
+    /* Undo the stretch of the springs, parents come before their children */
+    for (s = 0; s != mss->spring_count; ++s)
+    {
+        uint32_t a = mss->spring_parent[s];
+        uint32_t b = mss->spring_child[s];
+        ikreal_t dx = px[b] - px[a];
+        ikreal_t dy = py[b] - py[a];
+        ikreal_t dz = pz[b] - pz[a];
+        ikreal_t length = sqrt(dx*dx + dy*dy + dz*dz);
+        struct ik_node_t* node = mss->nodes[b];
+
+        if (length == 0.0)
         {
-            ik.log.message("Step size too small in odeint");
-            return;
+            dx = 1;
+            length = 1;
         }
-        h=hnext;
+        length = mss->rest_length[s] / length;
+        px[b] = px[a] + dx * length;
+        py[b] = py[a] + dy * length;
+        pz[b] = pz[a] + dz * length;
+        node->position.x = px[b];
+        node->position.y = py[b];
+        node->position.z = pz[b];
     }
 
-    ik.log.message("Too many steps in routine odeint");
+    ik_transform_chain_list(&solver->chain_list, TR_G2L | TR_TRANSLATIONS);
+
+    return result;
 }
-#endif
@@ -1,10 +1,30 @@
 #include "ik/solver_ONE_BONE.h"
-#include "ik/ik.h"
+#include "ik/batch.h"
 #include "ik/chain.h"
+#include "ik/quat_static.h"
 #include "ik/vec3_static.h"
+#include "ik/ik.h"
 #include <stddef.h>
 #include <assert.h>
 
+/*
+ * Chains are gathered into blocks and aimed BATCH_BLOCK at a time by the
+ * one_bone batch kernel (see batch.h), which is also what solve_one_bone()
+ * uses. The base node stays where it is (see iterate_base_nodes() in
+ * solver.h), only the tip is moved.
+ */
+struct block_t
+{
+    const struct chain_t* chains[BATCH_BLOCK];
+    ikreal_t base[3][BATCH_BLOCK];
+    ikreal_t target[3][BATCH_BLOCK];
+    ikreal_t forward[3][BATCH_BLOCK];
+    ikreal_t length[BATCH_BLOCK];
+    ikreal_t tip[3][BATCH_BLOCK];
+    ikreal_t rotation[4][BATCH_BLOCK];
+    uint32_t count;
+};
+
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_solver_ONE_BONE_type_size(void)
@@ -26,7 +46,7 @@ ik_solver_ONE_BONE_destruct(struct ik_solver_t* solver)
 }
 
 /* ------------------------------------------------------------------------- */
-int
+ikret_t
 ik_solver_ONE_BONE_rebuild(struct ik_solver_t* solver)
 {
     /*
@@ -36,39 +56,127 @@ ik_solver_ONE_BONE_rebuild(struct ik_solver_t* solver)
     SOLVER_FOR_EACH_CHAIN(solver, chain)
         if (chain_length(chain) != 2) /* 2 nodes = 1 bone */
         {
-            IKAPI.log.message("ERROR: Your tree has chains that are longer than 1 bone. Are you sure you selected the correct solver algorithm?");
-            return -1;
+            IKAPI.log.message("ERROR: Your tree has chains that are longer or shorter than 1 bone. Are you sure you selected the correct solver algorithm?");
+            return IK_TREE_NOT_SUPPORTED;
         }
-        if (chain_length(chain) > 0)
+        if (chain_child_count(chain) > 0)
         {
             IKAPI.log.message("ERROR: Your tree has child chains. This solver does not support arbitrary trees. You will need to switch to another algorithm (e.g. FABRIK)");
-            return -1;
+            return IK_TREE_NOT_SUPPORTED;
         }
     SOLVER_END_EACH
 
-    return 0;
+    return IK_OK;
 }
 
 /* ------------------------------------------------------------------------- */
-int
-ik_solver_ONE_BONE_solve(struct ik_solver_t* solver)
+static void
+gather_chain(struct block_t* block, const struct chain_t* chain)
 {
-    SOLVER_FOR_EACH_CHAIN(solver, chain)
-        struct ik_node_t* node_tip;
-        struct ik_node_t* node_base;
+    struct ik_node_t* node_tip  = chain_get_node(chain, 0);
+    struct ik_node_t* node_base = chain_get_node(chain, 1);
+    const struct ik_effector_t* effector = node_tip->effector;
+    uint32_t i = block->count++;
+    ik_vec3_t forward;
+    int k;
+
+    assert(effector != NULL);
+
+    /* Global direction the bone currently points in */
+    forward = node_tip->position;
+    ik_vec3_static_rotate(forward.f, node_base->rotation.f);
+
+    block->chains[i] = chain;
+    block->length[i] = node_tip->dist_to_parent;
+    for (k = 0; k != 3; ++k)
+    {
+        block->base[k][i] = node_base->position.f[k];
+        block->target[k][i] = effector->_actual_target.f[k];
+        block->forward[k][i] = forward.f[k];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_block(const struct ik_solver_t* solver, struct block_t* block)
+{
+    ikret_t result = IK_RESULT_CONVERGED;
+    int rotate = (solver->flags & IK_ENABLE_JOINT_ROTATIONS) != 0;
+    ikreal_t* tip[3];
+    ikreal_t* rotation[4] = {NULL, NULL, NULL, NULL};
+    const ikreal_t* base[3];
+    const ikreal_t* target[3];
+    const ikreal_t* forward[3];
+    uint32_t i;
+    int k;
 
-        assert(chain_length(chain) > 1);
-        node_tip  = chain_get_node(chain, 0);
-        node_base = chain_get_node(chain, 1);
+    for (k = 0; k != 3; ++k)
+    {
+        tip[k] = block->tip[k];
+        base[k] = block->base[k];
+        target[k] = block->target[k];
+        forward[k] = block->forward[k];
+    }
+    if (rotate)
+        for (k = 0; k != 4; ++k)
+            rotation[k] = block->rotation[k];
 
-        assert(node_tip->effector != NULL);
-        node_tip->position = node_tip->effector->target_position;
+    batch_kernels()->one_bone(tip, rotation, base, target, forward,
+                              block->length, block->count);
 
-        ik_vec3_static_sub_vec3(node_tip->position.f, node_base->position.f);
-        ik_vec3_static_normalize(node_tip->position.f);
-        ik_vec3_static_mul_scalar(node_tip->position.f, node_tip->dist_to_parent);
-        ik_vec3_static_add_vec3(node_tip->position.f, node_base->position.f);
+    for (i = 0; i != block->count; ++i)
+    {
+        struct ik_node_t* node_tip  = chain_get_node(block->chains[i], 0);
+        struct ik_node_t* node_base = chain_get_node(block->chains[i], 1);
+        ik_vec3_t residual;
+        ik_quat_t q;
+
+        /* The tip is only off target if the target is out of reach */
+        for (k = 0; k != 3; ++k)
+            residual.f[k] = block->target[k][i] - block->tip[k][i];
+        if (ik_vec3_static_length_squared(residual.f) > solver->tolerance * solver->tolerance)
+            result = IK_OK;
+
+        if (rotate)
+        {
+            /* The base swings the bone onto the target, the tip stays put */
+            for (k = 0; k != 4; ++k)
+                q.f[k] = block->rotation[k][i];
+            ik_quat_static_mul_quat(q.f, node_base->rotation.f);
+            node_base->rotation = q;
+        }
+        else
+        {
+            /* The rotation stays the same, so only the local position changes */
+            for (k = 0; k != 3; ++k)
+                node_tip->position.f[k] = block->tip[k][i] - block->base[k][i];
+            q = node_base->rotation;
+            ik_quat_static_conj(q.f);
+            ik_vec3_static_rotate(node_tip->position.f, q.f);
+        }
+    }
+
+    block->count = 0;
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_ONE_BONE_solve(struct ik_solver_t* solver)
+{
+    struct block_t block;
+    ikret_t result = IK_RESULT_CONVERGED;
+    block.count = 0;
+
+    SOLVER_FOR_EACH_CHAIN(solver, chain)
+        assert(chain_length(chain) == 2);
+        gather_chain(&block, chain);
+        if (block.count == BATCH_BLOCK && solve_block(solver, &block) == IK_OK)
+            result = IK_OK;
     SOLVER_END_EACH
 
-    return 0;
+    if (block.count != 0 && solve_block(solver, &block) == IK_OK)
+        result = IK_OK;
+
+    return result;
 }
@@ -1,11 +1,37 @@
 #include "ik/solver_TWO_BONE.h"
+#include "ik/batch.h"
 #include "ik/chain.h"
+#include "ik/quat_static.h"
 #include "ik/vec3_static.h"
 #include "ik/ik.h"
 #include <assert.h>
 #include <math.h>
 #include <stddef.h>
 
+/*
+ * Chains are gathered into blocks and solved BATCH_BLOCK at a time by the
+ * two_bone batch kernel (see batch.h), which is also what solve_two_bone()
+ * uses. Base node transforms are global, see iterate_base_nodes() in
+ * solver.h.
+ */
+struct block_t
+{
+    const struct chain_t* chains[BATCH_BLOCK];
+    ikreal_t base[3][BATCH_BLOCK];
+    ikreal_t target[3][BATCH_BLOCK];
+    ikreal_t pole[3][BATCH_BLOCK];
+    ikreal_t upper[BATCH_BLOCK];
+    ikreal_t lower[BATCH_BLOCK];
+    ikreal_t mid[3][BATCH_BLOCK];
+    ikreal_t tip[3][BATCH_BLOCK];
+
+    /* Global transforms before solving */
+    ik_vec3_t old_mid[BATCH_BLOCK];
+    ik_vec3_t old_tip[BATCH_BLOCK];
+    ik_quat_t mid_rotation[BATCH_BLOCK];
+    uint32_t count;
+};
+
 /* ------------------------------------------------------------------------- */
 uintptr_t
 ik_solver_TWO_BONE_type_size(void)
@@ -27,112 +53,232 @@ ik_solver_TWO_BONE_destruct(struct ik_solver_t* solver)
 }
 
 /* ------------------------------------------------------------------------- */
-int
-ik_solver_TWO_BONE_data(struct ik_solver_t* solver)
+ikret_t
+ik_solver_TWO_BONE_rebuild(struct ik_solver_t* solver)
 {
     /*
-     * We need to assert that there really are only chains of length 1 and no
+     * We need to assert that there really are only chains of 2 bones and no
      * sub chains.
      */
     SOLVER_FOR_EACH_CHAIN(solver, chain)
         if (chain_length(chain) != 3) /* 3 nodes = 2 bones */
         {
             IKAPI.log.message("ERROR: Your tree has chains that are longer or shorter than 2 bones. Are you sure you selected the correct solver algorithm?");
-            return -1;
+            return IK_TREE_NOT_SUPPORTED;
         }
-        if (chain_length(chain) > 0)
+        if (chain_child_count(chain) > 0)
         {
             IKAPI.log.message("ERROR: Your tree has child chains. This solver does not support arbitrary trees. You will need to switch to another algorithm (e.g. FABRIK)");
-            return -1;
+            return IK_TREE_NOT_SUPPORTED;
         }
     SOLVER_END_EACH
 
-    return 0;
+    return IK_OK;
 }
 
 /* ------------------------------------------------------------------------- */
-int
+static void
+rotation_between(ikreal_t q[4], const ikreal_t from[3], const ikreal_t to[3])
+{
+    ikreal_t lengths = sqrt(ik_vec3_static_length_squared(from) *
+                            ik_vec3_static_length_squared(to));
+
+    /*
+     * Half-angle identity: (from x to, |from||to| + from.to) is the rotation
+     * from "from" to "to", scaled by 2|from||to|cos(angle/2). Normalizing it
+     * gives the rotation without ever computing the angle.
+     */
+    ik_vec3_static_set(q, from);
+    ik_vec3_static_cross(q, to);
+    q[3] = lengths + ik_vec3_static_dot(from, to);
+
+    if (lengths == 0.0)
+        ik_quat_static_set_identity(q);
+    else if (q[3] <= lengths * 1e-6)
+    {
+        /* Opposite vectors, turn half way around any perpendicular axis */
+        q[0] = from[1];
+        q[1] = -from[0];
+        q[2] = 0;
+        q[3] = 0;
+        if (q[0] == 0.0 && q[1] == 0.0)
+            q[0] = 1;
+    }
+
+    ik_quat_static_normalize(q);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+move_bones(struct block_t* block, uint32_t i)
+{
+    const struct chain_t* chain = block->chains[i];
+    struct ik_node_t* node_tip  = chain_get_node(chain, 0);
+    struct ik_node_t* node_mid  = chain_get_node(chain, 1);
+    struct ik_node_t* node_base = chain_get_node(chain, 2);
+    ik_quat_t inv_rotation;
+    int k;
+
+    /* Rotations stay the same, so only the local positions change */
+    for (k = 0; k != 3; ++k)
+    {
+        node_mid->position.f[k] = block->mid[k][i] - block->base[k][i];
+        node_tip->position.f[k] = block->tip[k][i] - block->mid[k][i];
+    }
+
+    inv_rotation = node_base->rotation;
+    ik_quat_static_conj(inv_rotation.f);
+    ik_vec3_static_rotate(node_mid->position.f, inv_rotation.f);
+
+    inv_rotation = block->mid_rotation[i];
+    ik_quat_static_conj(inv_rotation.f);
+    ik_vec3_static_rotate(node_tip->position.f, inv_rotation.f);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+rotate_bones(struct block_t* block, uint32_t i)
+{
+    const struct chain_t* chain = block->chains[i];
+    struct ik_node_t* node_mid  = chain_get_node(chain, 1);
+    struct ik_node_t* node_base = chain_get_node(chain, 2);
+    ik_vec3_t from, to;
+    ik_quat_t swing, rotation;
+    int k;
+
+    /*
+     * The positions stay the same. The base swings the upper bone onto the
+     * new middle joint, which also swings the lower bone...
+     */
+    for (k = 0; k != 3; ++k)
+    {
+        from.f[k] = block->old_mid[i].f[k] - block->base[k][i];
+        to.f[k] = block->mid[k][i] - block->base[k][i];
+    }
+    rotation_between(swing.f, from.f, to.f);
+    rotation = swing;
+    ik_quat_static_mul_quat(rotation.f, node_base->rotation.f);
+    node_base->rotation = rotation;
+
+    /* ...which the middle joint then swings onto the new tip */
+    for (k = 0; k != 3; ++k)
+    {
+        from.f[k] = block->old_tip[i].f[k] - block->old_mid[i].f[k];
+        to.f[k] = block->tip[k][i] - block->mid[k][i];
+    }
+    ik_vec3_static_rotate(from.f, swing.f);
+    rotation_between(swing.f, from.f, to.f);
+
+    /* Global swing to local: conj(base) * swing * base * mid */
+    rotation = node_base->rotation;
+    ik_quat_static_conj(rotation.f);
+    ik_quat_static_mul_quat(rotation.f, swing.f);
+    ik_quat_static_mul_quat(rotation.f, node_base->rotation.f);
+    ik_quat_static_mul_quat(rotation.f, node_mid->rotation.f);
+    node_mid->rotation = rotation;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+gather_chain(struct block_t* block, const struct chain_t* chain)
+{
+    struct ik_node_t* node_tip  = chain_get_node(chain, 0);
+    struct ik_node_t* node_mid  = chain_get_node(chain, 1);
+    struct ik_node_t* node_base = chain_get_node(chain, 2);
+    const struct ik_effector_t* effector = node_tip->effector;
+    uint32_t i = block->count++;
+    ik_vec3_t pos;
+    int k;
+
+    assert(effector != NULL);
+
+    /* Global transforms of the middle joint and the tip */
+    pos = node_mid->position;
+    ik_vec3_static_rotate(pos.f, node_base->rotation.f);
+    ik_vec3_static_add_vec3(pos.f, node_base->position.f);
+    block->old_mid[i] = pos;
+    block->mid_rotation[i] = node_base->rotation;
+    ik_quat_static_mul_quat(block->mid_rotation[i].f, node_mid->rotation.f);
+
+    pos = node_tip->position;
+    ik_vec3_static_rotate(pos.f, block->mid_rotation[i].f);
+    ik_vec3_static_add_vec3(pos.f, block->old_mid[i].f);
+    block->old_tip[i] = pos;
+
+    block->chains[i] = chain;
+    block->upper[i] = node_mid->dist_to_parent;
+    block->lower[i] = node_tip->dist_to_parent;
+    for (k = 0; k != 3; ++k)
+    {
+        block->base[k][i] = node_base->position.f[k];
+        block->target[k][i] = effector->_actual_target.f[k];
+        /* Without a pole, keep bending the way the chain currently does */
+        block->pole[k][i] = (effector->flags & IK_USE_POLE) ?
+            effector->pole_position.f[k] : block->old_mid[i].f[k];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_block(const struct ik_solver_t* solver, struct block_t* block)
+{
+    ikret_t result = IK_RESULT_CONVERGED;
+    ikreal_t* mid[3];
+    ikreal_t* tip[3];
+    const ikreal_t* base[3];
+    const ikreal_t* target[3];
+    const ikreal_t* pole[3];
+    uint32_t i;
+    int k;
+
+    for (k = 0; k != 3; ++k)
+    {
+        mid[k] = block->mid[k];
+        tip[k] = block->tip[k];
+        base[k] = block->base[k];
+        target[k] = block->target[k];
+        pole[k] = block->pole[k];
+    }
+
+    batch_kernels()->two_bone(mid, tip, base, target, pole,
+                              block->upper, block->lower, block->count);
+
+    for (i = 0; i != block->count; ++i)
+    {
+        /* The tip is only off target if the target is out of reach */
+        ik_vec3_t residual;
+        for (k = 0; k != 3; ++k)
+            residual.f[k] = block->target[k][i] - block->tip[k][i];
+        if (ik_vec3_static_length_squared(residual.f) > solver->tolerance * solver->tolerance)
+            result = IK_OK;
+
+        if (solver->flags & IK_ENABLE_JOINT_ROTATIONS)
+            rotate_bones(block, i);
+        else
+            move_bones(block, i);
+    }
+
+    block->count = 0;
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
 ik_solver_TWO_BONE_solve(struct ik_solver_t* solver)
 {
+    struct block_t block;
+    ikret_t result = IK_RESULT_CONVERGED;
+    block.count = 0;
+
     SOLVER_FOR_EACH_CHAIN(solver, chain)
-        struct ik_node_t* node_tip;
-        struct ik_node_t* node_mid;
-        struct ik_node_t* node_base;
-        ik_vec3_t to_target;
-        ikreal_t a, b, c, aa, bb, cc;
-
-        assert(chain_length(chain) > 2);
-        node_tip  = chain_get_node(chain, 0);
-        node_mid  = chain_get_node(chain, 1);
-        node_base = chain_get_node(chain, 2);
-
-        assert(node_tip->effector != NULL);
-        to_target = node_tip->effector->target_position;
-        ik_vec3_static_sub_vec3(to_target.f, node_base->position.f);
-
-        /*
-         * Form a triangle from the two segment lengths so we can calculate the
-         * angles. Here's some visual help.
-         *
-         *   target *--.__  a
-         *           \     --.___ (unknown position, needs solving)
-         *            \      _-
-         *           c \   _-
-         *              \-    b
-         *            base
-         *
-         */
-        a = node_tip->dist_to_parent;
-        b = node_mid->dist_to_parent;
-        aa = a*a;
-        bb = b*b;
-        cc = ik_vec3_static_length_squared(to_target.f);
-        c = sqrt(cc);
-
-        /* check if in reach */
-        if (c < a + b)
-        {
-            /* Cosine law to get base angle (alpha) */
-            ik_quat_t alpha_rotation;
-            ikreal_t alpha = acos((bb + cc - aa) / (2.0 * node_mid->dist_to_parent * sqrt(cc)));
-            ikreal_t cos_a = cos(alpha * 0.5);
-            ikreal_t sin_a = sin(alpha * 0.5);
-
-            /* Cross product of both segment vectors defines axis of rotation */
-            alpha_rotation.v = node_tip->position;
-            ik_vec3_static_sub_vec3(alpha_rotation.f, node_mid->position.f);  /* top segment */
-            ik_vec3_static_sub_vec3(node_mid->position.f, node_base->position.f);  /* bottom segment */
-            ik_vec3_static_cross(alpha_rotation.f, node_mid->position.f);
-
-            /*
-             * Set up quaternion describing the rotation of alpha. Need to
-             * normalise vec3 component of quaternion so rotation is correct.
-             */
-            ik_vec3_static_normalize(alpha_rotation.f);
-            ik_vec3_static_mul_scalar(alpha_rotation.f, sin_a);
-            alpha_rotation.w = cos_a;
-
-            /* Rotate side c and scale to length of side b to get the unknown position */
-            node_mid->position = to_target;
-            ik_vec3_static_normalize(node_mid->position.f);
-            ik_vec3_static_mul_scalar(node_mid->position.f, node_mid->dist_to_parent);
-            ik_vec3_static_rotate(node_mid->position.f, alpha_rotation.f);
-            ik_vec3_static_add_vec3(node_mid->position.f, node_base->position.f);
-
-            node_tip->position = node_tip->effector->target_position;
-        }
-        else
-        {
-            /* Just point both segments at target */
-            ik_vec3_static_normalize(to_target.f);
-            node_mid->position = to_target;
-            node_tip->position = to_target;
-            ik_vec3_static_mul_scalar(node_mid->position.f, node_mid->dist_to_parent);
-            ik_vec3_static_mul_scalar(node_tip->position.f, node_tip->dist_to_parent);
-            ik_vec3_static_add_vec3(node_mid->position.f, node_base->position.f);
-            ik_vec3_static_add_vec3(node_tip->position.f, node_mid->position.f);
-        }
+        assert(chain_length(chain) == 3);
+        gather_chain(&block, chain);
+        if (block.count == BATCH_BLOCK && solve_block(solver, &block) == IK_OK)
+            result = IK_OK;
     SOLVER_END_EACH
 
-    return 0;
+    if (block.count != 0 && solve_block(solver, &block) == IK_OK)
+        result = IK_OK;
+
+    return result;
 }
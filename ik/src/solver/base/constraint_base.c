@@ -1,6 +1,7 @@
 #include "ik/constraint_base.h"
 #include "ik/ik.h"
 #include "ik/memory.h"
+#include "ik/pool.h"
 #include <string.h>
 #include <assert.h>
 
@@ -91,6 +92,7 @@ ik_constraint_base_detach(struct ik_constraint_t* constraint)
     if (constraint->node == NULL)
         return;
 
+    constraint->node->v->mark_dirty(constraint->node);
     constraint->node->constraint = NULL;
     constraint->node = NULL;
 }
@@ -114,6 +116,9 @@ ik_constraint_base_attach(struct ik_constraint_t* constraint, struct ik_node_t*
 
     constraint->node = node;
     node->constraint = constraint;
+    node->v->mark_dirty(node);
+    if (node->pool != NULL && constraint->pool != node->pool)
+        node->pool->has_foreign_objects = 1;
 
     return 0;
 }
@@ -129,11 +134,20 @@ ik_constraint_base_create(enum ik_constraint_type_e constraint_type)
         return NULL;
     }
 
+    ik_constraint_base_construct(constraint, constraint_type);
+
+    return constraint;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_constraint_base_construct(struct ik_constraint_t* constraint, enum ik_constraint_type_e constraint_type)
+{
     memset(constraint, 0, sizeof *constraint);
     constraint->v = &IKAPI.internal.constraint_base;
     constraint->v->set_type(constraint, constraint_type);
 
-    return constraint;
+    return IK_OK;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -141,5 +155,8 @@ void
 ik_constraint_base_destroy(struct ik_constraint_t* constraint)
 {
     constraint->v->detach(constraint);
-    FREE(constraint);
+    if (constraint->pool != NULL)
+        slab_free(&constraint->pool->constraints, constraint);
+    else
+        FREE(constraint);
 }
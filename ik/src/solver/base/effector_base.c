@@ -1,6 +1,7 @@
 #include "ik/effector_base.h"
 #include "ik/ik.h"
 #include "ik/memory.h"
+#include "ik/pool.h"
 #include "ik/vec3_static.h"
 #include "ik/quat_static.h"
 #include <string.h>
@@ -13,6 +14,15 @@ ik_effector_base_create(void)
     if (effector == NULL)
         return NULL;
 
+    ik_effector_base_construct(effector);
+
+    return effector;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_effector_base_construct(struct ik_effector_t* effector)
+{
     memset(effector, 0, sizeof *effector);
     ik_vec3_static_set_zero(effector->target_position.f);
     ik_quat_static_set_identity(effector->target_rotation.f);
@@ -21,7 +31,7 @@ ik_effector_base_create(void)
     effector->rotation_decay = 0.25;
     effector->v = &IKAPI.internal.effector_base;
 
-    return effector;
+    return IK_OK;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -29,7 +39,10 @@ void
 ik_effector_base_destroy(struct ik_effector_t* effector)
 {
     ik_effector_base_detach(effector);
-    FREE(effector);
+    if (effector->pool != NULL)
+        slab_free(&effector->pool->effectors, effector);
+    else
+        FREE(effector);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -51,6 +64,9 @@ ik_effector_base_attach(struct ik_effector_t* effector, struct ik_node_t* node)
 
     node->effector = effector;
     effector->node = node;
+    node->v->mark_dirty(node);
+    if (node->pool != NULL && effector->pool != node->pool)
+        node->pool->has_foreign_objects = 1;
 
     return 0;
 }
@@ -62,6 +78,7 @@ ik_effector_base_detach(struct ik_effector_t* effector)
     if (effector->node == NULL)
         return;
 
+    effector->node->v->mark_dirty(effector->node);
     effector->node->effector = NULL;
     effector->node = NULL;
 }
@@ -1,12 +1,21 @@
 #include "ik/node_base.h"
+#include "ik/guid_index.h"
 #include "ik/ik.h"
 #include "ik/memory.h"
+#include "ik/pool.h"
 #include "ik/quat_static.h"
 #include "ik/vec3_static.h"
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
 
+/* ------------------------------------------------------------------------- */
+uintptr_t
+ik_node_base_type_size(void)
+{
+    return sizeof(struct ik_node_t);
+}
+
 /* ------------------------------------------------------------------------- */
 struct ik_node_t*
 ik_node_base_create(uint32_t guid)
@@ -27,15 +36,29 @@ ikret_t
 ik_node_base_construct(struct ik_node_t* node, uint32_t guid)
 {
     memset(node, 0, sizeof *node);
+#if !defined(IK_NODE_CHILDREN_LINKED)
     bstv_construct(&node->children);
+#endif
     node->v = &IKAPI.internal.node_base;
     node->guid = guid;
+    node->dirty = 1;
+    node->bone_index = -1;
     ik_quat_static_set_identity(node->rotation.f);
     ik_vec3_static_set_zero(node->rotation.f);
 
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+static void
+free_node(struct ik_node_t* node)
+{
+    if (node->pool != NULL)
+        slab_free(&node->pool->nodes, node);
+    else
+        FREE(node);
+}
+
 /* ------------------------------------------------------------------------- */
 static void
 destroy_recursive(struct ik_node_t* node);
@@ -51,11 +74,21 @@ destruct_recursive(struct ik_node_t* node)
     if (node->constraint)
         node->constraint->v->destroy(node->constraint);
 
+#if !defined(IK_NODE_CHILDREN_LINKED)
     bstv_clear_free(&node->children);
+#endif
 }
 void
 ik_node_base_destruct(struct ik_node_t* node)
 {
+    /*
+     * Unlink first so the parent's guid index is updated while the children
+     * still exist. If the node still has an index afterwards, it owns it.
+     */
+    node->v->unlink(node);
+    if (node->guid_index != NULL)
+        guid_index_destroy(node->guid_index);
+
     NODE_FOR_EACH(node, guid, child)
         destroy_recursive(child);
     NODE_END_EACH
@@ -65,8 +98,12 @@ ik_node_base_destruct(struct ik_node_t* node)
     if (node->constraint)
         node->constraint->v->destroy(node->constraint);
 
-    node->v->unlink(node);
+#if defined(IK_NODE_CHILDREN_LINKED)
+    node->first_child = NULL;
+    node->child_count = 0;
+#else
     bstv_clear_free(&node->children);
+#endif
 }
 
 /* ------------------------------------------------------------------------- */
@@ -74,7 +111,7 @@ static void
 destroy_recursive(struct ik_node_t* node)
 {
     destruct_recursive(node);
-    FREE(node);
+    free_node(node);
 }
 void
 ik_node_base_destroy(struct ik_node_t* node)
@@ -82,17 +119,90 @@ ik_node_base_destroy(struct ik_node_t* node)
     if (IKAPI.internal.callbacks->on_node_destroy != NULL)
         IKAPI.internal.callbacks->on_node_destroy(node);
     node->v->destruct(node);
-    FREE(node);
+    free_node(node);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+set_guid_index(struct ik_node_t* node, struct ik_guid_index_t* index)
+{
+    node->guid_index = index;
+    NODE_FOR_EACH(node, guid, child)
+        set_guid_index(child, index);
+    NODE_END_EACH
+}
+static void
+drop_guid_index(struct ik_guid_index_t* index)
+{
+    set_guid_index(index->root, NULL);
+    guid_index_destroy(index);
+}
+static ikret_t
+index_subtree(struct ik_guid_index_t* index, struct ik_node_t* node)
+{
+    ikret_t result;
+    node->guid_index = index;
+    if ((result = guid_index_insert(index, node)) != IK_OK)
+        return result;
+
+    NODE_FOR_EACH(node, guid, child)
+        if ((result = index_subtree(index, child)) != IK_OK)
+            return result;
+    NODE_END_EACH
+
+    return IK_OK;
+}
+static void
+unindex_subtree(struct ik_guid_index_t* index, struct ik_node_t* node)
+{
+    guid_index_erase(index, node);
+    node->guid_index = NULL;
+    NODE_FOR_EACH(node, guid, child)
+        unindex_subtree(index, child);
+    NODE_END_EACH
 }
 
 /* ------------------------------------------------------------------------- */
 ikret_t
 ik_node_base_add_child(struct ik_node_t* node, struct ik_node_t* child)
 {
+    /* A tree that becomes part of another tree gives up its own index */
+    if (child->guid_index != NULL && child->guid_index->root == child)
+        drop_guid_index(child->guid_index);
+
+#if defined(IK_NODE_CHILDREN_LINKED)
+    /* Append, so children are iterated in the order they were added */
+    child->next_sibling = NULL;
+    if (node->first_child == NULL)
+    {
+        node->first_child = child;
+        child->prev_sibling = child;
+    }
+    else
+    {
+        struct ik_node_t* last = node->first_child->prev_sibling;
+        last->next_sibling = child;
+        child->prev_sibling = last;
+        node->first_child->prev_sibling = child;
+    }
+    node->child_count++;
+#else
     ikret_t result;
     if ((result = bstv_insert(&node->children, child->guid, child)) != IK_OK)
         return result;
+#endif
     child->parent = node;
+    child->dirty = 1;
+    node->v->mark_dirty(node);
+    if (node->pool != NULL && child->pool != node->pool)
+        node->pool->has_foreign_objects = 1;
+
+    if (node->guid_index != NULL && index_subtree(node->guid_index, child) != IK_OK)
+    {
+        IKAPI.log.message("Discarding guid index: Ran out of memory");
+        drop_guid_index(node->guid_index);
+    }
+
     return IK_OK;
 }
 
@@ -100,7 +210,8 @@ ik_node_base_add_child(struct ik_node_t* node, struct ik_node_t* child)
 struct ik_node_t*
 ik_node_base_create_child(struct ik_node_t* node, uint32_t guid)
 {
-    struct ik_node_t* child = node->v->create(guid);
+    struct ik_node_t* child = node->pool != NULL ?
+        pool_create_node(node->pool, node->v, guid) : node->v->create(guid);
     if (child == NULL)
         goto create_child_failed;
     if (node->v->add_child(node, child) != IK_OK)
@@ -119,17 +230,75 @@ ik_node_base_unlink(struct ik_node_t* node)
     if (node->parent == NULL)
         return;
 
+    node->v->mark_dirty(node->parent);
+    if (node->guid_index != NULL)
+        unindex_subtree(node->guid_index, node);
+#if defined(IK_NODE_CHILDREN_LINKED)
+    {
+        struct ik_node_t* parent = node->parent;
+        if (parent->first_child == node)
+            parent->first_child = node->next_sibling;
+        else
+            node->prev_sibling->next_sibling = node->next_sibling;
+
+        if (node->next_sibling != NULL)
+            node->next_sibling->prev_sibling = node->prev_sibling;
+        else if (parent->first_child != NULL)
+            parent->first_child->prev_sibling = node->prev_sibling;
+
+        node->next_sibling = NULL;
+        node->prev_sibling = NULL;
+        parent->child_count--;
+    }
+#else
     bstv_erase(&node->parent->children, node->guid);
+#endif
     node->parent = NULL;
+    node->dirty = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_node_base_mark_dirty(struct ik_node_t* node)
+{
+    /*
+     * The parents of a dirty node are always dirty as well, so we can stop
+     * at the first node that is already marked.
+     */
+    for (; node != NULL && node->dirty == 0; node = node->parent)
+        node->dirty = 1;
 }
 
 /* ------------------------------------------------------------------------- */
 struct ik_node_t*
 ik_node_base_find_child(const struct ik_node_t* node, uint32_t guid)
 {
-    struct ik_node_t* found = bstv_find(&node->children, guid);
+    struct ik_node_t* found;
+
+    if (node->guid_index != NULL)
+    {
+        const struct ik_node_t* ancestor;
+        found = guid_index_find(node->guid_index, guid);
+        if (node->parent == NULL)
+            return found;
+
+        /* The index covers the whole tree, only return nodes in our subtree */
+        for (ancestor = found; ancestor != NULL; ancestor = ancestor->parent)
+            if (ancestor == node)
+                return found;
+        return NULL;
+    }
+
+#if defined(IK_NODE_CHILDREN_LINKED)
+    NODE_FOR_EACH(node, child_guid, child)
+        if (child_guid == guid)
+            return child;
+    NODE_END_EACH
+#else
+    found = bstv_find(&node->children, guid);
     if (found != NULL)
         return found;
+#endif
 
     if (node->guid == guid)
         return (struct ik_node_t*)node;
@@ -143,6 +312,29 @@ ik_node_base_find_child(const struct ik_node_t* node, uint32_t guid)
     return NULL;
 }
 
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_node_base_build_guid_index(struct ik_node_t* node)
+{
+    ikret_t result;
+    struct ik_guid_index_t* index;
+
+    while (node->parent != NULL)
+        node = node->parent;
+    if (node->guid_index != NULL)
+        return IK_OK;
+
+    if ((index = guid_index_create(node)) == NULL)
+        return IK_RAN_OUT_OF_MEMORY;
+    if ((result = index_subtree(index, node)) != IK_OK)
+    {
+        drop_guid_index(index);
+        return result;
+    }
+
+    return IK_OK;
+}
+
 /* ------------------------------------------------------------------------- */
 struct ik_node_t*
 ik_node_base_duplicate(const struct ik_node_t* node, int copy_attachments)
@@ -168,6 +360,8 @@ ik_node_base_duplicate(const struct ik_node_t* node, int copy_attachments)
             if (new_effector == NULL)
                 goto copy_child_node_failed;
             memcpy(new_effector, node->effector, sizeof *new_effector);
+            new_effector->node = NULL;
+            new_effector->pool = NULL;
             ei->attach(new_effector, new_node);
         }
         if (node->constraint != NULL)
@@ -177,6 +371,8 @@ ik_node_base_duplicate(const struct ik_node_t* node, int copy_attachments)
             if (new_constraint == NULL)
                 goto copy_child_node_failed;
             memcpy(new_constraint, node->constraint, sizeof *new_constraint);
+            new_constraint->node = NULL;
+            new_constraint->pool = NULL;
             ci->attach(new_constraint, new_node);
         }
     }
@@ -1,7 +1,10 @@
 #include "ik/ik.h"
 #include "ik/solver_base.h"
+#include "ik/batch.h"
 #include "ik/chain.h"
 #include "ik/memory.h"
+#include "ik/pool.h"
+#include "ik/pose.h"
 #include "ik/quat_static.h"
 #include "ik/transform.h"
 #include "ik/vec3_static.h"
@@ -40,23 +43,64 @@ ik_solver_base_construct(struct ik_solver_t* solver)
 {
     solver->max_iterations = 20;
     solver->tolerance = 1e-2;
+    solver->warm_start_blend = 0.0;
+    solver->warm_start_threshold = 1.0;
     solver->flags = IK_ENABLE_JOINT_ROTATIONS;
+    solver->topology = 0;
+    solver->pool = NULL;
+    if ((solver->chain_storage = MALLOC(sizeof *solver->chain_storage)) == NULL)
+    {
+        IKAPI.log.message("Failed to allocate chain storage: Ran out of memory");
+        return IK_RAN_OUT_OF_MEMORY;
+    }
+    chain_storage_construct(solver->chain_storage);
+    if ((solver->pose_table = MALLOC(sizeof *solver->pose_table)) == NULL)
+    {
+        IKAPI.log.message("Failed to allocate pose table: Ran out of memory");
+        chain_storage_destruct(solver->chain_storage);
+        FREE(solver->chain_storage);
+        return IK_RAN_OUT_OF_MEMORY;
+    }
+    pose_table_construct(solver->pose_table);
     vector_construct(&solver->effector_nodes_list, sizeof(struct ik_node_t*));
     vector_construct(&solver->chain_list, sizeof(struct chain_t));
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+static void
+release_tree(struct ik_solver_t* solver, struct ik_node_t* base, int allow_bulk)
+{
+    struct ik_pool_t* pool = solver->pool;
+
+    /*
+     * If everything in the tree came from our pool, there's no need to visit
+     * each node. Releasing the pool takes care of all of them.
+     */
+    if (allow_bulk && pool != NULL && base->pool == pool && !pool->has_foreign_objects)
+    {
+        if (IKAPI.internal.callbacks->on_node_destroy != NULL)
+            IKAPI.internal.callbacks->on_node_destroy(base);
+        pool_clear(pool);
+    }
+    else
+        solver->node->destroy(base);
+}
+
 /* ------------------------------------------------------------------------- */
 void
 ik_solver_base_destruct(struct ik_solver_t* solver)
 {
     if (solver->tree)
-        solver->node->destroy(solver->tree);
+        release_tree(solver, solver->tree, 1);
+    if (solver->pool)
+        pool_destroy(solver->pool);
 
-    SOLVER_FOR_EACH_CHAIN(solver, chain)
-        chain_destruct(chain);
-    SOLVER_END_EACH
     vector_clear_free(&solver->chain_list);
+    chain_storage_destruct(solver->chain_storage);
+    FREE(solver->chain_storage);
+    pose_table_destruct(solver->pose_table);
+    FREE(solver->pose_table);
 
     vector_clear_free(&solver->effector_nodes_list);
 }
@@ -72,9 +116,12 @@ ik_solver_base_unlink_tree(struct ik_solver_t* solver)
 
     /*
      * Effectors are owned by the nodes, but we need to release references to
-     * them.
+     * them. The same goes for the chains.
      */
     vector_clear(&solver->effector_nodes_list);
+    vector_clear(&solver->chain_list);
+    pose_table_clear(solver->pose_table);
+    solver->topology = 0;
 
     return base;
 }
@@ -86,18 +133,90 @@ ik_solver_base_destroy_tree(struct ik_solver_t* solver)
     struct ik_node_t* base;
     if ((base = solver->v->unlink_tree(solver)) == NULL)
         return;
-    solver->node->destroy(base);
+    release_tree(solver, base, 1);
 }
 
 /* ------------------------------------------------------------------------- */
 void
 ik_solver_base_set_tree(struct ik_solver_t* solver, struct ik_node_t* base)
 {
-    solver->v->destroy_tree(solver);
+    struct ik_node_t* old_base;
+
+    /* The new tree may have been allocated from the same pool as the old one */
+    if ((old_base = solver->v->unlink_tree(solver)) != NULL)
+        release_tree(solver, old_base, base == NULL || base->pool != solver->pool);
     solver->tree = base;
+
+    /* Nothing was built from this tree yet */
+    if (base != NULL)
+        base->dirty = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct ik_pool_t*
+get_pool(struct ik_solver_t* solver)
+{
+    if (solver->pool == NULL)
+        solver->pool = pool_create(solver->node->type_size());
+    return solver->pool;
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+ik_solver_base_create_node(struct ik_solver_t* solver, uint32_t guid)
+{
+    struct ik_pool_t* pool = get_pool(solver);
+    if (pool == NULL)
+        return NULL;
+    return pool_create_node(pool, solver->node, guid);
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_effector_t*
+ik_solver_base_create_effector(struct ik_solver_t* solver)
+{
+    struct ik_effector_t* effector;
+    struct ik_pool_t* pool = get_pool(solver);
+    if (pool == NULL)
+        return NULL;
+
+    if ((effector = slab_alloc(&pool->effectors)) == NULL)
+        return NULL;
+    solver->effector->construct(effector);
+    effector->pool = pool;
+
+    return effector;
 }
 
 /* ------------------------------------------------------------------------- */
+struct ik_constraint_t*
+ik_solver_base_create_constraint(struct ik_solver_t* solver,
+                                 enum ik_constraint_type_e constraint_type)
+{
+    struct ik_constraint_t* constraint;
+    struct ik_pool_t* pool = get_pool(solver);
+    if (pool == NULL)
+        return NULL;
+
+    if ((constraint = slab_alloc(&pool->constraints)) == NULL)
+        return NULL;
+    solver->constraint->construct(constraint, constraint_type);
+    constraint->pool = pool;
+
+    return constraint;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+effector_chain_lengths_changed(const struct ik_solver_t* solver)
+{
+    SOLVER_FOR_EACH_EFFECTOR_NODE(solver, node)
+        if (node->effector->chain_length != node->effector->_built_chain_length)
+            return 1;
+    SOLVER_END_EACH
+
+    return 0;
+}
 int
 ik_solver_base_rebuild(struct ik_solver_t* solver)
 {
@@ -110,26 +229,46 @@ ik_solver_base_rebuild(struct ik_solver_t* solver)
         return IK_SOLVER_HAS_NO_TREE;
     }
 
+    /*
+     * If no node was touched since the last rebuild and no effector changed
+     * its chain length, then the chains are still valid.
+     */
+    if (solver->tree->dirty == 0 && !effector_chain_lengths_changed(solver))
+    {
+        update_distances(&solver->chain_list);
+        return IK_OK;
+    }
+
     /*
      * Traverse the entire tree and generate a list of the effectors. This
      * makes the process of building the chain list for FABRIK much easier.
+     * Effectors can only have been added or removed if the tree is dirty.
      */
-    IKAPI.log.message("Rebuilding effector nodes list");
-    vector_clear(&solver->effector_nodes_list);
-    if ((result = recursively_get_all_effector_nodes(
-            solver->tree,
-            &solver->effector_nodes_list)) != IK_OK)
+    if (solver->tree->dirty)
     {
-        IKAPI.log.message("Ran out of memory while building the effector nodes list");
-        return result;
+        IKAPI.log.message("Rebuilding effector nodes list");
+        vector_clear(&solver->effector_nodes_list);
+        if ((result = recursively_get_all_effector_nodes(
+                solver->tree,
+                &solver->effector_nodes_list)) != IK_OK)
+        {
+            IKAPI.log.message("Ran out of memory while building the effector nodes list");
+            return result;
+        }
+
+        /* Bone indices can only have changed if the tree is dirty */
+        if ((result = pose_table_build(solver->pose_table, solver->tree)) != IK_OK)
+            return result;
     }
 
-    /* now build the chain tree */
-    if ((result = chain_tree_rebuild(
+    /* now update the chain tree */
+    if ((result = chain_tree_update(
+            solver->chain_storage,
             &solver->chain_list,
             solver->tree,
             &solver->effector_nodes_list)) != IK_OK)
         return result;
+    solver->topology = chain_tree_hash(&solver->chain_list);
 
     update_distances(&solver->chain_list);
 
@@ -213,6 +352,230 @@ ik_solver_base_solve(struct ik_solver_t* solver)
     return IK_OK;
 }
 
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_solve_batch(struct ik_solver_t** solvers, int count)
+{
+    ikret_t result = IK_RESULT_CONVERGED;
+    int i;
+
+    if (count <= 0)
+        return IK_OK;
+
+    for (i = 0; i != count; ++i)
+    {
+        ikret_t solver_result = solvers[i]->v->solve(solvers[i]);
+        if (solver_result < result)
+            result = solver_result;
+    }
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_solve_lanes(struct ik_solver_t** solvers, int count)
+{
+    /* Solvers without a lockstep implementation are solved one by one */
+    return ik_solver_base_solve_batch(solvers, count);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_base_solve_two_bone(const struct ik_two_bone_batch_t* batch, int32_t count)
+{
+    assert("Don't use this function! Use ik.solver.solve_two_bone()");
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_base_solve_one_bone(const struct ik_one_bone_batch_t* batch, int32_t count)
+{
+    assert("Don't use this function! Use ik.solver.solve_one_bone()");
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_get_island_stats(const struct ik_solver_t* solver, int island_idx,
+                                int32_t* iterations, ikreal_t* residual)
+{
+    if (island_idx < 0 || island_idx >= (int)vector_count(&solver->chain_list))
+        return IK_INDEX_OUT_OF_RANGE;
+
+    if (iterations != NULL)
+        *iterations = 0;
+    if (residual != NULL)
+        *residual = 0.0;
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/*
+ * The global transforms are accumulated serially while walking the tree, and
+ * then converted to matrices with the batch kernels BATCH_BLOCK at a time.
+ */
+struct matrix_block_t
+{
+    ikreal_t* matrices;
+    const ikreal_t* inverse_bind;
+    int32_t bone_count;
+    ikret_t result;
+
+    uint32_t count;
+    int32_t bones[BATCH_BLOCK];
+    ikreal_t qx[BATCH_BLOCK], qy[BATCH_BLOCK], qz[BATCH_BLOCK], qw[BATCH_BLOCK];
+    ikreal_t px[BATCH_BLOCK], py[BATCH_BLOCK], pz[BATCH_BLOCK];
+    ikreal_t m[12][BATCH_BLOCK];
+    ikreal_t bind[12][BATCH_BLOCK];
+};
+static void
+flush_matrices(struct matrix_block_t* block)
+{
+    const struct batch_kernels_t* batch = batch_kernels();
+    ikreal_t* m[12];
+    const ikreal_t* bind[12];
+    uint32_t i;
+    int k;
+
+    for (k = 0; k != 12; ++k)
+    {
+        m[k] = block->m[k];
+        bind[k] = block->bind[k];
+    }
+
+    batch->to_matrix(m, block->qx, block->qy, block->qz, block->qw,
+                     block->px, block->py, block->pz, block->count);
+
+    if (block->inverse_bind != NULL)
+    {
+        for (i = 0; i != block->count; ++i)
+        {
+            const ikreal_t* src = &block->inverse_bind[(uintptr_t)block->bones[i] * 12];
+            for (k = 0; k != 12; ++k)
+                block->bind[k][i] = src[k];
+        }
+        batch->matrix_mul(m, bind, block->count);
+    }
+
+    for (i = 0; i != block->count; ++i)
+    {
+        ikreal_t* dst = &block->matrices[(uintptr_t)block->bones[i] * 12];
+        for (k = 0; k != 12; ++k)
+            dst[k] = block->m[k][i];
+    }
+
+    block->count = 0;
+}
+static void
+write_matrices_recursive(struct ik_node_t* node, const ikreal_t parent[7],
+                         struct matrix_block_t* block)
+{
+    ikreal_t acc[7];
+    ik_quat_static_set(acc, parent);
+    ik_quat_static_mul_quat(acc, node->rotation.f);
+    ik_vec3_static_set(acc + 4, node->position.f);
+    ik_vec3_static_rotate(acc + 4, parent);
+    ik_vec3_static_add_vec3(acc + 4, parent + 4);
+
+    if (node->bone_index >= block->bone_count)
+        block->result = IK_INDEX_OUT_OF_RANGE;
+    else if (node->bone_index >= 0)
+    {
+        uint32_t i = block->count++;
+        block->bones[i] = node->bone_index;
+        block->qx[i] = acc[0];
+        block->qy[i] = acc[1];
+        block->qz[i] = acc[2];
+        block->qw[i] = acc[3];
+        block->px[i] = acc[4];
+        block->py[i] = acc[5];
+        block->pz[i] = acc[6];
+        if (block->count == BATCH_BLOCK)
+            flush_matrices(block);
+    }
+
+    NODE_FOR_EACH(node, guid, child)
+        write_matrices_recursive(child, acc, block);
+    NODE_END_EACH
+}
+ikret_t
+ik_solver_base_write_matrices(const struct ik_solver_t* solver, ikreal_t* matrices,
+                              const ikreal_t* inverse_bind, int32_t bone_count)
+{
+    struct matrix_block_t block;
+    ikreal_t identity[7] = {0, 0, 0, 1, 0, 0, 0};
+
+    if (solver->tree == NULL)
+    {
+        IKAPI.log.message("Warning: Tried writing matrices, but no tree was set");
+        return IK_SOLVER_HAS_NO_TREE;
+    }
+
+    block.matrices = matrices;
+    block.inverse_bind = inverse_bind;
+    block.bone_count = bone_count;
+    block.result = IK_OK;
+    block.count = 0;
+
+    write_matrices_recursive(solver->tree, identity, &block);
+    flush_matrices(&block);
+
+    return block.result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_get_pose(struct ik_solver_t* solver, enum ik_pose_space_e space,
+                        ikreal_t* positions, uintptr_t position_stride,
+                        ikreal_t* rotations, uintptr_t rotation_stride,
+                        const int32_t* remap, int32_t count)
+{
+    if (solver->tree == NULL)
+    {
+        IKAPI.log.message("Warning: Tried getting the pose, but no tree was set");
+        return IK_SOLVER_HAS_NO_TREE;
+    }
+
+    return pose_table_get(solver->pose_table, space == IK_POSE_GLOBAL,
+                          positions, position_stride,
+                          rotations, rotation_stride,
+                          remap, count);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_base_set_pose(struct ik_solver_t* solver, enum ik_pose_space_e space,
+                        const ikreal_t* positions, uintptr_t position_stride,
+                        const ikreal_t* rotations, uintptr_t rotation_stride,
+                        const int32_t* remap, int32_t count)
+{
+    if (solver->tree == NULL)
+    {
+        IKAPI.log.message("Warning: Tried setting the pose, but no tree was set");
+        return IK_SOLVER_HAS_NO_TREE;
+    }
+
+    return pose_table_set(solver->pose_table, space == IK_POSE_GLOBAL,
+                          positions, position_stride,
+                          rotations, rotation_stride,
+                          remap, count);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_base_bind_pose(struct ik_solver_t* solver, const struct ik_pose_binding_t* binding)
+{
+    struct pose_table_t* table = solver->pose_table;
+    if (binding == NULL)
+    {
+        table->bound = 0;
+        return;
+    }
+
+    table->binding = *binding;
+    table->bound = 1;
+}
+
 /* ------------------------------------------------------------------------- */
 static void
 iterate_tree_recursive(struct ik_node_t* node,
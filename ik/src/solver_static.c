@@ -1,6 +1,9 @@
 #include "ik/solver_static.h"
 #include "ik/ik.h"
+#include "ik/batch.h"
 #include "ik/memory.h"
+#include "ik/pose.h"
+#include "ik/thread_pool_static.h"
 #include <assert.h>
 #include <string.h>
 
@@ -91,7 +94,130 @@ ik_solver_static_update_distances(struct ik_solver_t* solver)
 ikret_t
 ik_solver_static_solve(struct ik_solver_t* solver)
 {
-    return solver->v->solve(solver);
+    ikret_t result;
+    if (solver->flags & IK_ENABLE_PARALLEL_ISLANDS)
+        ik_thread_pool_static_start();
+
+    ik_memory_enter_solve();
+    pose_table_pull(solver->pose_table);
+    result = solver->v->solve(solver);
+    pose_table_push(solver->pose_table);
+    ik_memory_leave_solve();
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+solve_batch_job(void* user_data, uint32_t job_idx)
+{
+    struct ik_solver_t* solver = ((struct ik_solver_t**)user_data)[job_idx];
+    ikret_t result;
+    pose_table_pull(solver->pose_table);
+    result = solver->v->solve(solver);
+    pose_table_push(solver->pose_table);
+    return result;
+}
+ikret_t
+ik_solver_static_solve_batch(struct ik_solver_t** solvers, int count)
+{
+    ikret_t result;
+    if (count <= 0)
+        return IK_OK;
+
+    ik_thread_pool_static_start();
+    ik_memory_enter_solve();
+    result = ik_thread_pool_static_run(solve_batch_job, solvers, (uint32_t)count);
+    ik_memory_leave_solve();
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_solve_lanes(struct ik_solver_t** solvers, int count)
+{
+    ikret_t result;
+    int i;
+
+    /* Grouping is up to the implementation, which knows its own data */
+    if (count <= 0)
+        return IK_OK;
+
+    ik_thread_pool_static_start();
+    ik_memory_enter_solve();
+    for (i = 0; i != count; ++i)
+        pose_table_pull(solvers[i]->pose_table);
+    result = solvers[0]->v->solve_lanes(solvers, count);
+    for (i = 0; i != count; ++i)
+        pose_table_push(solvers[i]->pose_table);
+    ik_memory_leave_solve();
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_static_solve_two_bone(const struct ik_two_bone_batch_t* batch, int32_t count)
+{
+    if (count <= 0)
+        return;
+
+    batch_kernels()->two_bone(batch->mid, batch->tip, batch->base, batch->target, batch->pole,
+                              batch->upper_length, batch->lower_length, (uint32_t)count);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_static_solve_one_bone(const struct ik_one_bone_batch_t* batch, int32_t count)
+{
+    if (count <= 0)
+        return;
+
+    batch_kernels()->one_bone(batch->tip, batch->rotation, batch->base, batch->target,
+                              batch->forward, batch->length, (uint32_t)count);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_get_island_stats(const struct ik_solver_t* solver, int island_idx,
+                                  int32_t* iterations, ikreal_t* residual)
+{
+    return solver->v->get_island_stats(solver, island_idx, iterations, residual);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_write_matrices(const struct ik_solver_t* solver, ikreal_t* matrices,
+                                const ikreal_t* inverse_bind, int32_t bone_count)
+{
+    return solver->v->write_matrices(solver, matrices, inverse_bind, bone_count);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_get_pose(struct ik_solver_t* solver, enum ik_pose_space_e space,
+                          ikreal_t* positions, uintptr_t position_stride,
+                          ikreal_t* rotations, uintptr_t rotation_stride,
+                          const int32_t* remap, int32_t count)
+{
+    return solver->v->get_pose(solver, space, positions, position_stride,
+                               rotations, rotation_stride, remap, count);
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_solver_static_set_pose(struct ik_solver_t* solver, enum ik_pose_space_e space,
+                          const ikreal_t* positions, uintptr_t position_stride,
+                          const ikreal_t* rotations, uintptr_t rotation_stride,
+                          const int32_t* remap, int32_t count)
+{
+    return solver->v->set_pose(solver, space, positions, position_stride,
+                               rotations, rotation_stride, remap, count);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_solver_static_bind_pose(struct ik_solver_t* solver, const struct ik_pose_binding_t* binding)
+{
+    solver->v->bind_pose(solver, binding);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -115,6 +241,28 @@ ik_solver_static_destroy_tree(struct ik_solver_t* solver)
     solver->v->destroy_tree(solver);
 }
 
+/* ------------------------------------------------------------------------- */
+struct ik_node_t*
+ik_solver_static_create_node(struct ik_solver_t* solver, uint32_t guid)
+{
+    return solver->v->create_node(solver, guid);
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_effector_t*
+ik_solver_static_create_effector(struct ik_solver_t* solver)
+{
+    return solver->v->create_effector(solver);
+}
+
+/* ------------------------------------------------------------------------- */
+struct ik_constraint_t*
+ik_solver_static_create_constraint(struct ik_solver_t* solver,
+                                   enum ik_constraint_type_e constraint_type)
+{
+    return solver->v->create_constraint(solver, constraint_type);
+}
+
 /* ------------------------------------------------------------------------- */
 void
 ik_solver_static_iterate_all_nodes(struct ik_solver_t* solver, ik_solver_iterate_node_cb_func callback)
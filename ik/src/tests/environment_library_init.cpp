@@ -16,6 +16,7 @@ public:
 
     virtual void TearDown()
     {
+        EXPECT_THAT(IKAPI.heap.solve_allocation_count(), Eq(0u)) << "Number of allocations during solve()";
         EXPECT_THAT(IKAPI.deinit(), Eq(0u)) << "Number of memory leaks";
     }
 };
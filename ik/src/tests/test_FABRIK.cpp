@@ -1,5 +1,9 @@
 #include "gmock/gmock.h"
 #include "ik/ik.h"
+#include "ik/solver_FABRIK.h"
+#include "ik/transform.h"
+#include <string.h>
+#include <vector>
 
 #define NAME FABRIK
 
@@ -10,6 +14,691 @@ TEST(NAME, todo)
     ASSERT_TRUE(0);
 }
 
+static ikreal_t length_of(const ik_vec3_t& v)
+{
+    return sqrt(v.x*v.x + v.y*v.y + v.z*v.z);
+}
+
+TEST(NAME, single_chain_reaches_target)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    ik_node_t* n1 = solver->node->create_child(root, 1);
+    ik_node_t* n2 = solver->node->create_child(n1, 2);
+    ik_node_t* n3 = solver->node->create_child(n2, 3);
+    n1->position.y = 1;
+    n2->position.y = 1;
+    n3->position.y = 1;
+
+    ik_effector_t* eff = solver->effector->create();
+    solver->effector->attach(eff, n3);
+    eff->target_position = IKAPI.vec3.vec3(1, 2, 0);
+
+    solver->flags &= ~IK_ENABLE_JOINT_ROTATIONS;
+    IKAPI.solver.set_tree(solver, root);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+
+    // Segment lengths are preserved
+    EXPECT_THAT(length_of(n1->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(n2->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(n3->position), DoubleNear(1, 1e-6));
+
+    // Without joint rotations the global position is the sum of all segments
+    EXPECT_THAT(n1->position.x + n2->position.x + n3->position.x, DoubleNear(1, 1e-2));
+    EXPECT_THAT(n1->position.y + n2->position.y + n3->position.y, DoubleNear(2, 1e-2));
+    EXPECT_THAT(n1->position.z + n2->position.z + n3->position.z, DoubleNear(0, 1e-2));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, sub_base_is_averaged_between_arms)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    ik_node_t* spine = solver->node->create_child(root, 1);
+    ik_node_t* sub_base = solver->node->create_child(spine, 2);
+    ik_node_t* l1 = solver->node->create_child(sub_base, 3);
+    ik_node_t* l2 = solver->node->create_child(l1, 4);
+    ik_node_t* r1 = solver->node->create_child(sub_base, 5);
+    ik_node_t* r2 = solver->node->create_child(r1, 6);
+    spine->position.y = 1;
+    sub_base->position.y = 1;
+    l1->position.x = -1;
+    l2->position.x = -1;
+    r1->position.x = 1;
+    r2->position.x = 1;
+
+    ik_effector_t* eff_l = solver->effector->create();
+    ik_effector_t* eff_r = solver->effector->create();
+    solver->effector->attach(eff_l, l2);
+    solver->effector->attach(eff_r, r2);
+    eff_l->target_position = IKAPI.vec3.vec3(-1.5, 2.5, 0.5);
+    eff_r->target_position = IKAPI.vec3.vec3(1.5, 2.5, 0.5);
+
+    solver->flags &= ~IK_ENABLE_JOINT_ROTATIONS;
+    solver->max_iterations = 100;
+    IKAPI.solver.set_tree(solver, root);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    IKAPI.solver.solve(solver);
+
+    EXPECT_THAT(length_of(spine->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(sub_base->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(l1->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(l2->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(r1->position), DoubleNear(1, 1e-6));
+    EXPECT_THAT(length_of(r2->position), DoubleNear(1, 1e-6));
+
+    // Symmetric targets keep the sub-base on the symmetry plane
+    EXPECT_THAT(spine->position.x + sub_base->position.x, DoubleNear(0, 1e-6));
+
+    ik_vec3_t left = IKAPI.vec3.vec3(0, 0, 0);
+    ik_vec3_t right = IKAPI.vec3.vec3(0, 0, 0);
+    ik_node_t* left_path[] = {spine, sub_base, l1, l2};
+    ik_node_t* right_path[] = {spine, sub_base, r1, r2};
+    for (int i = 0; i != 4; ++i)
+    {
+        left.x += left_path[i]->position.x; left.y += left_path[i]->position.y; left.z += left_path[i]->position.z;
+        right.x += right_path[i]->position.x; right.y += right_path[i]->position.y; right.z += right_path[i]->position.z;
+    }
+    EXPECT_THAT(left.x, DoubleNear(-1.5, 1e-2));
+    EXPECT_THAT(left.y, DoubleNear(2.5, 1e-2));
+    EXPECT_THAT(left.z, DoubleNear(0.5, 1e-2));
+    EXPECT_THAT(right.x, DoubleNear(1.5, 1e-2));
+    EXPECT_THAT(right.y, DoubleNear(2.5, 1e-2));
+    EXPECT_THAT(right.z, DoubleNear(0.5, 1e-2));
+
+    IKAPI.solver.destroy(solver);
+}
+
+static ik_solver_t* create_three_islands(uint8_t flags)
+{
+    // Two islands hang off of "shared", one off of "root". Every effector
+    // only reaches up two nodes, which splits the tree into islands.
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    ik_node_t* shared = solver->node->create_child(root, 1);
+    shared->position.y = 1;
+    IKAPI.solver.set_tree(solver, root);
+
+    ik_node_t* bases[] = {shared, shared, root};
+    for (int arm = 0; arm != 3; ++arm)
+    {
+        ik_node_t* parent = bases[arm];
+        for (int i = 0; i != 2; ++i)
+        {
+            parent = solver->node->create_child(parent, 10 * (arm + 1) + i);
+            parent->position = IKAPI.vec3.vec3(arm - 1, 1, 0);
+        }
+        ik_effector_t* eff = solver->effector->create();
+        solver->effector->attach(eff, parent);
+        eff->chain_length = 2;
+        eff->target_position = IKAPI.vec3.vec3(arm, 2, 1);
+    }
+
+    solver->flags = flags;
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(vector_count(&solver->chain_list), Eq(3u));
+    return solver;
+}
+
+static void expect_identical_nodes(ik_node_t* a, ik_node_t* b)
+{
+    EXPECT_THAT(memcmp(a->transform, b->transform, sizeof(a->transform)), Eq(0)) << "node " << a->guid;
+    NODE_FOR_EACH(a, guid, child)
+        expect_identical_nodes(child, b->v->find_child(b, guid));
+    NODE_END_EACH
+}
+
+TEST(NAME, parallel_islands_are_identical_to_serial)
+{
+    ik_solver_t* serial = create_three_islands(IK_ENABLE_JOINT_ROTATIONS);
+    ik_solver_t* parallel = create_three_islands(IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_PARALLEL_ISLANDS);
+    IKAPI.thread_pool.set_worker_count(2);
+
+    for (int i = 0; i != 3; ++i)
+        EXPECT_THAT(IKAPI.solver.solve(parallel), Eq(IKAPI.solver.solve(serial)));
+    expect_identical_nodes(serial->tree, parallel->tree);
+
+    IKAPI.thread_pool.set_worker_count(-1);
+    IKAPI.solver.destroy(serial);
+    IKAPI.solver.destroy(parallel);
+}
+
+TEST(NAME, solved_islands_stop_after_one_iteration)
+{
+    ik_solver_t* solver = create_three_islands(0);
+    solver->max_iterations = 20;
+
+    // The target of the arm attached to root is out of reach, move it closer
+    for (unsigned i = 0; i != vector_count(&solver->effector_nodes_list); ++i)
+    {
+        ik_node_t* tip = *(ik_node_t**)vector_get_element(&solver->effector_nodes_list, i);
+        if (tip->guid == 31)
+            tip->effector->target_position = IKAPI.vec3.vec3(1.5, 1.5, 0.5);
+    }
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    int32_t iterations;
+    ikreal_t residual;
+    for (int island = 0; island != 3; ++island)
+    {
+        EXPECT_THAT(IKAPI.solver.get_island_stats(solver, island, &iterations, &residual), Eq(IK_RESULT_CONVERGED));
+        EXPECT_THAT(iterations, Gt(0));
+        EXPECT_THAT(iterations, Lt(20));
+        EXPECT_THAT(residual, Le(solver->tolerance));
+    }
+
+    // The pose now satisfies every target
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+    for (int island = 0; island != 3; ++island)
+    {
+        EXPECT_THAT(IKAPI.solver.get_island_stats(solver, island, &iterations, NULL), Eq(IK_RESULT_CONVERGED));
+        EXPECT_THAT(iterations, Eq(1));
+    }
+    EXPECT_THAT(IKAPI.solver.get_island_stats(solver, 3, NULL, NULL), Eq(IK_INDEX_OUT_OF_RANGE));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, unreachable_target_uses_all_iterations)
+{
+    // Only the target of the arm attached to root is out of reach
+    ik_solver_t* solver = create_three_islands(0);
+    solver->max_iterations = 7;
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+
+    int island_idx = -1;
+    int32_t iterations;
+    ikreal_t residual;
+    for (int island = 0; island != 3; ++island)
+        if (IKAPI.solver.get_island_stats(solver, island, &iterations, &residual) == IK_OK)
+        {
+            EXPECT_THAT(island_idx, Eq(-1));
+            island_idx = island;
+            EXPECT_THAT(iterations, Eq(7));
+            EXPECT_THAT(residual, Gt(0.1));
+        }
+    EXPECT_THAT(island_idx, Ne(-1));
+
+    IKAPI.solver.destroy(solver);
+}
+
+static ik_solver_t* create_arm(uint8_t flags, ik_node_t** nodes)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    nodes[0] = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, nodes[0]);
+    for (int i = 1; i != 6; ++i)
+    {
+        nodes[i] = solver->node->create_child(nodes[i - 1], i);
+        nodes[i]->position = IKAPI.vec3.vec3(0, 1, 0);
+    }
+    solver->effector->attach(solver->effector->create(), nodes[5]);
+    solver->flags = flags;
+    solver->max_iterations = 100;
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    return solver;
+}
+
+static int32_t solve_frame(ik_solver_t* solver, ik_node_t** nodes, const ik_vec3_t& target)
+{
+    // Like an engine writing the animated pose back every frame
+    for (int i = 1; i != 6; ++i)
+        nodes[i]->position = IKAPI.vec3.vec3(0, 1, 0);
+    nodes[5]->effector->target_position = target;
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    int32_t iterations;
+    IKAPI.solver.get_island_stats(solver, 0, &iterations, NULL);
+    return iterations;
+}
+
+TEST(NAME, warm_start_needs_fewer_iterations_for_slow_targets)
+{
+    ik_node_t* cold_nodes[6];
+    ik_node_t* warm_nodes[6];
+    ik_solver_t* cold = create_arm(0, cold_nodes);
+    ik_solver_t* warm = create_arm(IK_ENABLE_WARM_START, warm_nodes);
+    int32_t cold_total = 0, warm_total = 0;
+
+    for (int frame = 0; frame != 20; ++frame)
+    {
+        ik_vec3_t target = IKAPI.vec3.vec3(2 + 0.01 * frame, 2, 0.02 * frame);
+        int32_t cold_iterations = solve_frame(cold, cold_nodes, target);
+        int32_t warm_iterations = solve_frame(warm, warm_nodes, target);
+        if (frame == 0)
+            EXPECT_THAT(warm_iterations, Eq(cold_iterations));
+        else
+            EXPECT_THAT(warm_iterations, Le(3));
+        cold_total += cold_iterations;
+        warm_total += warm_iterations;
+    }
+    EXPECT_THAT(warm_total, Lt(cold_total));
+
+    // A target jumping further than the threshold starts cold again
+    ik_vec3_t target = IKAPI.vec3.vec3(-2, 2, -2);
+    EXPECT_THAT(solve_frame(warm, warm_nodes, target), Eq(solve_frame(cold, cold_nodes, target)));
+
+    IKAPI.solver.destroy(cold);
+    IKAPI.solver.destroy(warm);
+}
+
+TEST(NAME, last_iteration_writes_back_same_pose_as_converging)
+{
+    // The last allowed iteration writes the nodes back to local space in the
+    // same sweep as the backward pass, otherwise it's done separately after
+    ik_node_t* fused_nodes[6];
+    ik_node_t* separate_nodes[6];
+    ik_solver_t* fused = create_arm(0, fused_nodes);
+    ik_solver_t* separate = create_arm(0, separate_nodes);
+    ik_vec3_t target = IKAPI.vec3.vec3(2, 2, 1);
+    for (int i = 0; i != 6; ++i)
+    {
+        // Joint rotations are off, these only affect the local space
+        ik_quat_t rotation = IKAPI.quat.quat(0.1 * i, 0.2, -0.1, 1);
+        IKAPI.quat.normalize(rotation.f);
+        fused_nodes[i]->rotation = separate_nodes[i]->rotation = rotation;
+    }
+
+    int32_t iterations = solve_frame(separate, separate_nodes, target);
+    ASSERT_THAT(iterations, Gt(1));
+    fused->max_iterations = iterations;
+    EXPECT_THAT(solve_frame(fused, fused_nodes, target), Eq(iterations));
+
+    // The fused pass rotates the segment instead of the difference of the
+    // global positions, which only differs in rounding
+    for (int i = 0; i != 6; ++i)
+        for (int k = 0; k != 7; ++k)
+            EXPECT_THAT(fused_nodes[i]->transform[k], DoubleNear(separate_nodes[i]->transform[k], 1e-12))
+                << "node " << i;
+
+    // The segments keep their lengths and the tip is on the target
+    ik_transform_chain_list(&fused->chain_list, TR_L2G);
+    for (int i = 1; i != 6; ++i)
+    {
+        ik_vec3_t segment = fused_nodes[i]->position;
+        IKAPI.vec3.sub_vec3(segment.f, fused_nodes[i - 1]->position.f);
+        EXPECT_THAT(length_of(segment), DoubleNear(1, 1e-9)) << "node " << i;
+    }
+    IKAPI.vec3.sub_vec3(target.f, fused_nodes[5]->position.f);
+    EXPECT_THAT(length_of(target), Le(fused->tolerance));
+
+    IKAPI.solver.destroy(fused);
+    IKAPI.solver.destroy(separate);
+}
+
+TEST(NAME, rebuild_without_changes_keeps_topology)
+{
+    ik_solver_t* solver = create_three_islands(0);
+    uint64_t topology = solver->topology;
+
+    EXPECT_THAT(solver->tree->dirty, Eq(0));
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(solver->topology, Eq(topology));
+
+    IKAPI.solver.destroy(solver);
+}
+
+static void edit_three_islands(ik_solver_t* solver)
+{
+    // Move the effector of arm 1 one node further down
+    ik_node_t* node_21 = solver->node->find_child(solver->tree, 21);
+    ik_node_t* leaf = solver->node->create_child(node_21, 22);
+    leaf->position.y = 1;
+    solver->effector->destroy(node_21->effector);
+    ik_effector_t* eff = solver->effector->create();
+    solver->effector->attach(eff, leaf);
+    eff->chain_length = 3;
+    eff->target_position = IKAPI.vec3.vec3(0, 3, 1);
+}
+
+TEST(NAME, incremental_rebuild_matches_full_rebuild)
+{
+    ik_solver_t* incremental = create_three_islands(IK_ENABLE_JOINT_ROTATIONS);
+    ik_solver_t* full = create_three_islands(IK_ENABLE_JOINT_ROTATIONS);
+    uint64_t topology = incremental->topology;
+
+    // Changing the chain length is picked up without marking anything
+    incremental->node->find_child(incremental->tree, 31)->effector->chain_length = 1;
+    full->node->find_child(full->tree, 31)->effector->chain_length = 1;
+    ASSERT_THAT(IKAPI.solver.rebuild(incremental), Eq(IK_OK));
+    EXPECT_THAT(incremental->topology, Ne(topology));
+
+    edit_three_islands(incremental);
+    edit_three_islands(full);
+    ASSERT_THAT(IKAPI.solver.rebuild(incremental), Eq(IK_OK));
+
+    // Setting the tree again discards all chains
+    IKAPI.solver.set_tree(full, IKAPI.solver.unlink_tree(full));
+    ASSERT_THAT(IKAPI.solver.rebuild(full), Eq(IK_OK));
+    EXPECT_THAT(vector_count(&incremental->chain_list), Eq(vector_count(&full->chain_list)));
+
+
+    for (int i = 0; i != 3; ++i)
+        EXPECT_THAT(IKAPI.solver.solve(incremental), Eq(IKAPI.solver.solve(full)));
+    expect_identical_nodes(incremental->tree, full->tree);
+
+    // Island indices refer to the same islands
+    for (int island = 0; island != 3; ++island)
+    {
+        int32_t incremental_iterations, full_iterations;
+        ikreal_t incremental_residual, full_residual;
+        EXPECT_THAT(IKAPI.solver.get_island_stats(incremental, island, &incremental_iterations, &incremental_residual),
+                    Eq(IKAPI.solver.get_island_stats(full, island, &full_iterations, &full_residual)));
+        EXPECT_THAT(incremental_iterations, Eq(full_iterations)) << "island " << island;
+        EXPECT_THAT(incremental_residual, Eq(full_residual)) << "island " << island;
+    }
+
+    // Solvers sharing lanes stop all of their islands at the same time, which
+    // only happens if both were compiled to the same program
+    ik_solver_t* solvers[] = {full, incremental};
+    for (int s = 0; s != 2; ++s)
+    {
+        solvers[s]->node->find_child(solvers[s]->tree, 31)->effector->target_position = IKAPI.vec3.vec3(-5, 1, 1);
+        solvers[s]->max_iterations = 30;
+    }
+    EXPECT_THAT(IKAPI.solver.solve_lanes(solvers, 2), Eq(IK_OK));
+    expect_identical_nodes(incremental->tree, full->tree);
+    for (int s = 0; s != 2; ++s)
+        for (int island = 0; island != 3; ++island)
+        {
+            int32_t iterations;
+            IKAPI.solver.get_island_stats(solvers[s], island, &iterations, NULL);
+            EXPECT_THAT(iterations, Eq(30)) << "solver " << s << " island " << island;
+        }
+
+    IKAPI.solver.destroy(incremental);
+    IKAPI.solver.destroy(full);
+}
+
+static void edit_both(ik_solver_t* solvers[2], uint32_t guid, void (*edit)(ik_node_t*))
+{
+    for (int s = 0; s != 2; ++s)
+        edit(solvers[s]->node->find_child(solvers[s]->tree, guid));
+}
+
+static void solve_without_cache(ik_solver_t* solver)
+{
+    // Invalidates the global space cache of every island
+    program_t* program = &((ik_solver_FABRIK_t*)solver)->program;
+    memset(program->island_cached, 0, program->island_count);
+    IKAPI.solver.solve(solver);
+}
+
+TEST(NAME, global_space_cache_matches_solving_without_it)
+{
+    ik_solver_t* solvers[2] = {create_three_islands(0), create_three_islands(0)};
+    ik_solver_t* cached = solvers[0];
+    ik_solver_t* uncached = solvers[1];
+
+    const int steps = 7;
+    for (int step = 0; step != steps; ++step)
+    {
+        switch (step)
+        {
+            // Base node of the two islands hanging off of "shared"
+            case 1: edit_both(solvers, 1, [](ik_node_t* node) { node->position.x += 0.5; }); break;
+            // Only rotations, the base of the third island and a node within one
+            case 2: edit_both(solvers, 0, [](ik_node_t* node) {
+                        node->rotation = IKAPI.quat.quat(0, 0.2, 0, 1);
+                        IKAPI.quat.normalize(node->rotation.f);
+                    }); break;
+            case 3: edit_both(solvers, 10, [](ik_node_t* node) {
+                        node->rotation = IKAPI.quat.quat(0.3, 0, 0, 1);
+                        IKAPI.quat.normalize(node->rotation.f);
+                    }); break;
+            // A node's position within an island
+            case 4: edit_both(solvers, 20, [](ik_node_t* node) { node->position.z = 0.5; }); break;
+            // Joint rotations bypass the cache and change the rotations
+            case 5:
+            case 6:
+                for (int s = 0; s != 2; ++s)
+                    solvers[s]->flags ^= IK_ENABLE_JOINT_ROTATIONS;
+                break;
+        }
+
+        IKAPI.solver.solve(cached);
+        solve_without_cache(uncached);
+        expect_identical_nodes(cached->tree, uncached->tree);
+    }
+    EXPECT_THAT(cached->flags, Eq(0));
+
+    IKAPI.solver.destroy(cached);
+    IKAPI.solver.destroy(uncached);
+}
+
+TEST(NAME, write_matrices_matches_global_transforms)
+{
+    // More bones than fit into one block of the batch kernels
+    const int bone_count = 40;
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    ik_node_t* node = root;
+    root->position = IKAPI.vec3.vec3(1, 2, 3);
+    for (int i = 0; i != bone_count; ++i)
+    {
+        node = solver->node->create_child(node, i + 1);
+        node->position = IKAPI.vec3.vec3(0, 1, 0.1 * i);
+        node->rotation = IKAPI.quat.quat(0.1, 0, 0.2, 1);
+        IKAPI.quat.normalize(node->rotation.f);
+        node->bone_index = bone_count - 1 - i;
+    }
+    IKAPI.solver.set_tree(solver, root);
+
+    std::vector<ikreal_t> global(bone_count * 12);
+    ASSERT_THAT(IKAPI.solver.write_matrices(solver, global.data(), NULL, bone_count), Eq(IK_OK));
+
+    ik_quat_t acc_rot = root->rotation;
+    ik_vec3_t acc_pos = root->position;
+    node = root;
+    for (int i = 0; i != bone_count; ++i)
+    {
+        node = node->v->find_child(node, i + 1);
+        ik_vec3_t pos = node->position;
+        IKAPI.vec3.rotate(pos.f, acc_rot.f);
+        IKAPI.vec3.add_vec3(acc_pos.f, pos.f);
+        IKAPI.quat.mul_quat(acc_rot.f, node->rotation.f);
+
+        // The columns are the rotated axes, the last one is the position
+        const ikreal_t* m = &global[node->bone_index * 12];
+        ik_vec3_t axis = IKAPI.vec3.vec3(0, 1, 0);
+        IKAPI.vec3.rotate(axis.f, acc_rot.f);
+        EXPECT_THAT(m[1], DoubleNear(axis.x, 1e-5));
+        EXPECT_THAT(m[5], DoubleNear(axis.y, 1e-5));
+        EXPECT_THAT(m[9], DoubleNear(axis.z, 1e-5));
+        EXPECT_THAT(m[3], DoubleNear(acc_pos.x, 1e-4));
+        EXPECT_THAT(m[7], DoubleNear(acc_pos.y, 1e-4));
+        EXPECT_THAT(m[11], DoubleNear(acc_pos.z, 1e-4));
+    }
+
+    // Skinning with the inverse of the pose itself gives identity matrices
+    std::vector<ikreal_t> inverse_bind(bone_count * 12);
+    for (int b = 0; b != bone_count; ++b)
+    {
+        const ikreal_t* m = &global[b * 12];
+        ikreal_t* inv = &inverse_bind[b * 12];
+        for (int r = 0; r != 3; ++r)
+        {
+            for (int c = 0; c != 3; ++c)
+                inv[r*4+c] = m[c*4+r];
+            inv[r*4+3] = -(m[0*4+r]*m[3] + m[1*4+r]*m[7] + m[2*4+r]*m[11]);
+        }
+    }
+    std::vector<ikreal_t> skinning(bone_count * 12);
+    ASSERT_THAT(IKAPI.solver.write_matrices(solver, skinning.data(), inverse_bind.data(), bone_count), Eq(IK_OK));
+    for (int b = 0; b != bone_count; ++b)
+        for (int k = 0; k != 12; ++k)
+            EXPECT_THAT(skinning[b * 12 + k], DoubleNear(k % 5 == 0 ? 1 : 0, 1e-4)) << "bone " << b;
+
+    // Bones that don't fit into the array are skipped
+    node->bone_index = bone_count;
+    EXPECT_THAT(IKAPI.solver.write_matrices(solver, global.data(), NULL, bone_count), Eq(IK_INDEX_OUT_OF_RANGE));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, get_and_set_pose_round_trip)
+{
+    const int bone_count = 40;
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    ik_node_t* node = root;
+    std::vector<ik_node_t*> bones(bone_count);
+    for (int i = 0; i != bone_count; ++i)
+    {
+        node = solver->node->create_child(node, i + 1);
+        node->position = IKAPI.vec3.vec3(0, 1, 0.1 * i);
+        node->rotation = IKAPI.quat.quat(0.1, 0, 0.2, 1);
+        IKAPI.quat.normalize(node->rotation.f);
+        node->bone_index = bone_count - 1 - i;
+        bones[node->bone_index] = node;
+    }
+    IKAPI.solver.set_tree(solver, root);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    // Interleaved like the caller's own bone structure
+    struct bone_t { ikreal_t pos[3]; ikreal_t rot[4]; int32_t flags; };
+    std::vector<bone_t> global(bone_count);
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_GLOBAL,
+        global[0].pos, sizeof(bone_t), global[0].rot, sizeof(bone_t), NULL, bone_count), Eq(IK_OK));
+
+    std::vector<ikreal_t> matrices(bone_count * 12);
+    ASSERT_THAT(IKAPI.solver.write_matrices(solver, matrices.data(), NULL, bone_count), Eq(IK_OK));
+    for (int b = 0; b != bone_count; ++b)
+    {
+        EXPECT_THAT(global[b].pos[0], DoubleNear(matrices[b * 12 + 3], 1e-4));
+        EXPECT_THAT(global[b].pos[1], DoubleNear(matrices[b * 12 + 7], 1e-4));
+        EXPECT_THAT(global[b].pos[2], DoubleNear(matrices[b * 12 + 11], 1e-4));
+    }
+
+    // Element i is bone remap[i], the arrays are tightly packed
+    int32_t remap[] = {7, 0, 39};
+    ikreal_t positions[3 * 3];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_LOCAL, positions, 0, NULL, 0, remap, 3), Eq(IK_OK));
+    for (int i = 0; i != 3; ++i)
+        for (int k = 0; k != 3; ++k)
+            EXPECT_THAT(positions[i * 3 + k], DoubleEq(bones[remap[i]]->position.f[k]));
+
+    // Setting the global pose again restores the local transforms
+    std::vector<ikreal_t> local(bone_count * 7);
+    for (int b = 0; b != bone_count; ++b)
+    {
+        for (int k = 0; k != 7; ++k)
+            local[b * 7 + k] = bones[b]->transform[k];
+        bones[b]->position = IKAPI.vec3.vec3(0, 0, 0);
+        bones[b]->rotation = IKAPI.quat.quat(0, 0, 0, 1);
+    }
+    ASSERT_THAT(IKAPI.solver.set_pose(solver, IK_POSE_GLOBAL,
+        global[0].pos, sizeof(bone_t), global[0].rot, sizeof(bone_t), NULL, bone_count), Eq(IK_OK));
+    for (int b = 0; b != bone_count; ++b)
+        for (int k = 0; k != 7; ++k)
+            EXPECT_THAT(bones[b]->transform[k], DoubleNear(local[b * 7 + k], 1e-4)) << "bone " << b;
+
+    // Unknown bones are skipped
+    int32_t unknown[] = {bone_count};
+    EXPECT_THAT(IKAPI.solver.set_pose(solver, IK_POSE_LOCAL, positions, 0, NULL, 0, unknown, 1), Eq(IK_INDEX_OUT_OF_RANGE));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, solve_reads_and_writes_bound_pose)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* nodes[4];
+    nodes[0] = solver->node->create(0);
+    for (int i = 1; i != 4; ++i)
+    {
+        nodes[i] = solver->node->create_child(nodes[i - 1], i);
+        nodes[i]->position.y = 1;
+    }
+    for (int i = 0; i != 4; ++i)
+        nodes[i]->bone_index = i;
+
+    ik_effector_t* eff = solver->effector->create();
+    solver->effector->attach(eff, nodes[3]);
+    eff->target_position = IKAPI.vec3.vec3(6, 2, 0);
+
+    solver->flags &= ~IK_ENABLE_JOINT_ROTATIONS;
+    IKAPI.solver.set_tree(solver, nodes[0]);
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    // The caller's pose moves the base of the chain
+    float pos[3][4] = {{5, 0, 0, 0}, {0, 1, 1, 1}, {0, 0, 0, 0}};
+    float rot[4][4] = {{0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {1, 1, 1, 1}};
+    ik_pose_binding_t binding = {IK_BINDING_FLOAT, {pos[0], pos[1], pos[2]}, {rot[0], rot[1], rot[2], rot[3]}, 4};
+    IKAPI.solver.bind_pose(solver, &binding);
+    IKAPI.solver.solve(solver);
+
+    EXPECT_THAT(nodes[0]->position.x, DoubleEq(5));
+    ik_vec3_t tip = IKAPI.vec3.vec3(0, 0, 0);
+    for (int i = 0; i != 4; ++i)
+    {
+        IKAPI.vec3.add_vec3(tip.f, nodes[i]->position.f);
+        for (int k = 0; k != 3; ++k)
+            EXPECT_THAT(pos[k][i], FloatEq((float)nodes[i]->position.f[k])) << "bone " << i;
+        for (int k = 0; k != 4; ++k)
+            EXPECT_THAT(rot[k][i], FloatEq((float)nodes[i]->rotation.f[k])) << "bone " << i;
+    }
+    EXPECT_THAT(tip.x, DoubleNear(6, 1e-2));
+    EXPECT_THAT(tip.y, DoubleNear(2, 1e-2));
+
+    // Unbound arrays aren't touched anymore
+    IKAPI.solver.bind_pose(solver, NULL);
+    pos[0][0] = 0;
+    IKAPI.solver.solve(solver);
+    EXPECT_THAT(nodes[0]->position.x, DoubleEq(5));
+    EXPECT_THAT(pos[0][0], FloatEq(0));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, solve_does_not_allocate)
+{
+    uint8_t flags[] = {
+        0,
+        IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_TARGET_ROTATIONS,
+        IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_PARALLEL_ISLANDS,
+        IK_ENABLE_JOINT_ROTATIONS | IK_ENABLE_WARM_START
+    };
+    IKAPI.thread_pool.set_worker_count(2);
+
+    for (int i = 0; i != 4; ++i)
+    {
+        // The first solve with parallel islands starts the worker threads
+        ik_solver_t* solver = create_three_islands(flags[i]);
+        IKAPI.solver.solve(solver);
+        uintptr_t allocations = IKAPI.heap.allocation_count();
+        for (int frame = 0; frame != 3; ++frame)
+            IKAPI.solver.solve(solver);
+        EXPECT_THAT(IKAPI.heap.allocation_count(), Eq(allocations)) << "flags " << int(flags[i]);
+        IKAPI.solver.destroy(solver);
+    }
+
+    IKAPI.thread_pool.set_worker_count(-1);
+}
+
+TEST(NAME, rebuilding_same_tree_does_not_allocate)
+{
+    ik_solver_t* solver = create_three_islands(IK_ENABLE_JOINT_ROTATIONS);
+
+    // Setting the tree again discards all chains. The first time around, the
+    // chain storage's second block is allocated.
+    IKAPI.solver.set_tree(solver, IKAPI.solver.unlink_tree(solver));
+    ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+    uintptr_t allocations = IKAPI.heap.allocation_count();
+    for (int i = 0; i != 3; ++i)
+    {
+        IKAPI.solver.set_tree(solver, IKAPI.solver.unlink_tree(solver));
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    }
+    EXPECT_THAT(IKAPI.heap.allocation_count(), Eq(allocations));
+    EXPECT_THAT(vector_count(&solver->chain_list), Eq(3u));
+
+    IKAPI.solver.destroy(solver);
+}
+
 /*
 class NAME : public Test
 {
@@ -0,0 +1,93 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "test_util.h"
+
+#define NAME MSS
+
+using namespace ::testing;
+
+/*
+ * Base (bone 0) with a chain of two bones going up to node 2, which splits
+ * into two arms of two bones each. The arms end in bones 4 and 6.
+ */
+static ik_solver_t* create_two_arms(ik_effector_t** left, ik_effector_t** right)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_MSS);
+    ik_node_t* base = solver->node->create(0);
+    ik_node_t* n1 = solver->node->create_child(base, 1);
+    ik_node_t* n2 = solver->node->create_child(n1, 2);
+    ik_node_t* l1 = solver->node->create_child(n2, 3);
+    ik_node_t* l2 = solver->node->create_child(l1, 4);
+    ik_node_t* r1 = solver->node->create_child(n2, 5);
+    ik_node_t* r2 = solver->node->create_child(r1, 6);
+    n1->position.y = 1;
+    n2->position.y = 1;
+    l1->position = IKAPI.vec3.vec3(-1, 0, 0);
+    l2->position = IKAPI.vec3.vec3(-1, 0, 0);
+    r1->position = IKAPI.vec3.vec3(1, 0, 0);
+    r2->position = IKAPI.vec3.vec3(1, 0, 0);
+    ik_node_t* nodes[] = {base, n1, n2, l1, l2, r1, r2};
+    for (int i = 0; i != 7; ++i)
+        nodes[i]->bone_index = i;
+
+    *left = solver->effector->create();
+    *right = solver->effector->create();
+    solver->effector->attach(*left, l2);
+    solver->effector->attach(*right, r2);
+    IKAPI.solver.set_tree(solver, base);
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    return solver;
+}
+
+TEST(NAME, reaches_targets_and_keeps_bone_lengths)
+{
+    ik_effector_t *left, *right;
+    ik_solver_t* solver = create_two_arms(&left, &right);
+    left->target_position = IKAPI.vec3.vec3(-1.5, 2.5, 0.5);
+    right->target_position = IKAPI.vec3.vec3(1.5, 1.0, -0.5);
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+    ikreal_t global[7 * 3];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_GLOBAL, global, 0, NULL, 0, NULL, 7), Eq(IK_OK));
+    int parent[] = {-1, 0, 1, 2, 3, 2, 5};
+    for (int i = 1; i != 7; ++i)
+        EXPECT_THAT(distance(&global[i * 3], &global[parent[i] * 3]), DoubleNear(1, 1e-6)) << "bone " << i;
+    EXPECT_THAT(distance(&global[4 * 3], left->target_position.f), Lt(0.01));
+    EXPECT_THAT(distance(&global[6 * 3], right->target_position.f), Lt(0.01));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, stops_when_out_of_budget)
+{
+    ik_effector_t *left, *right;
+    ik_solver_t* solver = create_two_arms(&left, &right);
+    left->target_position = IKAPI.vec3.vec3(-10, 0, 0);
+    right->target_position = IKAPI.vec3.vec3(10, 0, 0);
+
+    EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+
+    // The arms are stretched toward their targets
+    ikreal_t global[7 * 3];
+    ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_GLOBAL, global, 0, NULL, 0, NULL, 7), Eq(IK_OK));
+    EXPECT_THAT(global[4 * 3], Lt(-1.5));
+    EXPECT_THAT(global[6 * 3], Gt(1.5));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, solve_does_not_allocate)
+{
+    ik_effector_t *left, *right;
+    ik_solver_t* solver = create_two_arms(&left, &right);
+    left->target_position = IKAPI.vec3.vec3(-1, 2, 1);
+    right->target_position = IKAPI.vec3.vec3(1, 2, 1);
+
+    uintptr_t allocations = IKAPI.heap.allocation_count();
+    for (int frame = 0; frame != 3; ++frame)
+        IKAPI.solver.solve(solver);
+    EXPECT_THAT(IKAPI.heap.allocation_count(), Eq(allocations));
+
+    IKAPI.solver.destroy(solver);
+}
@@ -0,0 +1,120 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include <vector>
+
+#define NAME ONE_BONE
+
+using namespace ::testing;
+
+TEST(NAME, bone_points_at_target)
+{
+    uint8_t flags[] = {0, IK_ENABLE_JOINT_ROTATIONS};
+    for (int f = 0; f != 2; ++f)
+    {
+        ik_solver_t* solver = IKAPI.solver.create(IK_ONE_BONE);
+        ik_node_t* base = solver->node->create(0);
+        ik_node_t* tip = solver->node->create_child(base, 1);
+        base->position = IKAPI.vec3.vec3(1, 0, 0);
+        tip->position.y = 2;
+        base->bone_index = 0;
+        tip->bone_index = 1;
+        ik_effector_t* eff = solver->effector->create();
+        solver->effector->attach(eff, tip);
+        solver->flags = flags[f];
+        IKAPI.solver.set_tree(solver, base);
+        ASSERT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+
+        eff->target_position = IKAPI.vec3.vec3(1, 0, -5);
+        EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+
+        ikreal_t global[2 * 3];
+        ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_GLOBAL, global, 0, NULL, 0, NULL, 2), Eq(IK_OK));
+        EXPECT_THAT(global[3], DoubleNear(1, 1e-6)) << "flags " << (int)flags[f];
+        EXPECT_THAT(global[4], DoubleNear(0, 1e-6)) << "flags " << (int)flags[f];
+        EXPECT_THAT(global[5], DoubleNear(-2, 1e-6)) << "flags " << (int)flags[f];
+
+        eff->target_position = IKAPI.vec3.vec3(1, 2, 0);
+        EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+        IKAPI.solver.destroy(solver);
+    }
+}
+
+TEST(NAME, rebuild_rejects_trees_with_child_chains)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_ONE_BONE);
+    ik_node_t* base = solver->node->create(0);
+    ik_node_t* mid = solver->node->create_child(base, 1);
+    IKAPI.solver.set_tree(solver, base);
+    solver->effector->attach(solver->effector->create(), mid);
+    solver->effector->attach(solver->effector->create(), solver->node->create_child(mid, 2));
+
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_TREE_NOT_SUPPORTED));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, solve_one_bone_batch)
+{
+    // Not a multiple of any vector width, so the scalar tail runs too
+    const int count = 37;
+    std::vector<ikreal_t> in(count * 10), out(count * 7);
+    ik_one_bone_batch_t batch;
+    for (int k = 0; k != 3; ++k)
+    {
+        batch.base[k] = &in[(0 + k) * count];
+        batch.target[k] = &in[(3 + k) * count];
+        batch.forward[k] = &in[(6 + k) * count];
+        batch.tip[k] = &out[k * count];
+    }
+    for (int k = 0; k != 4; ++k)
+        batch.rotation[k] = &out[(3 + k) * count];
+    batch.length = &in[9 * count];
+
+    for (int i = 0; i != count; ++i)
+    {
+        in[0 * count + i] = i;
+        in[1 * count + i] = 1;
+        in[2 * count + i] = -i;
+        in[3 * count + i] = i + 1 - 0.1 * (i % 7);
+        in[4 * count + i] = 1 + 0.3 * (i % 5);
+        in[5 * count + i] = -i + 0.2 * (i % 3);
+        in[6 * count + i] = 0;
+        in[7 * count + i] = 2;
+        in[8 * count + i] = 0;
+        in[9 * count + i] = 0.5 + 0.1 * (i % 4);
+    }
+    // A target on the base and one opposite of forward
+    in[3 * count + 0] = 0; in[4 * count + 0] = 1; in[5 * count + 0] = 0;
+    in[3 * count + 1] = 1; in[4 * count + 1] = -3; in[5 * count + 1] = -1;
+
+    IKAPI.solver.solve_one_bone(&batch, count);
+
+    for (int i = 0; i != count; ++i)
+    {
+        ik_vec3_t dir = IKAPI.vec3.vec3(batch.target[0][i] - batch.base[0][i],
+                                        batch.target[1][i] - batch.base[1][i],
+                                        batch.target[2][i] - batch.base[2][i]);
+        if (i == 0)
+            dir = IKAPI.vec3.vec3(1, 0, 0);
+        IKAPI.vec3.normalize(dir.f);
+
+        for (int k = 0; k != 3; ++k)
+            EXPECT_THAT(batch.tip[k][i], DoubleNear(batch.base[k][i] + dir.f[k] * batch.length[i], 1e-6))
+                << "problem " << i;
+
+        // Rotating forward must give the new direction
+        ik_quat_t q = IKAPI.quat.quat(batch.rotation[0][i], batch.rotation[1][i],
+                                      batch.rotation[2][i], batch.rotation[3][i]);
+        ik_vec3_t forward = IKAPI.vec3.vec3(0, 1, 0);
+        IKAPI.vec3.rotate(forward.f, q.f);
+        for (int k = 0; k != 3; ++k)
+            EXPECT_THAT(forward.f[k], DoubleNear(dir.f[k], 1e-6)) << "problem " << i;
+    }
+
+    // Without rotations, forward is never read
+    batch.rotation[0] = NULL;
+    for (int k = 0; k != 3; ++k)
+        batch.forward[k] = NULL;
+    IKAPI.solver.solve_one_bone(&batch, count);
+}
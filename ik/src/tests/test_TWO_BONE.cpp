@@ -0,0 +1,155 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "test_util.h"
+#include <vector>
+#include <cmath>
+
+#define NAME TWO_BONE
+
+using namespace ::testing;
+
+static ik_solver_t* create_arm(uint8_t flags, ik_effector_t** eff)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_TWO_BONE);
+    ik_node_t* base = solver->node->create(0);
+    ik_node_t* mid = solver->node->create_child(base, 1);
+    ik_node_t* tip = solver->node->create_child(mid, 2);
+    base->position = IKAPI.vec3.vec3(1, 0, 0);
+    mid->position.y = 1;
+    tip->position.y = 2;
+    base->bone_index = 0;
+    mid->bone_index = 1;
+    tip->bone_index = 2;
+
+    *eff = solver->effector->create();
+    solver->effector->attach(*eff, tip);
+    solver->flags = flags;
+    IKAPI.solver.set_tree(solver, base);
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    return solver;
+}
+
+TEST(NAME, tip_reaches_target_and_bends_toward_pole)
+{
+    uint8_t flags[] = {0, IK_ENABLE_JOINT_ROTATIONS};
+    for (int f = 0; f != 2; ++f)
+    {
+        ik_effector_t* eff;
+        ik_solver_t* solver = create_arm(flags[f], &eff);
+        eff->target_position = IKAPI.vec3.vec3(2, 2, 0);
+        eff->pole_position = IKAPI.vec3.vec3(1, 0, 5);
+        eff->flags |= IK_USE_POLE;
+
+        EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_RESULT_CONVERGED));
+
+        ikreal_t global[3 * 3];
+        ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_GLOBAL, global, 0, NULL, 0, NULL, 3), Eq(IK_OK));
+        EXPECT_THAT(global[6], DoubleNear(2, 1e-6)) << "flags " << (int)flags[f];
+        EXPECT_THAT(global[7], DoubleNear(2, 1e-6)) << "flags " << (int)flags[f];
+        EXPECT_THAT(global[8], DoubleNear(0, 1e-6)) << "flags " << (int)flags[f];
+        EXPECT_THAT(distance(&global[0], &global[3]), DoubleNear(1, 1e-6));
+        EXPECT_THAT(distance(&global[3], &global[6]), DoubleNear(2, 1e-6));
+        EXPECT_THAT(global[5], Gt(0));
+
+        // Out of reach, both bones point at the target
+        eff->target_position = IKAPI.vec3.vec3(1, 0, -6);
+        EXPECT_THAT(IKAPI.solver.solve(solver), Eq(IK_OK));
+        ASSERT_THAT(IKAPI.solver.get_pose(solver, IK_POSE_GLOBAL, global, 0, NULL, 0, NULL, 3), Eq(IK_OK));
+        EXPECT_THAT(global[5], DoubleNear(-1, 1e-6));
+        EXPECT_THAT(global[8], DoubleNear(-3, 1e-6));
+
+        IKAPI.solver.destroy(solver);
+    }
+}
+
+TEST(NAME, rebuild_rejects_chains_that_are_not_two_bones)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_TWO_BONE);
+    ik_node_t* node = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, node);
+    for (int i = 1; i != 4; ++i)
+        node = solver->node->create_child(node, i);
+    solver->effector->attach(solver->effector->create(), node);
+
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_TREE_NOT_SUPPORTED));
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, solve_two_bone_batch)
+{
+    // Not a multiple of any vector width, so the scalar tail runs too
+    const int count = 37;
+    std::vector<ikreal_t> in(count * 11), out(count * 6);
+    ik_two_bone_batch_t batch;
+    for (int k = 0; k != 3; ++k)
+    {
+        batch.base[k] = &in[(0 + k) * count];
+        batch.target[k] = &in[(3 + k) * count];
+        batch.pole[k] = &in[(6 + k) * count];
+        batch.mid[k] = &out[k * count];
+        batch.tip[k] = &out[(3 + k) * count];
+    }
+    batch.upper_length = &in[9 * count];
+    batch.lower_length = &in[10 * count];
+
+    for (int i = 0; i != count; ++i)
+    {
+        in[0 * count + i] = i;
+        in[1 * count + i] = -i;
+        in[2 * count + i] = 1;
+        in[3 * count + i] = i + 0.1 * (i % 7);
+        in[4 * count + i] = -i + 0.2 * (i % 5);
+        in[5 * count + i] = 1 + 0.15 * (i % 3);
+        in[6 * count + i] = i - 3;
+        in[7 * count + i] = -i;
+        in[8 * count + i] = 10;
+        in[9 * count + i] = 0.5;
+        in[10 * count + i] = 0.25 + 0.05 * (i % 4);
+    }
+    // A target on the base and one straight above it
+    in[3 * count + 0] = 0; in[4 * count + 0] = 0; in[5 * count + 0] = 1;
+    in[3 * count + 1] = 1; in[4 * count + 1] = -1; in[5 * count + 1] = 1.5;
+
+    IKAPI.solver.solve_two_bone(&batch, count);
+
+    for (int i = 0; i != count; ++i)
+    {
+        ikreal_t base[3], target[3], mid[3], tip[3];
+        for (int k = 0; k != 3; ++k)
+        {
+            base[k] = batch.base[k][i];
+            target[k] = batch.target[k][i];
+            mid[k] = batch.mid[k][i];
+            tip[k] = batch.tip[k][i];
+        }
+        ikreal_t upper = batch.upper_length[i];
+        ikreal_t lower = batch.lower_length[i];
+        ikreal_t reach = distance(base, target);
+
+        EXPECT_THAT(distance(base, mid), DoubleNear(upper, 1e-6)) << "problem " << i;
+        EXPECT_THAT(distance(mid, tip), DoubleNear(lower, 1e-6)) << "problem " << i;
+        if (reach <= upper + lower && reach >= upper - lower)
+            EXPECT_THAT(distance(tip, target), DoubleNear(0, 1e-6)) << "problem " << i;
+        else if (reach > upper + lower)
+            EXPECT_THAT(distance(tip, target), DoubleNear(reach - upper - lower, 1e-6)) << "problem " << i;
+
+        // The middle joint bends toward the pole
+        if (i > 1 && reach < upper + lower && reach > std::fabs(upper - lower))
+        {
+            ikreal_t along_mid = 0, along_pole = 0, side = 0;
+            for (int k = 0; k != 3; ++k)
+            {
+                along_mid += (mid[k] - base[k]) * (target[k] - base[k]) / reach;
+                along_pole += (batch.pole[k][i] - base[k]) * (target[k] - base[k]) / reach;
+            }
+            for (int k = 0; k != 3; ++k)
+            {
+                ikreal_t dir = (target[k] - base[k]) / reach;
+                side += (mid[k] - base[k] - dir * along_mid) *
+                        (batch.pole[k][i] - base[k] - dir * along_pole);
+            }
+            EXPECT_THAT(side, Gt(0)) << "problem " << i;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include "ik/vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NAME heap
+
+using namespace ::testing;
+
+struct counting_allocator_t
+{
+    int mallocs;
+    int reallocs;
+    int frees;
+};
+
+static void* counting_malloc(void* user_data, uintptr_t size)
+{
+    ((counting_allocator_t*)user_data)->mallocs++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* user_data, void* ptr, uintptr_t size)
+{
+    ((counting_allocator_t*)user_data)->reallocs++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* user_data, void* ptr)
+{
+    ((counting_allocator_t*)user_data)->frees++;
+    free(ptr);
+}
+
+TEST(NAME, growth_goes_through_custom_allocator)
+{
+    counting_allocator_t counts = {0, 0, 0};
+    ik_allocator_t allocator = {counting_malloc, counting_realloc, counting_free, &counts};
+
+    // The environment keeps the library initialized
+    EXPECT_THAT(IKAPI.heap.set_allocator(&allocator), Eq(IK_LIBRARY_IS_INITIALIZED));
+    ASSERT_THAT(IKAPI.deinit(), Eq(0u));
+    ASSERT_THAT(IKAPI.heap.set_allocator(&allocator), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.init(), Eq(IK_OK));
+
+    struct vector_t* vec = vector_create(sizeof(int));
+    for (int i = 0; i != 100; ++i)
+        vector_push(vec, &i);
+    EXPECT_THAT(counts.reallocs, Ge(1));
+    vector_destroy(vec);
+
+    ASSERT_THAT(IKAPI.deinit(), Eq(0u));
+    EXPECT_THAT(counts.mallocs, Gt(0));
+    EXPECT_THAT(counts.frees, Eq(counts.mallocs));
+    ASSERT_THAT(IKAPI.heap.set_allocator(NULL), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.init(), Eq(IK_OK));
+}
+
+TEST(NAME, live_storage_shows_up_in_heap_profile)
+{
+#ifdef IK_MEMORY_BACKTRACE
+    const char* file_name = "ik_heap_profile.txt";
+    unsigned long live_objects = 0, live_bytes = 0;
+    char line[256] = "";
+
+    enum ik_heap_sampling_e sampling;
+    uintptr_t interval;
+    ASSERT_THAT(IKAPI.heap.get_sampling(&sampling, &interval), Eq(IK_OK));
+    ASSERT_THAT(IKAPI.heap.set_sampling(IK_HEAP_SAMPLE_ALLOCATIONS, 1), Eq(IK_OK));
+    struct vector_t* vec = vector_create(sizeof(int));
+    for (int i = 0; i != 1000; ++i)
+        vector_push(vec, &i);
+    EXPECT_THAT(IKAPI.heap.dump_profile(file_name, IK_HEAP_PROFILE_PPROF), Eq(IK_OK));
+    vector_destroy(vec);
+    ASSERT_THAT(IKAPI.heap.set_sampling(sampling, interval), Eq(IK_OK));
+
+    FILE* fp = fopen(file_name, "r");
+    ASSERT_THAT(fp, NotNull());
+    EXPECT_THAT(fgets(line, sizeof line, fp), NotNull());
+    fclose(fp);
+    remove(file_name);
+    ASSERT_THAT(sscanf(line, "heap profile: %lu: %lu", &live_objects, &live_bytes), Eq(2));
+    EXPECT_THAT(live_objects, Ge(2u));
+    EXPECT_THAT(live_bytes, Ge(1000 * sizeof(int)));
+#else
+    EXPECT_THAT(IKAPI.heap.dump_profile(NULL, IK_HEAP_PROFILE_PPROF), Eq(IK_BUILT_WITHOUT_MEMORY_BACKTRACE));
+#endif
+}
@@ -1,5 +1,7 @@
 #include "gmock/gmock.h"
 #include "ik/ik.h"
+#include <vector>
+#include <algorithm>
 
 #define NAME node
 
@@ -9,3 +11,195 @@ TEST(NAME, todo)
 {
     ASSERT_TRUE(0);
 }
+
+static ik_node_t* create_node_tree(uint32_t* guid, int depth)
+{
+    ik_node_t* node = IKAPI.internal.node_base.create((*guid)++);
+    if (depth > 0)
+        for (int i = 0; i != 3; ++i)
+            IKAPI.internal.node_base.add_child(node, create_node_tree(guid, depth - 1));
+    return node;
+}
+
+TEST(NAME, guid_index_finds_same_nodes_as_search)
+{
+    uint32_t guid = 0;
+    ik_node_t* root = create_node_tree(&guid, 4);
+    std::vector<ik_node_t*> expected;
+    for (uint32_t i = 0; i != guid + 1; ++i)
+        expected.push_back(IKAPI.internal.node_base.find_child(root, i));
+
+    ASSERT_THAT(IKAPI.internal.node_base.build_guid_index(root->v->find_child(root, 7)), Eq(IK_OK));
+    ASSERT_THAT(root->guid_index, NotNull());
+    for (uint32_t i = 0; i != guid + 1; ++i)
+        EXPECT_THAT(IKAPI.internal.node_base.find_child(root, i), Eq(expected[i]));
+
+    // Searching from within the tree only finds nodes in that subtree
+    ik_node_t* subtree = IKAPI.internal.node_base.find_child(root, 1);
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(subtree, 2), Eq(expected[2]));
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(subtree, 0), IsNull());
+
+    IKAPI.internal.node_base.destroy(root);
+}
+
+TEST(NAME, guid_index_follows_tree_changes)
+{
+    uint32_t guid = 0;
+    ik_node_t* root = create_node_tree(&guid, 3);
+    ASSERT_THAT(IKAPI.internal.node_base.build_guid_index(root), Eq(IK_OK));
+
+    // Unlinked subtrees leave the index
+    ik_node_t* subtree = IKAPI.internal.node_base.find_child(root, 1);
+    ik_node_t* grandchild = IKAPI.internal.node_base.find_child(subtree, 2);
+    IKAPI.internal.node_base.unlink(subtree);
+    EXPECT_THAT(subtree->guid_index, IsNull());
+    EXPECT_THAT(grandchild->guid_index, IsNull());
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(root, 2), IsNull());
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(subtree, 2), Eq(grandchild));
+
+    // Added subtrees join it, and give up their own index
+    ASSERT_THAT(IKAPI.internal.node_base.build_guid_index(subtree), Eq(IK_OK));
+    ik_node_t* other = IKAPI.internal.node_base.find_child(root, guid - 1);
+    IKAPI.internal.node_base.add_child(other, subtree);
+    EXPECT_THAT(grandchild->guid_index, Eq(root->guid_index));
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(root, 2), Eq(grandchild));
+
+    // Destroyed nodes leave the index
+    IKAPI.internal.node_base.destroy(subtree);
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(root, 1), IsNull());
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(root, 2), IsNull());
+    EXPECT_THAT(IKAPI.internal.node_base.find_child(root, guid - 1), Eq(other));
+
+    IKAPI.internal.node_base.destroy(root);
+}
+
+TEST(NAME, solver_pool_stores_nodes_in_creation_order)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->v->create_node(solver, 0);
+    ik_node_t* nodes[8] = {root};
+    for (int i = 1; i != 8; ++i)
+        nodes[i] = solver->node->create_child(nodes[i - 1], i);
+
+    intptr_t stride = (char*)nodes[1] - (char*)nodes[0];
+    EXPECT_THAT(stride, Ge((intptr_t)solver->node->type_size()));
+    for (int i = 1; i != 8; ++i)
+    {
+        EXPECT_THAT(nodes[i]->pool, Eq(root->pool));
+        EXPECT_THAT((char*)nodes[i] - (char*)nodes[i - 1], Eq(stride));
+    }
+
+    // Destroyed objects are reused
+    solver->node->destroy(nodes[7]);
+    EXPECT_THAT(solver->node->create_child(nodes[6], 7), Eq(nodes[7]));
+
+    ik_effector_t* effector = solver->v->create_effector(solver);
+    solver->effector->attach(effector, nodes[7]);
+    solver->constraint->attach(solver->v->create_constraint(solver, IK_NONE), nodes[3]);
+    solver->node->build_guid_index(root);
+    solver->v->set_tree(solver, root);
+    ASSERT_THAT(solver->v->rebuild(solver), Eq(IK_OK));
+
+    // Released in bulk, including objects that were unlinked from the tree
+    solver->node->unlink(nodes[5]);
+    solver->v->destroy_tree(solver);
+    EXPECT_THAT(solver->tree, IsNull());
+
+    IKAPI.solver.destroy(solver);
+}
+
+TEST(NAME, solver_pool_tree_with_foreign_nodes)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->v->create_node(solver, 0);
+    ik_node_t* child = solver->node->create(1);
+    solver->node->add_child(root, child);
+    solver->node->create_child(child, 2);
+    solver->effector->attach(solver->effector->create(), root);
+    solver->v->set_tree(solver, root);
+
+    // A new tree from the same pool must survive the old one being destroyed
+    ik_node_t* new_root = solver->v->create_node(solver, 3);
+    solver->v->set_tree(solver, new_root);
+    EXPECT_THAT(new_root->guid, Eq(3u));
+    EXPECT_THAT(solver->node->create_child(new_root, 4), NotNull());
+
+    IKAPI.solver.destroy(solver);
+}
+
+static void expect_children(ik_node_t* parent, std::vector<uint32_t> expected)
+{
+#if !defined(IK_NODE_CHILDREN_LINKED)
+    // Sorted by guid instead of kept in the order they were added
+    std::sort(expected.begin(), expected.end());
+#endif
+    std::vector<uint32_t> guids;
+    NODE_FOR_EACH(parent, guid, child)
+        EXPECT_THAT(child->parent, Eq(parent));
+        EXPECT_THAT(child->guid, Eq(guid));
+        guids.push_back(guid);
+    NODE_END_EACH
+    EXPECT_THAT(guids, ElementsAreArray(expected));
+    EXPECT_THAT(NODE_CHILD_COUNT(parent), Eq(expected.size()));
+
+#if defined(IK_NODE_CHILDREN_LINKED)
+    if (expected.empty())
+    {
+        EXPECT_THAT(parent->first_child, IsNull());
+        return;
+    }
+
+    ik_node_t* last = parent->first_child;
+    while (last->next_sibling != NULL)
+    {
+        EXPECT_THAT(last->next_sibling->prev_sibling, Eq(last));
+        last = last->next_sibling;
+    }
+    EXPECT_THAT(parent->first_child->prev_sibling, Eq(last));
+#endif
+}
+
+TEST(NAME, children_stay_linked_when_unlinking_first_middle_and_last)
+{
+    ik_node_t* root = IKAPI.internal.node_base.create(0);
+    const uint32_t guids[] = {5, 2, 8, 1, 7};
+    ik_node_t* children[5];
+    for (int i = 0; i != 5; ++i)
+    {
+        children[i] = IKAPI.internal.node_base.create(guids[i]);
+        IKAPI.internal.node_base.add_child(root, children[i]);
+    }
+    expect_children(root, {5, 2, 8, 1, 7});
+
+    IKAPI.internal.node_base.unlink(children[0]);
+    expect_children(root, {2, 8, 1, 7});
+    IKAPI.internal.node_base.unlink(children[3]);
+    expect_children(root, {2, 8, 7});
+    IKAPI.internal.node_base.unlink(children[4]);
+    expect_children(root, {2, 8});
+    for (int i : {0, 3, 4})
+    {
+        EXPECT_THAT(children[i]->parent, IsNull());
+#if defined(IK_NODE_CHILDREN_LINKED)
+        EXPECT_THAT(children[i]->next_sibling, IsNull());
+        EXPECT_THAT(children[i]->prev_sibling, IsNull());
+#endif
+    }
+
+    // Re-added children go to the back
+    IKAPI.internal.node_base.add_child(root, children[0]);
+    expect_children(root, {2, 8, 5});
+
+    IKAPI.internal.node_base.unlink(children[1]);
+    IKAPI.internal.node_base.unlink(children[2]);
+    IKAPI.internal.node_base.unlink(children[0]);
+    expect_children(root, {});
+
+    // An emptied parent starts over
+    IKAPI.internal.node_base.add_child(root, children[3]);
+    expect_children(root, {1});
+
+    for (int i : {0, 1, 2, 4})
+        IKAPI.internal.node_base.destroy(children[i]);
+    IKAPI.internal.node_base.destroy(root);
+}
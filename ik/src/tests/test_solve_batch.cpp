@@ -0,0 +1,165 @@
+#include "gmock/gmock.h"
+#include "ik/ik.h"
+#include <vector>
+
+#define NAME solve_batch
+
+using namespace ::testing;
+
+static ik_solver_t* create_arm_solver(int seed)
+{
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* parent = solver->node->create(0);
+    IKAPI.solver.set_tree(solver, parent);
+    for (int i = 1; i != 6; ++i)
+    {
+        ik_node_t* child = solver->node->create_child(parent, i);
+        child->position.y = 1;
+        parent = child;
+    }
+
+    ik_effector_t* eff = solver->effector->create();
+    solver->effector->attach(eff, parent);
+    eff->target_position = IKAPI.vec3.vec3(seed % 3, 2, seed % 5);
+
+    solver->max_iterations = 50;
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    return solver;
+}
+
+static void expect_same_positions(ik_node_t* a, ik_node_t* b)
+{
+    EXPECT_THAT(a->position.x, Eq(b->position.x));
+    EXPECT_THAT(a->position.y, Eq(b->position.y));
+    EXPECT_THAT(a->position.z, Eq(b->position.z));
+    EXPECT_THAT(a->rotation.w, Eq(b->rotation.w));
+    ASSERT_THAT(NODE_CHILD_COUNT(a), Eq(NODE_CHILD_COUNT(b)));
+    NODE_FOR_EACH(a, guid, child)
+        expect_same_positions(child, b->v->find_child(b, guid));
+    NODE_END_EACH
+}
+
+static void compare_batch_with_serial(int worker_count)
+{
+    const int count = 16;
+    std::vector<ik_solver_t*> serial, batch;
+    for (int i = 0; i != count; ++i)
+    {
+        serial.push_back(create_arm_solver(i));
+        batch.push_back(create_arm_solver(i));
+    }
+
+    ASSERT_THAT(IKAPI.thread_pool.set_worker_count(worker_count), Eq(IK_OK));
+#ifdef IK_THREADS
+    EXPECT_THAT(IKAPI.thread_pool.worker_count(), Eq(worker_count));
+#else
+    // Without threads, everything is solved on the calling thread
+    EXPECT_THAT(IKAPI.thread_pool.worker_count(), Eq(0));
+#endif
+
+    for (int i = 0; i != count; ++i)
+        IKAPI.solver.solve(serial[i]);
+    EXPECT_THAT(IKAPI.solver.solve_batch(&batch[0], count), Ge(IK_OK));
+
+    for (int i = 0; i != count; ++i)
+        expect_same_positions(serial[i]->tree, batch[i]->tree);
+
+    for (int i = 0; i != count; ++i)
+    {
+        IKAPI.solver.destroy(serial[i]);
+        IKAPI.solver.destroy(batch[i]);
+    }
+    IKAPI.thread_pool.set_worker_count(-1);
+}
+
+TEST(NAME, results_match_serial_solve_on_calling_thread)
+{
+    compare_batch_with_serial(0);
+}
+
+TEST(NAME, results_match_serial_solve_on_worker_threads)
+{
+    compare_batch_with_serial(3);
+}
+
+TEST(NAME, empty_batch_is_ok)
+{
+    EXPECT_THAT(IKAPI.solver.solve_batch(NULL, 0), Eq(IK_OK));
+}
+
+static void expect_near_positions(ik_node_t* a, ik_node_t* b)
+{
+    EXPECT_THAT(a->position.x, DoubleNear(b->position.x, 1e-4));
+    EXPECT_THAT(a->position.y, DoubleNear(b->position.y, 1e-4));
+    EXPECT_THAT(a->position.z, DoubleNear(b->position.z, 1e-4));
+    ASSERT_THAT(NODE_CHILD_COUNT(a), Eq(NODE_CHILD_COUNT(b)));
+    NODE_FOR_EACH(a, guid, child)
+        expect_near_positions(child, b->v->find_child(b, guid));
+    NODE_END_EACH
+}
+
+TEST(NAME, lanes_match_serial_solve)
+{
+    /*
+     * A tolerance of 0 disables the early-out, so every lane runs for the
+     * same number of iterations as the serial solver. The odd solver out has
+     * a different topology and can't share lanes with its neighbours.
+     */
+    const int count = 11;
+    std::vector<ik_solver_t*> serial, lanes;
+    for (int i = 0; i != count; ++i)
+    {
+        serial.push_back(create_arm_solver(i));
+        lanes.push_back(create_arm_solver(i));
+    }
+    ik_node_t* extra = lanes[5]->node->create_child(lanes[5]->tree, 100);
+    extra->position.x = 1;
+    lanes[5]->effector->attach(lanes[5]->effector->create(), extra);
+    ASSERT_THAT(IKAPI.solver.rebuild(lanes[5]), Eq(IK_OK));
+    serial[5]->node->create_child(serial[5]->tree, 100)->position.x = 1;
+    serial[5]->effector->attach(serial[5]->effector->create(), serial[5]->tree->v->find_child(serial[5]->tree, 100));
+    ASSERT_THAT(IKAPI.solver.rebuild(serial[5]), Eq(IK_OK));
+
+    for (int i = 0; i != count; ++i)
+    {
+        serial[i]->tolerance = 0;
+        lanes[i]->tolerance = 0;
+        IKAPI.solver.solve(serial[i]);
+    }
+    IKAPI.solver.solve_lanes(&lanes[0], count);
+
+    for (int i = 0; i != count; ++i)
+        expect_near_positions(serial[i]->tree, lanes[i]->tree);
+
+    for (int i = 0; i != count; ++i)
+    {
+        IKAPI.solver.destroy(serial[i]);
+        IKAPI.solver.destroy(lanes[i]);
+    }
+}
+
+TEST(NAME, lanes_stop_once_converged)
+{
+    /* Without joint rotations, the global position is the sum of the local ones */
+    const int count = 4;
+    std::vector<ik_solver_t*> lanes;
+    for (int i = 0; i != count; ++i)
+    {
+        lanes.push_back(create_arm_solver(i));
+        lanes[i]->flags &= ~IK_ENABLE_JOINT_ROTATIONS;
+    }
+
+    EXPECT_THAT(IKAPI.solver.solve_lanes(&lanes[0], count), Eq(IK_RESULT_CONVERGED));
+
+    for (int i = 0; i != count; ++i)
+    {
+        ik_node_t* tip = *(ik_node_t**)vector_get_element(&lanes[i]->effector_nodes_list, 0);
+        ik_vec3_t global = IKAPI.vec3.vec3(0, 0, 0);
+        for (ik_node_t* node = tip; node != NULL; node = node->parent)
+            IKAPI.vec3.add_vec3(global.f, node->position.f);
+        EXPECT_THAT(global.x, DoubleNear(tip->effector->target_position.x, 1e-3));
+        EXPECT_THAT(global.y, DoubleNear(tip->effector->target_position.y, 1e-3));
+        EXPECT_THAT(global.z, DoubleNear(tip->effector->target_position.z, 1e-3));
+        IKAPI.solver.destroy(lanes[i]);
+    }
+}
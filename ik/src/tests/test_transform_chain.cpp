@@ -1,5 +1,10 @@
 #include "gmock/gmock.h"
 #include "ik/ik.h"
+#include "ik/chain.h"
+#include "ik/program.h"
+#include "ik/transform.h"
+#include <string.h>
+#include <vector>
 
 #define NAME transform_chain
 
@@ -9,3 +14,110 @@ TEST(NAME, todo)
 {
     ASSERT_TRUE(0);
 }
+
+static ik_node_t* create_child(ik_solver_t* solver, ik_node_t* parent, uint32_t guid)
+{
+    ik_node_t* node = solver->node->create_child(parent, guid);
+    node->position = IKAPI.vec3.vec3(0.1 * (guid % 5), 1, -0.2 * (guid % 3));
+    node->rotation = IKAPI.quat.quat(0.1 * (guid % 4), -0.2, 0.05 * guid, 1);
+    IKAPI.quat.normalize(node->rotation.f);
+    return node;
+}
+
+static ik_solver_t* create_branching_tree()
+{
+    /*
+     * Island 0 starts at the root and forks twice, island 1 hangs off of the
+     * root but only reaches up to node 10:
+     *
+     *         5   9
+     *         |   |
+     *   7     4 - 8      13
+     *   |     |          |
+     *   6     3          12
+     *    \   /           |
+     *      2             11
+     *      |             |
+     *      1             10
+     *       \           /
+     *        --- 0 -----
+     */
+    ik_solver_t* solver = IKAPI.solver.create(IK_FABRIK);
+    ik_node_t* root = solver->node->create(0);
+    root->position = IKAPI.vec3.vec3(1, 2, 3);
+    root->rotation = IKAPI.quat.quat(0, 0.3, 0, 1);
+    IKAPI.quat.normalize(root->rotation.f);
+    IKAPI.solver.set_tree(solver, root);
+
+    ik_node_t* fork = create_child(solver, create_child(solver, root, 1), 2);
+    ik_node_t* n4 = create_child(solver, create_child(solver, fork, 3), 4);
+    ik_node_t* tips[] = {
+        create_child(solver, n4, 5),
+        create_child(solver, create_child(solver, fork, 6), 7),
+        create_child(solver, create_child(solver, n4, 8), 9),
+        create_child(solver, create_child(solver, create_child(solver, create_child(solver, root, 10), 11), 12), 13)
+    };
+    for (int i = 0; i != 4; ++i)
+        solver->effector->attach(solver->effector->create(), tips[i]);
+    tips[3]->effector->chain_length = 3;
+
+    EXPECT_THAT(IKAPI.solver.rebuild(solver), Eq(IK_OK));
+    EXPECT_THAT(vector_count(&solver->chain_list), Eq(2u));
+    return solver;
+}
+
+static void save_transforms(ik_node_t* node, std::vector<ikreal_t>* transforms)
+{
+    transforms->insert(transforms->end(), node->transform, node->transform + 7);
+    NODE_FOR_EACH(node, guid, child)
+        save_transforms(child, transforms);
+    NODE_END_EACH
+}
+
+static void load_transforms(ik_node_t* node, const std::vector<ikreal_t>& transforms, size_t* i)
+{
+    memcpy(node->transform, &transforms[*i], sizeof(node->transform));
+    *i += 7;
+    NODE_FOR_EACH(node, guid, child)
+        load_transforms(child, transforms, i);
+    NODE_END_EACH
+}
+
+TEST(NAME, transform_island_matches_transform_chain)
+{
+    ik_solver_t* solver = create_branching_tree();
+    program_t program;
+    program_construct(&program);
+    ASSERT_THAT(program_compile(&program, &solver->chain_list), Eq(IK_OK));
+    ASSERT_THAT(program.island_count, Eq(vector_count(&solver->chain_list)));
+
+    std::vector<ikreal_t> initial;
+    save_transforms(solver->tree, &initial);
+
+    const uint8_t modes[] = {0, TR_ROTATIONS, TR_TRANSLATIONS, TR_ROTATIONS | TR_TRANSLATIONS};
+    for (uint8_t direction : {TR_G2L, TR_L2G})
+        for (uint8_t mode : modes)
+            for (uint32_t island = 0; island != program.island_count; ++island)
+            {
+                uint8_t flags = direction | mode;
+                std::vector<ikreal_t> expected, actual;
+                size_t i = 0;
+
+                ik_transform_chain((chain_t*)vector_get_element(&solver->chain_list, island), flags);
+                save_transforms(solver->tree, &expected);
+                load_transforms(solver->tree, initial, &i);
+                EXPECT_THAT(expected, Ne(initial));
+
+                ik_transform_island(&program, island, flags);
+                save_transforms(solver->tree, &actual);
+                i = 0;
+                load_transforms(solver->tree, initial, &i);
+
+                for (i = 0; i != expected.size(); ++i)
+                    EXPECT_THAT(actual[i], DoubleNear(expected[i], 1e-12))
+                        << "flags " << (int)flags << " island " << island << " node " << i / 7;
+            }
+
+    program_destruct(&program);
+    IKAPI.solver.destroy(solver);
+}
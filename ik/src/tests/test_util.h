@@ -0,0 +1,13 @@
+#ifndef IK_TEST_UTIL_H
+#define IK_TEST_UTIL_H
+
+#include "ik/ik.h"
+
+/* Distance between two points, e.g. in an array filled by ik.solver.get_pose() */
+static inline ikreal_t distance(const ikreal_t* a, const ikreal_t* b)
+{
+    ik_vec3_t d = IKAPI.vec3.vec3(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+    return IKAPI.vec3.length(d.f);
+}
+
+#endif /* IK_TEST_UTIL_H */
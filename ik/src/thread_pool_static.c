@@ -0,0 +1,404 @@
+#include "ik/thread_pool_static.h"
+#include "ik/memory.h"
+#include "ik/ik.h"
+#include <string.h>
+
+#ifdef IK_THREADS
+#   include <pthread.h>
+#   include <unistd.h>
+
+/*
+ * Every participant (the workers plus the thread calling run()) owns a range
+ * of job indices. The owner takes jobs from the front of its range. When it
+ * runs dry, it steals the back half of somebody else's range. Padded to avoid
+ * false sharing between neighbouring participants.
+ */
+struct job_range_t
+{
+    pthread_mutex_t lock;
+    uint32_t begin;
+    uint32_t end;
+    char pad[64];
+};
+
+struct worker_t
+{
+    pthread_t thread;
+    uint32_t idx;
+    /* Generation of the last batch this worker took part in */
+    uint32_t generation;
+};
+
+struct thread_pool_t
+{
+    struct worker_t* workers;
+    /* One range per worker plus one for the caller, which is always last */
+    struct job_range_t* ranges;
+    int range_count;
+    int worker_count;
+    int started;
+    int busy;
+    int shutdown;
+
+    /* State of the batch currently being processed */
+    uint32_t generation;
+    int active_workers;
+    ik_thread_pool_job_func job;
+    void* user_data;
+    ikret_t result;
+    /* Workers count their allocations as part of the caller's solve */
+    int solving;
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_work_available = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_work_done = PTHREAD_COND_INITIALIZER;
+static struct thread_pool_t g_pool;
+static int g_requested_worker_count = -1;
+
+/* ------------------------------------------------------------------------- */
+static int
+default_worker_count(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 1 ? (int)cpus - 1 : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+take_job(struct job_range_t* range, uint32_t* job_idx)
+{
+    int found = 0;
+    pthread_mutex_lock(&range->lock);
+    if (range->begin != range->end)
+    {
+        *job_idx = range->begin++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+steal_jobs(uint32_t thief_idx, uint32_t* job_idx)
+{
+    uint32_t participants = (uint32_t)g_pool.worker_count + 1;
+    uint32_t i;
+
+    for (i = 1; i != participants; ++i)
+    {
+        struct job_range_t* victim = &g_pool.ranges[(thief_idx + i) % participants];
+        struct job_range_t* own = &g_pool.ranges[thief_idx];
+        uint32_t begin, end;
+
+        pthread_mutex_lock(&victim->lock);
+            end = victim->end;
+            begin = end - (end - victim->begin + 1) / 2;
+            victim->end = begin;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin == end)
+            continue;
+
+        /* Run the first stolen job right away and queue the rest */
+        *job_idx = begin;
+        pthread_mutex_lock(&own->lock);
+            own->begin = begin + 1;
+            own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+participate(uint32_t participant_idx)
+{
+    ikret_t result = IK_RESULT_CONVERGED;
+    uint32_t job_idx;
+
+    for (;;)
+    {
+        ikret_t job_result;
+        if (take_job(&g_pool.ranges[participant_idx], &job_idx) == 0)
+            if (steal_jobs(participant_idx, &job_idx) == 0)
+                break;
+
+        job_result = g_pool.job(g_pool.user_data, job_idx);
+        if (job_result < result)
+            result = job_result;
+    }
+
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static void*
+worker_main(void* arg)
+{
+    struct worker_t* worker = (struct worker_t*)arg;
+
+    pthread_mutex_lock(&g_lock);
+    for (;;)
+    {
+        ikret_t result;
+        int solving;
+
+        while (g_pool.shutdown == 0 && g_pool.generation == worker->generation)
+            pthread_cond_wait(&g_work_available, &g_lock);
+        if (g_pool.shutdown)
+            break;
+        worker->generation = g_pool.generation;
+        solving = g_pool.solving;
+        pthread_mutex_unlock(&g_lock);
+
+        if (solving)
+            ik_memory_enter_solve();
+        result = participate(worker->idx);
+        if (solving)
+            ik_memory_leave_solve();
+
+        pthread_mutex_lock(&g_lock);
+        if (result < g_pool.result)
+            g_pool.result = result;
+        if (--g_pool.active_workers == 0)
+            pthread_cond_signal(&g_work_done);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+stop_workers(void)
+{
+    int i;
+
+    if (g_pool.started == 0)
+        return;
+
+    pthread_mutex_lock(&g_lock);
+        g_pool.shutdown = 1;
+        pthread_cond_broadcast(&g_work_available);
+    pthread_mutex_unlock(&g_lock);
+
+    for (i = 0; i != g_pool.worker_count; ++i)
+        pthread_join(g_pool.workers[i].thread, NULL);
+    for (i = 0; i != g_pool.range_count; ++i)
+        pthread_mutex_destroy(&g_pool.ranges[i].lock);
+
+    FREE(g_pool.workers);
+    FREE(g_pool.ranges);
+    g_pool.workers = NULL;
+    g_pool.ranges = NULL;
+    g_pool.range_count = 0;
+    g_pool.worker_count = 0;
+    g_pool.started = 0;
+    g_pool.shutdown = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+start_workers(int count)
+{
+    int i;
+
+    g_pool.ranges = (struct job_range_t*)MALLOC(sizeof(struct job_range_t) * (count + 1));
+    if (g_pool.ranges == NULL)
+        goto alloc_ranges_failed;
+    g_pool.workers = (struct worker_t*)MALLOC(sizeof(struct worker_t) * (count ? count : 1));
+    if (g_pool.workers == NULL)
+        goto alloc_workers_failed;
+
+    memset(g_pool.ranges, 0, sizeof(struct job_range_t) * (count + 1));
+    for (i = 0; i != count + 1; ++i)
+        pthread_mutex_init(&g_pool.ranges[i].lock, NULL);
+    g_pool.range_count = count + 1;
+
+    /*
+     * If fewer threads could be created than requested, the caller simply
+     * uses the range after the last worker. Everything past it is unused.
+     */
+    g_pool.started = 1;
+    g_pool.worker_count = 0;
+    for (i = 0; i != count; ++i)
+    {
+        g_pool.workers[i].idx = (uint32_t)i;
+        g_pool.workers[i].generation = g_pool.generation;
+        if (pthread_create(&g_pool.workers[i].thread, NULL, worker_main, &g_pool.workers[i]) != 0)
+        {
+            IKAPI.log.message("Failed to create worker thread %d of %d, continuing with %d", i + 1, count, i);
+            break;
+        }
+        g_pool.worker_count++;
+    }
+
+    return IK_OK;
+
+    alloc_workers_failed : FREE(g_pool.ranges);
+                           g_pool.ranges = NULL;
+    alloc_ranges_failed  : IKAPI.log.message("Failed to allocate thread pool: Ran out of memory");
+                           return IK_RAN_OUT_OF_MEMORY;
+}
+static ikret_t
+start_requested_workers(void)
+{
+    int worker_count = g_requested_worker_count < 0 ?
+            default_worker_count() : g_requested_worker_count;
+    return start_workers(worker_count);
+}
+#endif /* IK_THREADS */
+
+/* ------------------------------------------------------------------------- */
+static ikret_t
+run_serial(ik_thread_pool_job_func job, void* user_data, uint32_t count)
+{
+    ikret_t result = IK_RESULT_CONVERGED;
+    uint32_t i;
+    for (i = 0; i != count; ++i)
+    {
+        ikret_t job_result = job(user_data, i);
+        if (job_result < result)
+            result = job_result;
+    }
+    return result;
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_thread_pool_static_run(ik_thread_pool_job_func job, void* user_data, uint32_t count)
+{
+#ifdef IK_THREADS
+    uint32_t participants, i;
+    ikret_t result;
+
+    if (count == 0)
+        return IK_OK;
+    if (count == 1)
+        return job(user_data, 0);
+
+    pthread_mutex_lock(&g_lock);
+    if (g_pool.busy)
+    {
+        pthread_mutex_unlock(&g_lock);
+        return run_serial(job, user_data, count);
+    }
+    g_pool.busy = 1;
+    pthread_mutex_unlock(&g_lock);
+
+    /* Lazily spawn the workers the first time they are needed */
+    if (g_pool.started == 0 && start_requested_workers() != IK_OK)
+        goto serial;
+    if (g_pool.worker_count == 0)
+        goto serial;
+
+    /* Hand every participant an equal share of the jobs to start with */
+    participants = (uint32_t)g_pool.worker_count + 1;
+    for (i = 0; i != participants; ++i)
+    {
+        g_pool.ranges[i].begin = (uint32_t)((uint64_t)count * i / participants);
+        g_pool.ranges[i].end = (uint32_t)((uint64_t)count * (i + 1) / participants);
+    }
+
+    pthread_mutex_lock(&g_lock);
+        g_pool.job = job;
+        g_pool.user_data = user_data;
+        g_pool.result = IK_RESULT_CONVERGED;
+        g_pool.solving = ik_memory_is_solving();
+        g_pool.active_workers = g_pool.worker_count;
+        g_pool.generation++;
+        pthread_cond_broadcast(&g_work_available);
+    pthread_mutex_unlock(&g_lock);
+
+    result = participate(participants - 1);
+
+    pthread_mutex_lock(&g_lock);
+        while (g_pool.active_workers != 0)
+            pthread_cond_wait(&g_work_done, &g_lock);
+        if (g_pool.result < result)
+            result = g_pool.result;
+        g_pool.job = NULL;
+        g_pool.user_data = NULL;
+        g_pool.busy = 0;
+    pthread_mutex_unlock(&g_lock);
+
+    return result;
+
+    serial : result = run_serial(job, user_data, count);
+    pthread_mutex_lock(&g_lock);
+        g_pool.busy = 0;
+    pthread_mutex_unlock(&g_lock);
+    return result;
+#else
+    if (count == 0)
+        return IK_OK;
+    return run_serial(job, user_data, count);
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_thread_pool_static_start(void)
+{
+#ifdef IK_THREADS
+    ikret_t result = IK_OK;
+
+    pthread_mutex_lock(&g_lock);
+    if (g_pool.busy)
+    {
+        pthread_mutex_unlock(&g_lock);
+        return IK_OK;
+    }
+    g_pool.busy = 1;
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_pool.started == 0)
+        result = start_requested_workers();
+
+    pthread_mutex_lock(&g_lock);
+        g_pool.busy = 0;
+    pthread_mutex_unlock(&g_lock);
+
+    return result;
+#else
+    return IK_OK;
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_thread_pool_static_deinit(void)
+{
+#ifdef IK_THREADS
+    stop_workers();
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+ikret_t
+ik_thread_pool_static_set_worker_count(int count)
+{
+#ifdef IK_THREADS
+    g_requested_worker_count = count;
+    stop_workers();
+#endif
+    return IK_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+int
+ik_thread_pool_static_worker_count(void)
+{
+#ifdef IK_THREADS
+    if (g_pool.started)
+        return g_pool.worker_count;
+    return g_requested_worker_count < 0 ?
+            default_worker_count() : g_requested_worker_count;
+#else
+    return 0;
+#endif
+}
@@ -1,3 +1,4 @@
+#include "ik/batch.h"
 #include "ik/bstv.h"
 #include "ik/quat_static.h"
 #include "ik/transform.h"
@@ -17,19 +18,72 @@
  * doesn't have to be transformed anyway, because its not relative to anything.
  */
 
+/*
+ * The transforms process the nodes of a chain in blocks. The accumulated
+ * rotation of each node depends on the one before it, so it is computed
+ * serially and stored in the block. Rotating the positions and multiplying
+ * the rotations is then done for the whole block at once with the batch
+ * kernels (see batch.h).
+ */
+struct block_t
+{
+    struct ik_node_t* nodes[BATCH_BLOCK];
+    ikreal_t px[BATCH_BLOCK], py[BATCH_BLOCK], pz[BATCH_BLOCK];
+    ikreal_t rx[BATCH_BLOCK], ry[BATCH_BLOCK], rz[BATCH_BLOCK], rw[BATCH_BLOCK];
+    ikreal_t qx[BATCH_BLOCK], qy[BATCH_BLOCK], qz[BATCH_BLOCK], qw[BATCH_BLOCK];
+};
+
+/* ------------------------------------------------------------------------- */
+static void
+block_store_quat(struct block_t* block, int i, const ikreal_t q[4])
+{
+    block->qx[i] = q[0];
+    block->qy[i] = q[1];
+    block->qz[i] = q[2];
+    block->qw[i] = q[3];
+}
+static void
+block_load_rotation(struct block_t* block, int i, const struct ik_node_t* node)
+{
+    block->rx[i] = node->rotation.x;
+    block->ry[i] = node->rotation.y;
+    block->rz[i] = node->rotation.z;
+    block->rw[i] = node->rotation.w;
+}
+static void
+block_store_rotation(const struct block_t* block, int i, struct ik_node_t* node)
+{
+    node->rotation.x = block->rx[i];
+    node->rotation.y = block->ry[i];
+    node->rotation.z = block->rz[i];
+    node->rotation.w = block->rw[i];
+}
+
 /* ------------------------------------------------------------------------- */
 static void
 local_to_global_rotation_recursive(struct chain_t* chain, ikreal_t acc_rot[4])
 {
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
     int idx = chain_length(chain) - 1;
     assert(idx > 0);
-    while (idx--)
+    while (idx > 0)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t rotation = node->rotation;
-        ik_quat_static_mul_quat(node->rotation.f, acc_rot);
-        ik_quat_static_mul_quat(acc_rot, rotation.f);
+        int i, count = idx < BATCH_BLOCK ? idx : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = chain_get_node(chain, --idx);
+            block.nodes[i] = node;
+            block_load_rotation(&block, i, node);
+            block_store_quat(&block, i, acc_rot);
+            ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+        }
+
+        /* node->rotation = node->rotation * acc_rot */
+        batch->quat_mul(block.rx, block.ry, block.rz, block.rw,
+                        block.qx, block.qy, block.qz, block.qw, count);
+        for (i = 0; i != count; ++i)
+            block_store_rotation(&block, i, block.nodes[i]);
     }
 
     CHAIN_FOR_EACH_CHILD(chain, child)
@@ -41,6 +95,10 @@ local_to_global_rotation_recursive(struct chain_t* chain, ikreal_t acc_rot[4])
 static void
 global_to_local_rotation_recursive(struct chain_t* chain, ikreal_t acc_rot[4])
 {
+    /*
+     * The accumulated rotation depends on the *result* of the previous node,
+     * so there is nothing to batch here.
+     */
     int idx = chain_length(chain) - 1;
     assert(idx > 0);
     while (idx--)
@@ -65,7 +123,8 @@ global_to_local_rotation_recursive(struct chain_t* chain, ikreal_t acc_rot[4])
 static void
 local_to_global_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
 {
-    ik_vec3_t position;
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
 
     /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
     ikreal_t* acc_rot = &acc_rot_pos[0];
@@ -73,16 +132,31 @@ local_to_global_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_po
 
     int idx = chain_length(chain) - 1;
     assert(idx > 0);
-    while (idx--)
+    while (idx > 0)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_vec3_static_rotate(node->position.f, acc_rot);
-        position = node->position;
-        ik_vec3_static_add_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, position.f);
-
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+        int i, count = idx < BATCH_BLOCK ? idx : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = chain_get_node(chain, --idx);
+            block.nodes[i] = node;
+            block.px[i] = node->position.x;
+            block.py[i] = node->position.y;
+            block.pz[i] = node->position.z;
+            block_store_quat(&block, i, acc_rot);
+            ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = block.nodes[i];
+            acc_pos[0] += block.px[i];
+            acc_pos[1] += block.py[i];
+            acc_pos[2] += block.pz[i];
+            ik_vec3_static_set(node->position.f, acc_pos);
+        }
     }
 
     /* Recurse into child chains */
@@ -96,25 +170,46 @@ local_to_global_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_po
 static void
 global_to_local_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
 {
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+
     /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
     ikreal_t* acc_rot = &acc_rot_pos[0];
     ikreal_t* acc_pos = &acc_rot_pos[4];
 
     int idx = chain_length(chain) - 1;
     assert(idx > 0);
-    while (idx--)
+    while (idx > 0)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t inv_rot_acc;
-        ik_quat_static_set(inv_rot_acc.f, acc_rot);
-        ik_quat_static_conj(inv_rot_acc.f);
-
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
-
-        ik_vec3_static_sub_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, node->position.f);
-        ik_vec3_static_rotate(node->position.f, inv_rot_acc.f);
+        int i, count = idx < BATCH_BLOCK ? idx : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = chain_get_node(chain, --idx);
+            block.nodes[i] = node;
+
+            /* Rotate by the inverse of the accumulated rotation */
+            block_store_quat(&block, i, acc_rot);
+            block.qx[i] = -block.qx[i];
+            block.qy[i] = -block.qy[i];
+            block.qz[i] = -block.qz[i];
+            ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+
+            block.px[i] = node->position.x - acc_pos[0];
+            block.py[i] = node->position.y - acc_pos[1];
+            block.pz[i] = node->position.z - acc_pos[2];
+            ik_vec3_static_set(acc_pos, node->position.f);
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = block.nodes[i];
+            node->position.x = block.px[i];
+            node->position.y = block.py[i];
+            node->position.z = block.pz[i];
+        }
     }
 
     CHAIN_FOR_EACH_CHILD(chain, child)
@@ -129,8 +224,8 @@ global_to_local_translation_recursive(struct chain_t* chain, ikreal_t acc_rot_po
 static void
 local_to_global_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
 {
-    ik_vec3_t position;
-    ik_quat_t rotation;
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
 
     /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
     ikreal_t* acc_rot = &acc_rot_pos[0];
@@ -138,18 +233,35 @@ local_to_global_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
 
     int idx = chain_length(chain) - 1;
     assert(idx > 0);
-    while (idx--)
+    while (idx > 0)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_vec3_static_rotate(node->position.f, acc_rot);
-        position = node->position;
-        ik_vec3_static_add_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, position.f);
-
-        rotation = node->rotation;
-        ik_quat_static_mul_quat(node->rotation.f, acc_rot);
-        ik_quat_static_mul_quat(acc_rot, rotation.f);
+        int i, count = idx < BATCH_BLOCK ? idx : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = chain_get_node(chain, --idx);
+            block.nodes[i] = node;
+            block.px[i] = node->position.x;
+            block.py[i] = node->position.y;
+            block.pz[i] = node->position.z;
+            block_load_rotation(&block, i, node);
+            block_store_quat(&block, i, acc_rot);
+            ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+        batch->quat_mul(block.rx, block.ry, block.rz, block.rw,
+                        block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = block.nodes[i];
+            acc_pos[0] += block.px[i];
+            acc_pos[1] += block.py[i];
+            acc_pos[2] += block.pz[i];
+            ik_vec3_static_set(node->position.f, acc_pos);
+            block_store_rotation(&block, i, node);
+        }
     }
 
     /* Recurse into child chains */
@@ -163,25 +275,47 @@ local_to_global_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
 static void
 global_to_local_recursive(struct chain_t* chain, ikreal_t acc_rot_pos[7])
 {
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+
     /* Unpack rotation (first 4 floats) and position (last 3 floats) from argument */
     ikreal_t* acc_rot = &acc_rot_pos[0];
     ikreal_t* acc_pos = &acc_rot_pos[4];
 
     int idx = chain_length(chain) - 1;
     assert(idx > 0);
-    while (idx--)
+    while (idx > 0)
     {
-        struct ik_node_t* node = chain_get_node(chain, idx);
-
-        ik_quat_t inv_rot_acc;
-        ik_quat_static_set(inv_rot_acc.f, acc_rot);
-        ik_quat_static_conj(inv_rot_acc.f);
-        ik_quat_static_mul_quat(node->rotation.f, inv_rot_acc.f);
-        ik_quat_static_mul_quat(acc_rot, node->rotation.f);
-
-        ik_vec3_static_sub_vec3(node->position.f, acc_pos);
-        ik_vec3_static_add_vec3(acc_pos, node->position.f);
-        ik_vec3_static_rotate(node->position.f, inv_rot_acc.f);
+        int i, count = idx < BATCH_BLOCK ? idx : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = chain_get_node(chain, --idx);
+            ik_quat_t inv_rot_acc;
+            block.nodes[i] = node;
+
+            /* Rotations depend on the previous result and can't be batched */
+            ik_quat_static_set(inv_rot_acc.f, acc_rot);
+            ik_quat_static_conj(inv_rot_acc.f);
+            ik_quat_static_mul_quat(node->rotation.f, inv_rot_acc.f);
+            ik_quat_static_mul_quat(acc_rot, node->rotation.f);
+            block_store_quat(&block, i, inv_rot_acc.f);
+
+            block.px[i] = node->position.x - acc_pos[0];
+            block.py[i] = node->position.y - acc_pos[1];
+            block.pz[i] = node->position.z - acc_pos[2];
+            ik_vec3_static_set(acc_pos, node->position.f);
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = block.nodes[i];
+            node->position.x = block.px[i];
+            node->position.y = block.py[i];
+            node->position.z = block.pz[i];
+        }
     }
 
     CHAIN_FOR_EACH_CHILD(chain, child)
@@ -0,0 +1,323 @@
+#include "ik/batch.h"
+#include "ik/node.h"
+#include "ik/program.h"
+#include "ik/quat_static.h"
+#include "ik/transform.h"
+#include "ik/vec3_static.h"
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Slots are visited back to front, i.e. starting at the island's base node,
+ * which means every slot's parent (see program->parent) has already been
+ * processed. Like in transform_chains.c, the accumulated rotations are
+ * computed serially for a block of slots, and the positions and rotations of
+ * the block are then transformed with the batch kernels. A parent may be in
+ * the same block as its child, but it's always earlier in the block.
+ */
+struct block_t
+{
+    uint32_t slots[BATCH_BLOCK];
+    ikreal_t px[BATCH_BLOCK], py[BATCH_BLOCK], pz[BATCH_BLOCK];
+    ikreal_t rx[BATCH_BLOCK], ry[BATCH_BLOCK], rz[BATCH_BLOCK], rw[BATCH_BLOCK];
+    ikreal_t qx[BATCH_BLOCK], qy[BATCH_BLOCK], qz[BATCH_BLOCK], qw[BATCH_BLOCK];
+};
+
+#define ACC(program, slot) (&(program)->transform[(uintptr_t)(slot) * 7])
+#define LOCAL(program, slot) (&(program)->local[(uintptr_t)(slot) * 7])
+
+/* ------------------------------------------------------------------------- */
+static void
+block_store_quat(struct block_t* block, int i, const ikreal_t q[4])
+{
+    block->qx[i] = q[0];
+    block->qy[i] = q[1];
+    block->qz[i] = q[2];
+    block->qw[i] = q[3];
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+local_to_global(struct program_t* p, const struct program_island_t* island,
+                int rotations, int translations)
+{
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+    uint32_t slot = island->slot_begin + island->slot_count - 1;
+
+    /* The island's base node is the only one that isn't relative to anything */
+    memcpy(ACC(p, slot), p->nodes[slot]->transform, sizeof(ikreal_t) * 7);
+
+    while (slot != island->slot_begin)
+    {
+        int i, count = slot - island->slot_begin < BATCH_BLOCK ?
+            (int)(slot - island->slot_begin) : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = p->nodes[--slot];
+            const ikreal_t* parent_acc = ACC(p, p->parent[slot]);
+            ikreal_t* acc = ACC(p, slot);
+            assert(p->parent[slot] > slot);
+
+            block.slots[i] = slot;
+            block_store_quat(&block, i, parent_acc);
+            block.px[i] = node->position.x;
+            block.py[i] = node->position.y;
+            block.pz[i] = node->position.z;
+            block.rx[i] = node->rotation.x;
+            block.ry[i] = node->rotation.y;
+            block.rz[i] = node->rotation.z;
+            block.rw[i] = node->rotation.w;
+            ik_quat_static_set(acc, parent_acc);
+            ik_quat_static_mul_quat(acc, node->rotation.f);
+        }
+
+        if (translations)
+            batch->rotate(block.px, block.py, block.pz,
+                          block.qx, block.qy, block.qz, block.qw, count);
+        /* node->rotation = node->rotation * parent's accumulated rotation */
+        if (rotations)
+            batch->quat_mul(block.rx, block.ry, block.rz, block.rw,
+                            block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            uint32_t s = block.slots[i];
+            struct ik_node_t* node = p->nodes[s];
+            if (translations)
+            {
+                const ikreal_t* parent_pos = ACC(p, p->parent[s]) + 4;
+                ikreal_t* pos = ACC(p, s) + 4;
+                pos[0] = parent_pos[0] + block.px[i];
+                pos[1] = parent_pos[1] + block.py[i];
+                pos[2] = parent_pos[2] + block.pz[i];
+                ik_vec3_static_set(node->position.f, pos);
+            }
+            if (rotations)
+            {
+                node->rotation.x = block.rx[i];
+                node->rotation.y = block.ry[i];
+                node->rotation.z = block.rz[i];
+                node->rotation.w = block.rw[i];
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+global_to_local(struct program_t* p, const struct program_island_t* island,
+                int rotations, int translations)
+{
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+    uint32_t slot = island->slot_begin + island->slot_count - 1;
+
+    memcpy(ACC(p, slot), p->nodes[slot]->transform, sizeof(ikreal_t) * 7);
+
+    while (slot != island->slot_begin)
+    {
+        int i, count = slot - island->slot_begin < BATCH_BLOCK ?
+            (int)(slot - island->slot_begin) : BATCH_BLOCK;
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = p->nodes[--slot];
+            const ikreal_t* parent_acc = ACC(p, p->parent[slot]);
+            ikreal_t* acc = ACC(p, slot);
+            ik_quat_t inv_rot_acc;
+            assert(p->parent[slot] > slot);
+            block.slots[i] = slot;
+
+            /* Rotations depend on the previous result and can't be batched */
+            ik_quat_static_set(inv_rot_acc.f, parent_acc);
+            ik_quat_static_conj(inv_rot_acc.f);
+            if (rotations)
+                ik_quat_static_mul_quat(node->rotation.f, inv_rot_acc.f);
+            ik_quat_static_set(acc, parent_acc);
+            ik_quat_static_mul_quat(acc, node->rotation.f);
+            block_store_quat(&block, i, inv_rot_acc.f);
+
+            /* The global position is needed by the children */
+            block.px[i] = node->position.x - parent_acc[4];
+            block.py[i] = node->position.y - parent_acc[5];
+            block.pz[i] = node->position.z - parent_acc[6];
+            ik_vec3_static_set(acc + 4, node->position.f);
+        }
+
+        if (translations == 0)
+            continue;
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            struct ik_node_t* node = p->nodes[block.slots[i]];
+            node->position.x = block.px[i];
+            node->position.y = block.py[i];
+            node->position.z = block.pz[i];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+node_changed(const struct program_t* p, uint32_t slot)
+{
+    return memcmp(p->nodes[slot]->transform, LOCAL(p, slot), sizeof(ikreal_t) * 7) != 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_transform_island_to_cache(struct program_t* p, uint32_t island_idx)
+{
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+    const struct program_island_t* island = &p->islands[island_idx];
+    uint32_t slot = island->slot_begin + island->slot_count - 1;
+    int cached = p->island_cached[island_idx];
+
+    p->slot_changed[slot] = !cached || node_changed(p, slot);
+    if (p->slot_changed[slot])
+    {
+        memcpy(ACC(p, slot), p->nodes[slot]->transform, sizeof(ikreal_t) * 7);
+        memcpy(LOCAL(p, slot), p->nodes[slot]->transform, sizeof(ikreal_t) * 7);
+    }
+    p->pos_x[slot] = ACC(p, slot)[4];
+    p->pos_y[slot] = ACC(p, slot)[5];
+    p->pos_z[slot] = ACC(p, slot)[6];
+
+    while (slot != island->slot_begin)
+    {
+        int i, count = 0;
+
+        /* Only the slots that changed, or whose parent changed, go into the block */
+        while (slot != island->slot_begin && count != BATCH_BLOCK)
+        {
+            struct ik_node_t* node = p->nodes[--slot];
+            const ikreal_t* parent_acc = ACC(p, p->parent[slot]);
+            ikreal_t* acc = ACC(p, slot);
+
+            p->slot_changed[slot] = !cached ||
+                p->slot_changed[p->parent[slot]] ||
+                node_changed(p, slot);
+            if (p->slot_changed[slot] == 0)
+            {
+                /* Saves the solver from gathering the positions separately */
+                p->pos_x[slot] = acc[4];
+                p->pos_y[slot] = acc[5];
+                p->pos_z[slot] = acc[6];
+                continue;
+            }
+
+            memcpy(LOCAL(p, slot), node->transform, sizeof(ikreal_t) * 7);
+            block.slots[count] = slot;
+            block_store_quat(&block, count, parent_acc);
+            block.px[count] = node->position.x;
+            block.py[count] = node->position.y;
+            block.pz[count] = node->position.z;
+            ik_quat_static_set(acc, parent_acc);
+            ik_quat_static_mul_quat(acc, node->rotation.f);
+            count++;
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            uint32_t s = block.slots[i];
+            const ikreal_t* parent_pos = ACC(p, p->parent[s]) + 4;
+            ikreal_t* pos = ACC(p, s) + 4;
+            p->pos_x[s] = pos[0] = parent_pos[0] + block.px[i];
+            p->pos_y[s] = pos[1] = parent_pos[1] + block.py[i];
+            p->pos_z[s] = pos[2] = parent_pos[2] + block.pz[i];
+        }
+    }
+
+    p->island_cached[island_idx] = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_transform_island_from_cache(struct program_t* p, uint32_t island_idx)
+{
+    struct block_t block;
+    const struct batch_kernels_t* batch = batch_kernels();
+    const struct program_island_t* island = &p->islands[island_idx];
+    uint32_t slot = island->slot_begin + island->slot_count - 1;
+
+    /* The solver never moves the base node */
+    p->slot_changed[slot] = 0;
+
+    while (slot != island->slot_begin)
+    {
+        int i, count = 0;
+
+        /*
+         * A node's local position changes if it moved, or if its parent
+         * moved. The accumulated rotations stay the same, since only
+         * positions are solved for.
+         */
+        while (slot != island->slot_begin && count != BATCH_BLOCK)
+        {
+            const ikreal_t* parent_acc;
+            ikreal_t* acc;
+
+            --slot;
+            parent_acc = ACC(p, p->parent[slot]);
+            acc = ACC(p, slot);
+            p->slot_changed[slot] = p->pos_x[slot] != acc[4] ||
+                                    p->pos_y[slot] != acc[5] ||
+                                    p->pos_z[slot] != acc[6];
+            if (p->slot_changed[slot])
+            {
+                acc[4] = p->pos_x[slot];
+                acc[5] = p->pos_y[slot];
+                acc[6] = p->pos_z[slot];
+            }
+            else if (p->slot_changed[p->parent[slot]] == 0)
+                continue;
+
+            /* Rotate by the inverse of the parent's accumulated rotation */
+            block.slots[count] = slot;
+            block_store_quat(&block, count, parent_acc);
+            block.qx[count] = -block.qx[count];
+            block.qy[count] = -block.qy[count];
+            block.qz[count] = -block.qz[count];
+            block.px[count] = acc[4] - parent_acc[4];
+            block.py[count] = acc[5] - parent_acc[5];
+            block.pz[count] = acc[6] - parent_acc[6];
+            count++;
+        }
+
+        batch->rotate(block.px, block.py, block.pz,
+                      block.qx, block.qy, block.qz, block.qw, count);
+
+        for (i = 0; i != count; ++i)
+        {
+            uint32_t s = block.slots[i];
+            struct ik_node_t* node = p->nodes[s];
+            ikreal_t* local = LOCAL(p, s);
+            node->position.x = local[4] = block.px[i];
+            node->position.y = local[5] = block.py[i];
+            node->position.z = local[6] = block.pz[i];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void
+ik_transform_island(struct program_t* program, uint32_t island_idx, uint8_t flags)
+{
+    const struct program_island_t* island = &program->islands[island_idx];
+
+    /* Same as the transform tables: Neither flag means both */
+    int rotations = (flags & TR_ROTATIONS) || !(flags & TR_TRANSLATIONS);
+    int translations = (flags & TR_TRANSLATIONS) || !(flags & TR_ROTATIONS);
+
+    if (flags & TR_L2G)
+        local_to_global(program, island, rotations, translations);
+    else
+        global_to_local(program, island, rotations, translations);
+}
@@ -1,5 +1,4 @@
 #include "ik/vec3_static.h"
-#include "ik/quat_static.h"
 #include <string.h>
 #include <math.h>
 
@@ -158,37 +157,24 @@ ik_vec3_static_cross(ikreal_t v1[3], const ikreal_t v2[3])
 }
 
 /* ------------------------------------------------------------------------- */
-static void
-mul_quat_no_normalize(ikreal_t q1[4], const ikreal_t q2[4])
-{
-    ik_vec3_t v1;
-    ik_vec3_t v2;
-    ik_vec3_static_set(v1.f, q1);
-    ik_vec3_static_set(v2.f, q2);
-
-    ik_vec3_static_mul_scalar(v1.f, q2[3]);
-    ik_vec3_static_mul_scalar(v2.f, q1[3]);
-    q1[3] = q1[3]*q2[3] - ik_vec3_static_dot(q1, q2);
-    ik_vec3_static_cross(q1, q2);
-    ik_vec3_static_add_vec3(q1, v1.f);
-    ik_vec3_static_add_vec3(q1, v2.f);
-}
 void
 ik_vec3_static_rotate(ikreal_t v[3], const ikreal_t q[4])
 {
-    /* P' = RPR' */
-    ik_quat_t result;
-    ik_quat_t conj;
-    ik_quat_t point;
-
-    ik_vec3_static_set(point.f, v);
-    point.w = 0.0;
-
-    ik_quat_static_set(conj.f, q);
-    ik_quat_static_conj(conj.f);
-
-    ik_quat_static_set(result.f, q);
-    mul_quat_no_normalize(result.f, point.f);
-    mul_quat_no_normalize(result.f, conj.f);
-    ik_vec3_static_set(v, result.f);
+    /*
+     * Expanding P' = RPR' with P = (v, 0) and R = (u, w) gives
+     *   v' = (w^2 - u.u)v + 2(u.v)u + 2w(u x v)
+     * which is a lot cheaper than doing two full quaternion multiplications.
+     * Note that this holds for non-unit quaternions as well.
+     */
+    ikreal_t uu = q[0]*q[0] + q[1]*q[1] + q[2]*q[2];
+    ikreal_t uv2 = 2.0 * (q[0]*v[0] + q[1]*v[1] + q[2]*v[2]);
+    ikreal_t s = q[3]*q[3] - uu;
+    ikreal_t w2 = 2.0 * q[3];
+    ikreal_t cx = q[1]*v[2] - q[2]*v[1];
+    ikreal_t cy = q[2]*v[0] - q[0]*v[2];
+    ikreal_t cz = q[0]*v[1] - q[1]*v[0];
+    ikreal_t x = v[0], y = v[1], z = v[2];
+    v[0] = s*x + uv2*q[0] + w2*cx;
+    v[1] = s*y + uv2*q[1] + w2*cy;
+    v[2] = s*z + uv2*q[2] + w2*cz;
 }
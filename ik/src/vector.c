@@ -90,11 +90,10 @@ vector_resize(struct vector_t* vector, uint32_t size)
 
     assert(vector);
 
-    if (vector->count < size)
-    {
-        if ((result = vector_expand(vector, VECTOR_ERROR, size)) == IK_OK)
-            vector->count = size;
-    }
+    if (vector->capacity < size)
+        result = vector_expand(vector, VECTOR_ERROR, size);
+    if (result == IK_OK && vector->count < size)
+        vector->count = size;
 
     return result;
 }
@@ -324,18 +323,27 @@ vector_expand(struct vector_t *vector,
         return IK_OK;
     }
 
+    /*
+     * If no insertion index is required, let the allocator grow the block. It
+     * may be able to do so in place.
+     */
+    if (insertion_index == VECTOR_ERROR || insertion_index >= new_count)
+    {
+        new_data = REALLOC(vector->data, new_count * vector->element_size);
+        if (!new_data)
+            return IK_RAN_OUT_OF_MEMORY;
+        vector->data = new_data;
+        vector->capacity = new_count;
+        return IK_OK;
+    }
+
     /* prepare for reallocating data */
     old_data = vector->data;
     new_data = MALLOC(new_count * vector->element_size);
     if (!new_data)
         return IK_RAN_OUT_OF_MEMORY;
 
-    /* if (no insertion index is required, copy all data to new memory */
-    if (insertion_index == VECTOR_ERROR || insertion_index >= new_count)
-        memcpy(new_data, old_data, vector->count * vector->element_size);
-
     /* keep space for one element at the insertion index */
-    else
     {
         /* copy old data up until right before insertion offset */
         vector_size_t offset = vector->element_size * insertion_index;